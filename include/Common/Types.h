@@ -65,10 +65,32 @@ struct SkeletonMesh : public Mesh
 	std::vector<MathLib::HVector4> mJoints;
 };
 
+// See Engine/PixelFormat.h for sizes and conversions
+enum class PixelFormat : uint8_t
+{
+	UNKNOWN,
+	R8,
+	RG8,
+	RGBA8,
+	RGBA16F,
+	RGBA32F,
+	// 4x4 blocks
+	BC1,
+	BC3,
+	BC5,
+	BC7,
+	COUNT
+};
+
 struct Image
 {
 	uint32_t mWidth = 0;
 	uint32_t mHeight = 0;
-	uint32_t mChannels = 0;
-	std::vector<float> mPixels;
+	PixelFormat mFormat = PixelFormat::UNKNOWN;
+	uint32_t mMipLevels = 1;
+	// Color channels hold sRGB encoded values, alpha is always linear
+	bool mIsSRGB = false;
+	// Tightly packed rows of pixels, or rows of blocks for compressed formats. Mip levels
+	// follow each other, largest first.
+	std::vector<uint8_t> mData;
 };
\ No newline at end of file
@@ -1,39 +1,288 @@
 #pragma once
 #include "Common/pch.h"
 #include "Model.h"
+#include "Engine/AsyncFileService.h"
+#include "Engine/AssetRegistry.h"
+#include "Engine/CookedTexture.h"
+#include <span>
+
+enum class AssetLoadStatus : uint8_t
+{
+    LOADING,
+    LOADED,
+    FAILED
+};
+
+template <typename Type>
+struct AssetLoadState
+{
+    std::string mPath;
+    AssetPathID mPathID = 0;
+    AssetHandle<Type> mAsset;
+    std::atomic<AssetLoadStatus> mStatus = AssetLoadStatus::LOADING;
+    // Highest priority any request for the path asked for
+    std::atomic<uint8_t> mPriority = JOB_PRIORITY_NORMAL;
+    JobCounter mCounter{1};
+};
+
+// Shared by every request for the same path while it loads
+template <typename Type>
+class AssetLoadHandle
+{
+public:
+    AssetLoadHandle() = default;
+    explicit AssetLoadHandle(SharedPtr<AssetLoadState<Type>> state) : m_State(std::move(state)) {}
+
+    bool IsValid() const
+    {
+        return m_State != nullptr;
+    }
+
+    AssetLoadStatus GetStatus() const
+    {
+        return m_State ? m_State->mStatus.load(std::memory_order_acquire) : AssetLoadStatus::FAILED;
+    }
+
+    bool IsDone() const
+    {
+        return GetStatus() != AssetLoadStatus::LOADING;
+    }
+
+    // Runs other jobs while waiting, true when the asset loaded
+    bool Wait() const
+    {
+        if (!m_State)
+            return false;
+        if (JobSystem *jobSystem = JobSystem::GetInstance())
+        {
+            jobSystem->WaitForCounter(m_State->mCounter);
+        }
+        return GetStatus() == AssetLoadStatus::LOADED;
+    }
+
+    // Reaches zero once the load finished, for jobs that wait on it
+    JobCounter &GetCounter() const
+    {
+        return m_State->mCounter;
+    }
+
+    const Type &Get() const
+    {
+        HASSERT(GetStatus() == AssetLoadStatus::LOADED);
+        return *m_State->mAsset;
+    }
+
+    // Keeps the asset alive after the load handle is gone
+    AssetHandle<Type> GetAsset() const
+    {
+        return GetStatus() == AssetLoadStatus::LOADED ? m_State->mAsset : AssetHandle<Type>();
+    }
+
+    const std::string &GetPath() const
+    {
+        return m_State->mPath;
+    }
+
+private:
+    SharedPtr<AssetLoadState<Type>> m_State;
+};
 
 template <typename Type>
 class AssetLoader
 {
 public:
-    virtual void ReadFile(const std::string &filename, Type &asset) = 0;
+    virtual ~AssetLoader() = default;
+
+    // Shares the registered asset when the path is loaded already, otherwise reads and
+    // decodes it on the calling thread. Empty when loading failed.
+    AssetHandle<Type> Load(const std::string &filename);
+    // Copies the asset out, Load avoids that
+    void ReadFile(const std::string &filename, Type &asset);
+
+    // Returns at once. Assets that are loaded already are shared right away, others are read
+    // on the AsyncFileService and decoded by a job of the given priority. Requests for a path
+    // that is still loading share its handle. The loader has to outlive its loads, see WaitIdle.
+    AssetLoadHandle<Type> ReadFileAsync(const std::string &filename, uint8_t priority = JOB_PRIORITY_NORMAL);
+    void WaitIdle();
+
+protected:
+    // Turns the bytes of a file into the asset, called from workers for asynchronous loads
+    virtual bool Decode(const std::string &filename, std::span<const uint8_t> data, Type &asset) = 0;
+    // What the asset counts against the registry budget
+    virtual uint64_t GetAssetBytes(const Type &asset) const
+    {
+        return sizeof(Type);
+    }
+
+private:
+    // Registers the asset, or fails the load when it is null
+    void FinishLoad(AssetLoadState<Type> &state, UniquePtr<Type> asset);
+
+private:
+    std::mutex m_LoadMutex;
+    std::unordered_map<AssetPathID, std::weak_ptr<AssetLoadState<Type>>> m_Loading;
+    JobCounter m_NumLoads;
 };
 
+template <typename Type>
+AssetHandle<Type> AssetLoader<Type>::Load(const std::string &filename)
+{
+    AssetPathID path = InternAssetPath(filename);
+    AssetRegistry<Type> &registry = AssetRegistry<Type>::GetInstance();
+    if (AssetHandle<Type> asset = registry.Find(path))
+        return asset;
+    std::vector<uint8_t> data;
+    UniquePtr<Type> asset = std::make_unique<Type>();
+    if (!ReadFileBytes(filename, data) || !Decode(filename, data, *asset))
+        return {};
+    const uint64_t bytes = GetAssetBytes(*asset);
+    return registry.Add(path, std::move(asset), bytes);
+}
+
+template <typename Type>
+void AssetLoader<Type>::ReadFile(const std::string &filename, Type &asset)
+{
+    if (AssetHandle<Type> loaded = Load(filename))
+    {
+        asset = *loaded;
+    }
+}
+
+template <typename Type>
+AssetLoadHandle<Type> AssetLoader<Type>::ReadFileAsync(const std::string &filename, uint8_t priority)
+{
+    AssetPathID path = InternAssetPath(filename);
+    SharedPtr<AssetLoadState<Type>> state;
+    {
+        std::lock_guard<std::mutex> guard(m_LoadMutex);
+        // Loads register their asset before they stop being in flight, so one of the two finds it
+        if (AssetHandle<Type> asset = AssetRegistry<Type>::GetInstance().Find(path))
+        {
+            state = std::make_shared<AssetLoadState<Type>>();
+            state->mPath = filename;
+            state->mPathID = path;
+            state->mAsset = std::move(asset);
+            state->mStatus.store(AssetLoadStatus::LOADED, std::memory_order_relaxed);
+            state->mCounter.Decrement();
+            return AssetLoadHandle<Type>(state);
+        }
+        auto it = m_Loading.find(path);
+        if (it != m_Loading.end())
+        {
+            state = it->second.lock();
+        }
+        if (state)
+        {
+            // A later request can raise the priority of the decode, as long as it hasn't started
+            uint8_t current = state->mPriority.load(std::memory_order_relaxed);
+            while (current < priority && !state->mPriority.compare_exchange_weak(current, priority, std::memory_order_relaxed))
+            {
+            }
+            return AssetLoadHandle<Type>(state);
+        }
+        state = std::make_shared<AssetLoadState<Type>>();
+        state->mPath = filename;
+        state->mPathID = path;
+        state->mPriority.store(priority, std::memory_order_relaxed);
+        m_Loading[path] = state;
+    }
+    m_NumLoads.Increment();
+
+    JobSystem *jobSystem = JobSystem::GetInstance();
+    if (jobSystem == nullptr)
+    {
+        std::vector<uint8_t> data;
+        UniquePtr<Type> asset = std::make_unique<Type>();
+        bool loaded = ReadFileBytes(filename, data) && Decode(filename, data, *asset);
+        FinishLoad(*state, loaded ? std::move(asset) : nullptr);
+        return AssetLoadHandle<Type>(state);
+    }
+    FileReadRequest request;
+    request.mPath = filename;
+    request.mPriority = priority;
+    jobSystem->GetFileService().Read(request, [this, jobSystem, state](FileReadResult &result)
+                                     {
+        if (!result.mSucceeded)
+        {
+            FinishLoad(*state, nullptr);
+            return;
+        }
+        UniquePtr<Job> job = std::make_unique<Job>([this, state, data = std::move(result.mData)]()
+                                                   {
+            UniquePtr<Type> asset = std::make_unique<Type>();
+            bool loaded = Decode(state->mPath, data, *asset);
+            FinishLoad(*state, loaded ? std::move(asset) : nullptr); },
+                                                   UINT_MAX, state->mPriority.load(std::memory_order_relaxed));
+        if (!jobSystem->SubmitJob(job))
+        {
+            job->Execute();
+        } });
+    return AssetLoadHandle<Type>(state);
+}
+
+template <typename Type>
+void AssetLoader<Type>::WaitIdle()
+{
+    if (JobSystem *jobSystem = JobSystem::GetInstance())
+    {
+        jobSystem->WaitForCounter(m_NumLoads);
+    }
+}
+
+template <typename Type>
+void AssetLoader<Type>::FinishLoad(AssetLoadState<Type> &state, UniquePtr<Type> asset)
+{
+    const bool loaded = asset != nullptr;
+    if (loaded)
+    {
+        const uint64_t bytes = GetAssetBytes(*asset);
+        state.mAsset = AssetRegistry<Type>::GetInstance().Add(state.mPathID, std::move(asset), bytes);
+    }
+    else
+    {
+        HLOG_ERROR("Loading %s failed\n", state.mPath.c_str());
+    }
+    {
+        std::lock_guard<std::mutex> guard(m_LoadMutex);
+        auto it = m_Loading.find(state.mPathID);
+        if (it != m_Loading.end() && it->second.lock().get() == &state)
+        {
+            m_Loading.erase(it);
+        }
+    }
+    state.mStatus.store(loaded ? AssetLoadStatus::LOADED : AssetLoadStatus::FAILED, std::memory_order_release);
+    state.mCounter.Decrement();
+    m_NumLoads.Decrement();
+}
+
 class ImageLoader : virtual public AssetLoader<Image>
 {
 public:
-    void ReadFile(const std::string &filename, Image &asset) override;
+    // Imports the image, generates its mips, compresses it and writes it out in the cooked
+    // format, which Load and ReadFileAsync read back as is. See CookedTexture.h.
+    bool Cook(const std::string &filename, const std::string &cookedPath, const TextureCookSettings &settings = {});
 
-private:
-    std::unordered_map<std::string, Image> m_images;
+protected:
+    bool Decode(const std::string &filename, std::span<const uint8_t> data, Image &asset) override;
+    uint64_t GetAssetBytes(const Image &asset) const override;
 };
 
 class ModelLoader : virtual public AssetLoader<Model>
 {
 public:
-    void ReadFile(const std::string &filename, Model &asset) override;
+    // Imports the model and writes it out in the cooked format, which Load and ReadFileAsync
+    // read back without the importer. See CookedMesh.h.
+    bool Cook(const std::string &filename, const std::string &cookedPath);
 
-private:
-    std::unordered_map<std::string, Model> m_models;
+protected:
+    bool Decode(const std::string &filename, std::span<const uint8_t> data, Model &asset) override;
+    uint64_t GetAssetBytes(const Model &asset) const override;
 };
 
 class MaterialLoader : virtual public AssetLoader<IMaterial>
 {
-public:
-    void ReadFile(const std::string &filename, IMaterial &asset) override;
-
-private:
-    std::unordered_map<std::string, IMaterial> m_materials;
+protected:
+    bool Decode(const std::string &filename, std::span<const uint8_t> data, IMaterial &asset) override;
 };
 
 inline bool TestModelLoader()
@@ -0,0 +1,361 @@
+#pragma once
+#include "Common/pch.h"
+#include <atomic>
+#include <string_view>
+#include <typeinfo>
+#include <utility>
+
+// Paths are interned once and referred to by their 64-bit hash from then on
+using AssetPathID = uint64_t;
+
+AssetPathID InternAssetPath(std::string_view path);
+// Empty for ids that were never interned
+const std::string &GetAssetPath(AssetPathID id);
+
+// Weak reference to a registered asset, safe to keep around after the asset was freed
+struct AssetID
+{
+    uint32_t mIndex = UINT32_MAX;
+    uint32_t mGeneration = 0;
+
+    bool IsValid() const
+    {
+        return mIndex != UINT32_MAX;
+    }
+};
+
+struct AssetCacheStats
+{
+    uint64_t mBudgetBytes = 0;
+    // Every registered asset, whether handles pin it or it is only kept around as cache
+    uint64_t mResidentBytes = 0;
+    uint64_t mPinnedBytes = 0;
+    uint32_t mNumAssets = 0;
+    uint32_t mNumPinned = 0;
+    uint64_t mNumHits = 0;
+    uint64_t mNumMisses = 0;
+    uint64_t mNumEvictions = 0;
+    uint64_t mEvictedBytes = 0;
+
+    double GetHitRate() const
+    {
+        uint64_t lookups = mNumHits + mNumMisses;
+        return lookups ? static_cast<double>(mNumHits) / lookups : 0.0;
+    }
+};
+
+template <typename Type>
+class AssetRegistry;
+
+template <typename Type>
+struct AssetSlot
+{
+    UniquePtr<const Type> mAsset;
+    // Handles pin the asset, only assets without any can be evicted
+    std::atomic<uint32_t> mRefCount = 0;
+    // Bumped whenever the slot is freed, so handles and ids of the previous asset don't match
+    std::atomic<uint32_t> mGeneration = 0;
+    uint32_t mIndex = 0;
+    AssetPathID mPath = 0;
+    uint64_t mBytes = 0;
+    // CLOCK bit, set when a lookup hits and cleared as the hand passes
+    bool mIsReferenced = false;
+};
+
+// Counted reference to an immutable registered asset. Copies share the asset, which stays
+// resident while any handle to it is alive.
+template <typename Type>
+class AssetHandle
+{
+public:
+    AssetHandle() = default;
+    AssetHandle(const AssetHandle &other) : m_Slot(other.m_Slot), m_Generation(other.m_Generation)
+    {
+        if (m_Slot)
+        {
+            m_Slot->mRefCount.fetch_add(1, std::memory_order_relaxed);
+        }
+    }
+    AssetHandle(AssetHandle &&other) noexcept
+        : m_Slot(std::exchange(other.m_Slot, nullptr)), m_Generation(other.m_Generation) {}
+    AssetHandle &operator=(AssetHandle other) noexcept
+    {
+        std::swap(m_Slot, other.m_Slot);
+        std::swap(m_Generation, other.m_Generation);
+        return *this;
+    }
+    ~AssetHandle()
+    {
+        Reset();
+    }
+
+    void Reset();
+
+    bool IsValid() const
+    {
+        return m_Slot != nullptr;
+    }
+
+    explicit operator bool() const
+    {
+        return IsValid();
+    }
+
+    const Type *Get() const
+    {
+        if (!m_Slot)
+            return nullptr;
+        HASSERT(m_Slot->mGeneration.load(std::memory_order_relaxed) == m_Generation);
+        return m_Slot->mAsset.get();
+    }
+
+    const Type &operator*() const
+    {
+        return *Get();
+    }
+
+    const Type *operator->() const
+    {
+        return Get();
+    }
+
+    AssetID GetID() const
+    {
+        return m_Slot ? AssetID{m_Slot->mIndex, m_Generation} : AssetID{};
+    }
+
+    AssetPathID GetPathID() const
+    {
+        return m_Slot ? m_Slot->mPath : 0;
+    }
+
+    uint32_t GetRefCount() const
+    {
+        return m_Slot ? m_Slot->mRefCount.load(std::memory_order_relaxed) : 0;
+    }
+
+    friend bool operator==(const AssetHandle &a, const AssetHandle &b)
+    {
+        return a.m_Slot == b.m_Slot;
+    }
+
+private:
+    friend class AssetRegistry<Type>;
+
+    // Takes over a reference the registry already counted
+    AssetHandle(AssetSlot<Type> *slot, uint32_t generation) : m_Slot(slot), m_Generation(generation) {}
+
+    AssetSlot<Type> *m_Slot = nullptr;
+    uint32_t m_Generation = 0;
+};
+
+// One registry per asset type, shared by every loader of that type. Assets are keyed by
+// interned path, a lookup is one hash map probe and hands out a handle to the shared data
+// instead of a copy. Slots live in a deque so handles can point at them while it grows.
+// Assets nobody holds a handle to stay resident as a cache until the registry goes over its
+// byte budget, then CLOCK evicts the ones that went longest without a lookup.
+template <typename Type>
+class AssetRegistry
+{
+public:
+    static constexpr uint64_t DEFAULT_BUDGET_BYTES = 256ull << 20;
+
+    static AssetRegistry &GetInstance()
+    {
+        static AssetRegistry registry;
+        return registry;
+    }
+
+    // Empty when the path isn't loaded
+    AssetHandle<Type> Find(AssetPathID path)
+    {
+        std::lock_guard<std::mutex> guard(m_Mutex);
+        auto it = m_Paths.find(path);
+        if (it == m_Paths.end())
+        {
+            m_Stats.mNumMisses++;
+            return {};
+        }
+        m_Stats.mNumHits++;
+        return Acquire(m_Slots[it->second], true);
+    }
+
+    // Registers the asset under path, bytes is what it counts against the budget. When another
+    // thread registered the path first, the asset passed in is dropped and the registered one
+    // is returned.
+    AssetHandle<Type> Add(AssetPathID path, UniquePtr<Type> asset, uint64_t bytes = sizeof(Type))
+    {
+        HASSERT(asset != nullptr);
+        std::vector<UniquePtr<const Type>> evicted;
+        std::lock_guard<std::mutex> guard(m_Mutex);
+        auto it = m_Paths.find(path);
+        if (it != m_Paths.end())
+            return Acquire(m_Slots[it->second], true);
+        uint32_t index = 0;
+        if (!m_FreeSlots.empty())
+        {
+            index = m_FreeSlots.back();
+            m_FreeSlots.pop_back();
+        }
+        else
+        {
+            index = static_cast<uint32_t>(m_Slots.size());
+            m_Slots.emplace_back().mIndex = index;
+        }
+        AssetSlot<Type> &slot = m_Slots[index];
+        slot.mAsset = std::move(asset);
+        slot.mPath = path;
+        slot.mBytes = bytes;
+        m_Paths.emplace(path, index);
+        m_Stats.mResidentBytes += bytes;
+        // New assets start without their CLOCK bit, they are evicted first unless looked up again
+        AssetHandle<Type> handle = Acquire(slot, false);
+        // The new asset is pinned, it can only push others out
+        EvictOverBudget(evicted);
+        return handle;
+    }
+
+    // Empty once the asset the id was taken from has been freed
+    AssetHandle<Type> Resolve(AssetID id)
+    {
+        std::lock_guard<std::mutex> guard(m_Mutex);
+        if (id.mIndex >= m_Slots.size())
+            return {};
+        AssetSlot<Type> &slot = m_Slots[id.mIndex];
+        if (slot.mGeneration.load(std::memory_order_relaxed) != id.mGeneration || !slot.mAsset)
+            return {};
+        return Acquire(slot, true);
+    }
+
+    uint32_t GetNumAssets() const
+    {
+        std::lock_guard<std::mutex> guard(m_Mutex);
+        return static_cast<uint32_t>(m_Paths.size());
+    }
+
+    // A budget of 0 frees assets as soon as their last handle goes
+    void SetBudget(uint64_t bytes)
+    {
+        std::vector<UniquePtr<const Type>> evicted;
+        std::lock_guard<std::mutex> guard(m_Mutex);
+        m_Stats.mBudgetBytes = bytes;
+        EvictOverBudget(evicted);
+    }
+
+    // Drops every asset no handle pins, e.g. when a level is unloaded
+    void EvictUnused()
+    {
+        std::vector<UniquePtr<const Type>> evicted;
+        std::lock_guard<std::mutex> guard(m_Mutex);
+        for (AssetSlot<Type> &slot : m_Slots)
+        {
+            if (slot.mAsset && slot.mRefCount.load(std::memory_order_acquire) == 0)
+            {
+                evicted.push_back(Evict(slot));
+            }
+        }
+    }
+
+    AssetCacheStats GetStats() const
+    {
+        std::lock_guard<std::mutex> guard(m_Mutex);
+        AssetCacheStats stats = m_Stats;
+        stats.mNumAssets = static_cast<uint32_t>(m_Paths.size());
+        for (const AssetSlot<Type> &slot : m_Slots)
+        {
+            if (slot.mAsset && slot.mRefCount.load(std::memory_order_relaxed) != 0)
+            {
+                stats.mNumPinned++;
+                stats.mPinnedBytes += slot.mBytes;
+            }
+        }
+        return stats;
+    }
+
+private:
+    friend class AssetHandle<Type>;
+
+    AssetRegistry()
+    {
+        m_Stats.mBudgetBytes = DEFAULT_BUDGET_BYTES;
+    }
+
+    AssetHandle<Type> Acquire(AssetSlot<Type> &slot, bool isHit)
+    {
+        // Always under the lock, so the eviction scan never races a slot going from 0 to 1
+        slot.mRefCount.fetch_add(1, std::memory_order_relaxed);
+        slot.mIsReferenced |= isHit;
+        return AssetHandle<Type>(&slot, slot.mGeneration.load(std::memory_order_relaxed));
+    }
+
+    // Called when the last handle went, the asset may have been looked up again since
+    void Release(AssetSlot<Type> &slot, uint32_t generation)
+    {
+        std::vector<UniquePtr<const Type>> evicted;
+        std::lock_guard<std::mutex> guard(m_Mutex);
+        if (slot.mRefCount.load(std::memory_order_acquire) != 0 || slot.mGeneration.load(std::memory_order_relaxed) != generation)
+            return;
+        EvictOverBudget(evicted);
+    }
+
+    // Evicted assets are handed out so they are destroyed once the lock is released
+    UniquePtr<const Type> Evict(AssetSlot<Type> &slot)
+    {
+        m_Paths.erase(slot.mPath);
+        m_Stats.mResidentBytes -= slot.mBytes;
+        m_Stats.mNumEvictions++;
+        m_Stats.mEvictedBytes += slot.mBytes;
+        slot.mPath = 0;
+        slot.mBytes = 0;
+        slot.mIsReferenced = false;
+        slot.mGeneration.fetch_add(1, std::memory_order_relaxed);
+        m_FreeSlots.push_back(slot.mIndex);
+        return std::move(slot.mAsset);
+    }
+
+    void EvictOverBudget(std::vector<UniquePtr<const Type>> &evicted)
+    {
+        // Two turns of the hand clear every CLOCK bit and then reach every unpinned asset
+        const size_t slotCount = m_Slots.size();
+        for (size_t step = 0; step < 2 * slotCount && m_Stats.mResidentBytes > m_Stats.mBudgetBytes; step++)
+        {
+            AssetSlot<Type> &slot = m_Slots[m_ClockHand];
+            m_ClockHand = (m_ClockHand + 1) % slotCount;
+            if (!slot.mAsset || slot.mRefCount.load(std::memory_order_acquire) != 0)
+                continue;
+            if (slot.mIsReferenced)
+            {
+                slot.mIsReferenced = false;
+                continue;
+            }
+            evicted.push_back(Evict(slot));
+        }
+        const bool isOverBudget = m_Stats.mResidentBytes > m_Stats.mBudgetBytes;
+        if (isOverBudget && !m_IsOverBudget)
+        {
+            HLOG_WARNING("%s assets in use take %llu bytes, over the budget of %llu\n", typeid(Type).name(),
+                         static_cast<unsigned long long>(m_Stats.mResidentBytes), static_cast<unsigned long long>(m_Stats.mBudgetBytes));
+        }
+        m_IsOverBudget = isOverBudget;
+    }
+
+private:
+    mutable std::mutex m_Mutex;
+    std::deque<AssetSlot<Type>> m_Slots;
+    std::vector<uint32_t> m_FreeSlots;
+    std::unordered_map<AssetPathID, uint32_t> m_Paths;
+    size_t m_ClockHand = 0;
+    AssetCacheStats m_Stats;
+    // Everything left is pinned, warn once each time the budget is exceeded
+    bool m_IsOverBudget = false;
+};
+
+template <typename Type>
+void AssetHandle<Type>::Reset()
+{
+    AssetSlot<Type> *slot = std::exchange(m_Slot, nullptr);
+    if (slot && slot->mRefCount.fetch_sub(1, std::memory_order_acq_rel) == 1)
+    {
+        AssetRegistry<Type>::GetInstance().Release(*slot, m_Generation);
+    }
+}
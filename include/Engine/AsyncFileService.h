@@ -0,0 +1,128 @@
+#pragma once
+#include "Common/pch.h"
+#include "Engine/JobSystem.h"
+#include <condition_variable>
+#include <span>
+
+struct FileReadRequest
+{
+    static constexpr uint64_t WHOLE_FILE = UINT64_MAX;
+
+    std::string mPath;
+    uint64_t mOffset = 0;
+    // Reads are cut short at the end of the file
+    uint64_t mSize = WHOLE_FILE;
+    // Incremented when the read is queued and decremented after its callback ran
+    JobCounter *mCounter = nullptr;
+    uint32_t mPipeLineID = 0;
+    uint8_t mPriority = 0;
+};
+
+struct FileReadResult
+{
+    std::string mPath;
+    std::vector<uint8_t> mData;
+    bool mSucceeded = false;
+};
+
+using FileReadCallback = std::function<void(FileReadResult &)>;
+
+struct AsyncFileServicePolicy
+{
+    // Reads wait in the queue while the reads in flight, and the data they returned that no
+    // callback has picked up yet, add up to this many bytes. A larger read still goes alone.
+    uint64_t mMaxInFlightBytes = 64ull << 20;
+    // Reads up to this size are grouped, up to mMaxBatchReads of them per submission
+    uint32_t mSmallReadBytes = 64 << 10;
+    uint32_t mMaxBatchReads = 32;
+    // Reads handed to the kernel or the I/O threads at a time
+    uint32_t mQueueDepth = 64;
+    // Threads doing blocking reads when io_uring is off or not available
+    uint32_t mThreadCount = 2;
+    bool mUseIoUring = true;
+};
+
+class IoUring;
+
+// Reads files on its own threads and submits the callbacks as jobs once the data is in, so
+// workers never block on the disk. On Linux the reads go through io_uring, elsewhere or when
+// the kernel refuses it a few threads do blocking reads instead.
+class AsyncFileService
+{
+public:
+    AsyncFileService(JobSystem *jobSystem, const AsyncFileServicePolicy &policy = {});
+    AsyncFileService(const AsyncFileService &) = delete;
+    AsyncFileService &operator=(const AsyncFileService &) = delete;
+    // Waits for every read and callback still pending
+    ~AsyncFileService();
+
+    void Read(const FileReadRequest &request, FileReadCallback onComplete);
+    // Queued together, so small reads among them end up in the same batches
+    void Read(std::span<const FileReadRequest> requests, const FileReadCallback &onComplete);
+    void ReadFile(const std::string &path, FileReadCallback onComplete, JobCounter *counter = nullptr, uint32_t pipeLineID = 0);
+    // Waits with JobSystem::WaitForCounter, a worker calling it runs other jobs meanwhile
+    bool ReadFileAndWait(const std::string &path, std::vector<uint8_t> &data);
+    void WaitIdle();
+
+    bool IsUsingIoUring() const;
+    uint64_t GetInFlightBytes() const;
+    uint64_t GetPeakInFlightBytes() const;
+    uint64_t GetNumReads() const;
+    uint64_t GetNumBatches() const;
+
+private:
+    struct PendingRead
+    {
+        FileReadRequest mRequest;
+        FileReadCallback mOnComplete;
+        FileReadResult mResult;
+        uint64_t mLength = 0;
+        bool mIsInFlight = false;
+#ifdef __linux__
+        int mFile = -1;
+#endif
+    };
+    using Batch = std::vector<UniquePtr<PendingRead>>;
+
+    void Dispatch();
+    bool Prepare(PendingRead &read);
+    bool HasRoom(const PendingRead &read) const;
+    void SubmitBatch(Batch &batch);
+    void RunReadThread();
+    void ReadBlocking(PendingRead &read);
+    void Complete(UniquePtr<PendingRead> read);
+#ifdef __linux__
+    void SubmitToRing(Batch &batch);
+    void RunRingCompletions();
+#endif
+
+private:
+    JobSystem *m_JobSystem = nullptr;
+    AsyncFileServicePolicy m_Policy;
+    // Reads queued but not yet given to a backend
+    std::deque<UniquePtr<PendingRead>> m_Queue;
+    // Batches waiting for a blocking read thread
+    std::deque<Batch> m_Batches;
+    mutable std::mutex m_Mutex;
+    std::condition_variable m_QueueCV;
+    std::condition_variable m_RoomCV;
+    std::condition_variable m_BatchCV;
+    bool m_IsStopping = false;
+    uint64_t m_InFlightBytes = 0;
+    uint64_t m_PeakInFlightBytes = 0;
+    uint32_t m_NumInFlight = 0;
+    uint64_t m_NumReads = 0;
+    uint64_t m_NumBatches = 0;
+    // Reads whose callback hasn't finished yet
+    JobCounter m_Outstanding;
+    std::thread m_DispatchThread;
+    std::vector<std::thread> m_ReadThreads;
+    UniquePtr<IoUring> m_Ring;
+    std::thread m_RingThread;
+};
+
+// Reads through the JobSystem's file service when there is one, with a blocking read otherwise
+bool ReadFileBytes(const std::string &path, std::vector<uint8_t> &data);
+// Writes to a uniquely named path.*.tmp file and renames it into place, readers never see a
+// partially written file and concurrent writers of one path don't get in each other's way
+bool WriteFileAtomically(const std::string &path, std::span<const uint8_t> data);
@@ -0,0 +1,83 @@
+#pragma once
+#include "Common/pch.h"
+#include "Engine/MappedFile.h"
+#include <span>
+
+// Cooked meshes are stored in the layout Mesh uses in memory, little endian, every stream
+// aligned so it can be used in place from a mapping of the file:
+//   CookedMeshFileHeader, CookedMeshRecord[mNumMeshes], streams
+inline constexpr uint32_t COOKED_MESH_MAGIC = 0x48534D48; // "HMSH"
+// Bump whenever the layout changes, older files are rejected and have to be cooked again
+inline constexpr uint32_t COOKED_MESH_VERSION = 1;
+inline constexpr uint64_t COOKED_MESH_ALIGNMENT = 16;
+inline constexpr const char *COOKED_MESH_EXTENSION = ".hmesh";
+
+// CookedMeshRecord::mFlags
+inline constexpr uint32_t COOKED_MESH_HAS_NORMALS = 1u << 0;
+inline constexpr uint32_t COOKED_MESH_HAS_TANGENTS = 1u << 1;
+
+struct CookedMeshFileHeader
+{
+    uint32_t mMagic = COOKED_MESH_MAGIC;
+    uint32_t mVersion = COOKED_MESH_VERSION;
+    uint32_t mNumMeshes = 0;
+    uint32_t mReserved = 0;
+    uint64_t mFileSize = 0;
+    uint64_t mReserved2 = 0;
+};
+
+struct CookedMeshRecord
+{
+    uint32_t mNumVertices = 0;
+    uint32_t mNumIndices = 0;
+    uint32_t mNumTexCoordSets = 0;
+    uint32_t mFlags = 0;
+    float mColor[4] = {};
+    // Byte offsets from the start of the file, texture coordinate sets follow each other
+    // with their size rounded up to the alignment
+    uint64_t mVerticesOffset = 0;
+    uint64_t mNormalsOffset = 0;
+    uint64_t mTangentsOffset = 0;
+    uint64_t mTexCoordsOffset = 0;
+    uint64_t mIndicesOffset = 0;
+};
+
+// Points into the cooked data, valid as long as the CookedModel it came from
+struct CookedMeshView
+{
+    std::span<const MathLib::HVector3> mVertices;
+    std::span<const MathLib::HVector3> mNormals;
+    std::span<const MathLib::HVector4> mTangents;
+    std::vector<std::span<const MathLib::HVector2>> mTexCoordsArray;
+    std::span<const uint32_t> mIndices;
+    Color mColor;
+
+    // One bulk copy per stream
+    void CopyTo(Mesh &mesh) const;
+};
+
+bool SerializeCookedMeshes(std::span<const Mesh> meshes, std::vector<uint8_t> &file);
+// Writes to a temporary file first, readers never see a partially written one
+bool WriteCookedMeshes(const std::string &path, std::span<const Mesh> meshes);
+bool IsCookedMeshData(std::span<const uint8_t> data);
+
+class CookedModel
+{
+public:
+    // Maps the file, nothing is read until the streams are touched
+    bool Open(const std::string &path);
+    // Views data the caller keeps alive, it has to be aligned like a heap allocation
+    bool Parse(std::span<const uint8_t> data);
+
+    uint32_t GetNumMeshes() const
+    {
+        return static_cast<uint32_t>(m_Records.size());
+    }
+
+    CookedMeshView GetMesh(uint32_t index) const;
+
+private:
+    MappedFile m_File;
+    std::span<const uint8_t> m_Data;
+    std::span<const CookedMeshRecord> m_Records;
+};
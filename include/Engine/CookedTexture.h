@@ -0,0 +1,47 @@
+#pragma once
+#include "Common/pch.h"
+#include "Engine/MipGenerator.h"
+#include "Engine/TextureCompressor.h"
+#include <span>
+
+// Cooked textures hold the final texels with their whole mip chain, ready for upload, so
+// nothing is filtered or compressed at load time:
+//   CookedTextureFileHeader, mip levels largest first as Image lays them out
+inline constexpr uint32_t COOKED_TEXTURE_MAGIC = 0x58455448; // "HTEX"
+// Bump whenever the layout changes, older files are rejected and have to be cooked again
+inline constexpr uint32_t COOKED_TEXTURE_VERSION = 1;
+inline constexpr const char *COOKED_TEXTURE_EXTENSION = ".htex";
+
+// CookedTextureFileHeader::mFlags
+inline constexpr uint32_t COOKED_TEXTURE_SRGB = 1u << 0;
+
+struct CookedTextureFileHeader
+{
+    uint32_t mMagic = COOKED_TEXTURE_MAGIC;
+    uint32_t mVersion = COOKED_TEXTURE_VERSION;
+    uint32_t mWidth = 0;
+    uint32_t mHeight = 0;
+    uint32_t mMipLevels = 0;
+    uint32_t mFormat = 0;
+    uint32_t mFlags = 0;
+    uint32_t mReserved = 0;
+    uint64_t mFileSize = 0;
+    uint64_t mReserved2 = 0;
+};
+
+struct TextureCookSettings
+{
+    // Color textures are authored in sRGB, data like normal maps is linear
+    bool mIsSRGB = true;
+    MipGenerationSettings mMips;
+    bool mIsCompressed = true;
+    TextureCompressionSettings mCompression;
+};
+
+// Generates the mip chain and compresses every level
+bool CookTexture(const Image &source, const TextureCookSettings &settings, Image &cooked);
+bool SerializeCookedTexture(const Image &image, std::vector<uint8_t> &file);
+// Writes to a temporary file first, readers never see a partially written one
+bool WriteCookedTexture(const std::string &path, const Image &image);
+bool IsCookedTextureData(std::span<const uint8_t> data);
+bool ReadCookedTexture(std::span<const uint8_t> data, Image &image);
@@ -0,0 +1,84 @@
+#pragma once
+#include "Common/pch.h"
+#include <span>
+
+struct LogicalCpu
+{
+    uint32_t mID = 0;
+    // Physical core, unique across packages
+    uint32_t mCoreID = 0;
+    uint32_t mPackageID = 0;
+    // CPUs sharing the last level cache (L3 on most desktop parts)
+    uint32_t mCacheDomainID = 0;
+    uint32_t mNumaNode = 0;
+    // 0 for the first hardware thread of a core, 1+ for its SMT siblings
+    uint32_t mSmtIndex = 0;
+};
+
+// Where the workers of a pipeline are pinned
+enum class PipeLinePlacement
+{
+    // Not pinned, the OS schedules the workers anywhere
+    ANY,
+    // One worker per physical core, spread over cache domains
+    SPREAD,
+    // All workers inside one last level cache domain, e.g. the render pipeline
+    SHARED_CACHE,
+    // Second hardware threads of cores, for workers that mostly wait such as file I/O
+    SMT_SIBLINGS
+};
+
+class CpuTopology
+{
+public:
+    CpuTopology() = default;
+
+    // Reads the topology of this machine, falls back to a flat layout when it can't
+    static CpuTopology Detect();
+    // Parses a sysfs tree, root is normally /sys/devices/system
+    static bool ParseSysfs(const std::string &root, CpuTopology &topology);
+    // count CPUs, each its own core, in one cache domain and NUMA node
+    static CpuTopology MakeFlat(uint32_t count);
+    // Pins the calling thread to cpuID, UINT_MAX lets it run anywhere again
+    static bool SetCurrentThreadAffinity(uint32_t cpuID);
+
+    // Picks count CPUs for a pipeline, wrapping around when there are fewer than count.
+    // cpuLoad[i] is how many workers are already pinned to CPU i, less loaded CPUs come first.
+    // Returns nothing for PipeLinePlacement::ANY.
+    std::vector<LogicalCpu> SelectCpus(PipeLinePlacement placement, uint32_t count, std::span<const uint32_t> cpuLoad = {}) const;
+
+    const std::vector<LogicalCpu> &GetLogicalCpus() const
+    {
+        return m_Cpus;
+    }
+
+    uint32_t GetNumLogicalCpus() const
+    {
+        return static_cast<uint32_t>(m_Cpus.size());
+    }
+
+    uint32_t GetNumPhysicalCores() const
+    {
+        return m_NumPhysicalCores;
+    }
+
+    uint32_t GetNumCacheDomains() const
+    {
+        return m_NumCacheDomains;
+    }
+
+    uint32_t GetNumNumaNodes() const
+    {
+        return m_NumNumaNodes;
+    }
+
+private:
+    // Renumbers cores and cache domains densely and fills in the SMT indices and counts
+    void Finalize();
+
+private:
+    std::vector<LogicalCpu> m_Cpus;
+    uint32_t m_NumPhysicalCores = 0;
+    uint32_t m_NumCacheDomains = 0;
+    uint32_t m_NumNumaNodes = 0;
+};
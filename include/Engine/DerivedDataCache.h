@@ -0,0 +1,115 @@
+#pragma once
+#include "Common/pch.h"
+#include <list>
+#include <span>
+#include <string_view>
+
+// Names a piece of derived data by everything it was made from, so it never has to be
+// invalidated: changed sources, importer versions or settings simply give a new key
+struct DerivedDataKey
+{
+    uint64_t mHigh = 0;
+    uint64_t mLow = 0;
+
+    bool operator==(const DerivedDataKey &other) const = default;
+    // 32 hex digits
+    std::string ToString() const;
+};
+
+// Streaming MurmurHash3 x64 128 over the inputs of a key
+class DerivedDataKeyBuilder
+{
+public:
+    // Kind separates the outputs of different importers made from the same bytes
+    explicit DerivedDataKeyBuilder(std::string_view kind);
+
+    DerivedDataKeyBuilder &Add(std::span<const uint8_t> bytes);
+    // Length prefixed, so neighboring strings can't run into each other
+    DerivedDataKeyBuilder &Add(std::string_view text);
+    DerivedDataKeyBuilder &Add(uint64_t value);
+    DerivedDataKey Finish() const;
+
+private:
+    void MixBlock(const uint8_t *block);
+
+private:
+    uint64_t m_H1 = 0;
+    uint64_t m_H2 = 0;
+    uint64_t m_Length = 0;
+    uint8_t m_Tail[16] = {};
+    uint32_t m_TailSize = 0;
+};
+
+struct DerivedDataCacheStats
+{
+    uint64_t mBudgetBytes = 0;
+    uint64_t mResidentBytes = 0;
+    uint32_t mNumEntries = 0;
+    uint64_t mNumHits = 0;
+    uint64_t mNumMisses = 0;
+    uint64_t mNumWrites = 0;
+    uint64_t mNumEvictions = 0;
+    uint64_t mEvictedBytes = 0;
+
+    double GetHitRate() const
+    {
+        uint64_t lookups = mNumHits + mNumMisses;
+        return lookups ? static_cast<double>(mNumHits) / lookups : 0.0;
+    }
+};
+
+// Cooked outputs on disk, one file per key under <directory>/<first two digits>/<key>. Files
+// are written to a temporary name and renamed, and carry a checksum, so a crash or a damaged
+// file only ever costs a miss. The least recently used entries are deleted once the directory
+// grows past its budget, last use survives restarts as the file's write time.
+// Lookups and stores are safe from any thread.
+class DerivedDataCache
+{
+public:
+    static constexpr uint64_t DEFAULT_BUDGET_BYTES = 4ull << 30;
+
+    static DerivedDataCache &GetInstance()
+    {
+        static DerivedDataCache cache;
+        return cache;
+    }
+
+    // Creates the directory when it is missing and indexes the entries already in it. Until
+    // then every lookup misses and nothing is stored.
+    bool Open(const std::string &directory, uint64_t budgetBytes = DEFAULT_BUDGET_BYTES);
+    void Close();
+    bool IsOpen() const;
+
+    bool Get(const DerivedDataKey &key, std::vector<uint8_t> &data);
+    bool Put(const DerivedDataKey &key, std::span<const uint8_t> data);
+    void SetBudget(uint64_t bytes);
+    DerivedDataCacheStats GetStats() const;
+
+private:
+    struct Entry
+    {
+        uint64_t mBytes = 0;
+        std::list<DerivedDataKey>::iterator mRecency;
+    };
+
+    struct KeyHash
+    {
+        size_t operator()(const DerivedDataKey &key) const
+        {
+            return static_cast<size_t>(key.mLow);
+        }
+    };
+
+    std::string GetEntryPath(const DerivedDataKey &key) const;
+    void Remove(const DerivedDataKey &key);
+    // Paths of the evicted entries, deleted once the lock is released
+    void EvictOverBudget(std::vector<std::string> &evicted);
+
+private:
+    mutable std::mutex m_Mutex;
+    std::string m_Directory;
+    // Least recently used at the front
+    std::list<DerivedDataKey> m_Recency;
+    std::unordered_map<DerivedDataKey, Entry, KeyHash> m_Entries;
+    DerivedDataCacheStats m_Stats;
+};
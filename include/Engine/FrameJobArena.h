@@ -0,0 +1,119 @@
+#pragma once
+#include "Common/pch.h"
+#include "Engine/JobSystem.h"
+#include <atomic>
+#include <span>
+
+// Linear allocator for jobs and data that only live for one frame, such as culling batches
+// or command recording. Allocating is a bump of an atomic offset, and a whole frame is given
+// back at once by NextFrame instead of job by job. The arena cycles through framesInFlight
+// buffers, so the memory of a frame stays valid until framesInFlight - 1 more frames began.
+// Chunks are kept across frames, once warm the arena no longer touches the heap.
+class FrameJobArena
+{
+public:
+    static constexpr size_t DEFAULT_CHUNK_SIZE = 64 * 1024;
+    static constexpr uint32_t MAX_FRAMES_IN_FLIGHT = 3;
+
+    explicit FrameJobArena(uint32_t framesInFlight = 2, size_t chunkSize = DEFAULT_CHUNK_SIZE);
+    ~FrameJobArena();
+    FrameJobArena(const FrameJobArena &) = delete;
+    FrameJobArena &operator=(const FrameJobArena &) = delete;
+
+    // Safe to call from any thread, including jobs of the current frame
+    void *Allocate(size_t size, size_t alignment = alignof(std::max_align_t))
+    {
+        return Allocate(CurrentFrame(), size, alignment);
+    }
+
+    // Destructors of arena data never run, so only trivially destructible types are allowed
+    template <typename Type, typename... Args>
+    Type *New(Args &&...args)
+    {
+        static_assert(std::is_trivially_destructible_v<Type>, "Frame arena data is never destroyed");
+        return ::new (Allocate(sizeof(Type), alignof(Type))) Type(std::forward<Args>(args)...);
+    }
+
+    template <typename Type>
+    std::span<Type> NewArray(size_t count)
+    {
+        static_assert(std::is_trivially_destructible_v<Type>, "Frame arena data is never destroyed");
+        Type *data = static_cast<Type *>(Allocate(sizeof(Type) * count, alignof(Type)));
+        std::uninitialized_value_construct_n(data, count);
+        return {data, count};
+    }
+
+    // The job is submitted like any other. Its destructor still runs once it has executed,
+    // so captures are released, but its memory only comes back with the frame.
+    template <typename Function>
+        requires std::is_constructible_v<JobFunction, Function>
+    UniquePtr<Job> CreateJob(Function &&executeFunction, uint8_t priority = 0)
+    {
+        Frame &frame = CurrentFrame();
+        void *memory = Allocate(frame, sizeof(Job), JobAllocator::BLOCK_ALIGNMENT);
+        UniquePtr<Job> job(::new (memory) Job(std::forward<Function>(executeFunction), UINT_MAX, priority));
+        frame.m_LiveJobs.fetch_add(1, std::memory_order_relaxed);
+        job->m_ArenaJobs = &frame.m_LiveJobs;
+        return job;
+    }
+
+    // Call once per frame from the thread driving the frames, e.g. at the end of Engine::Update.
+    // Recycles the oldest buffer. Jobs made in it that are still alive are flushed first.
+    void NextFrame();
+
+    uint64_t GetFrameNumber() const
+    {
+        return m_FrameNumber;
+    }
+
+    uint32_t GetFramesInFlight() const
+    {
+        return m_NumFrames;
+    }
+
+    // Bytes of all chunks owned by the arena
+    size_t GetReservedBytes() const;
+    // Bytes handed out in the current frame, including alignment padding
+    size_t GetUsedBytes() const;
+    uint64_t GetNumChunkAllocations() const
+    {
+        return m_NumChunkAllocations.load(std::memory_order_relaxed);
+    }
+
+private:
+    struct Chunk
+    {
+        UniquePtr<unsigned char[]> m_Data;
+        size_t m_Size = 0;
+        std::atomic<size_t> m_Offset = 0;
+    };
+
+    struct Frame
+    {
+        // Chunks in the order they were used, chunks past m_Current are free again
+        std::vector<UniquePtr<Chunk>> m_Chunks;
+        std::atomic<Chunk *> m_Current = nullptr;
+        size_t m_CurrentIndex = 0;
+        std::atomic<uint32_t> m_LiveJobs = 0;
+    };
+
+    Frame &CurrentFrame()
+    {
+        return m_Frames[m_FrameIndex.load(std::memory_order_acquire)];
+    }
+
+    void *Allocate(Frame &frame, size_t size, size_t alignment);
+    // Moves the frame on to a chunk with room for size bytes unless another thread already did
+    void AdvanceChunk(Frame &frame, Chunk *full, size_t size);
+    void ResetFrame(Frame &frame);
+
+private:
+    std::array<Frame, MAX_FRAMES_IN_FLIGHT> m_Frames;
+    uint32_t m_NumFrames;
+    size_t m_ChunkSize;
+    std::atomic<uint32_t> m_FrameIndex = 0;
+    uint64_t m_FrameNumber = 0;
+    std::atomic<uint64_t> m_NumChunkAllocations = 0;
+    // Taken to change chunks, never on the bump path
+    mutable std::mutex m_Mutex;
+};
@@ -0,0 +1,18 @@
+#pragma once
+#include "Common/pch.h"
+
+// Fixed-size block allocator backing Job::operator new. Every thread keeps its own free
+// list and trades whole batches of blocks with a shared pool, so jobs created on one
+// thread and destroyed on a worker stop touching the heap once the pool is warm.
+class JobAllocator
+{
+public:
+    static constexpr size_t BLOCK_SIZE = 192;
+    static constexpr size_t BLOCK_ALIGNMENT = 64;
+    static constexpr uint32_t BATCH_SIZE = 64;
+
+    static void *Allocate(size_t size);
+    static void Free(void *block, size_t size);
+    // Number of times the pool had to go to the heap for a new batch of blocks
+    static uint64_t GetNumSlabAllocations();
+};
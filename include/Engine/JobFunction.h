@@ -0,0 +1,148 @@
+#pragma once
+#include "Common/pch.h"
+#include <cstddef>
+#include <type_traits>
+
+// Move-only void() callable that keeps captures of up to INLINE_CAPACITY bytes inside the
+// object instead of on the heap like std::function does. Larger callables still work but
+// cost one allocation.
+class JobFunction
+{
+public:
+    static constexpr size_t INLINE_CAPACITY = 64;
+
+    JobFunction() = default;
+    JobFunction(std::nullptr_t) {}
+
+    template <typename Function>
+        requires(!std::is_same_v<std::decay_t<Function>, JobFunction> && std::is_invocable_v<std::decay_t<Function> &>)
+    JobFunction(Function &&function)
+    {
+        using Callable = std::decay_t<Function>;
+        if constexpr (std::is_constructible_v<bool, const Callable &>)
+        {
+            // Empty std::function or null function pointer
+            if (!static_cast<bool>(function))
+                return;
+        }
+        if constexpr (IsStoredInline<Callable>())
+        {
+            new (m_Storage) Callable(std::forward<Function>(function));
+            m_Operations = &InlineOperations<Callable>::OPERATIONS;
+        }
+        else
+        {
+            *reinterpret_cast<Callable **>(m_Storage) = new Callable(std::forward<Function>(function));
+            m_Operations = &HeapOperations<Callable>::OPERATIONS;
+        }
+    }
+
+    JobFunction(JobFunction &&other) noexcept
+    {
+        MoveFrom(other);
+    }
+
+    JobFunction &operator=(JobFunction &&other) noexcept
+    {
+        if (this != &other)
+        {
+            Reset();
+            MoveFrom(other);
+        }
+        return *this;
+    }
+
+    JobFunction(const JobFunction &) = delete;
+    JobFunction &operator=(const JobFunction &) = delete;
+
+    ~JobFunction()
+    {
+        Reset();
+    }
+
+    void operator()()
+    {
+        m_Operations->m_Invoke(m_Storage);
+    }
+
+    explicit operator bool() const
+    {
+        return m_Operations != nullptr;
+    }
+
+    void Reset()
+    {
+        if (m_Operations)
+        {
+            m_Operations->m_Destroy(m_Storage);
+            m_Operations = nullptr;
+        }
+    }
+
+    template <typename Callable>
+    static constexpr bool IsStoredInline()
+    {
+        return sizeof(Callable) <= INLINE_CAPACITY &&
+               alignof(Callable) <= alignof(std::max_align_t) &&
+               std::is_nothrow_move_constructible_v<Callable>;
+    }
+
+private:
+    struct Operations
+    {
+        void (*m_Invoke)(void *storage);
+        void (*m_Move)(void *destination, void *source);
+        void (*m_Destroy)(void *storage);
+    };
+
+    template <typename Callable>
+    struct InlineOperations
+    {
+        static void Invoke(void *storage)
+        {
+            (*static_cast<Callable *>(storage))();
+        }
+        static void Move(void *destination, void *source)
+        {
+            new (destination) Callable(std::move(*static_cast<Callable *>(source)));
+            static_cast<Callable *>(source)->~Callable();
+        }
+        static void Destroy(void *storage)
+        {
+            static_cast<Callable *>(storage)->~Callable();
+        }
+        static constexpr Operations OPERATIONS = {&Invoke, &Move, &Destroy};
+    };
+
+    template <typename Callable>
+    struct HeapOperations
+    {
+        static void Invoke(void *storage)
+        {
+            (**static_cast<Callable **>(storage))();
+        }
+        static void Move(void *destination, void *source)
+        {
+            *static_cast<Callable **>(destination) = *static_cast<Callable **>(source);
+        }
+        static void Destroy(void *storage)
+        {
+            delete *static_cast<Callable **>(storage);
+        }
+        static constexpr Operations OPERATIONS = {&Invoke, &Move, &Destroy};
+    };
+
+    void MoveFrom(JobFunction &other)
+    {
+        if (other.m_Operations)
+        {
+            other.m_Operations->m_Move(m_Storage, other.m_Storage);
+            m_Operations = other.m_Operations;
+            other.m_Operations = nullptr;
+        }
+    }
+
+private:
+    alignas(std::max_align_t) unsigned char m_Storage[INLINE_CAPACITY];
+    const Operations *m_Operations = nullptr;
+};
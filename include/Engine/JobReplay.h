@@ -0,0 +1,82 @@
+#pragma once
+#include "Common/pch.h"
+#include <deque>
+
+class Job;
+class JobPipeLine;
+
+// Jobs are named after the job that submitted them and how many jobs it had submitted before,
+// so a program submitting the same work gets the same ids on every run, whichever worker ran
+// what. Jobs submitted from outside any job count as children of id 0.
+struct JobTraceNode
+{
+    uint64_t mID = 0;
+    uint64_t mParentID = 0;
+    uint8_t mPriority = 0;
+};
+
+struct JobTraceEdge
+{
+    uint64_t mFrom = 0;
+    uint64_t mTo = 0;
+};
+
+struct JobTrace
+{
+    std::vector<JobTraceNode> mJobs;
+    // Continuations whose id was known when their predecessor finished
+    std::vector<JobTraceEdge> mDependencies;
+    // Ids in the order the jobs started running
+    std::vector<uint64_t> mExecutionOrder;
+};
+
+// Records job graphs and runs jobs serially for JobSystem. Pipelines only see it while
+// recording or serial execution is on, otherwise the normal path doesn't touch it.
+class JobReplay
+{
+public:
+    struct Context
+    {
+        uint64_t mID = 0;
+        uint64_t mChildren = 0;
+    };
+
+    void StartRecording();
+    JobTrace StopRecording();
+    bool IsRecording() const;
+
+    // Serial jobs are run one at a time by threads waiting for jobs, never by workers.
+    // With seed 0 ready jobs run in the order they became ready, other seeds pick a random
+    // ready job each time from a generator seeded with it.
+    void SetSerial(bool serial, uint64_t seed = 0);
+    // Serial execution that runs jobs in the given order of ids, as long as the program
+    // submits the same jobs again. Falls back to the seeded order once it diverges.
+    void SetReplayOrder(std::vector<uint64_t> order);
+    bool IsSerial() const;
+    bool IsActive() const;
+
+    // Gives jobs their ids, called as they are submitted
+    void OnSubmit(Job *const *jobs, uint32_t count);
+    // Takes over ready jobs in serial mode
+    void Schedule(Job *const *jobs, uint32_t count);
+    // Runs one ready job on the calling thread, false when there is none
+    bool RunNext();
+    // Around the execution of a job, so jobs it submits are named after it
+    Context EnterJob(Job &job);
+    void LeaveJob(Job &job, const Context &previous);
+
+private:
+    Job *PickNextJob();
+
+private:
+    mutable std::mutex m_Mutex;
+    bool m_IsRecording = false;
+    bool m_IsSerial = false;
+    JobTrace m_Trace;
+    uint64_t m_RootChildren = 0;
+    uint64_t m_RandomState = 0;
+    std::deque<Job *> m_ReadyJobs;
+    std::vector<uint64_t> m_ReplayOrder;
+    size_t m_ReplayPosition = 0;
+    bool m_HasDiverged = false;
+};
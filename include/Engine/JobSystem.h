@@ -1,5 +1,18 @@
 #pragma once
 #include "Common/pch.h"
+#include "Engine/WorkStealingQueue.h"
+#include "Engine/MPMCQueue.h"
+#include "Engine/JobFunction.h"
+#include "Engine/JobAllocator.h"
+#include "Engine/CpuTopology.h"
+#include "Engine/TimerWheel.h"
+#include "Engine/JobReplay.h"
+#include <atomic>
+#include <array>
+#include <condition_variable>
+#include <new>
+#include <shared_mutex>
+#include <span>
 
 enum class ScheduleStrategy
 {
@@ -8,6 +21,13 @@ enum class ScheduleStrategy
     PRIORITY
 };
 
+// Job priorities are bucketed into levels of 64, jobs on a higher level always run first
+static constexpr uint32_t JOB_PRIORITY_LEVELS = 4;
+static constexpr uint8_t JOB_PRIORITY_LOW = 0;
+static constexpr uint8_t JOB_PRIORITY_NORMAL = 64;
+static constexpr uint8_t JOB_PRIORITY_HIGH = 128;
+static constexpr uint8_t JOB_PRIORITY_CRITICAL = 192;
+
 enum class JobType
 {
     RENDER,
@@ -22,19 +42,163 @@ enum class JobType
     CUSTOM
 };
 
+// How long an idle worker keeps looking for work before it parks. It first spins with a
+// pause instruction, then yields its time slice, then sleeps until a submit wakes it.
+struct WorkerIdlePolicy
+{
+    uint32_t mSpinMicroseconds = 50;
+    uint32_t mYieldMicroseconds = 100;
+};
+
+struct JobSchedulePolicy
+{
+    // Order in which a worker runs the jobs it spawned itself, per priority level. LIFO keeps
+    // the data of the job that just ran hot in cache, FIFO is fairer. Only FIFO and LIFO apply.
+    std::array<ScheduleStrategy, JOB_PRIORITY_LEVELS> mLevelOrder = {ScheduleStrategy::LIFO, ScheduleStrategy::LIFO,
+                                                                    ScheduleStrategy::LIFO, ScheduleStrategy::LIFO};
+    // Every mAgingInterval-th job a worker picks comes from the lowest non empty level, so a
+    // flood of high priority work delays lower levels but never starves them. 0 disables it.
+    uint32_t mAgingInterval = 32;
+};
+
 class Job;
+// Per-worker counters behind JobPipeLine::GetStats. Define JOB_SYSTEM_STATS as 0 to compile
+// them out, GetStats then returns empty stats.
+#ifndef JOB_SYSTEM_STATS
+#define JOB_SYSTEM_STATS 1
+#endif
+
+struct JobWorkerStats
+{
+    uint64_t mJobsRun = 0;
+    // Time between waits for jobs and time spent waiting, spinning included
+    uint64_t mBusyNanoseconds = 0;
+    uint64_t mIdleNanoseconds = 0;
+    uint64_t mParks = 0;
+    // Looks into other workers' deques after its own and the injection queue came up empty
+    uint64_t mStealAttempts = 0;
+    uint64_t mSteals = 0;
+    // Time blocked on the pipeline's park mutex
+    uint64_t mLockWaitNanoseconds = 0;
+    // Deepest the worker's own deque got, over all priority levels
+    uint64_t mQueueHighWater = 0;
+};
+
+struct JobPipeLineStats
+{
+    // One entry per worker slot, threads outside the pipeline are not counted
+    std::vector<JobWorkerStats> mWorkers;
+    // Deepest any injection queue got
+    uint64_t mInjectedHighWater = 0;
+    size_t mQueuedJobs = 0;
+};
+
+class JobCounter;
 class Worker;
 class JobPipeLine;
 class JobSystem;
+class WorkerBalancer;
+struct WorkerBalancePolicy;
+class FrameJobArena;
+class AsyncFileService;
+
+// Counts unfinished jobs. Jobs submitted with a counter increment it on submit and
+// decrement it once they have executed, see JobSystem::WaitForCounter.
+class JobCounter
+{
+public:
+    JobCounter(int32_t value = 0) : m_Value(value) {}
+    JobCounter(const JobCounter &) = delete;
+    JobCounter &operator=(const JobCounter &) = delete;
+
+    void Increment(int32_t count = 1)
+    {
+        m_Value.fetch_add(count, std::memory_order_relaxed);
+    }
+
+    int32_t Decrement(int32_t count = 1)
+    {
+        return m_Value.fetch_sub(count, std::memory_order_acq_rel) - count;
+    }
+
+    int32_t GetValue() const
+    {
+        return m_Value.load(std::memory_order_acquire);
+    }
+
+private:
+    std::atomic<int32_t> m_Value;
+};
+
+// Cancels a group of jobs that share it. Jobs still queued when it is cancelled are dropped
+// without running, running jobs can poll IsCancelled to stop early. Like JobCounter it must
+// outlive the jobs using it.
+class CancellationToken
+{
+public:
+    CancellationToken() = default;
+    CancellationToken(const CancellationToken &) = delete;
+    CancellationToken &operator=(const CancellationToken &) = delete;
+
+    void Cancel()
+    {
+        m_IsCancelled.store(true, std::memory_order_release);
+    }
+
+    // Makes the token usable for new work again
+    void Reset()
+    {
+        m_IsCancelled.store(false, std::memory_order_release);
+    }
+
+    bool IsCancelled() const
+    {
+        return m_IsCancelled.load(std::memory_order_acquire);
+    }
+
+    // Jobs that were dropped because of this token
+    uint64_t GetNumCancelledJobs() const
+    {
+        return m_NumCancelledJobs.load(std::memory_order_relaxed);
+    }
+
+private:
+    friend class JobPipeLine;
+    std::atomic<bool> m_IsCancelled = false;
+    std::atomic<uint64_t> m_NumCancelledJobs = 0;
+};
 
 class Job
 {
 public:
-    Job(std::function<void()> executeFunction, uint32_t workerID = UINT_MAX, uint8_t priority = 0)
-        : m_ExecuteFunction(executeFunction),
-          m_IsFinished(false),
-          m_Priority(priority)
+    template <typename Function>
+        requires std::is_constructible_v<JobFunction, Function>
+    Job(Function &&executeFunction, uint32_t workerID = UINT_MAX, uint8_t priority = 0)
+        : m_IsFinished(false),
+          m_Priority(priority),
+          m_ExecuteFunction(std::forward<Function>(executeFunction))
+    {
+    }
+
+    // Jobs come from JobAllocator's per-thread free lists instead of the heap
+    static void *operator new(size_t size)
     {
+        return JobAllocator::Allocate(size);
+    }
+
+    // Jobs made by a FrameJobArena are only destroyed here, their memory goes back with the frame
+    static void operator delete(Job *job, std::destroying_delete_t)
+    {
+        std::atomic<uint32_t> *arenaJobs = job->m_ArenaJobs;
+        job->~Job();
+        if (arenaJobs)
+        {
+            arenaJobs->fetch_sub(1, std::memory_order_release);
+        }
+        else
+        {
+            JobAllocator::Free(job, sizeof(Job));
+        }
     }
 
     void Execute()
@@ -43,27 +207,26 @@ public:
         {
             m_ExecuteFunction();
         }
-        m_IsFinished = true;
+        m_IsFinished.store(true, std::memory_order_release);
     }
 
     bool IsFinished()
     {
-        return m_IsFinished;
+        return m_IsFinished.load(std::memory_order_acquire);
     }
 
     template <class F, class... Args>
     auto BindOperation(F &&f, Args &&...args)
-        -> std::future<typename std::invoke_result<F(Args...)>::type>
+        -> std::future<std::invoke_result_t<F, Args...>>
     {
-        using return_type = typename std::invoke_result<F(Args...)>::type;
+        using return_type = std::invoke_result_t<F, Args...>;
 
-        auto task = std::make_shared<std::packaged_task<return_type()>>(
-            std::bind(std::forward<F>(f), std::forward<Args>(args)...));
+        std::packaged_task<return_type()> task(
+            [f = std::forward<F>(f), ... args = std::forward<Args>(args)]() mutable
+            { return std::invoke(std::move(f), std::move(args)...); });
 
-        std::future<return_type> res = task->get_future();
-        {
-            m_ExecuteFunction = (*task)();
-        }
+        std::future<return_type> res = task.get_future();
+        m_ExecuteFunction = std::move(task);
         return res;
     }
 
@@ -79,10 +242,76 @@ public:
         return m_Priority;
     }
 
+    uint32_t GetPriorityLevel() const
+    {
+        return m_Priority / (256 / JOB_PRIORITY_LEVELS);
+    }
+
+    // Schedules job once this one has finished. Both jobs must not have been submitted yet.
+    void AddContinuation(Job &job)
+    {
+        HASSERT(m_PipeLine == nullptr && job.m_PipeLine == nullptr);
+        m_Continuations.push_back(&job);
+        job.m_PendingDependencies.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    // Holds this job back until job has finished. Both jobs must not have been submitted yet.
+    void AddDependency(Job &job)
+    {
+        job.AddContinuation(*this);
+    }
+
+    void SetCancellationToken(CancellationToken *token)
+    {
+        m_CancellationToken = token;
+    }
+
+    CancellationToken *GetCancellationToken() const
+    {
+        return m_CancellationToken;
+    }
+
+    // A job that hasn't started by the deadline is dropped instead of run
+    void SetDeadline(std::chrono::steady_clock::time_point deadline)
+    {
+        m_Deadline = deadline.time_since_epoch().count();
+    }
+
+    void SetTimeout(std::chrono::steady_clock::duration timeout)
+    {
+        SetDeadline(std::chrono::steady_clock::now() + timeout);
+    }
+
+    bool IsCancelled() const
+    {
+        return m_CancellationToken && m_CancellationToken->IsCancelled();
+    }
+
+    bool IsExpired() const
+    {
+        return m_Deadline != 0 && std::chrono::steady_clock::now().time_since_epoch().count() >= m_Deadline;
+    }
+
 private:
-    bool m_IsFinished = false;
+    friend class JobPipeLine;
+    friend class FrameJobArena;
+    friend class JobReplay;
+    std::atomic<bool> m_IsFinished = false;
     uint8_t m_Priority = 0;
-    std::function<void()> m_ExecuteFunction;
+    JobFunction m_ExecuteFunction;
+    // Starts at one for the submission itself, so a job whose dependencies all finish
+    // before it is submitted is still only scheduled once
+    std::atomic<uint32_t> m_PendingDependencies = 1;
+    std::vector<Job *> m_Continuations;
+    JobCounter *m_Counter = nullptr;
+    JobPipeLine *m_PipeLine = nullptr;
+    CancellationToken *m_CancellationToken = nullptr;
+    // steady_clock ticks, 0 when the job has no deadline
+    int64_t m_Deadline = 0;
+    // Set on submission while JobReplay is recording or running jobs serially
+    uint64_t m_TraceID = 0;
+    // Live job count of the arena frame this job was made in, null for pooled jobs
+    std::atomic<uint32_t> *m_ArenaJobs = nullptr;
 };
 
 inline bool operator<(const UniquePtr<Job> &a, const UniquePtr<Job> &b)
@@ -90,6 +319,8 @@ inline bool operator<(const UniquePtr<Job> &a, const UniquePtr<Job> &b)
     return a->m_Priority < b->m_Priority;
 };
 
+static_assert(sizeof(Job) <= JobAllocator::BLOCK_SIZE, "Job no longer fits in a JobAllocator block");
+
 class Worker
 {
 public:
@@ -100,50 +331,170 @@ public:
     void Reset();
     bool IsBusy() const;
     bool IsInPipeLine() const;
+    // Moves a running worker between jobs without restarting its thread. Gives up and
+    // returns false when the worker doesn't get to it in time, e.g. while it runs a long job.
     bool SetPipeLine(JobPipeLine *pipeLine);
+    std::thread::id GetThreadID() const;
 
 private:
+    friend class JobPipeLine;
     void Stop();
     bool WakeUp();
+    void SwitchPipeLine();
+    void ApplyAffinity();
+
+    bool ShouldLeaveIdle() const
+    {
+        return !m_IsRunning.load(std::memory_order_acquire) || m_PendingPipeLine.load(std::memory_order_acquire) != nullptr;
+    }
 
 private:
     std::atomic<bool> m_IsRunning;
+    std::atomic<bool> m_IsBusy;
     std::thread m_Thread;
-    UniquePtr<Job> m_CurrentJob;
     JobPipeLine *m_PipeLine = nullptr;
-    std::mutex *m_Mutex = nullptr;
-    std::condition_variable *m_Condition = nullptr;
+    // Set by SetPipeLine, the worker thread takes it when it starts switching
+    std::atomic<JobPipeLine *> m_PendingPipeLine = nullptr;
+    std::mutex m_SwitchMutex;
+    std::condition_variable m_SwitchCondition;
+    bool m_SwitchDone = false;
+    bool m_SwitchSucceeded = false;
+    uint32_t m_SlotIndex = UINT_MAX;
+    uint32_t m_RandomState = 0;
+    uint32_t m_PinnedCpu = UINT_MAX;
+    uint32_t m_NumPicks = 0;
 };
 
 class JobPipeLine
 {
 public:
     JobPipeLine() = delete;
-    JobPipeLine(uint32_t workerCount);
-    ~JobPipeLine() = default;
+    // Slot i's worker is pinned to cpus[i % cpus.size()], an empty cpus leaves workers unpinned
+    JobPipeLine(uint32_t workerCount, uint32_t maxWorkerCount = 0, std::span<const LogicalCpu> cpus = {});
+    ~JobPipeLine();
     JobPipeLine(const JobPipeLine &) = delete;
     JobPipeLine(JobPipeLine &&) = delete;
     JobPipeLine &operator=(const JobPipeLine &) = delete;
 
-    void PushJob(UniquePtr<Job> &job);
+    void PushJob(UniquePtr<Job> &job, JobCounter *counter = nullptr);
+    void PushJobs(std::span<UniquePtr<Job>> jobs, JobCounter *counter = nullptr);
     bool PopJob(UniquePtr<Job> &job);
+    bool RunPendingJob();
     bool TransferInWorker(UniquePtr<Worker> &worker);
     bool TransferInWorkers(std::vector<UniquePtr<Worker>> &workers);
     bool TransferOutWorker(UniquePtr<Worker> &worker);
     bool TransferOutAllWorkers(std::vector<UniquePtr<Worker>> &workers);
     bool IsIdle();
+    void WaitIdle();
+    // Jobs are always scheduled by priority. FIFO and LIFO set the order of every level,
+    // PRIORITY changes nothing.
     void SortJobs(ScheduleStrategy strategy);
+    void SetSchedulePolicy(const JobSchedulePolicy &policy);
+    JobSchedulePolicy GetSchedulePolicy() const;
     bool BorrowWorker(JobPipeLine *pipeLine);
     bool CallReturnWorker(JobPipeLine *pipeLine);
+    uint32_t GetWorkerCount();
+    // Bounds for WorkerBalancer, manual BorrowWorker calls ignore them
+    void SetWorkerQuota(uint32_t minWorkers, uint32_t maxWorkers);
+    uint32_t GetMinWorkers() const;
+    uint32_t GetMaxWorkers() const;
+    // Approximate while jobs are being pushed and run
+    size_t GetQueuedJobCount();
+    // Dropped jobs count as completed too
+    uint64_t GetCompletedJobCount();
+    uint64_t GetCancelledJobCount() const;
+    uint64_t GetExpiredJobCount() const;
+    JobPipeLineStats GetStats();
+    // Set by JobSystem while it records or runs jobs serially, null otherwise
+    void SetReplay(JobReplay *replay);
+    void SetIdlePolicy(const WorkerIdlePolicy &policy);
+    WorkerIdlePolicy GetIdlePolicy() const;
+
+    static JobPipeLine *GetCurrentPipeLine();
 
 private:
     friend class Worker;
-    std::deque<UniquePtr<Job>> m_Jobs;
+    friend class JobReplay;
+
+    // Each worker owns one slot while it is in the pipeline. Slots outlive the workers
+    // using them, so a thief never touches a deque that has been freed.
+    struct alignas(64) WorkerSlot
+    {
+        WorkStealingQueue<Job *> m_Jobs[JOB_PRIORITY_LEVELS];
+        Worker *m_Owner = nullptr;
+        std::atomic<uint64_t> m_Submitted = 0;
+        std::atomic<uint64_t> m_Completed = 0;
+        // 1 while the owner is parked, it sleeps on this word until a waker clears it
+        std::atomic<uint32_t> m_ParkState = 0;
+        uint32_t m_CpuID = UINT_MAX;
+        uint32_t m_CacheDomain = 0;
+#if JOB_SYSTEM_STATS
+        // Only written by the owner, read by GetStats
+        std::atomic<uint64_t> m_BusyNanoseconds = 0;
+        std::atomic<uint64_t> m_IdleNanoseconds = 0;
+        std::atomic<uint64_t> m_Parks = 0;
+        std::atomic<uint64_t> m_StealAttempts = 0;
+        std::atomic<uint64_t> m_Steals = 0;
+        std::atomic<uint64_t> m_LockWaitNanoseconds = 0;
+        std::atomic<uint64_t> m_QueueHighWater = 0;
+        // steady_clock nanoseconds when the owner last stopped and started waiting for jobs,
+        // m_IdleSince is 0 while it isn't waiting
+        std::atomic<int64_t> m_ActiveSince = 0;
+        std::atomic<int64_t> m_IdleSince = 0;
+#endif
+    };
+
+    void ScheduleJob(Job *job);
+    void ScheduleJobs(Job *const *jobs, uint32_t count);
+    void InjectJobs(Job *const *jobs, uint32_t count);
+    uint32_t ClaimSlot(Worker *worker);
+    void ReleaseSlot(uint32_t slotIndex, Worker *worker);
+    Job *FindJob(Worker *worker, uint32_t &randomState);
+    Job *TakeJob(Worker *worker, uint32_t &randomState, uint32_t level);
+    Job *StealJob(uint32_t &randomState, uint32_t skipSlot, uint32_t level);
+    Job *StealJobInDomain(uint32_t start, uint32_t skipSlot, uint32_t level, uint32_t cacheDomain, bool sameDomain);
+    bool HasQueuedJobs();
+    bool HasQueuedJobs(uint32_t level);
+    void ClearEmptyLevels();
+    void RunJob(Job *job, std::atomic<uint64_t> &completed);
+    void WaitForJobs(Worker *worker);
+    void ParkWorker(Worker *worker);
+    void NotifyJobsAvailable(uint32_t count, uint32_t levelMask);
+    void WakeWorker(uint32_t slotIndex);
+    // Locks m_ParkMutex, counting the time a worker of this pipeline waits for it
+    std::unique_lock<std::mutex> LockParkMutex();
+
+    UniquePtr<WorkerSlot[]> m_Slots;
+    uint32_t m_NumSlots = 0;
+    // Slots are spread over more than one cache domain, thieves try their own domain first
+    bool m_HasCacheDomains = false;
+    // Jobs submitted from threads outside the pipeline, one queue per priority level
+    std::array<UniquePtr<MPMCQueue<Job *>>, JOB_PRIORITY_LEVELS> m_InjectedJobs;
+    // Bit per level that may hold jobs. Only a hint: it lets workers skip unused levels,
+    // a full scan still runs before a worker goes idle.
+    std::atomic<uint32_t> m_LevelMask = 0;
+    std::atomic<uint32_t> m_LifoLevelMask;
+    std::atomic<uint32_t> m_AgingInterval;
+    std::atomic<uint64_t> m_ExternalSubmitted = 0;
+    std::atomic<uint64_t> m_ExternalCompleted = 0;
+    // Only touched when a job is dropped, so they cost nothing on the normal path
+    std::atomic<uint64_t> m_CancelledJobs = 0;
+    std::atomic<uint64_t> m_ExpiredJobs = 0;
+#if JOB_SYSTEM_STATS
+    std::atomic<uint64_t> m_InjectedHighWater = 0;
+#endif
+    std::atomic<JobReplay *> m_Replay = nullptr;
     std::vector<UniquePtr<Worker>> m_Workers;
     std::vector<JobPipeLine *> m_PipeLinesBorrowed;
-    std::mutex m_QueueMutex;
-    std::mutex m_JobMutex;
-    std::condition_variable m_JobCV;
+    std::mutex m_WorkerMutex;
+    std::atomic<uint32_t> m_MinWorkers;
+    std::atomic<uint32_t> m_MaxWorkers;
+    std::atomic<uint32_t> m_SpinMicroseconds;
+    std::atomic<uint32_t> m_YieldMicroseconds;
+    // Slots of parked workers, the most recently parked one is woken first
+    std::mutex m_ParkMutex;
+    std::vector<uint32_t> m_ParkedSlots;
+    std::atomic<uint32_t> m_NumSleepingWorkers = 0;
 };
 
 class JobSystem
@@ -153,20 +504,106 @@ private:
 
 public:
     ~JobSystem();
-    uint32_t CreateNewPipeLine();
+    uint32_t CreateNewPipeLine(PipeLinePlacement placement = PipeLinePlacement::ANY);
     bool DestroyPipeLine(uint32_t pipeLineID);
     void SortJobs(ScheduleStrategy strategy);
-    bool SubmitJob(UniquePtr<Job> &job, const uint32_t pipeLineID = 0);
+    bool SubmitJob(UniquePtr<Job> &job, const uint32_t pipeLineID = 0, JobCounter *counter = nullptr);
+    bool SubmitJobs(std::span<UniquePtr<Job>> jobs, const uint32_t pipeLineID = 0, JobCounter *counter = nullptr);
+    void WaitForCounter(JobCounter &counter, int32_t value = 0);
+    void FlushJobs();
+    // Submits function as a job once delay has passed
+    TimerHandle SubmitDelayedJob(std::chrono::steady_clock::duration delay, JobFunction function, const uint32_t pipeLineID = 0, uint8_t priority = 0);
+    // Submits function as a job every interval, starting one interval from now. A run is
+    // skipped while the previous one hasn't finished yet.
+    TimerHandle SubmitPeriodicJob(std::chrono::steady_clock::duration interval, JobFunction function, const uint32_t pipeLineID = 0, uint8_t priority = 0);
+    // False when the timer already fired for the last time or was cancelled before
+    bool CancelTimer(TimerHandle handle);
+    bool SetIdlePolicy(const WorkerIdlePolicy &policy, const uint32_t pipeLineID = 0);
+    bool SetSchedulePolicy(const JobSchedulePolicy &policy, const uint32_t pipeLineID = 0);
+    bool SetWorkerQuota(uint32_t minWorkers, uint32_t maxWorkers, const uint32_t pipeLineID = 0);
+    // Runs one balancing step now, returns whether a worker was moved
+    bool RebalanceWorkers();
+    // Balances workers between pipelines on a background thread until stopped
+    void StartWorkerBalancer(const WorkerBalancePolicy &policy);
+    void StopWorkerBalancer();
+    const CpuTopology &GetCpuTopology() const;
+    uint64_t GetCancelledJobCount(const uint32_t pipeLineID = 0);
+    uint64_t GetExpiredJobCount(const uint32_t pipeLineID = 0);
+    JobPipeLineStats GetStats(const uint32_t pipeLineID = 0);
+    // Logs a summary line per pipeline, once or on every interval until the timer is cancelled
+    void LogStats();
+    TimerHandle LogStatsEvery(std::chrono::steady_clock::duration interval);
+    // Records the jobs submitted from now on, the dependencies between them and the order
+    // they start in. Works with workers as well as with serial execution.
+    void StartRecording();
+    JobTrace StopRecording();
+    // Runs every job on the threads waiting for jobs (FlushJobs, WaitForCounter, ...) one at a
+    // time instead of on workers. Seed 0 keeps the order jobs became ready in, other seeds pick
+    // a reproducible random order. Waits for the jobs in flight before switching.
+    void SetSerialExecution(bool serial, uint64_t seed = 0);
+    // Serial execution in the order a recorded trace ran in, to reproduce that run
+    void ReplayTrace(const JobTrace &trace);
+    // Frame-scoped jobs and data, Engine::Update moves it to the next frame
+    FrameJobArena &GetFrameArena();
+    // Reads files off the workers and hands the data to jobs, started on first use
+    AsyncFileService &GetFileService();
 
 public:
     static JobSystem *CreateJobSystem();
     static void DestroyJobSystem(JobSystem *jobSystem);
+    // Same as GetJobSystem but returns nullptr quietly, for code that can run without one
+    static JobSystem *GetInstance();
+
+private:
+    bool RunPendingJob();
+    SharedPtr<JobPipeLine> GetPipeLine(uint32_t pipeLineID);
+    // Counts the first workerCount CPUs as busy and returns their ids
+    std::vector<uint32_t> ReserveCpus(const std::vector<LogicalCpu> &cpus, uint32_t workerCount);
+    // Hands m_Replay to the pipelines while it has something to do
+    void UpdateReplay();
+
+    struct TimedJob
+    {
+        JobFunction mFunction;
+        uint32_t mPipeLineID = 0;
+        uint8_t mPriority = 0;
+        std::atomic<bool> mIsRunning = false;
+    };
+    TimerHandle ScheduleTimer(std::chrono::steady_clock::duration delay, std::chrono::steady_clock::duration interval, JobFunction function, uint32_t pipeLineID, uint8_t priority);
+    uint64_t GetTimerTick(std::chrono::steady_clock::time_point time) const;
+    void RunTimers();
+    void StopTimers();
 
 private:
     uint32_t m_MaxNumOfWorkers = std::thread::hardware_concurrency();
     uint32_t m_CurrentNumOfWorkers = 0;
-    std::vector<UniquePtr<JobPipeLine>> m_JobPipeLines;
-    std::mutex m_Mutex;
+    // Declared before the pipelines so it outlives the jobs still queued in them
+    UniquePtr<FrameJobArena> m_FrameArena;
+    UniquePtr<JobReplay> m_Replay;
+    // Shared so a submit in flight keeps its pipeline alive, see DestroyPipeLine
+    std::vector<SharedPtr<JobPipeLine>> m_JobPipeLines;
+    CpuTopology m_Topology;
+    // Workers pinned to each CPU, and the CPUs each pipeline's workers were pinned to
+    std::vector<uint32_t> m_CpuLoad;
+    std::vector<std::vector<uint32_t>> m_PipeLineCpus;
+    // Shared for submission, exclusive only when pipelines are created or destroyed
+    std::shared_mutex m_Mutex;
+    // Held for a balancing step, a pipeline is only destroyed between steps
+    std::mutex m_BalanceMutex;
+    UniquePtr<WorkerBalancer> m_Balancer;
+    std::thread m_BalancerThread;
+    std::mutex m_BalancerThreadMutex;
+    std::condition_variable m_BalancerCV;
+    bool m_IsBalancerRunning = false;
+    // Ticks are milliseconds since the timer thread started, it sleeps until the next one due
+    TimerWheel<SharedPtr<TimedJob>> m_Timers;
+    std::chrono::steady_clock::time_point m_TimerEpoch;
+    std::thread m_TimerThread;
+    std::mutex m_TimerMutex;
+    std::condition_variable m_TimerCV;
+    bool m_IsTimerRunning = false;
+    UniquePtr<AsyncFileService> m_FileService;
+    std::once_flag m_FileServiceOnce;
 };
 
 inline bool GetJobSystem(JobSystem **jobSystem);
@@ -183,5 +620,6 @@ inline void TestJobSystem()
         jobSystem->SubmitJob(job);
     }
     jobSystem->SortJobs(ScheduleStrategy::PRIORITY);
+    jobSystem->FlushJobs();
 }
 #endif
\ No newline at end of file
@@ -0,0 +1,146 @@
+#pragma once
+#include "Common/pch.h"
+#include <atomic>
+
+// Bounded lock-free multi-producer multi-consumer ring buffer (Vyukov). Every cell carries a
+// sequence number telling producers and consumers whose turn it is, so neither side locks.
+template <typename Type>
+class MPMCQueue
+{
+public:
+    explicit MPMCQueue(size_t capacity)
+        : m_Cells(new Cell[capacity]),
+          m_Capacity(capacity),
+          m_Mask(capacity - 1),
+          m_EnqueuePos(0),
+          m_DequeuePos(0)
+    {
+        HASSERT(capacity >= 2 && (capacity & (capacity - 1)) == 0);
+        for (size_t i = 0; i < capacity; i++)
+        {
+            m_Cells[i].m_Sequence.store(i, std::memory_order_relaxed);
+        }
+    }
+
+    MPMCQueue(const MPMCQueue &) = delete;
+    MPMCQueue &operator=(const MPMCQueue &) = delete;
+
+    bool TryPush(Type item)
+    {
+        size_t pos = m_EnqueuePos.load(std::memory_order_relaxed);
+        Cell *cell;
+        for (;;)
+        {
+            cell = &m_Cells[pos & m_Mask];
+            size_t sequence = cell->m_Sequence.load(std::memory_order_acquire);
+            intptr_t diff = static_cast<intptr_t>(sequence) - static_cast<intptr_t>(pos);
+            if (diff == 0)
+            {
+                if (m_EnqueuePos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+                    break;
+            }
+            else if (diff < 0)
+            {
+                return false;
+            }
+            else
+            {
+                pos = m_EnqueuePos.load(std::memory_order_relaxed);
+            }
+        }
+        cell->m_Data = item;
+        cell->m_Sequence.store(pos + 1, std::memory_order_release);
+        return true;
+    }
+
+    // Reserves count consecutive cells with a single CAS and publishes all items, or pushes
+    // nothing and returns false if the queue does not have room for all of them.
+    bool TryPushBatch(const Type *items, size_t count)
+    {
+        if (count == 0)
+            return true;
+        if (count > m_Capacity)
+            return false;
+        size_t pos = m_EnqueuePos.load(std::memory_order_relaxed);
+        for (;;)
+        {
+            size_t dequeuePos = m_DequeuePos.load(std::memory_order_acquire);
+            // Signed, pos may be stale and behind dequeuePos, in which case the CAS below fails
+            if (static_cast<intptr_t>(pos + count - dequeuePos) > static_cast<intptr_t>(m_Capacity))
+                return false;
+            if (m_EnqueuePos.compare_exchange_weak(pos, pos + count, std::memory_order_relaxed))
+                break;
+        }
+        for (size_t i = 0; i < count; i++)
+        {
+            Cell &cell = m_Cells[(pos + i) & m_Mask];
+            // The consumer of the previous lap has claimed this cell but may still be reading it
+            while (cell.m_Sequence.load(std::memory_order_acquire) != pos + i)
+            {
+                std::this_thread::yield();
+            }
+            cell.m_Data = items[i];
+            cell.m_Sequence.store(pos + i + 1, std::memory_order_release);
+        }
+        return true;
+    }
+
+    bool TryPop(Type &item)
+    {
+        size_t pos = m_DequeuePos.load(std::memory_order_relaxed);
+        Cell *cell;
+        for (;;)
+        {
+            cell = &m_Cells[pos & m_Mask];
+            size_t sequence = cell->m_Sequence.load(std::memory_order_acquire);
+            intptr_t diff = static_cast<intptr_t>(sequence) - static_cast<intptr_t>(pos + 1);
+            if (diff == 0)
+            {
+                if (m_DequeuePos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+                    break;
+            }
+            else if (diff < 0)
+            {
+                return false;
+            }
+            else
+            {
+                pos = m_DequeuePos.load(std::memory_order_relaxed);
+            }
+        }
+        item = cell->m_Data;
+        cell->m_Sequence.store(pos + m_Capacity, std::memory_order_release);
+        return true;
+    }
+
+    bool IsEmpty() const
+    {
+        return Size() == 0;
+    }
+
+    // Approximate while producers or consumers are active
+    size_t Size() const
+    {
+        size_t dequeuePos = m_DequeuePos.load(std::memory_order_relaxed);
+        size_t enqueuePos = m_EnqueuePos.load(std::memory_order_relaxed);
+        return enqueuePos > dequeuePos ? enqueuePos - dequeuePos : 0;
+    }
+
+    size_t GetCapacity() const
+    {
+        return m_Capacity;
+    }
+
+private:
+    struct Cell
+    {
+        std::atomic<size_t> m_Sequence;
+        Type m_Data;
+    };
+
+    UniquePtr<Cell[]> m_Cells;
+    const size_t m_Capacity;
+    const size_t m_Mask;
+    alignas(64) std::atomic<size_t> m_EnqueuePos;
+    alignas(64) std::atomic<size_t> m_DequeuePos;
+};
@@ -0,0 +1,36 @@
+#pragma once
+#include "Common/pch.h"
+#include <span>
+
+// Read-only memory map of a whole file, pages are faulted in on first touch
+class MappedFile
+{
+public:
+    MappedFile() = default;
+    ~MappedFile();
+    MappedFile(const MappedFile &) = delete;
+    MappedFile &operator=(const MappedFile &) = delete;
+    MappedFile(MappedFile &&other) noexcept;
+    MappedFile &operator=(MappedFile &&other) noexcept;
+
+    bool Open(const std::string &path);
+    void Close();
+
+    bool IsOpen() const
+    {
+        return m_Data != nullptr;
+    }
+
+    std::span<const uint8_t> GetData() const
+    {
+        return {m_Data, m_Size};
+    }
+
+private:
+    const uint8_t *m_Data = nullptr;
+    size_t m_Size = 0;
+#ifdef _WIN32
+    void *m_File = nullptr;
+    void *m_Mapping = nullptr;
+#endif
+};
@@ -0,0 +1,27 @@
+#pragma once
+#include "Common/pch.h"
+#include "Engine/PixelFormat.h"
+
+enum class MipFilter : uint8_t
+{
+    // Average of the texels a target texel covers, soft but never rings
+    BOX,
+    // Kaiser windowed sinc, keeps more detail at the cost of slight ringing
+    KAISER
+};
+
+struct MipGenerationSettings
+{
+    MipFilter mFilter = MipFilter::KAISER;
+    // Levels in the result, counting the top one, 0 for the full chain down to 1x1
+    uint32_t mMaxLevels = 0;
+};
+
+// Builds the mip chain of an uncompressed image from its top level, in the same format. Every
+// level is filtered from the one above in linear float, sRGB color channels are decoded before
+// and encoded after filtering. Odd sizes weight the texels a target texel partly covers, so
+// non power of two images don't shift. Rows of each level are filtered in parallel.
+bool GenerateMips(const Image &source, const MipGenerationSettings &settings, Image &target);
+
+float SrgbToLinear(float value);
+float LinearToSrgb(float value);
@@ -12,6 +12,11 @@ public:
     void Update(float dt) override;
     void Shutdown();
 
+    const std::vector<Mesh> &GetMeshes() const
+    {
+        return m_Meshes;
+    }
+
 private:
     friend class ModelLoader;
     MathLib::HAABBox3D m_BoundingBox;
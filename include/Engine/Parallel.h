@@ -0,0 +1,97 @@
+#pragma once
+#include "Common/pch.h"
+#include "Engine/JobSystem.h"
+
+// Data-parallel helpers on top of JobSystem. Ranges are split in halves until they are no
+// larger than grainSize. The upper half of every split becomes a job, so idle workers steal
+// the biggest pieces left while the splitting thread keeps working on the lower half.
+// Without a JobSystem everything runs on the calling thread.
+
+template <typename Function>
+struct ParallelForContext
+{
+    Function &m_Function;
+    size_t m_GrainSize;
+    JobSystem *m_JobSystem;
+    uint32_t m_PipeLineID;
+    JobCounter m_Counter;
+};
+
+template <typename Function>
+void ParallelForRange(ParallelForContext<Function> &context, size_t begin, size_t end)
+{
+    while (end - begin > context.m_GrainSize)
+    {
+        size_t middle = begin + (end - begin) / 2;
+        auto job = std::make_unique<Job>([&context, middle, end]()
+                                         { ParallelForRange(context, middle, end); });
+        context.m_JobSystem->SubmitJob(job, context.m_PipeLineID, &context.m_Counter);
+        end = middle;
+    }
+    context.m_Function(begin, end);
+}
+
+// Calls function(chunkBegin, chunkEnd) for disjoint chunks covering [begin, end)
+template <typename Function>
+void ParallelFor(size_t begin, size_t end, size_t grainSize, Function &&function, uint32_t pipeLineID = 0)
+{
+    if (begin >= end)
+        return;
+    grainSize = std::max<size_t>(grainSize, 1);
+    JobSystem *jobSystem = JobSystem::GetInstance();
+    if (jobSystem == nullptr || end - begin <= grainSize)
+    {
+        function(begin, end);
+        return;
+    }
+    ParallelForContext<std::remove_reference_t<Function>> context{function, grainSize, jobSystem, pipeLineID, {}};
+    ParallelForRange(context, begin, end);
+    jobSystem->WaitForCounter(context.m_Counter);
+}
+
+template <typename Type, typename MapFunction, typename ReduceFunction>
+struct ParallelReduceContext
+{
+    const Type &m_Identity;
+    MapFunction &m_Map;
+    ReduceFunction &m_Reduce;
+    size_t m_GrainSize;
+    JobSystem *m_JobSystem;
+    uint32_t m_PipeLineID;
+};
+
+template <typename Type, typename MapFunction, typename ReduceFunction>
+Type ParallelReduceRange(ParallelReduceContext<Type, MapFunction, ReduceFunction> &context, size_t begin, size_t end)
+{
+    if (end - begin <= context.m_GrainSize)
+    {
+        return context.m_Map(begin, end);
+    }
+    size_t middle = begin + (end - begin) / 2;
+    Type right = context.m_Identity;
+    JobCounter counter;
+    auto job = std::make_unique<Job>([&context, &right, middle, end]()
+                                     { right = ParallelReduceRange(context, middle, end); });
+    context.m_JobSystem->SubmitJob(job, context.m_PipeLineID, &counter);
+    Type left = ParallelReduceRange(context, begin, middle);
+    context.m_JobSystem->WaitForCounter(counter);
+    // Always reduce left to right, so results don't depend on which thread ran what
+    return context.m_Reduce(left, right);
+}
+
+// Reduces map(chunkBegin, chunkEnd) over chunks of [begin, end) with reduce(left, right)
+template <typename Type, typename MapFunction, typename ReduceFunction>
+Type ParallelReduce(size_t begin, size_t end, size_t grainSize, const Type &identity, MapFunction &&map, ReduceFunction &&reduce, uint32_t pipeLineID = 0)
+{
+    if (begin >= end)
+        return identity;
+    grainSize = std::max<size_t>(grainSize, 1);
+    JobSystem *jobSystem = JobSystem::GetInstance();
+    if (jobSystem == nullptr || end - begin <= grainSize)
+    {
+        return map(begin, end);
+    }
+    ParallelReduceContext<Type, std::remove_reference_t<MapFunction>, std::remove_reference_t<ReduceFunction>> context{
+        identity, map, reduce, grainSize, jobSystem, pipeLineID};
+    return ParallelReduceRange(context, begin, end);
+}
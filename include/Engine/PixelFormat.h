@@ -0,0 +1,42 @@
+#pragma once
+#include "Common/pch.h"
+#include <span>
+
+struct PixelFormatInfo
+{
+    const char *mName;
+    // 1 for plain pixels, 4 for block compressed formats
+    uint32_t mBlockSize;
+    uint32_t mBytesPerBlock;
+    uint32_t mChannels;
+};
+
+const PixelFormatInfo &GetPixelFormatInfo(PixelFormat format);
+
+inline bool IsCompressedFormat(PixelFormat format)
+{
+    return GetPixelFormatInfo(format).mBlockSize > 1;
+}
+
+// Partial blocks at the right and bottom edge count as whole blocks. With mipLevels the size
+// of that many levels together, which is also the offset of the next level.
+uint64_t GetImageDataSize(PixelFormat format, uint32_t width, uint32_t height, uint32_t mipLevels = 1);
+uint64_t GetImageRowPitch(PixelFormat format, uint32_t width);
+
+// Each level halves both sizes, rounding down, until it reaches 1x1. Empty images stay empty.
+inline uint32_t GetMipSize(uint32_t size, uint32_t level)
+{
+    return size == 0 ? 0 : std::max(size >> level, 1u);
+}
+uint32_t GetMaxMipLevels(uint32_t width, uint32_t height);
+// Bytes of one level inside mData
+std::span<const uint8_t> GetMipData(const Image &image, uint32_t level);
+std::span<uint8_t> GetMipData(Image &image, uint32_t level);
+
+uint16_t FloatToHalf(float value);
+float HalfToFloat(uint16_t value);
+
+// Converts between uncompressed formats, rows of every mip level in parallel. Channels the
+// source lacks become 0, alpha becomes 1, and 8-bit targets clamp to [0, 1]. Values keep their
+// encoding, sRGB stays sRGB. False for compressed formats.
+bool ConvertImage(const Image &source, PixelFormat format, Image &target);
@@ -0,0 +1,334 @@
+#pragma once
+#include "Common/pch.h"
+#include "Engine/JobSystem.h"
+#include <coroutine>
+#include <exception>
+#include <optional>
+
+// Lazily started coroutine returning Type. Awaiting a Task starts it on the awaiting thread
+// and resumes the awaiter right where the Task finishes, through symmetric transfer, so a
+// chain of Tasks never blocks a thread. Use co_await ScheduleOn(...) or co_await RunJobs(...)
+// inside a Task to move onto JobSystem workers, and SyncWait to get a result from normal code.
+template <typename Type = void>
+class Task;
+
+struct TaskPromiseBase
+{
+    struct FinalAwaiter
+    {
+        bool await_ready() const noexcept
+        {
+            return false;
+        }
+
+        template <typename Promise>
+        std::coroutine_handle<> await_suspend(std::coroutine_handle<Promise> handle) noexcept
+        {
+            TaskPromiseBase &promise = handle.promise();
+            if (promise.m_Continuation)
+            {
+                return promise.m_Continuation;
+            }
+            // The frame may be destroyed as soon as the counter drops, don't touch it after
+            if (JobCounter *counter = promise.m_Counter)
+            {
+                counter->Decrement();
+            }
+            return std::noop_coroutine();
+        }
+
+        void await_resume() noexcept
+        {
+        }
+    };
+
+    std::suspend_always initial_suspend() noexcept
+    {
+        return {};
+    }
+
+    FinalAwaiter final_suspend() noexcept
+    {
+        return {};
+    }
+
+    void unhandled_exception()
+    {
+        m_Exception = std::current_exception();
+    }
+
+    void RethrowIfFailed()
+    {
+        if (m_Exception)
+        {
+            std::rethrow_exception(m_Exception);
+        }
+    }
+
+    std::coroutine_handle<> m_Continuation;
+    JobCounter *m_Counter = nullptr;
+    std::exception_ptr m_Exception;
+};
+
+template <typename Type>
+struct TaskPromise : TaskPromiseBase
+{
+    Task<Type> get_return_object();
+
+    template <typename Value>
+    void return_value(Value &&value)
+    {
+        m_Value.emplace(std::forward<Value>(value));
+    }
+
+    Type TakeResult()
+    {
+        RethrowIfFailed();
+        return std::move(*m_Value);
+    }
+
+    std::optional<Type> m_Value;
+};
+
+template <>
+struct TaskPromise<void> : TaskPromiseBase
+{
+    Task<void> get_return_object();
+
+    void return_void()
+    {
+    }
+
+    void TakeResult()
+    {
+        RethrowIfFailed();
+    }
+};
+
+template <typename Type>
+class Task
+{
+public:
+    using promise_type = TaskPromise<Type>;
+    using Handle = std::coroutine_handle<promise_type>;
+
+    Task() = default;
+    explicit Task(Handle handle) : m_Handle(handle) {}
+    Task(Task &&other) noexcept : m_Handle(std::exchange(other.m_Handle, nullptr)) {}
+    Task &operator=(Task &&other) noexcept
+    {
+        if (this != &other)
+        {
+            Reset();
+            m_Handle = std::exchange(other.m_Handle, nullptr);
+        }
+        return *this;
+    }
+    Task(const Task &) = delete;
+    Task &operator=(const Task &) = delete;
+
+    ~Task()
+    {
+        Reset();
+    }
+
+    bool IsValid() const
+    {
+        return static_cast<bool>(m_Handle);
+    }
+
+    bool IsDone() const
+    {
+        return m_Handle && m_Handle.done();
+    }
+
+    auto operator co_await() && noexcept
+    {
+        struct Awaiter
+        {
+            Handle m_Handle;
+
+            bool await_ready() const noexcept
+            {
+                return !m_Handle || m_Handle.done();
+            }
+
+            std::coroutine_handle<> await_suspend(std::coroutine_handle<> awaiting) noexcept
+            {
+                m_Handle.promise().m_Continuation = awaiting;
+                return m_Handle;
+            }
+
+            Type await_resume()
+            {
+                return m_Handle.promise().TakeResult();
+            }
+        };
+        return Awaiter{m_Handle};
+    }
+
+    // Starts the task on the calling thread, counter is decremented once it has finished
+    void Start(JobCounter &counter)
+    {
+        counter.Increment();
+        m_Handle.promise().m_Counter = &counter;
+        m_Handle.resume();
+    }
+
+    Type TakeResult()
+    {
+        return m_Handle.promise().TakeResult();
+    }
+
+private:
+    void Reset()
+    {
+        if (m_Handle)
+        {
+            m_Handle.destroy();
+            m_Handle = nullptr;
+        }
+    }
+
+    Handle m_Handle;
+};
+
+template <typename Type>
+Task<Type> TaskPromise<Type>::get_return_object()
+{
+    return Task<Type>(std::coroutine_handle<TaskPromise<Type>>::from_promise(*this));
+}
+
+inline Task<void> TaskPromise<void>::get_return_object()
+{
+    return Task<void>(std::coroutine_handle<TaskPromise<void>>::from_promise(*this));
+}
+
+// co_await ScheduleOn(pipeLineID) continues the coroutine on a worker of that pipeline,
+// e.g. to hop onto the FILE_IO pipeline before a blocking read
+struct ScheduleOnAwaiter
+{
+    JobSystem *m_JobSystem;
+    uint32_t m_PipeLineID;
+
+    bool await_ready() const noexcept
+    {
+        return m_JobSystem == nullptr;
+    }
+
+    void await_suspend(std::coroutine_handle<> handle)
+    {
+        auto job = std::make_unique<Job>([handle]()
+                                         { handle.resume(); });
+        if (!m_JobSystem->SubmitJob(job, m_PipeLineID))
+        {
+            handle.resume();
+        }
+    }
+
+    void await_resume() const noexcept
+    {
+    }
+};
+
+inline ScheduleOnAwaiter ScheduleOn(uint32_t pipeLineID = 0)
+{
+    return ScheduleOnAwaiter{JobSystem::GetInstance(), pipeLineID};
+}
+
+// co_await RunJobs(jobs, pipeLineID) submits the jobs and resumes the coroutine on a worker
+// once all of them have finished, without blocking any thread in between
+struct RunJobsAwaiter
+{
+    std::span<UniquePtr<Job>> m_Jobs;
+    JobSystem *m_JobSystem;
+    uint32_t m_PipeLineID;
+
+    bool await_ready()
+    {
+        if (m_Jobs.empty())
+            return true;
+        if (m_JobSystem == nullptr)
+        {
+            RunInline();
+            return true;
+        }
+        return false;
+    }
+
+    void await_suspend(std::coroutine_handle<> handle)
+    {
+        auto resume = std::make_unique<Job>([handle]()
+                                            { handle.resume(); });
+        for (UniquePtr<Job> &job : m_Jobs)
+        {
+            resume->AddDependency(*job);
+        }
+        JobSystem *jobSystem = m_JobSystem;
+        uint32_t pipeLineID = m_PipeLineID;
+        if (!jobSystem->SubmitJobs(m_Jobs, pipeLineID))
+        {
+            RunInline();
+            handle.resume();
+            return;
+        }
+        // Submitted last: the coroutine, and this awaiter with it, may be gone right after
+        jobSystem->SubmitJob(resume, pipeLineID);
+    }
+
+    void await_resume() const noexcept
+    {
+    }
+
+    void RunInline()
+    {
+        for (UniquePtr<Job> &job : m_Jobs)
+        {
+            job->Execute();
+            job.reset();
+        }
+    }
+};
+
+inline RunJobsAwaiter RunJobs(std::span<UniquePtr<Job>> jobs, uint32_t pipeLineID = 0)
+{
+    return RunJobsAwaiter{jobs, JobSystem::GetInstance(), pipeLineID};
+}
+
+inline void WaitForTasks(JobCounter &counter)
+{
+    if (JobSystem *jobSystem = JobSystem::GetInstance())
+    {
+        jobSystem->WaitForCounter(counter);
+    }
+    else
+    {
+        while (counter.GetValue() > 0)
+        {
+            std::this_thread::yield();
+        }
+    }
+}
+
+// Runs task to completion from non-coroutine code, helping with jobs while it waits
+template <typename Type>
+Type SyncWait(Task<Type> task)
+{
+    JobCounter counter;
+    task.Start(counter);
+    WaitForTasks(counter);
+    return task.TakeResult();
+}
+
+// Starts all tasks at once so they are in flight together, then waits for every one of them.
+// Results stay in the tasks, read them with TakeResult.
+template <typename Type>
+void SyncWaitAll(std::span<Task<Type>> tasks)
+{
+    JobCounter counter;
+    for (Task<Type> &task : tasks)
+    {
+        task.Start(counter);
+    }
+    WaitForTasks(counter);
+}
@@ -0,0 +1,28 @@
+#pragma once
+#include "Common/pch.h"
+#include "Engine/PixelFormat.h"
+
+enum class TextureCompressionQuality : uint8_t
+{
+    // Bounding box endpoints, no refinement
+    FAST,
+    // Endpoints along the principal axis, refined once
+    NORMAL,
+    // Refined until stable, BC7 also searches all p-bit combinations
+    HIGH
+};
+
+struct TextureCompressionSettings
+{
+    PixelFormat mFormat = PixelFormat::BC7;
+    TextureCompressionQuality mQuality = TextureCompressionQuality::NORMAL;
+};
+
+// Encodes any uncompressed image into BC1 (RGB), BC3 (RGBA), BC5 (RG) or BC7 (RGBA), every
+// mip level, rows of blocks in parallel. BC7 blocks are written in mode 6, a single RGBA subset.
+bool CompressImage(const Image &source, const TextureCompressionSettings &settings, Image &target);
+// Back to RGBA8, BC7 only in the modes CompressImage writes
+bool DecompressImage(const Image &source, Image &target);
+// Peak signal to noise ratio in dB over the first channels of the top level of two RGBA8
+// images, infinity when they are identical
+double ComputeImagePSNR(const Image &a, const Image &b, uint32_t channels = 4);
@@ -0,0 +1,232 @@
+#pragma once
+#include "Common/pch.h"
+#include <array>
+
+struct TimerHandle
+{
+    uint32_t mIndex = UINT32_MAX;
+    uint32_t mGeneration = 0;
+
+    bool IsValid() const
+    {
+        return mIndex != UINT32_MAX;
+    }
+};
+
+// Hierarchical timer wheel with four levels of 256 slots. Level 0 holds timers due in the next
+// 256 ticks, one slot per tick, and each level above covers 256 times the range of the one below.
+// Whenever a level wraps around, the matching slot of the next level is spread over the levels
+// below. Timers live in a pool as intrusive doubly linked lists, so inserting and cancelling are
+// O(1). Not thread safe, JobSystem guards its wheel with a mutex.
+template <typename Payload>
+class TimerWheel
+{
+public:
+    static constexpr uint32_t LEVELS = 4;
+    static constexpr uint32_t SLOT_BITS = 8;
+    static constexpr uint32_t SLOTS = 1u << SLOT_BITS;
+    // Timers further out than this are clamped
+    static constexpr uint64_t MAX_DELAY = (uint64_t(1) << (SLOT_BITS * LEVELS)) - 1;
+
+    TimerWheel()
+    {
+        m_Slots.fill(INVALID);
+    }
+
+    // Fires once expireTick has been reached, and then every period ticks unless period is 0.
+    // A timer never fires in the tick it was added in.
+    TimerHandle Schedule(uint64_t expireTick, uint64_t period, Payload payload)
+    {
+        uint32_t index = m_FreeList;
+        if (index == INVALID)
+        {
+            index = static_cast<uint32_t>(m_Entries.size());
+            m_Entries.emplace_back();
+        }
+        else
+        {
+            m_FreeList = m_Entries[index].mNext;
+        }
+        Entry &entry = m_Entries[index];
+        entry.mPayload = std::move(payload);
+        entry.mExpireTick = std::clamp(expireTick, m_CurrentTick + 1, m_CurrentTick + MAX_DELAY);
+        entry.mPeriod = period;
+        Link(index);
+        m_NumTimers++;
+        return {index, entry.mGeneration};
+    }
+
+    // False when the timer already fired for the last time or was cancelled before
+    bool Cancel(TimerHandle handle)
+    {
+        if (!IsScheduled(handle))
+            return false;
+        Unlink(handle.mIndex);
+        Release(handle.mIndex);
+        return true;
+    }
+
+    bool IsScheduled(TimerHandle handle) const
+    {
+        return handle.mIndex < m_Entries.size() && m_Entries[handle.mIndex].mGeneration == handle.mGeneration &&
+               m_Entries[handle.mIndex].mSlot != INVALID;
+    }
+
+    // Moves time forward to tick and calls onExpired(Payload) for every timer that came due, in
+    // the order they are due. One-shot timers hand over their payload, periodic ones a copy.
+    // onExpired must not schedule or cancel timers.
+    template <typename Callback>
+    void Advance(uint64_t tick, Callback &&onExpired)
+    {
+        while (m_CurrentTick < tick)
+        {
+            if (m_NumTimers == 0)
+            {
+                m_CurrentTick = tick;
+                return;
+            }
+            m_CurrentTick++;
+            for (uint32_t level = LEVELS - 1; level > 0; level--)
+            {
+                if ((m_CurrentTick & ((uint64_t(1) << (SLOT_BITS * level)) - 1)) == 0)
+                {
+                    Cascade(level);
+                }
+            }
+
+            uint32_t &head = m_Slots[m_CurrentTick & (SLOTS - 1)];
+            while (head != INVALID)
+            {
+                uint32_t index = head;
+                Unlink(index);
+                Entry &entry = m_Entries[index];
+                if (entry.mPeriod == 0)
+                {
+                    Payload payload = std::move(entry.mPayload);
+                    Release(index);
+                    onExpired(std::move(payload));
+                    continue;
+                }
+                // Periods missed while nobody advanced the wheel are skipped, not fired in a burst
+                uint64_t next = entry.mExpireTick + entry.mPeriod;
+                if (next <= tick)
+                {
+                    next += ((tick - next) / entry.mPeriod + 1) * entry.mPeriod;
+                }
+                entry.mExpireTick = next;
+                Link(index);
+                onExpired(Payload(entry.mPayload));
+            }
+        }
+    }
+
+    // First tick at which Advance may have work to do, UINT64_MAX when no timer is pending.
+    // Looks at level 0 only, so for timers further out it returns the next cascade.
+    uint64_t GetNextEventTick() const
+    {
+        if (m_NumTimers == 0)
+            return UINT64_MAX;
+        for (uint64_t tick = m_CurrentTick + 1; tick <= m_CurrentTick + SLOTS; tick++)
+        {
+            if (m_Slots[tick & (SLOTS - 1)] != INVALID)
+                return tick;
+            if ((tick & (SLOTS - 1)) == 0)
+                return tick;
+        }
+        return m_CurrentTick + SLOTS;
+    }
+
+    uint64_t GetCurrentTick() const
+    {
+        return m_CurrentTick;
+    }
+
+    uint32_t GetNumTimers() const
+    {
+        return m_NumTimers;
+    }
+
+private:
+    static constexpr uint32_t INVALID = UINT32_MAX;
+
+    struct Entry
+    {
+        Payload mPayload{};
+        uint64_t mExpireTick = 0;
+        uint64_t mPeriod = 0;
+        uint32_t mNext = INVALID;
+        uint32_t mPrev = INVALID;
+        uint32_t mSlot = INVALID;
+        uint32_t mGeneration = 0;
+    };
+
+    void Link(uint32_t index)
+    {
+        Entry &entry = m_Entries[index];
+        uint64_t delta = entry.mExpireTick > m_CurrentTick ? entry.mExpireTick - m_CurrentTick : 0;
+        uint32_t level = 0;
+        while (level + 1 < LEVELS && delta >= (uint64_t(1) << (SLOT_BITS * (level + 1))))
+        {
+            level++;
+        }
+        // Due timers met during a cascade go into the current slot, which is processed next
+        uint64_t tick = std::max(entry.mExpireTick, m_CurrentTick);
+        uint32_t slot = level * SLOTS + static_cast<uint32_t>((tick >> (SLOT_BITS * level)) & (SLOTS - 1));
+        entry.mSlot = slot;
+        entry.mPrev = INVALID;
+        entry.mNext = m_Slots[slot];
+        if (entry.mNext != INVALID)
+        {
+            m_Entries[entry.mNext].mPrev = index;
+        }
+        m_Slots[slot] = index;
+    }
+
+    void Unlink(uint32_t index)
+    {
+        Entry &entry = m_Entries[index];
+        if (entry.mPrev != INVALID)
+        {
+            m_Entries[entry.mPrev].mNext = entry.mNext;
+        }
+        else
+        {
+            m_Slots[entry.mSlot] = entry.mNext;
+        }
+        if (entry.mNext != INVALID)
+        {
+            m_Entries[entry.mNext].mPrev = entry.mPrev;
+        }
+        entry.mSlot = INVALID;
+    }
+
+    void Release(uint32_t index)
+    {
+        Entry &entry = m_Entries[index];
+        entry.mPayload = Payload{};
+        entry.mGeneration++;
+        entry.mNext = m_FreeList;
+        m_FreeList = index;
+        m_NumTimers--;
+    }
+
+    void Cascade(uint32_t level)
+    {
+        uint32_t slot = level * SLOTS + static_cast<uint32_t>((m_CurrentTick >> (SLOT_BITS * level)) & (SLOTS - 1));
+        uint32_t index = m_Slots[slot];
+        m_Slots[slot] = INVALID;
+        while (index != INVALID)
+        {
+            uint32_t next = m_Entries[index].mNext;
+            Link(index);
+            index = next;
+        }
+    }
+
+private:
+    std::vector<Entry> m_Entries;
+    std::array<uint32_t, LEVELS * SLOTS> m_Slots;
+    uint32_t m_FreeList = INVALID;
+    uint32_t m_NumTimers = 0;
+    uint64_t m_CurrentTick = 0;
+};
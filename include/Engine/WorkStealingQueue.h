@@ -0,0 +1,135 @@
+#pragma once
+#include "Common/pch.h"
+#include <atomic>
+
+// Chase-Lev work-stealing deque, using the memory orderings from
+// Le et al. "Correct and Efficient Work-Stealing for Weak Memory Models".
+// Push/Pop may only be called by the owning thread, Steal may be called from any thread.
+template <typename Type>
+class WorkStealingQueue
+{
+public:
+    explicit WorkStealingQueue(int64_t capacity = 256)
+        : m_Top(0),
+          m_Bottom(0),
+          m_Buffer(new Buffer(capacity))
+    {
+    }
+
+    ~WorkStealingQueue()
+    {
+        delete m_Buffer.load(std::memory_order_relaxed);
+    }
+
+    WorkStealingQueue(const WorkStealingQueue &) = delete;
+    WorkStealingQueue &operator=(const WorkStealingQueue &) = delete;
+
+    void Push(Type item)
+    {
+        int64_t bottom = m_Bottom.load(std::memory_order_relaxed);
+        int64_t top = m_Top.load(std::memory_order_acquire);
+        Buffer *buffer = m_Buffer.load(std::memory_order_relaxed);
+        if (bottom - top > buffer->m_Capacity - 1)
+        {
+            buffer = Grow(buffer, bottom, top);
+        }
+        buffer->Store(bottom, item);
+        m_Bottom.store(bottom + 1, std::memory_order_release);
+    }
+
+    bool Pop(Type &item)
+    {
+        int64_t bottom = m_Bottom.load(std::memory_order_relaxed) - 1;
+        Buffer *buffer = m_Buffer.load(std::memory_order_relaxed);
+        m_Bottom.store(bottom, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        int64_t top = m_Top.load(std::memory_order_relaxed);
+        if (top > bottom)
+        {
+            m_Bottom.store(bottom + 1, std::memory_order_relaxed);
+            return false;
+        }
+        item = buffer->Load(bottom);
+        if (top == bottom)
+        {
+            // Last element, race against thieves for it
+            bool won = m_Top.compare_exchange_strong(top, top + 1, std::memory_order_seq_cst, std::memory_order_relaxed);
+            m_Bottom.store(bottom + 1, std::memory_order_relaxed);
+            return won;
+        }
+        return true;
+    }
+
+    bool Steal(Type &item)
+    {
+        int64_t top = m_Top.load(std::memory_order_acquire);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        int64_t bottom = m_Bottom.load(std::memory_order_acquire);
+        if (top >= bottom)
+        {
+            return false;
+        }
+        Buffer *buffer = m_Buffer.load(std::memory_order_acquire);
+        item = buffer->Load(top);
+        return m_Top.compare_exchange_strong(top, top + 1, std::memory_order_seq_cst, std::memory_order_relaxed);
+    }
+
+    bool IsEmpty() const
+    {
+        int64_t bottom = m_Bottom.load(std::memory_order_relaxed);
+        int64_t top = m_Top.load(std::memory_order_relaxed);
+        return bottom <= top;
+    }
+
+    size_t Size() const
+    {
+        int64_t bottom = m_Bottom.load(std::memory_order_relaxed);
+        int64_t top = m_Top.load(std::memory_order_relaxed);
+        return bottom > top ? static_cast<size_t>(bottom - top) : 0;
+    }
+
+private:
+    struct Buffer
+    {
+        explicit Buffer(int64_t capacity)
+            : m_Capacity(capacity),
+              m_Mask(capacity - 1),
+              m_Data(new std::atomic<Type>[capacity])
+        {
+            HASSERT((capacity & (capacity - 1)) == 0);
+        }
+
+        void Store(int64_t index, Type item)
+        {
+            m_Data[index & m_Mask].store(item, std::memory_order_relaxed);
+        }
+
+        Type Load(int64_t index) const
+        {
+            return m_Data[index & m_Mask].load(std::memory_order_relaxed);
+        }
+
+        int64_t m_Capacity;
+        int64_t m_Mask;
+        UniquePtr<std::atomic<Type>[]> m_Data;
+    };
+
+    Buffer *Grow(Buffer *buffer, int64_t bottom, int64_t top)
+    {
+        Buffer *newBuffer = new Buffer(buffer->m_Capacity * 2);
+        for (int64_t i = top; i != bottom; ++i)
+        {
+            newBuffer->Store(i, buffer->Load(i));
+        }
+        // Thieves may still be reading from the old buffer, keep it alive until the queue dies
+        m_RetiredBuffers.emplace_back(buffer);
+        m_Buffer.store(newBuffer, std::memory_order_release);
+        return newBuffer;
+    }
+
+private:
+    alignas(64) std::atomic<int64_t> m_Top;
+    alignas(64) std::atomic<int64_t> m_Bottom;
+    std::atomic<Buffer *> m_Buffer;
+    std::vector<UniquePtr<Buffer>> m_RetiredBuffers;
+};
@@ -0,0 +1,39 @@
+#pragma once
+#include "Common/pch.h"
+#include "Engine/JobSystem.h"
+
+struct WorkerBalancePolicy
+{
+    // A pipeline whose queue would take longer than this to drain at its measured
+    // completion rate asks for another worker
+    uint32_t mTargetDrainMicroseconds = 2000;
+    // How often JobSystem's balancer thread runs a step
+    uint32_t mIntervalMilliseconds = 5;
+};
+
+// Moves workers from pipelines with little to do to the one under the most pressure.
+// Pressure is the queue depth divided by the completion rate measured since the last step,
+// which is the expected wait of a newly queued job. At most one worker moves per step and
+// each pipeline's min/max quota is respected.
+class WorkerBalancer
+{
+public:
+    explicit WorkerBalancer(const WorkerBalancePolicy &policy = WorkerBalancePolicy());
+
+    void SetPolicy(const WorkerBalancePolicy &policy);
+    const WorkerBalancePolicy &GetPolicy() const;
+    // Returns whether a worker was moved. The first step only takes measurements.
+    bool Rebalance(std::span<JobPipeLine *const> pipeLines);
+    // Drops the measurements of a pipeline that is about to be destroyed
+    void Forget(JobPipeLine *pipeLine);
+
+private:
+    struct Sample
+    {
+        uint64_t mCompleted = 0;
+        std::chrono::steady_clock::time_point mTime;
+    };
+
+    WorkerBalancePolicy m_Policy;
+    std::unordered_map<JobPipeLine *, Sample> m_Samples;
+};
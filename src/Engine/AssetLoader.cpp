@@ -1,119 +1,458 @@
 #include "Common/pch.h"
 #include <Engine/AssetLoader.h>
+#include <Engine/Parallel.h>
+#include <Engine/AsyncFileService.h>
+#include <Engine/CookedMesh.h>
+#include <Engine/DerivedDataCache.h>
 #include <assimp/Importer.hpp>
+#include <assimp/IOStream.hpp>
+#include <assimp/IOSystem.hpp>
 #include <assimp/scene.h>
 #include <assimp/mesh.h>
 #include <assimp/postprocess.h>
 #include <SOIL2/SOIL2.h>
-void ModelLoader::ReadFile(const std::string &filename, Model &model)
+#include <cstring>
+#include <filesystem>
+
+// Number of pixels expanded per job when images are converted to RGBA
+static constexpr size_t IMAGE_CONVERT_GRAIN = 64 * 1024;
+// Part of every derived data key, bump them when an importer's output changes so results of
+// the old code are no longer found
+static constexpr uint64_t MODEL_IMPORTER_VERSION = 1;
+static constexpr uint64_t IMAGE_IMPORTER_VERSION = 2;
+
+class ModelFileStream : public Assimp::IOStream
 {
-    auto it = m_models.find(filename);
-    if (it != m_models.end())
+public:
+    explicit ModelFileStream(std::span<const uint8_t> data) : m_Data(data)
+    {
+    }
+
+    size_t Read(void *buffer, size_t size, size_t count) override
+    {
+        if (size == 0)
+            return 0;
+        count = std::min(count, (m_Data.size() - m_Position) / size);
+        std::memcpy(buffer, m_Data.data() + m_Position, size * count);
+        m_Position += size * count;
+        return count;
+    }
+
+    size_t Write(const void *, size_t, size_t) override
+    {
+        return 0;
+    }
+
+    aiReturn Seek(size_t offset, aiOrigin origin) override
+    {
+        // Like Assimp's own streams, offsets from the end count backwards
+        const size_t base = origin == aiOrigin_CUR ? m_Position : 0;
+        if (origin == aiOrigin_END ? offset > m_Data.size() : offset > m_Data.size() - base)
+            return aiReturn_FAILURE;
+        m_Position = origin == aiOrigin_END ? m_Data.size() - offset : base + offset;
+        return aiReturn_SUCCESS;
+    }
+
+    size_t Tell() const override
+    {
+        return m_Position;
+    }
+
+    size_t FileSize() const override
+    {
+        return m_Data.size();
+    }
+
+    void Flush() override
+    {
+    }
+
+private:
+    std::span<const uint8_t> m_Data;
+    size_t m_Position = 0;
+};
+
+// Everything the importer opens goes through here. The model itself is served from the bytes
+// the loader already read, the files it references are read with ReadFileBytes, which runs
+// other jobs while it waits, so a decode job never blocks its worker on the disk.
+class ModelFileSystem : public Assimp::IOSystem
+{
+public:
+    ModelFileSystem(const std::string &filename, std::span<const uint8_t> data)
+        : m_Filename(std::filesystem::path(filename).lexically_normal()), m_Data(data)
+    {
+    }
+
+    bool Exists(const char *path) const override
+    {
+        return IsModel(path) || FindSideFile(path).mExists;
+    }
+
+    char getOsSeparator() const override
+    {
+        return static_cast<char>(std::filesystem::path::preferred_separator);
+    }
+
+    Assimp::IOStream *Open(const char *path, const char *mode) override
+    {
+        if (std::strchr(mode, 'w') || std::strchr(mode, 'a'))
+            return nullptr;
+        if (IsModel(path))
+            return new ModelFileStream(m_Data);
+        const SideFile &file = FindSideFile(path);
+        return file.mExists ? new ModelFileStream(file.mData) : nullptr;
+    }
+
+    void Close(Assimp::IOStream *stream) override
     {
-        model = it->second;
-        return;
+        delete stream;
     }
 
+    // Paths relative to the model of every other file the importer asked for, one per line
+    std::string GetSideFileList() const
+    {
+        std::string list;
+        for (const UniquePtr<SideFile> &file : m_SideFiles)
+        {
+            list += file->mPath.lexically_relative(m_Filename.parent_path()).generic_string();
+            list += '\n';
+        }
+        return list;
+    }
+
+    // Reads the files of a list made by GetSideFileList ahead of the importer
+    void ReadSideFiles(std::span<const uint8_t> list)
+    {
+        std::string_view names(reinterpret_cast<const char *>(list.data()), list.size());
+        while (!names.empty())
+        {
+            const size_t end = std::min(names.find('\n'), names.size());
+            FindSideFile((m_Filename.parent_path() / names.substr(0, end)).string().c_str());
+            names.remove_prefix(std::min(end + 1, names.size()));
+        }
+    }
+
+    // Missing files are part of the key too, creating one later changes the import
+    void AddSideFiles(DerivedDataKeyBuilder &builder) const
+    {
+        for (const UniquePtr<SideFile> &file : m_SideFiles)
+        {
+            builder.Add(file->mPath.lexically_relative(m_Filename.parent_path()).generic_string()).Add(file->mExists).Add(file->mData);
+        }
+    }
+
+private:
+    struct SideFile
+    {
+        std::filesystem::path mPath;
+        bool mExists = false;
+        std::vector<uint8_t> mData;
+    };
+
+    bool IsModel(const char *path) const
+    {
+        return std::filesystem::path(path).lexically_normal() == m_Filename;
+    }
+
+    // Read once on first use, importers often check for a file before opening it
+    const SideFile &FindSideFile(const char *path) const
+    {
+        std::filesystem::path normalized = std::filesystem::path(path).lexically_normal();
+        for (const UniquePtr<SideFile> &file : m_SideFiles)
+        {
+            if (file->mPath == normalized)
+                return *file;
+        }
+        UniquePtr<SideFile> &file = m_SideFiles.emplace_back(std::make_unique<SideFile>());
+        file->mPath = std::move(normalized);
+        file->mExists = ReadFileBytes(file->mPath.string(), file->mData);
+        return *file;
+    }
+
+private:
+    std::filesystem::path m_Filename;
+    std::span<const uint8_t> m_Data;
+    // Stable addresses, streams point into the data
+    mutable std::vector<UniquePtr<SideFile>> m_SideFiles;
+};
+
+// aiVector3D is three packed floats like HVector3, positions and normals are copied in bulk
+static_assert(sizeof(aiVector3D) == sizeof(MathLib::HVector3), "Assimp built with double precision");
+
+static void ConvertMesh(const aiMesh *mesh, Mesh &newMesh)
+{
+    const uint32_t numVertices = mesh->mNumVertices;
+    newMesh.mVertices.resize(numVertices);
+    std::memcpy(newMesh.mVertices.data(), mesh->mVertices, numVertices * sizeof(aiVector3D));
+    if (mesh->HasNormals())
+    {
+        newMesh.mNormals.resize(numVertices);
+        std::memcpy(newMesh.mNormals.data(), mesh->mNormals, numVertices * sizeof(aiVector3D));
+    }
+    if (mesh->HasTangentsAndBitangents())
+    {
+        newMesh.mTangents.resize(numVertices);
+        for (uint32_t j = 0; j < numVertices; ++j)
+        {
+            const aiVector3D &tangent = mesh->mTangents[j];
+            newMesh.mTangents[j] = MathLib::HVector4(tangent.x, tangent.y, tangent.z, 0.0f);
+        }
+    }
+    for (uint32_t j = 0; j < mesh->GetNumUVChannels() && mesh->HasTextureCoords(j); ++j)
+    {
+        std::vector<MathLib::HVector2> &texCoords = newMesh.mTexCoordsArray.emplace_back(numVertices);
+        const aiVector3D *source = mesh->mTextureCoords[j];
+        for (uint32_t k = 0; k < numVertices; ++k)
+        {
+            texCoords[k] = MathLib::HVector2(source[k].x, source[k].y);
+        }
+    }
+    // Faces are triangles after aiProcess_Triangulate, but points and lines keep fewer indices
+    size_t numIndices = 0;
+    for (uint32_t j = 0; j < mesh->mNumFaces; ++j)
+    {
+        numIndices += mesh->mFaces[j].mNumIndices;
+    }
+    newMesh.mIndices.resize(numIndices);
+    uint32_t *indices = newMesh.mIndices.data();
+    for (uint32_t j = 0; j < mesh->mNumFaces; ++j)
+    {
+        const aiFace &face = mesh->mFaces[j];
+        std::memcpy(indices, face.mIndices, face.mNumIndices * sizeof(uint32_t));
+        indices += face.mNumIndices;
+    }
+}
+
+static bool DecodeCookedMeshes(const std::string &filename, std::span<const uint8_t> data, std::vector<Mesh> &meshes)
+{
+    CookedModel cooked;
+    if (!cooked.Parse(data))
+    {
+        HLOG_ERROR("%s is not a valid cooked mesh file\n", filename.c_str());
+        return false;
+    }
+    meshes.resize(cooked.GetNumMeshes());
+    for (uint32_t i = 0; i < cooked.GetNumMeshes(); i++)
+    {
+        cooked.GetMesh(i).CopyTo(meshes[i]);
+    }
+    return true;
+}
+
+bool ModelLoader::Decode(const std::string &filename, std::span<const uint8_t> data, Model &model)
+{
+    // Cooked models are laid out like Mesh already, no importer needed
+    if (IsCookedMeshData(data))
+        return DecodeCookedMeshes(filename, data, model.m_Meshes);
+    const unsigned int flags = aiProcess_Triangulate | aiProcess_GenSmoothNormals | aiProcess_FlipUVs;
     Assimp::Importer importer;
-    const aiScene *scene = importer.ReadFile(filename, aiProcess_Triangulate | aiProcess_GenSmoothNormals | aiProcess_FlipUVs);
+    // The importer owns its IO system and deletes it
+    ModelFileSystem *files = new ModelFileSystem(filename, data);
+    importer.SetIOHandler(files);
+    auto makeKey = [&]()
+    {
+        DerivedDataKeyBuilder builder("Model");
+        builder.Add(MODEL_IMPORTER_VERSION).Add(COOKED_MESH_VERSION).Add(flags).Add(data);
+        files->AddSideFiles(builder);
+        return builder.Finish();
+    };
+    // A model imported before comes back cooked from the derived data cache. Its key covers
+    // the files the model references as well, an .mtl or external glTF buffers. Which files
+    // those are only depends on the model's own bytes, so the list is cached by itself and a
+    // warm load knows what to read without running the importer.
+    DerivedDataCache &cache = DerivedDataCache::GetInstance();
+    DerivedDataKey listKey;
+    if (cache.IsOpen())
+    {
+        listKey = DerivedDataKeyBuilder("ModelFiles").Add(MODEL_IMPORTER_VERSION).Add(flags).Add(data).Finish();
+        std::vector<uint8_t> list, cooked;
+        if (cache.Get(listKey, list))
+        {
+            files->ReadSideFiles(list);
+            if (cache.Get(makeKey(), cooked) && DecodeCookedMeshes(filename, cooked, model.m_Meshes))
+                return true;
+        }
+    }
+    const aiScene *scene = importer.ReadFile(filename, flags);
     if (!scene)
     {
         HLOG_ERROR("Loading model %s failed\n", filename.c_str());
-        return;
+        return false;
     }
     HLOG_INFO("Loading model %s\n", filename.c_str());
     model.m_Meshes.resize(scene->mNumMeshes);
+    // Meshes are independent, convert each one in its own job
+    ParallelFor(0, scene->mNumMeshes, 1, [&](size_t meshBegin, size_t meshEnd)
+                {
+        for (size_t i = meshBegin; i < meshEnd; ++i)
+        {
+            ConvertMesh(scene->mMeshes[i], model.m_Meshes[i]);
+        } });
+    // rand() and the log are not safe to use from the jobs, so they run here in mesh order
     for (uint32_t i = 0; i < scene->mNumMeshes; ++i)
     {
-        aiMesh *mesh = scene->mMeshes[i];
-        auto &newMesh = model.m_Meshes[i];
+        const aiMesh *mesh = scene->mMeshes[i];
         HLOG_INFO("Loading mesh %s\n", mesh->mName.C_Str());
         HLOG_INFO("Number of vertices: %d\n", mesh->mNumVertices);
         HLOG_INFO("Number of faces: %d\n", mesh->mNumFaces);
         HLOG_INFO("Has normals: %d\n", mesh->HasNormals());
         HLOG_INFO("Has tangents and bitangents: %d\n", mesh->HasTangentsAndBitangents());
         HLOG_INFO("Number of texture coordinates: %d\n", mesh->GetNumUVChannels());
-        newMesh.mVertices.resize(mesh->mNumVertices);
-        newMesh.mIndices.resize(mesh->mNumFaces * 3);
-        for (uint32_t j = 0; j < mesh->mNumVertices; ++j)
-        {
-            aiVector3D vertex = mesh->mVertices[j];
-            newMesh.mVertices.push_back(MathLib::HVector3(vertex.x, vertex.y, vertex.z));
-        }
-        if (mesh->HasNormals())
-        {
-            newMesh.mNormals.resize(mesh->mNumVertices);
-            for (uint32_t j = 0; j < mesh->mNumVertices; ++j)
-            {
-                aiVector3D normal = mesh->mNormals[j];
-                newMesh.mNormals.push_back(MathLib::HVector3(normal.x, normal.y, normal.z));
-            }
-        }
-        if (mesh->HasTangentsAndBitangents())
-        {
-            newMesh.mTangents.resize(mesh->mNumVertices);
-            for (uint32_t j = 0; j < mesh->mNumVertices; ++j)
-            {
-                aiVector3D tangent = mesh->mTangents[j];
-                newMesh.mTangents.push_back(MathLib::HVector4(tangent.x, tangent.y, tangent.z, 0.0f));
-            }
-        }
-        for (uint32_t j = 0; j < mesh->GetNumUVChannels(); ++j)
+        model.m_Meshes[i].mColor = RandomColor();
+    }
+    std::vector<uint8_t> cooked;
+    if (cache.IsOpen() && SerializeCookedMeshes(model.m_Meshes, cooked))
+    {
+        const std::string list = files->GetSideFileList();
+        if (cache.Put(makeKey(), cooked))
         {
-            if (mesh->HasTextureCoords(j))
-            {
-                newMesh.mTexCoordsArray.push_back(std::vector<MathLib::HVector2>(mesh->mNumVertices));
-                for (uint32_t k = 0; k < mesh->mNumVertices; ++k)
-                {
-                    aiVector3D texCoord = mesh->mTextureCoords[j][k];
-                    newMesh.mTexCoordsArray[j].push_back(MathLib::HVector2(texCoord.x, texCoord.y));
-                }
-            }
-            else
-                break;
+            cache.Put(listKey, std::span(reinterpret_cast<const uint8_t *>(list.data()), list.size()));
         }
-        for (uint32_t j = 0; j < mesh->mNumFaces; ++j)
-        {
-            aiFace face = mesh->mFaces[j];
-            for (uint32_t k = 0; k < face.mNumIndices; ++k)
-            {
-                newMesh.mIndices.push_back(face.mIndices[k]);
-            }
-        }
-        newMesh.mColor = RandomColor();
     }
-    m_models.emplace(std::make_pair(filename, model));
+    return true;
 }
 
-void ImageLoader::ReadFile(const std::string &filename, Image &image)
+bool ImageLoader::Decode(const std::string &filename, std::span<const uint8_t> data, Image &image)
 {
-    auto it = m_images.find(filename);
-    if (it != m_images.end())
+    // Cooked textures already hold their mips in the final format
+    if (IsCookedTextureData(data))
     {
-        image = it->second;
-        return;
+        if (!ReadCookedTexture(data, image))
+        {
+            HLOG_ERROR("%s is not a valid cooked texture file\n", filename.c_str());
+            return false;
+        }
+        return true;
+    }
+    // Decoded before, the texels come back from the derived data cache
+    DerivedDataCache &cache = DerivedDataCache::GetInstance();
+    DerivedDataKey key;
+    if (cache.IsOpen())
+    {
+        key = DerivedDataKeyBuilder("Image").Add(IMAGE_IMPORTER_VERSION).Add(COOKED_TEXTURE_VERSION).Add(data).Finish();
+        std::vector<uint8_t> cooked;
+        if (cache.Get(key, cooked) && ReadCookedTexture(cooked, image))
+            return true;
     }
-
     int width, height, channels;
-    unsigned char *pixels = SOIL_load_image(filename.c_str(), &width, &height, &channels, SOIL_LOAD_RGBA);
+    // Decoded at the channel count of the file, 8 bits each
+    unsigned char *pixels = SOIL_load_image_from_memory(data.data(), static_cast<int>(data.size()), &width, &height, &channels, SOIL_LOAD_AUTO);
     if (!pixels)
     {
         HLOG_ERROR("Loading image %s failed\n", filename.c_str());
-        return;
+        return false;
     }
     HLOG_INFO("Loading image %s\n", filename.c_str());
     HLOG_INFO("width: %d, height: %d, channels: %d\n", width, height, channels);
     image.mWidth = width;
     image.mHeight = height;
-    image.mChannels = channels;
-    image.mPixels.reserve(width * height * channels);
-    for (int i = 0; i < width * height * channels; ++i)
+    image.mFormat = PixelFormat::RGBA8;
+    const size_t pixelCount = static_cast<size_t>(width) * height;
+    if (channels == 4)
+    {
+        image.mData.assign(pixels, pixels + pixelCount * 4);
+    }
+    else
     {
-        image.mPixels.push_back(pixels[i] / 255.0f);
+        // GPUs have no 24-bit format and R8/RG8 would sample grey as red, so everything
+        // becomes RGBA: grey is spread to L,L,L and the second channel of grey files is alpha
+        image.mData.resize(pixelCount * 4);
+        const size_t rowsPerJob = std::max<size_t>(1, IMAGE_CONVERT_GRAIN / std::max<size_t>(width, 1));
+        ParallelFor(0, height, rowsPerJob, [&](size_t rowBegin, size_t rowEnd)
+                    {
+            for (size_t i = rowBegin * width; i < rowEnd * width; ++i)
+            {
+                const unsigned char *src = pixels + i * channels;
+                uint8_t *dst = image.mData.data() + i * 4;
+                if (channels >= 3)
+                {
+                    dst[0] = src[0];
+                    dst[1] = src[1];
+                    dst[2] = src[2];
+                    dst[3] = 255;
+                }
+                else
+                {
+                    dst[0] = dst[1] = dst[2] = src[0];
+                    dst[3] = channels == 2 ? src[1] : 255;
+                }
+            } });
     }
     SOIL_free_image_data(pixels);
-    m_images.emplace(std::make_pair(filename, image));
+    std::vector<uint8_t> cooked;
+    if (cache.IsOpen() && SerializeCookedTexture(image, cooked))
+    {
+        cache.Put(key, cooked);
+    }
+    return true;
+}
+
+uint64_t ImageLoader::GetAssetBytes(const Image &image) const
+{
+    return sizeof(Image) + image.mData.capacity();
 }
 
-void MaterialLoader::ReadFile(const std::string& filename, IMaterial& asset)
-{}
\ No newline at end of file
+bool ImageLoader::Cook(const std::string &filename, const std::string &cookedPath, const TextureCookSettings &settings)
+{
+    std::vector<uint8_t> data;
+    if (!ReadFileBytes(filename, data))
+        return false;
+    // Filtering and compressing are by far the slowest part, the result is cached by itself
+    DerivedDataCache &cache = DerivedDataCache::GetInstance();
+    DerivedDataKey key;
+    std::vector<uint8_t> file;
+    if (cache.IsOpen())
+    {
+        key = DerivedDataKeyBuilder("CookedTexture")
+                  .Add(IMAGE_IMPORTER_VERSION)
+                  .Add(COOKED_TEXTURE_VERSION)
+                  .Add(settings.mIsSRGB)
+                  .Add(static_cast<uint64_t>(settings.mMips.mFilter))
+                  .Add(settings.mMips.mMaxLevels)
+                  .Add(settings.mIsCompressed)
+                  .Add(static_cast<uint64_t>(settings.mCompression.mFormat))
+                  .Add(static_cast<uint64_t>(settings.mCompression.mQuality))
+                  .Add(data)
+                  .Finish();
+        if (cache.Get(key, file) && IsCookedTextureData(file))
+            return WriteFileAtomically(cookedPath, file);
+    }
+    Image image, cooked;
+    if (!Decode(filename, data, image) || !CookTexture(image, settings, cooked) || !SerializeCookedTexture(cooked, file))
+        return false;
+    if (cache.IsOpen())
+    {
+        cache.Put(key, file);
+    }
+    return WriteFileAtomically(cookedPath, file);
+}
+
+bool ModelLoader::Cook(const std::string &filename, const std::string &cookedPath)
+{
+    AssetHandle<Model> model = Load(filename);
+    return model && WriteCookedMeshes(cookedPath, model->GetMeshes());
+}
+
+uint64_t ModelLoader::GetAssetBytes(const Model &model) const
+{
+    uint64_t bytes = sizeof(Model);
+    for (const Mesh &mesh : model.GetMeshes())
+    {
+        bytes += sizeof(Mesh);
+        bytes += mesh.mVertices.capacity() * sizeof(MathLib::HVector3);
+        bytes += mesh.mNormals.capacity() * sizeof(MathLib::HVector3);
+        bytes += mesh.mTangents.capacity() * sizeof(MathLib::HVector4);
+        bytes += mesh.mIndices.capacity() * sizeof(uint32_t);
+        for (const std::vector<MathLib::HVector2> &texCoords : mesh.mTexCoordsArray)
+        {
+            bytes += texCoords.capacity() * sizeof(MathLib::HVector2);
+        }
+    }
+    return bytes;
+}
+
+bool MaterialLoader::Decode(const std::string &filename, std::span<const uint8_t> data, IMaterial &asset)
+{
+    // Materials have no file format yet
+    return true;
+}
\ No newline at end of file
@@ -0,0 +1,36 @@
+#include "Common/pch.h"
+#include "Engine/AssetRegistry.h"
+
+static std::mutex pathMutex;
+static std::unordered_map<AssetPathID, std::string> internedPaths;
+
+static AssetPathID HashPath(std::string_view path)
+{
+    // FNV-1a
+    uint64_t hash = 0xCBF29CE484222325ull;
+    for (char c : path)
+    {
+        hash ^= static_cast<uint8_t>(c);
+        hash *= 0x100000001B3ull;
+    }
+    // 0 means no path
+    return hash == 0 ? 1 : hash;
+}
+
+AssetPathID InternAssetPath(std::string_view path)
+{
+    AssetPathID id = HashPath(path);
+    std::lock_guard<std::mutex> guard(pathMutex);
+    auto [it, inserted] = internedPaths.try_emplace(id, path);
+    HASSERT_LOG(inserted || it->second == path, "Asset path hash collision");
+    return id;
+}
+
+const std::string &GetAssetPath(AssetPathID id)
+{
+    static const std::string empty;
+    std::lock_guard<std::mutex> guard(pathMutex);
+    auto it = internedPaths.find(id);
+    // Entries are never removed and map nodes don't move, the reference stays valid
+    return it != internedPaths.end() ? it->second : empty;
+}
@@ -0,0 +1,626 @@
+#include "Common/pch.h"
+#include "Engine/AsyncFileService.h"
+#include <cstdio>
+#include <filesystem>
+#include <random>
+
+#ifdef __linux__
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <cerrno>
+#include <cstring>
+
+// The few io_uring calls the service needs, made through the raw system calls since liburing
+// isn't one of our dependencies. One thread fills the submission queue, another one reaps the
+// completion queue, so both sides only need ordered loads and stores on the ring indices.
+class IoUring
+{
+public:
+    IoUring() = default;
+    IoUring(const IoUring &) = delete;
+    IoUring &operator=(const IoUring &) = delete;
+
+    ~IoUring()
+    {
+        if (m_Sqes != nullptr)
+        {
+            munmap(m_Sqes, m_SqesSize);
+        }
+        if (m_CqRing != nullptr && m_CqRing != m_SqRing)
+        {
+            munmap(m_CqRing, m_CqRingSize);
+        }
+        if (m_SqRing != nullptr)
+        {
+            munmap(m_SqRing, m_SqRingSize);
+        }
+        if (m_File >= 0)
+        {
+            close(m_File);
+        }
+    }
+
+    bool Init(uint32_t entries)
+    {
+        io_uring_params params = {};
+        m_File = static_cast<int>(syscall(__NR_io_uring_setup, entries, &params));
+        if (m_File < 0)
+            return false;
+        m_SqRingSize = params.sq_off.array + params.sq_entries * sizeof(uint32_t);
+        m_CqRingSize = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+        const bool isSingleMap = (params.features & IORING_FEAT_SINGLE_MMAP) != 0;
+        if (isSingleMap)
+        {
+            m_SqRingSize = m_CqRingSize = std::max(m_SqRingSize, m_CqRingSize);
+        }
+        m_SqRing = Map(m_SqRingSize, IORING_OFF_SQ_RING);
+        m_CqRing = isSingleMap ? m_SqRing : Map(m_CqRingSize, IORING_OFF_CQ_RING);
+        m_SqesSize = params.sq_entries * sizeof(io_uring_sqe);
+        m_Sqes = static_cast<io_uring_sqe *>(Map(m_SqesSize, IORING_OFF_SQES));
+        if (m_SqRing == nullptr || m_CqRing == nullptr || m_Sqes == nullptr)
+            return false;
+
+        char *sq = static_cast<char *>(m_SqRing);
+        m_SqHead = reinterpret_cast<uint32_t *>(sq + params.sq_off.head);
+        m_SqTail = reinterpret_cast<uint32_t *>(sq + params.sq_off.tail);
+        m_SqMask = *reinterpret_cast<uint32_t *>(sq + params.sq_off.ring_mask);
+        m_SqArray = reinterpret_cast<uint32_t *>(sq + params.sq_off.array);
+        m_SqEntries = params.sq_entries;
+        m_SqLocalTail = *m_SqTail;
+
+        char *cq = static_cast<char *>(m_CqRing);
+        m_CqHead = reinterpret_cast<uint32_t *>(cq + params.cq_off.head);
+        m_CqTail = reinterpret_cast<uint32_t *>(cq + params.cq_off.tail);
+        m_CqMask = *reinterpret_cast<uint32_t *>(cq + params.cq_off.ring_mask);
+        m_Cqes = reinterpret_cast<io_uring_cqe *>(cq + params.cq_off.cqes);
+        return true;
+    }
+
+    // Queues an operation until the next Submit, false when the submission queue is full
+    bool Prepare(uint8_t opcode, int file, void *buffer, uint32_t length, uint64_t offset, uint64_t userData)
+    {
+        uint32_t head = std::atomic_ref<uint32_t>(*m_SqHead).load(std::memory_order_acquire);
+        if (m_SqLocalTail - head >= m_SqEntries)
+            return false;
+        uint32_t index = m_SqLocalTail & m_SqMask;
+        io_uring_sqe &sqe = m_Sqes[index];
+        std::memset(&sqe, 0, sizeof(sqe));
+        sqe.opcode = opcode;
+        sqe.fd = file;
+        sqe.addr = reinterpret_cast<uint64_t>(buffer);
+        sqe.len = length;
+        sqe.off = offset;
+        sqe.user_data = userData;
+        m_SqArray[index] = index;
+        m_SqLocalTail++;
+        return true;
+    }
+
+    bool Submit()
+    {
+        uint32_t count = m_SqLocalTail - std::atomic_ref<uint32_t>(*m_SqTail).load(std::memory_order_relaxed);
+        m_NumSubmits.fetch_add(1, std::memory_order_release);
+        std::atomic_ref<uint32_t>(*m_SqTail).store(m_SqLocalTail, std::memory_order_release);
+        while (count > 0)
+        {
+            long submitted = syscall(__NR_io_uring_enter, m_File, count, 0, 0, nullptr, 0);
+            if (submitted < 0)
+            {
+                if (errno == EINTR || errno == EAGAIN || errno == EBUSY)
+                    continue;
+                return false;
+            }
+            count -= static_cast<uint32_t>(submitted);
+        }
+        return true;
+    }
+
+    // Blocks until at least one completion is there
+    void Wait()
+    {
+        while (syscall(__NR_io_uring_enter, m_File, 0, 1, IORING_ENTER_GETEVENTS, nullptr, 0) < 0 && errno == EINTR)
+        {
+        }
+    }
+
+    template <typename Callback>
+    void Reap(Callback &&onCompletion)
+    {
+        uint32_t head = std::atomic_ref<uint32_t>(*m_CqHead).load(std::memory_order_relaxed);
+        uint32_t tail = std::atomic_ref<uint32_t>(*m_CqTail).load(std::memory_order_acquire);
+        // The kernel only completes what was submitted before, pairing with Submit makes the
+        // data handed over through it visible to the C++ memory model and race detectors too
+        m_NumSubmits.load(std::memory_order_acquire);
+        for (; head != tail; head++)
+        {
+            const io_uring_cqe &cqe = m_Cqes[head & m_CqMask];
+            onCompletion(cqe.user_data, cqe.res);
+        }
+        std::atomic_ref<uint32_t>(*m_CqHead).store(head, std::memory_order_release);
+    }
+
+private:
+    void *Map(size_t size, off_t offset)
+    {
+        void *address = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, m_File, offset);
+        return address == MAP_FAILED ? nullptr : address;
+    }
+
+private:
+    int m_File = -1;
+    void *m_SqRing = nullptr;
+    void *m_CqRing = nullptr;
+    io_uring_sqe *m_Sqes = nullptr;
+    size_t m_SqRingSize = 0;
+    size_t m_CqRingSize = 0;
+    size_t m_SqesSize = 0;
+    uint32_t *m_SqHead = nullptr;
+    uint32_t *m_SqTail = nullptr;
+    uint32_t *m_SqArray = nullptr;
+    uint32_t m_SqMask = 0;
+    uint32_t m_SqEntries = 0;
+    uint32_t m_SqLocalTail = 0;
+    uint32_t *m_CqHead = nullptr;
+    uint32_t *m_CqTail = nullptr;
+    uint32_t m_CqMask = 0;
+    io_uring_cqe *m_Cqes = nullptr;
+    std::atomic<uint32_t> m_NumSubmits = 0;
+};
+#else
+class IoUring
+{
+};
+#endif
+
+// A single kernel read is capped, the rest of a larger one is read when it completes
+static constexpr uint64_t MAX_RING_READ_BYTES = 1ull << 30;
+
+AsyncFileService::AsyncFileService(JobSystem *jobSystem, const AsyncFileServicePolicy &policy)
+    : m_JobSystem(jobSystem), m_Policy(policy)
+{
+    HASSERT(m_JobSystem != nullptr);
+    m_Policy.mMaxBatchReads = std::max(m_Policy.mMaxBatchReads, 1u);
+    m_Policy.mQueueDepth = std::max(m_Policy.mQueueDepth, 1u);
+#ifdef __linux__
+    if (m_Policy.mUseIoUring)
+    {
+        m_Ring = std::make_unique<IoUring>();
+        if (m_Ring->Init(m_Policy.mQueueDepth))
+        {
+            m_RingThread = std::thread(&AsyncFileService::RunRingCompletions, this);
+        }
+        else
+        {
+            HLOG_WARNING("io_uring is not available, reading files on blocking threads\n");
+            m_Ring.reset();
+        }
+    }
+#endif
+    if (!m_Ring)
+    {
+        for (uint32_t i = 0; i < std::max(m_Policy.mThreadCount, 1u); i++)
+        {
+            m_ReadThreads.emplace_back(&AsyncFileService::RunReadThread, this);
+        }
+    }
+    m_DispatchThread = std::thread(&AsyncFileService::Dispatch, this);
+}
+
+AsyncFileService::~AsyncFileService()
+{
+    WaitIdle();
+    {
+        std::lock_guard<std::mutex> guard(m_Mutex);
+        m_IsStopping = true;
+    }
+    m_QueueCV.notify_all();
+    m_BatchCV.notify_all();
+    m_DispatchThread.join();
+    for (std::thread &thread : m_ReadThreads)
+    {
+        thread.join();
+    }
+#ifdef __linux__
+    if (m_Ring)
+    {
+        // Only the dispatch thread submits, now that it is gone a no-op with id 0 stops the reaper
+        m_Ring->Prepare(IORING_OP_NOP, -1, nullptr, 0, 0, 0);
+        m_Ring->Submit();
+        m_RingThread.join();
+    }
+#endif
+}
+
+void AsyncFileService::Read(const FileReadRequest &request, FileReadCallback onComplete)
+{
+    Read(std::span<const FileReadRequest>(&request, 1), onComplete);
+}
+
+void AsyncFileService::Read(std::span<const FileReadRequest> requests, const FileReadCallback &onComplete)
+{
+    std::vector<UniquePtr<PendingRead>> reads;
+    reads.reserve(requests.size());
+    for (const FileReadRequest &request : requests)
+    {
+        UniquePtr<PendingRead> read = std::make_unique<PendingRead>();
+        read->mRequest = request;
+        read->mOnComplete = onComplete;
+        read->mResult.mPath = request.mPath;
+        if (request.mCounter)
+        {
+            request.mCounter->Increment();
+        }
+        reads.push_back(std::move(read));
+    }
+    m_Outstanding.Increment(static_cast<int32_t>(reads.size()));
+    {
+        std::lock_guard<std::mutex> guard(m_Mutex);
+        HASSERT(!m_IsStopping);
+        for (UniquePtr<PendingRead> &read : reads)
+        {
+            m_Queue.push_back(std::move(read));
+        }
+    }
+    m_QueueCV.notify_one();
+}
+
+void AsyncFileService::ReadFile(const std::string &path, FileReadCallback onComplete, JobCounter *counter, uint32_t pipeLineID)
+{
+    FileReadRequest request;
+    request.mPath = path;
+    request.mCounter = counter;
+    request.mPipeLineID = pipeLineID;
+    Read(request, std::move(onComplete));
+}
+
+bool AsyncFileService::ReadFileAndWait(const std::string &path, std::vector<uint8_t> &data)
+{
+    JobCounter counter;
+    bool succeeded = false;
+    ReadFile(path, [&data, &succeeded](FileReadResult &result)
+             {
+        succeeded = result.mSucceeded;
+        data = std::move(result.mData); }, &counter);
+    m_JobSystem->WaitForCounter(counter);
+    return succeeded;
+}
+
+void AsyncFileService::WaitIdle()
+{
+    m_JobSystem->WaitForCounter(m_Outstanding);
+}
+
+bool AsyncFileService::IsUsingIoUring() const
+{
+    return m_Ring != nullptr;
+}
+
+uint64_t AsyncFileService::GetInFlightBytes() const
+{
+    std::lock_guard<std::mutex> guard(m_Mutex);
+    return m_InFlightBytes;
+}
+
+uint64_t AsyncFileService::GetPeakInFlightBytes() const
+{
+    std::lock_guard<std::mutex> guard(m_Mutex);
+    return m_PeakInFlightBytes;
+}
+
+uint64_t AsyncFileService::GetNumReads() const
+{
+    std::lock_guard<std::mutex> guard(m_Mutex);
+    return m_NumReads;
+}
+
+uint64_t AsyncFileService::GetNumBatches() const
+{
+    std::lock_guard<std::mutex> guard(m_Mutex);
+    return m_NumBatches;
+}
+
+void AsyncFileService::Dispatch()
+{
+    Batch batch;
+    std::unique_lock<std::mutex> lock(m_Mutex);
+    auto flush = [this, &batch, &lock]()
+    {
+        if (batch.empty())
+            return;
+        m_NumBatches++;
+        lock.unlock();
+        SubmitBatch(batch);
+        batch.clear();
+        lock.lock();
+    };
+    while (true)
+    {
+        if (m_Queue.empty())
+        {
+            flush();
+            m_QueueCV.wait(lock, [this]()
+                           { return m_IsStopping || !m_Queue.empty(); });
+            if (m_Queue.empty())
+                return;
+        }
+        UniquePtr<PendingRead> read = std::move(m_Queue.front());
+        m_Queue.pop_front();
+        lock.unlock();
+        if (!Prepare(*read))
+        {
+            Complete(std::move(read));
+            lock.lock();
+            continue;
+        }
+        lock.lock();
+
+        const bool isSmall = read->mLength <= m_Policy.mSmallReadBytes;
+        if (!isSmall)
+        {
+            flush();
+        }
+        if (!HasRoom(*read))
+        {
+            // Reads held back in the batch count as in flight, they must go out before waiting
+            flush();
+            m_RoomCV.wait(lock, [this, &read]()
+                          { return HasRoom(*read); });
+        }
+        read->mIsInFlight = true;
+        m_InFlightBytes += read->mLength;
+        m_PeakInFlightBytes = std::max(m_PeakInFlightBytes, m_InFlightBytes);
+        m_NumInFlight++;
+        m_NumReads++;
+        batch.push_back(std::move(read));
+        if (!isSmall || batch.size() >= m_Policy.mMaxBatchReads)
+        {
+            flush();
+        }
+    }
+}
+
+bool AsyncFileService::Prepare(PendingRead &read)
+{
+    std::error_code error;
+    uint64_t fileSize = std::filesystem::file_size(read.mRequest.mPath, error);
+    if (error)
+    {
+        HLOG_ERROR("Failed to open file: %s\n", read.mRequest.mPath.c_str());
+        return false;
+    }
+    uint64_t offset = std::min(read.mRequest.mOffset, fileSize);
+    read.mLength = std::min(read.mRequest.mSize, fileSize - offset);
+    if (read.mLength == 0)
+    {
+        read.mResult.mSucceeded = true;
+        return false;
+    }
+    return true;
+}
+
+bool AsyncFileService::HasRoom(const PendingRead &read) const
+{
+    if (m_NumInFlight >= m_Policy.mQueueDepth)
+        return false;
+    return m_InFlightBytes == 0 || m_InFlightBytes + read.mLength <= m_Policy.mMaxInFlightBytes;
+}
+
+void AsyncFileService::SubmitBatch(Batch &batch)
+{
+#ifdef __linux__
+    if (m_Ring)
+    {
+        SubmitToRing(batch);
+        return;
+    }
+#endif
+    {
+        std::lock_guard<std::mutex> guard(m_Mutex);
+        m_Batches.push_back(std::move(batch));
+    }
+    m_BatchCV.notify_one();
+}
+
+void AsyncFileService::RunReadThread()
+{
+    while (true)
+    {
+        Batch batch;
+        {
+            std::unique_lock<std::mutex> lock(m_Mutex);
+            m_BatchCV.wait(lock, [this]()
+                           { return m_IsStopping || !m_Batches.empty(); });
+            if (m_Batches.empty())
+                return;
+            batch = std::move(m_Batches.front());
+            m_Batches.pop_front();
+        }
+        for (UniquePtr<PendingRead> &read : batch)
+        {
+            ReadBlocking(*read);
+            Complete(std::move(read));
+        }
+    }
+}
+
+void AsyncFileService::ReadBlocking(PendingRead &read)
+{
+    std::ifstream file(read.mRequest.mPath, std::ios::binary);
+    if (!file.is_open())
+    {
+        HLOG_ERROR("Failed to open file: %s\n", read.mRequest.mPath.c_str());
+        return;
+    }
+    std::vector<uint8_t> &data = read.mResult.mData;
+    data.resize(read.mLength);
+    file.seekg(static_cast<std::streamoff>(read.mRequest.mOffset));
+    file.read(reinterpret_cast<char *>(data.data()), static_cast<std::streamsize>(data.size()));
+    read.mResult.mSucceeded = static_cast<uint64_t>(file.gcount()) == read.mLength;
+    if (!read.mResult.mSucceeded)
+    {
+        HLOG_ERROR("Failed to read file: %s\n", read.mRequest.mPath.c_str());
+        data.clear();
+    }
+}
+
+void AsyncFileService::Complete(UniquePtr<PendingRead> read)
+{
+    if (read->mIsInFlight)
+    {
+        {
+            std::lock_guard<std::mutex> guard(m_Mutex);
+            m_NumInFlight--;
+        }
+        m_RoomCV.notify_one();
+    }
+    const uint32_t pipeLineID = read->mRequest.mPipeLineID;
+    const uint8_t priority = read->mRequest.mPriority;
+    UniquePtr<Job> job = std::make_unique<Job>([this, read = std::move(read)]()
+                                               {
+        if (read->mIsInFlight)
+        {
+            // The budget covers data waiting for its callback, not what callbacks keep of it,
+            // so a callback can issue and wait for more reads without stalling the queue
+            {
+                std::lock_guard<std::mutex> guard(m_Mutex);
+                m_InFlightBytes -= read->mLength;
+            }
+            m_RoomCV.notify_one();
+        }
+        if (read->mOnComplete)
+        {
+            read->mOnComplete(read->mResult);
+        }
+        if (read->mRequest.mCounter)
+        {
+            read->mRequest.mCounter->Decrement();
+        }
+        m_Outstanding.Decrement(); }, UINT_MAX, priority);
+    if (!m_JobSystem->SubmitJob(job, pipeLineID))
+    {
+        job->Execute();
+    }
+}
+
+#ifdef __linux__
+void AsyncFileService::SubmitToRing(Batch &batch)
+{
+    bool hasReads = false;
+    for (UniquePtr<PendingRead> &read : batch)
+    {
+        read->mFile = open(read->mRequest.mPath.c_str(), O_RDONLY | O_CLOEXEC);
+        if (read->mFile < 0)
+        {
+            HLOG_ERROR("Failed to open file: %s\n", read->mRequest.mPath.c_str());
+            Complete(std::move(read));
+            continue;
+        }
+        read->mResult.mData.resize(read->mLength);
+        uint32_t length = static_cast<uint32_t>(std::min(read->mLength, MAX_RING_READ_BYTES));
+        // Never fails, no more reads than the queue depth are in flight
+        bool isQueued = m_Ring->Prepare(IORING_OP_READ, read->mFile, read->mResult.mData.data(), length,
+                                        read->mRequest.mOffset, reinterpret_cast<uint64_t>(read.get()));
+        HASSERT(isQueued);
+        read.release();
+        hasReads = true;
+    }
+    if (hasReads && !m_Ring->Submit())
+    {
+        HLOG_ERROR("io_uring submission failed: %s\n", strerror(errno));
+        HASSERT(false);
+    }
+}
+
+void AsyncFileService::RunRingCompletions()
+{
+    bool isStopping = false;
+    while (!isStopping)
+    {
+        m_Ring->Wait();
+        m_Ring->Reap([this, &isStopping](uint64_t userData, int32_t result)
+                     {
+            if (userData == 0)
+            {
+                isStopping = true;
+                return;
+            }
+            UniquePtr<PendingRead> read(reinterpret_cast<PendingRead *>(userData));
+            uint8_t *data = read->mResult.mData.data();
+            uint64_t done = result > 0 ? static_cast<uint64_t>(result) : 0;
+            // Short reads, reads over the cap and kernels without IORING_OP_READ finish here
+            while (done < read->mLength)
+            {
+                ssize_t count = pread(read->mFile, data + done, read->mLength - done, read->mRequest.mOffset + done);
+                if (count < 0 && errno == EINTR)
+                    continue;
+                if (count <= 0)
+                    break;
+                done += static_cast<uint64_t>(count);
+            }
+            close(read->mFile);
+            read->mFile = -1;
+            read->mResult.mSucceeded = done == read->mLength;
+            if (!read->mResult.mSucceeded)
+            {
+                HLOG_ERROR("Failed to read file: %s\n", read->mRequest.mPath.c_str());
+                read->mResult.mData.clear();
+            }
+            Complete(std::move(read)); });
+    }
+}
+#endif
+
+bool ReadFileBytes(const std::string &path, std::vector<uint8_t> &data)
+{
+    JobSystem *jobSystem = JobSystem::GetInstance();
+    if (jobSystem != nullptr)
+        return jobSystem->GetFileService().ReadFileAndWait(path, data);
+
+    std::ifstream file(path, std::ios::binary | std::ios::ate);
+    if (!file.is_open())
+    {
+        HLOG_ERROR("Failed to open file: %s\n", path.c_str());
+        return false;
+    }
+    data.resize(static_cast<size_t>(file.tellg()));
+    file.seekg(0);
+    file.read(reinterpret_cast<char *>(data.data()), static_cast<std::streamsize>(data.size()));
+    return static_cast<size_t>(file.gcount()) == data.size();
+}
+
+// Every writer gets a temporary file of its own, so concurrent writes of one path don't
+// clobber each other and the last rename wins. The nonce tells processes apart.
+static std::string MakeTemporaryPath(const std::string &path)
+{
+    static const uint32_t processNonce = std::random_device()();
+    static std::atomic<uint32_t> writeCount = 0;
+    char suffix[32];
+    std::snprintf(suffix, sizeof(suffix), ".%08x%08x.tmp", processNonce, writeCount.fetch_add(1, std::memory_order_relaxed));
+    return path + suffix;
+}
+
+bool WriteFileAtomically(const std::string &path, std::span<const uint8_t> data)
+{
+    std::string tempPath = MakeTemporaryPath(path);
+    {
+        std::ofstream stream(tempPath, std::ios::binary | std::ios::trunc);
+        stream.write(reinterpret_cast<const char *>(data.data()), static_cast<std::streamsize>(data.size()));
+        if (!stream)
+        {
+            HLOG_ERROR("Writing %s failed\n", tempPath.c_str());
+            return false;
+        }
+    }
+    std::error_code error;
+    std::filesystem::rename(tempPath, path, error);
+    if (error)
+    {
+        HLOG_ERROR("Writing %s failed: %s\n", path.c_str(), error.message().c_str());
+        std::filesystem::remove(tempPath, error);
+        return false;
+    }
+    return true;
+}
@@ -0,0 +1,222 @@
+#include "Common/pch.h"
+#include "Engine/CookedMesh.h"
+#include "Engine/AsyncFileService.h"
+#include <algorithm>
+#include <cstring>
+
+// Streams are written and read as raw float arrays
+static_assert(sizeof(MathLib::HVector2) == 2 * sizeof(float));
+static_assert(sizeof(MathLib::HVector3) == 3 * sizeof(float));
+static_assert(sizeof(MathLib::HVector4) == 4 * sizeof(float));
+static_assert(sizeof(CookedMeshFileHeader) % COOKED_MESH_ALIGNMENT == 0);
+static_assert(sizeof(CookedMeshRecord) % 8 == 0);
+
+static uint64_t AlignUp(uint64_t value)
+{
+    return (value + COOKED_MESH_ALIGNMENT - 1) & ~(COOKED_MESH_ALIGNMENT - 1);
+}
+
+static uint64_t TexCoordSetBytes(uint32_t numVertices)
+{
+    return AlignUp(static_cast<uint64_t>(numVertices) * sizeof(MathLib::HVector2));
+}
+
+template <typename Element>
+static std::span<const Element> StreamAt(std::span<const uint8_t> data, uint64_t offset, uint64_t count)
+{
+    return {reinterpret_cast<const Element *>(data.data() + offset), static_cast<size_t>(count)};
+}
+
+template <typename Element>
+static void WriteStream(std::vector<uint8_t> &file, uint64_t offset, const std::vector<Element> &stream)
+{
+    if (!stream.empty())
+    {
+        std::memcpy(file.data() + offset, stream.data(), stream.size() * sizeof(Element));
+    }
+}
+
+void CookedMeshView::CopyTo(Mesh &mesh) const
+{
+    mesh.mVertices.assign(mVertices.begin(), mVertices.end());
+    mesh.mNormals.assign(mNormals.begin(), mNormals.end());
+    mesh.mTangents.assign(mTangents.begin(), mTangents.end());
+    mesh.mTexCoordsArray.resize(mTexCoordsArray.size());
+    for (size_t i = 0; i < mTexCoordsArray.size(); i++)
+    {
+        mesh.mTexCoordsArray[i].assign(mTexCoordsArray[i].begin(), mTexCoordsArray[i].end());
+    }
+    mesh.mIndices.assign(mIndices.begin(), mIndices.end());
+    mesh.mColor = mColor;
+}
+
+bool SerializeCookedMeshes(std::span<const Mesh> meshes, std::vector<uint8_t> &file)
+{
+    std::vector<CookedMeshRecord> records(meshes.size());
+    uint64_t offset = AlignUp(sizeof(CookedMeshFileHeader) + records.size() * sizeof(CookedMeshRecord));
+    auto reserve = [&offset](uint64_t bytes)
+    {
+        uint64_t start = offset;
+        offset = AlignUp(offset + bytes);
+        return start;
+    };
+    for (size_t i = 0; i < meshes.size(); i++)
+    {
+        const Mesh &mesh = meshes[i];
+        CookedMeshRecord &record = records[i];
+        const uint32_t numVertices = static_cast<uint32_t>(mesh.mVertices.size());
+        if ((!mesh.mNormals.empty() && mesh.mNormals.size() != numVertices) ||
+            (!mesh.mTangents.empty() && mesh.mTangents.size() != numVertices))
+        {
+            HLOG_ERROR("Cooking failed, mesh %zu has streams of different lengths\n", i);
+            return false;
+        }
+        record.mNumVertices = numVertices;
+        record.mNumIndices = static_cast<uint32_t>(mesh.mIndices.size());
+        record.mNumTexCoordSets = static_cast<uint32_t>(mesh.mTexCoordsArray.size());
+        record.mFlags = (mesh.mNormals.empty() ? 0u : COOKED_MESH_HAS_NORMALS) | (mesh.mTangents.empty() ? 0u : COOKED_MESH_HAS_TANGENTS);
+        record.mColor[0] = mesh.mColor.r;
+        record.mColor[1] = mesh.mColor.g;
+        record.mColor[2] = mesh.mColor.b;
+        record.mColor[3] = mesh.mColor.a;
+        record.mVerticesOffset = reserve(numVertices * sizeof(MathLib::HVector3));
+        record.mNormalsOffset = reserve(mesh.mNormals.size() * sizeof(MathLib::HVector3));
+        record.mTangentsOffset = reserve(mesh.mTangents.size() * sizeof(MathLib::HVector4));
+        record.mTexCoordsOffset = offset;
+        for (const std::vector<MathLib::HVector2> &texCoords : mesh.mTexCoordsArray)
+        {
+            if (texCoords.size() != numVertices)
+            {
+                HLOG_ERROR("Cooking failed, mesh %zu has streams of different lengths\n", i);
+                return false;
+            }
+            reserve(TexCoordSetBytes(numVertices));
+        }
+        record.mIndicesOffset = reserve(mesh.mIndices.size() * sizeof(uint32_t));
+    }
+
+    CookedMeshFileHeader header;
+    header.mNumMeshes = static_cast<uint32_t>(records.size());
+    header.mFileSize = offset;
+    file.assign(offset, 0);
+    std::memcpy(file.data(), &header, sizeof(header));
+    if (!records.empty())
+    {
+        std::memcpy(file.data() + sizeof(header), records.data(), records.size() * sizeof(CookedMeshRecord));
+    }
+    for (size_t i = 0; i < meshes.size(); i++)
+    {
+        const Mesh &mesh = meshes[i];
+        const CookedMeshRecord &record = records[i];
+        WriteStream(file, record.mVerticesOffset, mesh.mVertices);
+        WriteStream(file, record.mNormalsOffset, mesh.mNormals);
+        WriteStream(file, record.mTangentsOffset, mesh.mTangents);
+        for (size_t j = 0; j < mesh.mTexCoordsArray.size(); j++)
+        {
+            WriteStream(file, record.mTexCoordsOffset + j * TexCoordSetBytes(record.mNumVertices), mesh.mTexCoordsArray[j]);
+        }
+        WriteStream(file, record.mIndicesOffset, mesh.mIndices);
+    }
+
+    return true;
+}
+
+bool WriteCookedMeshes(const std::string &path, std::span<const Mesh> meshes)
+{
+    std::vector<uint8_t> file;
+    return SerializeCookedMeshes(meshes, file) && WriteFileAtomically(path, file);
+}
+
+bool IsCookedMeshData(std::span<const uint8_t> data)
+{
+    uint32_t magic = 0;
+    if (data.size() < sizeof(magic))
+        return false;
+    std::memcpy(&magic, data.data(), sizeof(magic));
+    return magic == COOKED_MESH_MAGIC;
+}
+
+bool CookedModel::Open(const std::string &path)
+{
+    if (!m_File.Open(path))
+    {
+        HLOG_ERROR("Opening %s failed\n", path.c_str());
+        return false;
+    }
+    if (!Parse(m_File.GetData()))
+    {
+        HLOG_ERROR("%s is not a valid cooked mesh file\n", path.c_str());
+        m_File.Close();
+        return false;
+    }
+    return true;
+}
+
+bool CookedModel::Parse(std::span<const uint8_t> data)
+{
+    m_Data = {};
+    m_Records = {};
+    if (data.size() < sizeof(CookedMeshFileHeader) || reinterpret_cast<uintptr_t>(data.data()) % COOKED_MESH_ALIGNMENT != 0)
+        return false;
+    const CookedMeshFileHeader &header = *reinterpret_cast<const CookedMeshFileHeader *>(data.data());
+    if (header.mMagic != COOKED_MESH_MAGIC || header.mFileSize != data.size())
+        return false;
+    if (header.mVersion != COOKED_MESH_VERSION)
+    {
+        HLOG_WARNING("Cooked mesh version %u is not supported, expected %u\n", header.mVersion, COOKED_MESH_VERSION);
+        return false;
+    }
+    if (header.mNumMeshes > (data.size() - sizeof(header)) / sizeof(CookedMeshRecord))
+        return false;
+    std::span<const CookedMeshRecord> records = StreamAt<CookedMeshRecord>(data, sizeof(header), header.mNumMeshes);
+
+    // Every stream has to lie inside the file, so views never read past the mapping
+    auto isInside = [&data](uint64_t offset, uint64_t bytes)
+    {
+        return offset % COOKED_MESH_ALIGNMENT == 0 && offset <= data.size() && bytes <= data.size() - offset;
+    };
+    for (const CookedMeshRecord &record : records)
+    {
+        const uint64_t numVertices = record.mNumVertices;
+        const bool isValid = isInside(record.mVerticesOffset, numVertices * sizeof(MathLib::HVector3)) &&
+                             (!(record.mFlags & COOKED_MESH_HAS_NORMALS) || isInside(record.mNormalsOffset, numVertices * sizeof(MathLib::HVector3))) &&
+                             (!(record.mFlags & COOKED_MESH_HAS_TANGENTS) || isInside(record.mTangentsOffset, numVertices * sizeof(MathLib::HVector4))) &&
+                             isInside(record.mTexCoordsOffset, record.mNumTexCoordSets * TexCoordSetBytes(record.mNumVertices)) &&
+                             isInside(record.mIndicesOffset, record.mNumIndices * sizeof(uint32_t));
+        if (!isValid)
+            return false;
+        // Indices are used to look up the vertex streams, so they have to stay inside them too
+        std::span<const uint32_t> indices = StreamAt<uint32_t>(data, record.mIndicesOffset, record.mNumIndices);
+        if (std::any_of(indices.begin(), indices.end(), [&record](uint32_t index) { return index >= record.mNumVertices; }))
+            return false;
+    }
+    m_Data = data;
+    m_Records = records;
+    return true;
+}
+
+CookedMeshView CookedModel::GetMesh(uint32_t index) const
+{
+    HASSERT(index < m_Records.size());
+    const CookedMeshRecord &record = m_Records[index];
+    CookedMeshView view;
+    view.mVertices = StreamAt<MathLib::HVector3>(m_Data, record.mVerticesOffset, record.mNumVertices);
+    if (record.mFlags & COOKED_MESH_HAS_NORMALS)
+    {
+        view.mNormals = StreamAt<MathLib::HVector3>(m_Data, record.mNormalsOffset, record.mNumVertices);
+    }
+    if (record.mFlags & COOKED_MESH_HAS_TANGENTS)
+    {
+        view.mTangents = StreamAt<MathLib::HVector4>(m_Data, record.mTangentsOffset, record.mNumVertices);
+    }
+    for (uint32_t i = 0; i < record.mNumTexCoordSets; i++)
+    {
+        view.mTexCoordsArray.push_back(StreamAt<MathLib::HVector2>(m_Data, record.mTexCoordsOffset + i * TexCoordSetBytes(record.mNumVertices), record.mNumVertices));
+    }
+    view.mIndices = StreamAt<uint32_t>(m_Data, record.mIndicesOffset, record.mNumIndices);
+    view.mColor.r = record.mColor[0];
+    view.mColor.g = record.mColor[1];
+    view.mColor.b = record.mColor[2];
+    view.mColor.a = record.mColor[3];
+    return view;
+}
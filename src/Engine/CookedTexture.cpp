@@ -0,0 +1,87 @@
+#include "Common/pch.h"
+#include "Engine/CookedTexture.h"
+#include "Engine/AsyncFileService.h"
+#include <cstring>
+
+bool CookTexture(const Image &source, const TextureCookSettings &settings, Image &cooked)
+{
+    Image image;
+    image.mWidth = source.mWidth;
+    image.mHeight = source.mHeight;
+    image.mFormat = source.mFormat;
+    image.mIsSRGB = settings.mIsSRGB;
+    std::span<const uint8_t> topLevel = GetMipData(source, 0);
+    image.mData.assign(topLevel.begin(), topLevel.end());
+    if (!GenerateMips(image, settings.mMips, image))
+        return false;
+    if (settings.mIsCompressed && !CompressImage(image, settings.mCompression, image))
+        return false;
+    cooked = std::move(image);
+    return true;
+}
+
+bool SerializeCookedTexture(const Image &image, std::vector<uint8_t> &file)
+{
+    const uint64_t dataSize = GetImageDataSize(image.mFormat, image.mWidth, image.mHeight, image.mMipLevels);
+    if (image.mFormat == PixelFormat::UNKNOWN || image.mData.size() < dataSize)
+    {
+        HLOG_ERROR("Cooking failed, the image has no valid texels\n");
+        return false;
+    }
+    CookedTextureFileHeader header;
+    header.mWidth = image.mWidth;
+    header.mHeight = image.mHeight;
+    header.mMipLevels = image.mMipLevels;
+    header.mFormat = static_cast<uint32_t>(image.mFormat);
+    header.mFlags = image.mIsSRGB ? COOKED_TEXTURE_SRGB : 0u;
+    header.mFileSize = sizeof(header) + dataSize;
+    file.resize(header.mFileSize);
+    std::memcpy(file.data(), &header, sizeof(header));
+    std::memcpy(file.data() + sizeof(header), image.mData.data(), dataSize);
+    return true;
+}
+
+bool WriteCookedTexture(const std::string &path, const Image &image)
+{
+    std::vector<uint8_t> file;
+    return SerializeCookedTexture(image, file) && WriteFileAtomically(path, file);
+}
+
+bool IsCookedTextureData(std::span<const uint8_t> data)
+{
+    uint32_t magic = 0;
+    if (data.size() < sizeof(magic))
+        return false;
+    std::memcpy(&magic, data.data(), sizeof(magic));
+    return magic == COOKED_TEXTURE_MAGIC;
+}
+
+bool ReadCookedTexture(std::span<const uint8_t> data, Image &image)
+{
+    CookedTextureFileHeader header;
+    if (data.size() < sizeof(header))
+        return false;
+    std::memcpy(&header, data.data(), sizeof(header));
+    if (header.mMagic != COOKED_TEXTURE_MAGIC || header.mFileSize != data.size())
+        return false;
+    if (header.mVersion != COOKED_TEXTURE_VERSION)
+    {
+        HLOG_WARNING("Cooked texture version %u is not supported, expected %u\n", header.mVersion, COOKED_TEXTURE_VERSION);
+        return false;
+    }
+    // Range checked before narrowing to PixelFormat, which would wrap large values into range
+    if (header.mFormat == 0 || header.mFormat >= static_cast<uint32_t>(PixelFormat::COUNT) || header.mMipLevels == 0 ||
+        header.mMipLevels > GetMaxMipLevels(header.mWidth, header.mHeight))
+        return false;
+    const PixelFormat format = static_cast<PixelFormat>(header.mFormat);
+    const uint64_t dataSize = GetImageDataSize(format, header.mWidth, header.mHeight, header.mMipLevels);
+    if (dataSize != data.size() - sizeof(header))
+        return false;
+    image.mWidth = header.mWidth;
+    image.mHeight = header.mHeight;
+    image.mFormat = format;
+    image.mMipLevels = header.mMipLevels;
+    image.mIsSRGB = (header.mFlags & COOKED_TEXTURE_SRGB) != 0;
+    image.mData.assign(data.begin() + sizeof(header), data.end());
+    return true;
+}
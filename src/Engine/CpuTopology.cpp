@@ -0,0 +1,392 @@
+#include "Common/pch.h"
+#include "Engine/CpuTopology.h"
+#include <cctype>
+#include <filesystem>
+#include <tuple>
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#elif defined(__linux__)
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+// Cache domain key for CPUs whose last level cache is unknown, they get one per package
+static constexpr uint32_t UNKNOWN_CACHE_DOMAIN = UINT_MAX;
+
+static bool ReadFirstLine(const std::filesystem::path &path, std::string &line)
+{
+    std::ifstream file(path);
+    if (!file.is_open())
+        return false;
+    std::getline(file, line);
+    return true;
+}
+
+static bool ReadUInt(const std::filesystem::path &path, uint32_t &value)
+{
+    std::string line;
+    if (!ReadFirstLine(path, line))
+        return false;
+    try
+    {
+        long long parsed = std::stoll(line);
+        // physical_package_id is -1 on some ARM boards
+        value = parsed < 0 ? 0 : static_cast<uint32_t>(parsed);
+    }
+    catch (const std::exception &)
+    {
+        return false;
+    }
+    return true;
+}
+
+// Parses the kernel's cpu list format, e.g. "0-3,8,10-11"
+static std::vector<uint32_t> ParseCpuList(const std::string &list)
+{
+    std::vector<uint32_t> cpus;
+    std::stringstream stream(list);
+    std::string range;
+    while (std::getline(stream, range, ','))
+    {
+        if (range.empty() || !std::isdigit(static_cast<unsigned char>(range[0])))
+            continue;
+        size_t dash = range.find('-');
+        uint32_t first = static_cast<uint32_t>(std::stoul(range.substr(0, dash)));
+        uint32_t last = dash == std::string::npos ? first : static_cast<uint32_t>(std::stoul(range.substr(dash + 1)));
+        for (uint32_t cpu = first; cpu <= last; cpu++)
+        {
+            cpus.push_back(cpu);
+        }
+    }
+    return cpus;
+}
+
+#ifdef _WIN32
+// Only the first 64 CPUs, the ones in the process' processor group, are reported
+static bool ReadWindowsTopology(std::vector<LogicalCpu> &cpus)
+{
+    DWORD length = 0;
+    GetLogicalProcessorInformation(nullptr, &length);
+    if (GetLastError() != ERROR_INSUFFICIENT_BUFFER)
+        return false;
+    std::vector<SYSTEM_LOGICAL_PROCESSOR_INFORMATION> infos(length / sizeof(SYSTEM_LOGICAL_PROCESSOR_INFORMATION));
+    if (!GetLogicalProcessorInformation(infos.data(), &length))
+        return false;
+
+    std::map<uint32_t, LogicalCpu> cpuByID;
+    uint32_t coreCount = 0;
+    uint32_t packageCount = 0;
+    uint32_t cacheDomainCount = 0;
+    for (const SYSTEM_LOGICAL_PROCESSOR_INFORMATION &info : infos)
+    {
+        if (info.Relationship == RelationCache && info.Cache.Level != 3)
+            continue;
+        for (uint32_t bit = 0; bit < sizeof(ULONG_PTR) * 8; bit++)
+        {
+            if ((info.ProcessorMask & (ULONG_PTR(1) << bit)) == 0)
+                continue;
+            auto [it, inserted] = cpuByID.try_emplace(bit);
+            LogicalCpu &cpu = it->second;
+            if (inserted)
+            {
+                cpu.mID = bit;
+                cpu.mCacheDomainID = UNKNOWN_CACHE_DOMAIN;
+            }
+            switch (info.Relationship)
+            {
+            case RelationProcessorCore:
+                cpu.mCoreID = coreCount;
+                break;
+            case RelationProcessorPackage:
+                cpu.mPackageID = packageCount;
+                break;
+            case RelationCache:
+                cpu.mCacheDomainID = cacheDomainCount;
+                break;
+            case RelationNumaNode:
+                cpu.mNumaNode = info.NumaNode.NodeNumber;
+                break;
+            default:
+                break;
+            }
+        }
+        if (info.Relationship == RelationProcessorCore)
+            coreCount++;
+        else if (info.Relationship == RelationProcessorPackage)
+            packageCount++;
+        else if (info.Relationship == RelationCache)
+            cacheDomainCount++;
+    }
+    for (auto &[id, cpu] : cpuByID)
+    {
+        cpus.push_back(cpu);
+    }
+    return coreCount > 0;
+}
+#endif
+
+CpuTopology CpuTopology::Detect()
+{
+    CpuTopology topology;
+#ifdef _WIN32
+    if (ReadWindowsTopology(topology.m_Cpus))
+    {
+        topology.Finalize();
+        return topology;
+    }
+#else
+    if (ParseSysfs("/sys/devices/system", topology))
+    {
+        return topology;
+    }
+#endif
+    HLOG_INFO("CPU topology not available, assuming %d independent cores\n", std::thread::hardware_concurrency());
+    return MakeFlat(std::max(std::thread::hardware_concurrency(), 1u));
+}
+
+bool CpuTopology::ParseSysfs(const std::string &root, CpuTopology &topology)
+{
+    namespace fs = std::filesystem;
+    const fs::path cpuRoot = fs::path(root) / "cpu";
+    std::vector<uint32_t> cpuIDs;
+    std::string online;
+    if (ReadFirstLine(cpuRoot / "online", online))
+    {
+        cpuIDs = ParseCpuList(online);
+    }
+    else
+    {
+        std::error_code error;
+        for (const fs::directory_entry &entry : fs::directory_iterator(cpuRoot, error))
+        {
+            std::string name = entry.path().filename().string();
+            if (name.size() > 3 && name.compare(0, 3, "cpu") == 0 && std::isdigit(static_cast<unsigned char>(name[3])))
+            {
+                cpuIDs.push_back(static_cast<uint32_t>(std::stoul(name.substr(3))));
+            }
+        }
+        std::sort(cpuIDs.begin(), cpuIDs.end());
+    }
+    if (cpuIDs.empty())
+        return false;
+
+    // NUMA nodes list their CPUs, invert that into a per CPU lookup
+    std::unordered_map<uint32_t, uint32_t> nodeOfCpu;
+    std::error_code error;
+    for (const fs::directory_entry &entry : fs::directory_iterator(fs::path(root) / "node", error))
+    {
+        std::string name = entry.path().filename().string();
+        std::string cpuList;
+        if (name.size() > 4 && name.compare(0, 4, "node") == 0 && std::isdigit(static_cast<unsigned char>(name[4])) &&
+            ReadFirstLine(entry.path() / "cpulist", cpuList))
+        {
+            uint32_t node = static_cast<uint32_t>(std::stoul(name.substr(4)));
+            for (uint32_t cpu : ParseCpuList(cpuList))
+            {
+                nodeOfCpu[cpu] = node;
+            }
+        }
+    }
+
+    std::vector<LogicalCpu> cpus;
+    for (uint32_t id : cpuIDs)
+    {
+        const fs::path cpuPath = cpuRoot / ("cpu" + std::to_string(id));
+        LogicalCpu cpu;
+        cpu.mID = id;
+        if (!ReadUInt(cpuPath / "topology" / "core_id", cpu.mCoreID))
+            return false;
+        ReadUInt(cpuPath / "topology" / "physical_package_id", cpu.mPackageID);
+        // Core ids repeat across packages
+        cpu.mCoreID = (cpu.mPackageID << 16) | cpu.mCoreID;
+
+        // The highest level data or unified cache is the last level cache, its lowest
+        // sharing CPU identifies the domain
+        uint32_t lastLevel = 0;
+        cpu.mCacheDomainID = UNKNOWN_CACHE_DOMAIN;
+        for (const fs::directory_entry &entry : fs::directory_iterator(cpuPath / "cache", error))
+        {
+            uint32_t level = 0;
+            std::string type;
+            std::string sharedList;
+            if (!ReadUInt(entry.path() / "level", level) || level <= lastLevel)
+                continue;
+            if (ReadFirstLine(entry.path() / "type", type) && type == "Instruction")
+                continue;
+            if (!ReadFirstLine(entry.path() / "shared_cpu_list", sharedList))
+                continue;
+            std::vector<uint32_t> sharing = ParseCpuList(sharedList);
+            if (sharing.empty())
+                continue;
+            lastLevel = level;
+            cpu.mCacheDomainID = *std::min_element(sharing.begin(), sharing.end());
+        }
+        auto node = nodeOfCpu.find(id);
+        cpu.mNumaNode = node != nodeOfCpu.end() ? node->second : 0;
+        cpus.push_back(cpu);
+    }
+    topology.m_Cpus = std::move(cpus);
+    topology.Finalize();
+    return true;
+}
+
+CpuTopology CpuTopology::MakeFlat(uint32_t count)
+{
+    CpuTopology topology;
+    for (uint32_t i = 0; i < count; i++)
+    {
+        LogicalCpu cpu;
+        cpu.mID = i;
+        cpu.mCoreID = i;
+        topology.m_Cpus.push_back(cpu);
+    }
+    topology.Finalize();
+    return topology;
+}
+
+bool CpuTopology::SetCurrentThreadAffinity(uint32_t cpuID)
+{
+#ifdef _WIN32
+    DWORD_PTR mask = 0;
+    if (cpuID == UINT_MAX)
+    {
+        DWORD_PTR systemMask = 0;
+        if (!GetProcessAffinityMask(GetCurrentProcess(), &mask, &systemMask))
+            return false;
+    }
+    else if (cpuID < sizeof(DWORD_PTR) * 8)
+    {
+        mask = DWORD_PTR(1) << cpuID;
+    }
+    else
+    {
+        return false;
+    }
+    return SetThreadAffinityMask(GetCurrentThread(), mask) != 0;
+#elif defined(__linux__)
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    if (cpuID == UINT_MAX)
+    {
+        // The kernel drops the CPUs this process isn't allowed on
+        for (uint32_t i = 0; i < CPU_SETSIZE; i++)
+        {
+            CPU_SET(i, &set);
+        }
+    }
+    else if (cpuID < CPU_SETSIZE)
+    {
+        CPU_SET(cpuID, &set);
+    }
+    else
+    {
+        return false;
+    }
+    return pthread_setaffinity_np(pthread_self(), sizeof(set), &set) == 0;
+#else
+    return false;
+#endif
+}
+
+std::vector<LogicalCpu> CpuTopology::SelectCpus(PipeLinePlacement placement, uint32_t count, std::span<const uint32_t> cpuLoad) const
+{
+    std::vector<LogicalCpu> selected;
+    if (placement == PipeLinePlacement::ANY || m_Cpus.empty() || count == 0)
+        return selected;
+    auto loadOf = [&](const LogicalCpu &cpu)
+    { return cpu.mID < cpuLoad.size() ? cpuLoad[cpu.mID] : 0u; };
+
+    std::vector<LogicalCpu> candidates;
+    switch (placement)
+    {
+    case PipeLinePlacement::SPREAD:
+    {
+        // Rank of each core inside its cache domain, so consecutive picks alternate domains
+        std::vector<uint32_t> coreRank(m_NumPhysicalCores, 0);
+        std::vector<uint32_t> coresInDomain(m_NumCacheDomains, 0);
+        for (const LogicalCpu &cpu : m_Cpus)
+        {
+            if (cpu.mSmtIndex == 0)
+                coreRank[cpu.mCoreID] = coresInDomain[cpu.mCacheDomainID]++;
+        }
+        candidates = m_Cpus;
+        std::sort(candidates.begin(), candidates.end(), [&](const LogicalCpu &a, const LogicalCpu &b)
+                  { return std::make_tuple(loadOf(a), a.mSmtIndex, coreRank[a.mCoreID], a.mCacheDomainID, a.mID) <
+                           std::make_tuple(loadOf(b), b.mSmtIndex, coreRank[b.mCoreID], b.mCacheDomainID, b.mID); });
+        break;
+    }
+    case PipeLinePlacement::SHARED_CACHE:
+    {
+        std::vector<uint32_t> domainLoad(m_NumCacheDomains, 0);
+        for (const LogicalCpu &cpu : m_Cpus)
+        {
+            domainLoad[cpu.mCacheDomainID] += loadOf(cpu);
+        }
+        uint32_t domain = static_cast<uint32_t>(std::min_element(domainLoad.begin(), domainLoad.end()) - domainLoad.begin());
+        for (const LogicalCpu &cpu : m_Cpus)
+        {
+            if (cpu.mCacheDomainID == domain)
+                candidates.push_back(cpu);
+        }
+        std::sort(candidates.begin(), candidates.end(), [&](const LogicalCpu &a, const LogicalCpu &b)
+                  { return std::make_tuple(loadOf(a), a.mSmtIndex, a.mID) < std::make_tuple(loadOf(b), b.mSmtIndex, b.mID); });
+        break;
+    }
+    case PipeLinePlacement::SMT_SIBLINGS:
+    {
+        for (const LogicalCpu &cpu : m_Cpus)
+        {
+            if (cpu.mSmtIndex > 0)
+                candidates.push_back(cpu);
+        }
+        if (candidates.empty())
+        {
+            // No SMT, use the last cores, the other placements fill up from the front
+            candidates = m_Cpus;
+            std::reverse(candidates.begin(), candidates.end());
+        }
+        std::stable_sort(candidates.begin(), candidates.end(), [&](const LogicalCpu &a, const LogicalCpu &b)
+                         { return loadOf(a) < loadOf(b); });
+        break;
+    }
+    default:
+        break;
+    }
+    if (candidates.empty())
+        return selected;
+    for (uint32_t i = 0; i < count; i++)
+    {
+        selected.push_back(candidates[i % candidates.size()]);
+    }
+    return selected;
+}
+
+void CpuTopology::Finalize()
+{
+    std::sort(m_Cpus.begin(), m_Cpus.end(), [](const LogicalCpu &a, const LogicalCpu &b)
+              { return a.mID < b.mID; });
+    std::map<uint32_t, uint32_t> coreIndex;
+    std::map<uint64_t, uint32_t> domainIndex;
+    std::set<uint32_t> nodes;
+    std::vector<uint32_t> threadsPerCore;
+    for (LogicalCpu &cpu : m_Cpus)
+    {
+        auto core = coreIndex.try_emplace(cpu.mCoreID, static_cast<uint32_t>(coreIndex.size())).first;
+        cpu.mCoreID = core->second;
+        if (threadsPerCore.size() <= cpu.mCoreID)
+            threadsPerCore.resize(cpu.mCoreID + 1, 0);
+        cpu.mSmtIndex = threadsPerCore[cpu.mCoreID]++;
+
+        uint64_t domainKey = cpu.mCacheDomainID == UNKNOWN_CACHE_DOMAIN ? (uint64_t(1) << 32) | cpu.mPackageID : cpu.mCacheDomainID;
+        auto domain = domainIndex.try_emplace(domainKey, static_cast<uint32_t>(domainIndex.size())).first;
+        cpu.mCacheDomainID = domain->second;
+        nodes.insert(cpu.mNumaNode);
+    }
+    m_NumPhysicalCores = static_cast<uint32_t>(coreIndex.size());
+    m_NumCacheDomains = static_cast<uint32_t>(domainIndex.size());
+    m_NumNumaNodes = static_cast<uint32_t>(nodes.size());
+}
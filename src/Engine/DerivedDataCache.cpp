@@ -0,0 +1,395 @@
+#include "Common/pch.h"
+#include "Engine/DerivedDataCache.h"
+#include "Engine/AsyncFileService.h"
+#include <algorithm>
+#include <cctype>
+#include <cstring>
+#include <filesystem>
+
+static constexpr uint32_t DERIVED_DATA_MAGIC = 0x43444448; // "HDDC"
+static constexpr uint32_t DERIVED_DATA_VERSION = 1;
+static constexpr uint64_t MURMUR_C1 = 0x87C37B91114253D5ull;
+static constexpr uint64_t MURMUR_C2 = 0x4CF5AD432745937Full;
+
+struct DerivedDataFileHeader
+{
+    uint32_t mMagic = DERIVED_DATA_MAGIC;
+    uint32_t mVersion = DERIVED_DATA_VERSION;
+    uint64_t mDataSize = 0;
+    // Checksum of the data, catches files damaged outside of our control
+    uint64_t mDataHash = 0;
+    uint64_t mReserved = 0;
+};
+
+static uint64_t RotateLeft(uint64_t value, int shift)
+{
+    return (value << shift) | (value >> (64 - shift));
+}
+
+static uint64_t FinalMix(uint64_t value)
+{
+    value ^= value >> 33;
+    value *= 0xFF51AFD7ED558CCDull;
+    value ^= value >> 33;
+    value *= 0xC4CEB9FE1A85EC53ull;
+    value ^= value >> 33;
+    return value;
+}
+
+static uint64_t HashData(std::span<const uint8_t> data)
+{
+    return DerivedDataKeyBuilder("Data").Add(data).Finish().mLow;
+}
+
+static bool ParseKey(const std::string &text, DerivedDataKey &key)
+{
+    if (text.size() != 32 || !std::all_of(text.begin(), text.end(), [](char c)
+                                          { return std::isxdigit(static_cast<unsigned char>(c)) != 0; }))
+        return false;
+    key.mHigh = std::stoull(text.substr(0, 16), nullptr, 16);
+    key.mLow = std::stoull(text.substr(16), nullptr, 16);
+    return true;
+}
+
+std::string DerivedDataKey::ToString() const
+{
+    char text[33];
+    snprintf(text, sizeof(text), "%016llx%016llx", static_cast<unsigned long long>(mHigh), static_cast<unsigned long long>(mLow));
+    return text;
+}
+
+DerivedDataKeyBuilder::DerivedDataKeyBuilder(std::string_view kind)
+{
+    Add(kind);
+}
+
+void DerivedDataKeyBuilder::MixBlock(const uint8_t *block)
+{
+    uint64_t k1, k2;
+    std::memcpy(&k1, block, sizeof(k1));
+    std::memcpy(&k2, block + 8, sizeof(k2));
+    k1 *= MURMUR_C1;
+    k1 = RotateLeft(k1, 31);
+    k1 *= MURMUR_C2;
+    m_H1 ^= k1;
+    m_H1 = RotateLeft(m_H1, 27);
+    m_H1 += m_H2;
+    m_H1 = m_H1 * 5 + 0x52DCE729;
+    k2 *= MURMUR_C2;
+    k2 = RotateLeft(k2, 33);
+    k2 *= MURMUR_C1;
+    m_H2 ^= k2;
+    m_H2 = RotateLeft(m_H2, 31);
+    m_H2 += m_H1;
+    m_H2 = m_H2 * 5 + 0x38495AB5;
+}
+
+DerivedDataKeyBuilder &DerivedDataKeyBuilder::Add(std::span<const uint8_t> bytes)
+{
+    m_Length += bytes.size();
+    size_t offset = 0;
+    // Top up a partial block from the previous call first
+    if (m_TailSize > 0)
+    {
+        const size_t count = std::min<size_t>(sizeof(m_Tail) - m_TailSize, bytes.size());
+        std::memcpy(m_Tail + m_TailSize, bytes.data(), count);
+        m_TailSize += static_cast<uint32_t>(count);
+        offset = count;
+        if (m_TailSize < sizeof(m_Tail))
+            return *this;
+        MixBlock(m_Tail);
+        m_TailSize = 0;
+    }
+    for (; offset + 16 <= bytes.size(); offset += 16)
+    {
+        MixBlock(bytes.data() + offset);
+    }
+    m_TailSize = static_cast<uint32_t>(bytes.size() - offset);
+    std::memcpy(m_Tail, bytes.data() + offset, m_TailSize);
+    return *this;
+}
+
+DerivedDataKeyBuilder &DerivedDataKeyBuilder::Add(std::string_view text)
+{
+    Add(static_cast<uint64_t>(text.size()));
+    return Add(std::span<const uint8_t>(reinterpret_cast<const uint8_t *>(text.data()), text.size()));
+}
+
+DerivedDataKeyBuilder &DerivedDataKeyBuilder::Add(uint64_t value)
+{
+    uint8_t bytes[8];
+    for (uint32_t i = 0; i < 8; i++)
+    {
+        bytes[i] = static_cast<uint8_t>(value >> (8 * i));
+    }
+    return Add(std::span<const uint8_t>(bytes));
+}
+
+DerivedDataKey DerivedDataKeyBuilder::Finish() const
+{
+    uint64_t h1 = m_H1;
+    uint64_t h2 = m_H2;
+    // The tail is zero padded, mixing in zeros leaves the state as the reference leaves it
+    uint8_t tail[16] = {};
+    std::memcpy(tail, m_Tail, m_TailSize);
+    uint64_t k1, k2;
+    std::memcpy(&k1, tail, sizeof(k1));
+    std::memcpy(&k2, tail + 8, sizeof(k2));
+    k2 *= MURMUR_C2;
+    k2 = RotateLeft(k2, 33);
+    k2 *= MURMUR_C1;
+    h2 ^= k2;
+    k1 *= MURMUR_C1;
+    k1 = RotateLeft(k1, 31);
+    k1 *= MURMUR_C2;
+    h1 ^= k1;
+
+    h1 ^= m_Length;
+    h2 ^= m_Length;
+    h1 += h2;
+    h2 += h1;
+    h1 = FinalMix(h1);
+    h2 = FinalMix(h2);
+    h1 += h2;
+    h2 += h1;
+    return {h1, h2};
+}
+
+bool DerivedDataCache::Open(const std::string &directory, uint64_t budgetBytes)
+{
+    std::error_code error;
+    std::filesystem::create_directories(directory, error);
+    if (error)
+    {
+        HLOG_ERROR("Opening derived data cache %s failed: %s\n", directory.c_str(), error.message().c_str());
+        return false;
+    }
+    struct FoundEntry
+    {
+        std::filesystem::file_time_type mLastUse;
+        DerivedDataKey mKey;
+        uint64_t mBytes;
+    };
+    std::vector<FoundEntry> found;
+    for (auto it = std::filesystem::recursive_directory_iterator(directory, error); !error && it != std::filesystem::recursive_directory_iterator(); it.increment(error))
+    {
+        if (!it->is_regular_file())
+            continue;
+        const std::filesystem::path &path = it->path();
+        FoundEntry entry;
+        if (ParseKey(path.filename().string(), entry.mKey))
+        {
+            entry.mLastUse = it->last_write_time();
+            entry.mBytes = it->file_size();
+            found.push_back(entry);
+        }
+        else if (path.extension() == ".tmp")
+        {
+            // Left behind by WriteFileAtomically in a process that died while writing
+            std::error_code removeError;
+            std::filesystem::remove(path, removeError);
+        }
+    }
+    std::sort(found.begin(), found.end(), [](const FoundEntry &a, const FoundEntry &b)
+              { return a.mLastUse < b.mLastUse; });
+
+    std::vector<std::string> evicted;
+    {
+        std::lock_guard<std::mutex> guard(m_Mutex);
+        m_Directory = directory;
+        m_Recency.clear();
+        m_Entries.clear();
+        m_Stats = {};
+        m_Stats.mBudgetBytes = budgetBytes;
+        for (const FoundEntry &entry : found)
+        {
+            m_Recency.push_back(entry.mKey);
+            m_Entries[entry.mKey] = {entry.mBytes, std::prev(m_Recency.end())};
+            m_Stats.mResidentBytes += entry.mBytes;
+        }
+        m_Stats.mNumEntries = static_cast<uint32_t>(m_Entries.size());
+        HLOG_INFO("Derived data cache %s: %u entries, %llu bytes\n", directory.c_str(), m_Stats.mNumEntries, static_cast<unsigned long long>(m_Stats.mResidentBytes));
+        EvictOverBudget(evicted);
+    }
+    for (const std::string &path : evicted)
+    {
+        std::filesystem::remove(path, error);
+    }
+    return true;
+}
+
+void DerivedDataCache::Close()
+{
+    std::lock_guard<std::mutex> guard(m_Mutex);
+    m_Directory.clear();
+    m_Recency.clear();
+    m_Entries.clear();
+    m_Stats = {};
+}
+
+bool DerivedDataCache::IsOpen() const
+{
+    std::lock_guard<std::mutex> guard(m_Mutex);
+    return !m_Directory.empty();
+}
+
+bool DerivedDataCache::Get(const DerivedDataKey &key, std::vector<uint8_t> &data)
+{
+    std::string path;
+    {
+        std::lock_guard<std::mutex> guard(m_Mutex);
+        if (m_Directory.empty())
+            return false;
+        auto it = m_Entries.find(key);
+        if (it == m_Entries.end())
+        {
+            m_Stats.mNumMisses++;
+            return false;
+        }
+        m_Recency.splice(m_Recency.end(), m_Recency, it->second.mRecency);
+        path = GetEntryPath(key);
+    }
+
+    // Read on the calling thread, entries are small next to what producing them costs
+    DerivedDataFileHeader header;
+    std::ifstream file(path, std::ios::binary | std::ios::ate);
+    bool isValid = file.is_open() && static_cast<uint64_t>(file.tellg()) >= sizeof(header);
+    if (isValid)
+    {
+        const uint64_t fileSize = static_cast<uint64_t>(file.tellg());
+        file.seekg(0);
+        file.read(reinterpret_cast<char *>(&header), sizeof(header));
+        isValid = file && header.mMagic == DERIVED_DATA_MAGIC && header.mVersion == DERIVED_DATA_VERSION &&
+                  header.mDataSize == fileSize - sizeof(header);
+    }
+    if (isValid)
+    {
+        data.resize(static_cast<size_t>(header.mDataSize));
+        file.read(reinterpret_cast<char *>(data.data()), static_cast<std::streamsize>(data.size()));
+        isValid = static_cast<uint64_t>(file.gcount()) == header.mDataSize && HashData(data) == header.mDataHash;
+    }
+    file.close();
+    if (isValid)
+    {
+        // Last use is kept as the write time, so the order survives restarts
+        std::error_code error;
+        std::filesystem::last_write_time(path, std::filesystem::file_time_type::clock::now(), error);
+    }
+
+    std::lock_guard<std::mutex> guard(m_Mutex);
+    if (!isValid)
+    {
+        HLOG_WARNING("Derived data %s is missing or damaged, dropping it\n", path.c_str());
+        data.clear();
+        Remove(key);
+        m_Stats.mNumMisses++;
+        return false;
+    }
+    m_Stats.mNumHits++;
+    return true;
+}
+
+bool DerivedDataCache::Put(const DerivedDataKey &key, std::span<const uint8_t> data)
+{
+    std::string path;
+    {
+        std::lock_guard<std::mutex> guard(m_Mutex);
+        if (m_Directory.empty())
+            return false;
+        // Same key, same data
+        if (m_Entries.contains(key))
+            return true;
+        path = GetEntryPath(key);
+    }
+    DerivedDataFileHeader header;
+    header.mDataSize = data.size();
+    header.mDataHash = HashData(data);
+    std::vector<uint8_t> file(sizeof(header) + data.size());
+    std::memcpy(file.data(), &header, sizeof(header));
+    if (!data.empty())
+    {
+        std::memcpy(file.data() + sizeof(header), data.data(), data.size());
+    }
+    std::error_code error;
+    std::filesystem::create_directories(std::filesystem::path(path).parent_path(), error);
+    if (error || !WriteFileAtomically(path, file))
+        return false;
+
+    std::vector<std::string> evicted;
+    {
+        std::lock_guard<std::mutex> guard(m_Mutex);
+        // Closed or reopened elsewhere while writing
+        if (path != GetEntryPath(key) || m_Directory.empty())
+            return false;
+        if (!m_Entries.contains(key))
+        {
+            m_Recency.push_back(key);
+            m_Entries[key] = {file.size(), std::prev(m_Recency.end())};
+            m_Stats.mResidentBytes += file.size();
+            m_Stats.mNumEntries++;
+            m_Stats.mNumWrites++;
+        }
+        EvictOverBudget(evicted);
+    }
+    for (const std::string &evictedPath : evicted)
+    {
+        std::filesystem::remove(evictedPath, error);
+    }
+    return true;
+}
+
+void DerivedDataCache::SetBudget(uint64_t bytes)
+{
+    std::vector<std::string> evicted;
+    {
+        std::lock_guard<std::mutex> guard(m_Mutex);
+        m_Stats.mBudgetBytes = bytes;
+        EvictOverBudget(evicted);
+    }
+    std::error_code error;
+    for (const std::string &path : evicted)
+    {
+        std::filesystem::remove(path, error);
+    }
+}
+
+DerivedDataCacheStats DerivedDataCache::GetStats() const
+{
+    std::lock_guard<std::mutex> guard(m_Mutex);
+    return m_Stats;
+}
+
+std::string DerivedDataCache::GetEntryPath(const DerivedDataKey &key) const
+{
+    std::string name = key.ToString();
+    return (std::filesystem::path(m_Directory) / name.substr(0, 2) / name).string();
+}
+
+void DerivedDataCache::Remove(const DerivedDataKey &key)
+{
+    auto it = m_Entries.find(key);
+    if (it == m_Entries.end())
+        return;
+    std::error_code error;
+    std::filesystem::remove(GetEntryPath(key), error);
+    m_Stats.mResidentBytes -= it->second.mBytes;
+    m_Stats.mNumEntries--;
+    m_Recency.erase(it->second.mRecency);
+    m_Entries.erase(it);
+}
+
+void DerivedDataCache::EvictOverBudget(std::vector<std::string> &evicted)
+{
+    while (m_Stats.mResidentBytes > m_Stats.mBudgetBytes && !m_Recency.empty())
+    {
+        const DerivedDataKey key = m_Recency.front();
+        const Entry &entry = m_Entries.at(key);
+        evicted.push_back(GetEntryPath(key));
+        m_Stats.mResidentBytes -= entry.mBytes;
+        m_Stats.mEvictedBytes += entry.mBytes;
+        m_Stats.mNumEvictions++;
+        m_Stats.mNumEntries--;
+        m_Entries.erase(key);
+        m_Recency.pop_front();
+    }
+}
@@ -1,6 +1,8 @@
 #include "Engine/Engine.h"
 #include "Engine/RenderModule.h"
 #include "Engine/PhysicsModule.h"
+#include "Engine/FrameJobArena.h"
+#include "Engine/DerivedDataCache.h"
 
 static Engine *engineSingleton = nullptr;
 
@@ -16,6 +18,9 @@ Engine::~Engine()
 
 void Engine::Init()
 {
+    // Imported and cooked assets are kept across runs, warm starts skip the importers
+    DerivedDataCache::GetInstance().Open("DerivedDataCache");
+
     m_physicsModule = new PhysicsModule();
     m_physicsModule->Init();
 
@@ -35,6 +40,11 @@ void Engine::Update()
     float deltaTime = m_Timer.GetDeltaTime();
     m_physicsModule->Update(deltaTime);
     m_renderModule->Update(deltaTime);
+    // Frame-scoped jobs of the oldest frame in flight are done with, recycle their memory
+    if (JobSystem *jobSystem = JobSystem::GetInstance())
+    {
+        jobSystem->GetFrameArena().NextFrame();
+    }
 }
 
 void Engine::Stop()
@@ -0,0 +1,133 @@
+#include "Common/pch.h"
+#include "Engine/FrameJobArena.h"
+
+FrameJobArena::FrameJobArena(uint32_t framesInFlight, size_t chunkSize)
+    : m_NumFrames(std::clamp(framesInFlight, 1u, MAX_FRAMES_IN_FLIGHT)),
+      m_ChunkSize(std::max<size_t>(chunkSize, 1024))
+{
+}
+
+FrameJobArena::~FrameJobArena()
+{
+    for (uint32_t i = 0; i < m_NumFrames; i++)
+    {
+        if (m_Frames[i].m_LiveJobs.load(std::memory_order_acquire) != 0)
+        {
+            HLOG_ERROR("FrameJobArena destroyed while jobs made in it are still alive\n");
+            break;
+        }
+    }
+}
+
+void *FrameJobArena::Allocate(Frame &frame, size_t size, size_t alignment)
+{
+    HASSERT(alignment != 0 && (alignment & (alignment - 1)) == 0);
+    // Reserving the worst case padding up front keeps the bump a single fetch_add
+    const size_t reserved = size + alignment - 1;
+    for (;;)
+    {
+        Chunk *chunk = frame.m_Current.load(std::memory_order_acquire);
+        if (chunk)
+        {
+            size_t offset = chunk->m_Offset.fetch_add(reserved, std::memory_order_relaxed);
+            if (offset + reserved <= chunk->m_Size)
+            {
+                auto address = reinterpret_cast<uintptr_t>(chunk->m_Data.get()) + offset;
+                address = (address + alignment - 1) & ~(uintptr_t(alignment) - 1);
+                return reinterpret_cast<void *>(address);
+            }
+        }
+        std::lock_guard<std::mutex> guard(m_Mutex);
+        AdvanceChunk(frame, chunk, reserved);
+    }
+}
+
+void FrameJobArena::AdvanceChunk(Frame &frame, Chunk *full, size_t size)
+{
+    if (frame.m_Current.load(std::memory_order_relaxed) != full)
+        return;
+    size_t next = full ? frame.m_CurrentIndex + 1 : 0;
+    size_t index = next;
+    while (index < frame.m_Chunks.size() && frame.m_Chunks[index]->m_Size < size)
+    {
+        index++;
+    }
+    if (index < frame.m_Chunks.size())
+    {
+        std::swap(frame.m_Chunks[next], frame.m_Chunks[index]);
+    }
+    else
+    {
+        auto chunk = std::make_unique<Chunk>();
+        chunk->m_Size = std::max(m_ChunkSize, size);
+        chunk->m_Data = std::make_unique<unsigned char[]>(chunk->m_Size);
+        frame.m_Chunks.insert(frame.m_Chunks.begin() + next, std::move(chunk));
+        m_NumChunkAllocations.fetch_add(1, std::memory_order_relaxed);
+    }
+    frame.m_CurrentIndex = next;
+    frame.m_Current.store(frame.m_Chunks[next].get(), std::memory_order_release);
+}
+
+void FrameJobArena::ResetFrame(Frame &frame)
+{
+    std::lock_guard<std::mutex> guard(m_Mutex);
+    for (UniquePtr<Chunk> &chunk : frame.m_Chunks)
+    {
+        chunk->m_Offset.store(0, std::memory_order_relaxed);
+    }
+    frame.m_CurrentIndex = 0;
+    frame.m_Current.store(frame.m_Chunks.empty() ? nullptr : frame.m_Chunks[0].get(), std::memory_order_release);
+}
+
+void FrameJobArena::NextFrame()
+{
+    uint32_t next = (m_FrameIndex.load(std::memory_order_relaxed) + 1) % m_NumFrames;
+    Frame &frame = m_Frames[next];
+    if (frame.m_LiveJobs.load(std::memory_order_acquire) != 0)
+    {
+        if (JobSystem *jobSystem = JobSystem::GetInstance())
+        {
+            jobSystem->FlushJobs();
+        }
+    }
+    if (frame.m_LiveJobs.load(std::memory_order_acquire) == 0)
+    {
+        ResetFrame(frame);
+    }
+    else
+    {
+        // Never reuse memory under a live job, the frame keeps growing until they are gone
+        HLOG_ERROR("Jobs of frame %llu are still alive, its arena memory is not recycled\n", static_cast<unsigned long long>(m_FrameNumber + 1 - m_NumFrames));
+    }
+    m_FrameIndex.store(next, std::memory_order_release);
+    m_FrameNumber++;
+}
+
+size_t FrameJobArena::GetReservedBytes() const
+{
+    std::lock_guard<std::mutex> guard(m_Mutex);
+    size_t bytes = 0;
+    for (uint32_t i = 0; i < m_NumFrames; i++)
+    {
+        for (const UniquePtr<Chunk> &chunk : m_Frames[i].m_Chunks)
+        {
+            bytes += chunk->m_Size;
+        }
+    }
+    return bytes;
+}
+
+size_t FrameJobArena::GetUsedBytes() const
+{
+    std::lock_guard<std::mutex> guard(m_Mutex);
+    const Frame &frame = m_Frames[m_FrameIndex.load(std::memory_order_acquire)];
+    if (frame.m_Current.load(std::memory_order_relaxed) == nullptr)
+        return 0;
+    size_t bytes = 0;
+    for (size_t i = 0; i <= frame.m_CurrentIndex; i++)
+    {
+        const Chunk &chunk = *frame.m_Chunks[i];
+        bytes += std::min(chunk.m_Offset.load(std::memory_order_relaxed), chunk.m_Size);
+    }
+    return bytes;
+}
@@ -0,0 +1,152 @@
+#include "Common/pch.h"
+#include "Engine/JobAllocator.h"
+#include <atomic>
+
+namespace
+{
+    struct FreeBlock
+    {
+        FreeBlock *m_Next;
+        // Only valid on the first block of a batch sitting in the shared pool
+        FreeBlock *m_NextBatch;
+        uint32_t m_BatchCount;
+    };
+
+    class JobBlockPool
+    {
+    public:
+        FreeBlock *AcquireBatch()
+        {
+            {
+                std::lock_guard<std::mutex> guard(m_Mutex);
+                if (m_Batches)
+                {
+                    FreeBlock *batch = m_Batches;
+                    m_Batches = batch->m_NextBatch;
+                    return batch;
+                }
+            }
+            return AllocateSlab();
+        }
+
+        void ReleaseBatch(FreeBlock *batch, uint32_t count)
+        {
+            batch->m_BatchCount = count;
+            std::lock_guard<std::mutex> guard(m_Mutex);
+            batch->m_NextBatch = m_Batches;
+            m_Batches = batch;
+        }
+
+        uint64_t GetNumSlabAllocations() const
+        {
+            return m_NumSlabAllocations.load(std::memory_order_relaxed);
+        }
+
+    private:
+        FreeBlock *AllocateSlab()
+        {
+            // Slabs are never returned to the heap, the pool lives as long as the process
+            auto *slab = static_cast<unsigned char *>(::operator new(JobAllocator::BLOCK_SIZE * JobAllocator::BATCH_SIZE, std::align_val_t(JobAllocator::BLOCK_ALIGNMENT)));
+            m_NumSlabAllocations.fetch_add(1, std::memory_order_relaxed);
+            FreeBlock *head = nullptr;
+            for (uint32_t i = JobAllocator::BATCH_SIZE; i > 0; i--)
+            {
+                auto *block = reinterpret_cast<FreeBlock *>(slab + (i - 1) * JobAllocator::BLOCK_SIZE);
+                block->m_Next = head;
+                head = block;
+            }
+            head->m_BatchCount = JobAllocator::BATCH_SIZE;
+            return head;
+        }
+
+        std::mutex m_Mutex;
+        FreeBlock *m_Batches = nullptr;
+        std::atomic<uint64_t> m_NumSlabAllocations = 0;
+    };
+
+    JobBlockPool &GetBlockPool()
+    {
+        // Intentionally leaked so jobs freed during static destruction still have a pool
+        static JobBlockPool *pool = new JobBlockPool();
+        return *pool;
+    }
+
+    class JobBlockCache
+    {
+    public:
+        ~JobBlockCache()
+        {
+            if (m_Head)
+            {
+                GetBlockPool().ReleaseBatch(m_Head, m_Count);
+            }
+        }
+
+        void *Allocate()
+        {
+            if (m_Head == nullptr)
+            {
+                m_Head = GetBlockPool().AcquireBatch();
+                m_Count = m_Head->m_BatchCount;
+            }
+            FreeBlock *block = m_Head;
+            m_Head = block->m_Next;
+            m_Count--;
+            return block;
+        }
+
+        void Free(void *pointer)
+        {
+            auto *block = static_cast<FreeBlock *>(pointer);
+            block->m_Next = m_Head;
+            m_Head = block;
+            m_Count++;
+            if (m_Count >= 2 * JobAllocator::BATCH_SIZE)
+            {
+                // Hand a full batch back so the threads creating jobs can reuse it
+                FreeBlock *batch = m_Head;
+                FreeBlock *last = batch;
+                for (uint32_t i = 1; i < JobAllocator::BATCH_SIZE; i++)
+                {
+                    last = last->m_Next;
+                }
+                m_Head = last->m_Next;
+                last->m_Next = nullptr;
+                m_Count -= JobAllocator::BATCH_SIZE;
+                GetBlockPool().ReleaseBatch(batch, JobAllocator::BATCH_SIZE);
+            }
+        }
+
+    private:
+        FreeBlock *m_Head = nullptr;
+        uint32_t m_Count = 0;
+    };
+
+    thread_local JobBlockCache blockCache;
+}
+
+void *JobAllocator::Allocate(size_t size)
+{
+    if (size > BLOCK_SIZE)
+    {
+        return ::operator new(size);
+    }
+    return blockCache.Allocate();
+}
+
+void JobAllocator::Free(void *block, size_t size)
+{
+    if (block == nullptr)
+        return;
+    if (size > BLOCK_SIZE)
+    {
+        ::operator delete(block);
+        return;
+    }
+    blockCache.Free(block);
+}
+
+uint64_t JobAllocator::GetNumSlabAllocations()
+{
+    return GetBlockPool().GetNumSlabAllocations();
+}
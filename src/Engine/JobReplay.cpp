@@ -0,0 +1,171 @@
+#include "Common/pch.h"
+#include "Engine/JobReplay.h"
+#include "Engine/JobSystem.h"
+
+// The job running on this thread, ids of the jobs it submits derive from it
+static thread_local JobReplay::Context currentContext;
+
+static uint64_t MixID(uint64_t parent, uint64_t child)
+{
+    // splitmix64 finalizer
+    uint64_t x = parent * 0x9E3779B97F4A7C15ull + child + 1;
+    x = (x ^ (x >> 30)) * 0xBF58476D1CE4E5B9ull;
+    x = (x ^ (x >> 27)) * 0x94D049BB133111EBull;
+    x ^= x >> 31;
+    // 0 is reserved for submissions from outside any job
+    return x == 0 ? 1 : x;
+}
+
+void JobReplay::StartRecording()
+{
+    std::lock_guard<std::mutex> guard(m_Mutex);
+    m_IsRecording = true;
+    m_Trace = JobTrace();
+    m_RootChildren = 0;
+}
+
+JobTrace JobReplay::StopRecording()
+{
+    std::lock_guard<std::mutex> guard(m_Mutex);
+    m_IsRecording = false;
+    return std::move(m_Trace);
+}
+
+bool JobReplay::IsRecording() const
+{
+    std::lock_guard<std::mutex> guard(m_Mutex);
+    return m_IsRecording;
+}
+
+void JobReplay::SetSerial(bool serial, uint64_t seed)
+{
+    std::lock_guard<std::mutex> guard(m_Mutex);
+    HASSERT(m_ReadyJobs.empty());
+    m_IsSerial = serial;
+    m_RandomState = seed;
+    m_ReplayOrder.clear();
+    m_ReplayPosition = 0;
+    m_HasDiverged = false;
+    m_RootChildren = 0;
+}
+
+void JobReplay::SetReplayOrder(std::vector<uint64_t> order)
+{
+    std::lock_guard<std::mutex> guard(m_Mutex);
+    HASSERT(m_ReadyJobs.empty());
+    m_IsSerial = true;
+    m_RandomState = 0;
+    m_ReplayOrder = std::move(order);
+    m_ReplayPosition = 0;
+    m_HasDiverged = false;
+    m_RootChildren = 0;
+}
+
+bool JobReplay::IsSerial() const
+{
+    std::lock_guard<std::mutex> guard(m_Mutex);
+    return m_IsSerial;
+}
+
+bool JobReplay::IsActive() const
+{
+    std::lock_guard<std::mutex> guard(m_Mutex);
+    return m_IsRecording || m_IsSerial;
+}
+
+void JobReplay::OnSubmit(Job *const *jobs, uint32_t count)
+{
+    Context &context = currentContext;
+    std::lock_guard<std::mutex> guard(m_Mutex);
+    for (uint32_t i = 0; i < count; i++)
+    {
+        Job &job = *jobs[i];
+        uint64_t child = context.mID != 0 ? context.mChildren++ : m_RootChildren++;
+        job.m_TraceID = MixID(context.mID, child);
+        if (m_IsRecording)
+        {
+            m_Trace.mJobs.push_back({job.m_TraceID, context.mID, job.GetPriority()});
+        }
+    }
+}
+
+void JobReplay::Schedule(Job *const *jobs, uint32_t count)
+{
+    std::lock_guard<std::mutex> guard(m_Mutex);
+    m_ReadyJobs.insert(m_ReadyJobs.end(), jobs, jobs + count);
+}
+
+Job *JobReplay::PickNextJob()
+{
+    if (m_ReadyJobs.empty())
+        return nullptr;
+    size_t index = 0;
+    if (!m_HasDiverged && m_ReplayPosition < m_ReplayOrder.size())
+    {
+        uint64_t id = m_ReplayOrder[m_ReplayPosition];
+        auto it = std::find_if(m_ReadyJobs.begin(), m_ReadyJobs.end(), [id](Job *job)
+                               { return job->m_TraceID == id; });
+        if (it != m_ReadyJobs.end())
+        {
+            index = it - m_ReadyJobs.begin();
+            m_ReplayPosition++;
+        }
+        else
+        {
+            HLOG_WARNING("Job replay diverged from the trace after %zu jobs\n", m_ReplayPosition);
+            m_HasDiverged = true;
+        }
+    }
+    else if (m_RandomState != 0)
+    {
+        // xorshift64
+        m_RandomState ^= m_RandomState << 13;
+        m_RandomState ^= m_RandomState >> 7;
+        m_RandomState ^= m_RandomState << 17;
+        index = m_RandomState % m_ReadyJobs.size();
+    }
+    Job *job = m_ReadyJobs[index];
+    m_ReadyJobs.erase(m_ReadyJobs.begin() + index);
+    return job;
+}
+
+bool JobReplay::RunNext()
+{
+    Job *job = nullptr;
+    {
+        std::lock_guard<std::mutex> guard(m_Mutex);
+        job = PickNextJob();
+    }
+    if (job == nullptr)
+        return false;
+    JobPipeLine *pipeLine = job->m_PipeLine;
+    pipeLine->RunJob(job, pipeLine->m_ExternalCompleted);
+    return true;
+}
+
+JobReplay::Context JobReplay::EnterJob(Job &job)
+{
+    Context previous = currentContext;
+    currentContext = {job.m_TraceID, 0};
+    std::lock_guard<std::mutex> guard(m_Mutex);
+    if (m_IsRecording)
+    {
+        m_Trace.mExecutionOrder.push_back(job.m_TraceID);
+    }
+    return previous;
+}
+
+void JobReplay::LeaveJob(Job &job, const Context &previous)
+{
+    currentContext = previous;
+    std::lock_guard<std::mutex> guard(m_Mutex);
+    if (!m_IsRecording)
+        return;
+    for (Job *continuation : job.m_Continuations)
+    {
+        if (continuation->m_TraceID != 0)
+        {
+            m_Trace.mDependencies.push_back({job.m_TraceID, continuation->m_TraceID});
+        }
+    }
+}
@@ -1,120 +1,251 @@
 #include "Common/pch.h"
 #include "Engine/JobSystem.h"
+#include "Engine/WorkerBalancer.h"
+#include "Engine/FrameJobArena.h"
+#include "Engine/AsyncFileService.h"
+#if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+#include <intrin.h>
+#endif
 
 static JobSystem *jobSystemSingleton = nullptr;
-static std::condition_variable jobSystemCV;
-Worker::Worker(JobPipeLine *pipeLine) : m_IsRunning(true)
+static thread_local Worker *currentWorker = nullptr;
+
+// Pause instructions an idle worker issues between two looks at the queues
+static constexpr uint32_t WORKER_PAUSES_PER_CHECK = 32;
+// Capacity of each of a pipeline's per level injection queues, producers help run jobs
+// while one is full
+static constexpr size_t INJECTION_QUEUE_CAPACITY = 4096;
+// Jobs made ready by one PushJobs call are published in chunks of this size
+static constexpr uint32_t SUBMIT_BATCH_SIZE = 64;
+// How long SetPipeLine waits for a running worker to reach the end of its current job
+static constexpr std::chrono::milliseconds PIPELINE_SWITCH_TIMEOUT(10);
+
+static uint32_t NextRandom(uint32_t &state)
 {
-    SetPipeLine(pipeLine);
-    m_Thread = std::thread(&Worker::Run, this);
+    // xorshift32
+    state ^= state << 13;
+    state ^= state >> 17;
+    state ^= state << 5;
+    return state;
 }
 
-Worker::~Worker()
+static inline void CpuRelax()
+{
+#if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+    _mm_pause();
+#elif defined(__x86_64__) || defined(__i386__)
+    __builtin_ia32_pause();
+#elif defined(__aarch64__)
+    asm volatile("yield");
+#else
+    std::this_thread::yield();
+#endif
+}
+
+#if JOB_SYSTEM_STATS
+static inline int64_t StatClock()
 {
-    if (m_Mutex != nullptr && m_Condition != nullptr)
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// Slot counters have a single writer, so they don't need a locked read-modify-write
+static inline void AddStat(std::atomic<uint64_t> &stat, uint64_t value)
+{
+    stat.store(stat.load(std::memory_order_relaxed) + value, std::memory_order_relaxed);
+}
+
+static inline void MaxStat(std::atomic<uint64_t> &stat, uint64_t value)
+{
+    if (value > stat.load(std::memory_order_relaxed))
     {
-        std::unique_lock<std::mutex> lock(*m_Mutex);
-        m_Condition->wait(lock, [&]
-                          { return !m_IsRunning && m_PipeLine->IsIdle(); });
+        stat.store(value, std::memory_order_relaxed);
     }
-    if (m_Thread.joinable())
+}
+#endif
+
+Worker::Worker(JobPipeLine *pipeLine) : m_IsRunning(false), m_IsBusy(false)
+{
+    static std::atomic<uint32_t> seed = 0x9E3779B9u;
+    m_RandomState = seed.fetch_add(0x9E3779B9u, std::memory_order_relaxed) | 1u;
+    SetPipeLine(pipeLine);
+}
+
+Worker::~Worker()
+{
+    Stop();
+    if (m_PipeLine)
     {
-        m_Thread.join();
+        m_PipeLine->ReleaseSlot(m_SlotIndex, this);
     }
 }
 
 void Worker::Run()
 {
-    while (m_IsRunning)
+    currentWorker = this;
+    ApplyAffinity();
+    while (m_IsRunning.load(std::memory_order_acquire))
     {
-        if (m_Mutex == nullptr || m_Condition == nullptr)
+        if (m_PendingPipeLine.load(std::memory_order_acquire) != nullptr)
         {
-            HLOG_ERROR("Mutex or Condition is not set\n");
-            break;
+            SwitchPipeLine();
+            continue;
         }
+        Job *job = m_PipeLine->FindJob(this, m_RandomState);
+        if (job)
         {
-            std::unique_lock<std::mutex> lock(*m_Mutex);
-            m_Condition->wait(lock, [this]
-                              { return !m_IsRunning || (!m_PipeLine->IsIdle()); });
-            if (m_PipeLine)
-            {
-                m_PipeLine->PopJob(m_CurrentJob);
-            }
-            if (!m_IsRunning)
-                break;
-            m_CurrentJob->Execute();
-            m_CurrentJob = nullptr;
+            m_IsBusy.store(true, std::memory_order_relaxed);
+            m_PipeLine->RunJob(job, m_PipeLine->m_Slots[m_SlotIndex].m_Completed);
+            m_IsBusy.store(false, std::memory_order_relaxed);
+            continue;
         }
+        m_PipeLine->WaitForJobs(this);
     }
+    currentWorker = nullptr;
 }
 
 void Worker::Reset()
 {
-    if (m_Mutex != nullptr && m_Condition != nullptr)
-    {
-        std::unique_lock<std::mutex> lock(*m_Mutex);
-        m_Condition->wait(lock, [&]
-                          { return !m_IsRunning && m_PipeLine->IsIdle(); });
-    }
-    if (m_Thread.joinable())
-    {
-        m_Thread.join();
-    }
-    m_Thread = std::thread(&Worker::Run, this);
+    Stop();
+    WakeUp();
 }
 
 bool Worker::IsBusy() const
 {
-    if (m_Mutex == nullptr)
-        return false;
-    std::lock_guard<std::mutex> guard(*m_Mutex);
-    return m_CurrentJob != nullptr;
+    return m_IsBusy.load(std::memory_order_relaxed);
 }
 
 bool Worker::IsInPipeLine() const
 {
-    return m_Mutex != nullptr && m_Condition != nullptr;
+    return m_PipeLine != nullptr && m_SlotIndex != UINT_MAX;
 }
 
 bool Worker::SetPipeLine(JobPipeLine *pipeLine)
 {
-    if (IsBusy())
+    if (pipeLine == nullptr)
     {
-        HLOG_ERROR("Worker is busy\n");
+        HLOG_ERROR("PipeLine is nullptr\n");
         return false;
     }
-    if (pipeLine == nullptr)
+    if (!m_Thread.joinable())
     {
-        HLOG_ERROR("PipeLine is nullptr\n");
+        if (m_PipeLine)
+        {
+            m_PipeLine->ReleaseSlot(m_SlotIndex, this);
+            m_PipeLine = nullptr;
+        }
+        m_SlotIndex = pipeLine->ClaimSlot(this);
+        if (m_SlotIndex == UINT_MAX)
+        {
+            HLOG_ERROR("PipeLine has no free worker slot\n");
+            return false;
+        }
+        m_PipeLine = pipeLine;
+        return WakeUp();
+    }
+    if (pipeLine == m_PipeLine)
+        return true;
+    if (currentWorker == this)
+    {
+        HLOG_ERROR("A worker can't move itself to another pipeline\n");
         return false;
     }
-    m_PipeLine = pipeLine;
-    m_Mutex = &pipeLine->m_JobMutex;
-    m_Condition = &pipeLine->m_JobCV;
-    return true;
+    // The worker switches over by itself between two jobs, so its thread keeps running.
+    // Wait for it, a worker that is half way between pipelines must never be observable.
+    JobPipeLine *current = m_PipeLine;
+    uint32_t slotIndex = m_SlotIndex;
+    std::unique_lock<std::mutex> lock(m_SwitchMutex);
+    m_SwitchDone = false;
+    m_PendingPipeLine.store(pipeLine, std::memory_order_seq_cst);
+    current->WakeWorker(slotIndex);
+    if (!m_SwitchCondition.wait_for(lock, PIPELINE_SWITCH_TIMEOUT, [this]() { return m_SwitchDone; }))
+    {
+        // Take the request back, unless the worker has already started on it. Callers like
+        // the balancer hold locks while moving workers, they retry later instead.
+        JobPipeLine *expected = pipeLine;
+        if (m_PendingPipeLine.compare_exchange_strong(expected, nullptr, std::memory_order_acq_rel))
+        {
+            return false;
+        }
+        m_SwitchCondition.wait(lock, [this]() { return m_SwitchDone; });
+    }
+    return m_SwitchSucceeded;
+}
+
+std::thread::id Worker::GetThreadID() const
+{
+    return m_Thread.get_id();
 }
 
 void Worker::Stop()
 {
+    if (!m_Thread.joinable())
+        return;
+    m_IsRunning.store(false, std::memory_order_release);
+    m_PipeLine->WakeWorker(m_SlotIndex);
+    m_Thread.join();
+}
+
+void Worker::SwitchPipeLine()
+{
+    // SetPipeLine may have given up and taken the request back in the meantime
+    JobPipeLine *pipeLine = m_PendingPipeLine.exchange(nullptr, std::memory_order_acq_rel);
+    if (pipeLine == nullptr)
+        return;
+    // Jobs left in the old deque stay stealable by the old pipeline's workers
+    uint32_t slotIndex = pipeLine->ClaimSlot(this);
+    if (slotIndex != UINT_MAX)
+    {
+        m_PipeLine->ReleaseSlot(m_SlotIndex, this);
+        m_PipeLine = pipeLine;
+        m_SlotIndex = slotIndex;
+        ApplyAffinity();
+    }
     {
-        std::lock_guard<std::mutex> guard(*m_Mutex);
-        m_IsRunning = false;
+        std::lock_guard<std::mutex> guard(m_SwitchMutex);
+        m_SwitchSucceeded = slotIndex != UINT_MAX;
+        m_SwitchDone = true;
     }
-    m_Condition->notify_all();
+    m_SwitchCondition.notify_all();
 }
 
-bool Worker::WakeUp()
+void Worker::ApplyAffinity()
 {
+    // Threads survive pipeline moves, so an unpinned slot has to undo an earlier pin
+    uint32_t cpuID = m_PipeLine->m_Slots[m_SlotIndex].m_CpuID;
+    if (cpuID != m_PinnedCpu && CpuTopology::SetCurrentThreadAffinity(cpuID))
     {
-        std::lock_guard<std::mutex> guard(*m_Mutex);
-        m_IsRunning = true;
+        m_PinnedCpu = cpuID;
     }
-    m_Condition->notify_all();
+}
+
+bool Worker::WakeUp()
+{
+    if (m_Thread.joinable() || !IsInPipeLine())
+        return false;
+    m_IsRunning.store(true, std::memory_order_release);
+    m_Thread = std::thread(&Worker::Run, this);
     return true;
 }
 
-JobPipeLine::JobPipeLine(uint32_t workerCount)
+JobPipeLine::JobPipeLine(uint32_t workerCount, uint32_t maxWorkerCount, std::span<const LogicalCpu> cpus)
 {
+    for (UniquePtr<MPMCQueue<Job *>> &injectedJobs : m_InjectedJobs)
+    {
+        injectedJobs = std::make_unique<MPMCQueue<Job *>>(INJECTION_QUEUE_CAPACITY);
+    }
+    m_NumSlots = std::max({workerCount, maxWorkerCount, std::thread::hardware_concurrency(), 1u});
+    m_Slots = std::make_unique<WorkerSlot[]>(m_NumSlots);
+    for (uint32_t i = 0; i < m_NumSlots && !cpus.empty(); i++)
+    {
+        const LogicalCpu &cpu = cpus[i % cpus.size()];
+        m_Slots[i].m_CpuID = cpu.mID;
+        m_Slots[i].m_CacheDomain = cpu.mCacheDomainID;
+        m_HasCacheDomains |= cpu.mCacheDomainID != m_Slots[0].m_CacheDomain;
+    }
+    m_ParkedSlots.reserve(m_NumSlots);
+    SetIdlePolicy(WorkerIdlePolicy());
+    SetSchedulePolicy(JobSchedulePolicy());
+    SetWorkerQuota(1, m_NumSlots);
     m_Workers.reserve(workerCount);
     for (uint32_t i = 0; i < workerCount; i++)
     {
@@ -123,51 +254,188 @@ JobPipeLine::JobPipeLine(uint32_t workerCount)
     HLOG_INFO("JobPipeLine created with %d workers\n", workerCount);
 }
 
-void JobPipeLine::PushJob(UniquePtr<Job> &job)
+JobPipeLine::~JobPipeLine()
+{
+    WaitIdle();
+    std::vector<UniquePtr<Worker>> workers;
+    TransferOutAllWorkers(workers);
+    // Workers release their slots on destruction, so they must die outside m_WorkerMutex
+    workers.clear();
+}
+
+void JobPipeLine::PushJob(UniquePtr<Job> &job, JobCounter *counter)
+{
+    Job *pending = job.release();
+    pending->m_PipeLine = this;
+    pending->m_Counter = counter;
+    if (counter)
+    {
+        counter->Increment();
+    }
+    if (JobReplay *replay = m_Replay.load(std::memory_order_relaxed))
+    {
+        replay->OnSubmit(&pending, 1);
+    }
+    // Drop the submission reference, whoever releases the last dependency schedules the job
+    if (pending->m_PendingDependencies.fetch_sub(1, std::memory_order_acq_rel) == 1)
+    {
+        ScheduleJob(pending);
+    }
+}
+
+void JobPipeLine::PushJobs(std::span<UniquePtr<Job>> jobs, JobCounter *counter)
+{
+    if (counter)
+    {
+        counter->Increment(static_cast<int32_t>(jobs.size()));
+    }
+    Job *ready[SUBMIT_BATCH_SIZE];
+    uint32_t readyCount = 0;
+    for (UniquePtr<Job> &job : jobs)
+    {
+        Job *pending = job.release();
+        pending->m_PipeLine = this;
+        pending->m_Counter = counter;
+        if (JobReplay *replay = m_Replay.load(std::memory_order_relaxed))
+        {
+            replay->OnSubmit(&pending, 1);
+        }
+        if (pending->m_PendingDependencies.fetch_sub(1, std::memory_order_acq_rel) == 1)
+        {
+            ready[readyCount++] = pending;
+            if (readyCount == SUBMIT_BATCH_SIZE)
+            {
+                ScheduleJobs(ready, readyCount);
+                readyCount = 0;
+            }
+        }
+    }
+    ScheduleJobs(ready, readyCount);
+}
+
+void JobPipeLine::ScheduleJob(Job *job)
+{
+    ScheduleJobs(&job, 1);
+}
+
+void JobPipeLine::ScheduleJobs(Job *const *jobs, uint32_t count)
 {
-    std::lock_guard<std::mutex> guard(m_QueueMutex);
-    m_Jobs.push_back(std::move(job));
-    m_JobCV.notify_one();
+    if (count == 0)
+        return;
+    JobReplay *replay = m_Replay.load(std::memory_order_relaxed);
+    if (replay && replay->IsSerial())
+    {
+        m_ExternalSubmitted.fetch_add(count, std::memory_order_relaxed);
+        replay->Schedule(jobs, count);
+        return;
+    }
+    // Read before the jobs are published, after that they may already be gone
+    uint32_t levelMask = 0;
+    for (uint32_t i = 0; i < count; i++)
+    {
+        levelMask |= 1u << jobs[i]->GetPriorityLevel();
+    }
+    Worker *worker = currentWorker;
+    if (worker != nullptr && worker->m_PipeLine == this)
+    {
+        // Spawned from one of our own workers, keep it in the worker's deque for locality
+        WorkerSlot &slot = m_Slots[worker->m_SlotIndex];
+        slot.m_Submitted.store(slot.m_Submitted.load(std::memory_order_relaxed) + count, std::memory_order_relaxed);
+        for (uint32_t i = 0; i < count; i++)
+        {
+            slot.m_Jobs[jobs[i]->GetPriorityLevel()].Push(jobs[i]);
+        }
+#if JOB_SYSTEM_STATS
+        for (uint32_t level = 0; level < JOB_PRIORITY_LEVELS; level++)
+        {
+            if (levelMask & (1u << level))
+            {
+                MaxStat(slot.m_QueueHighWater, slot.m_Jobs[level].Size());
+            }
+        }
+#endif
+    }
+    else
+    {
+        m_ExternalSubmitted.fetch_add(count, std::memory_order_relaxed);
+        InjectJobs(jobs, count);
+    }
+    NotifyJobsAvailable(count, levelMask);
+}
+
+void JobPipeLine::InjectJobs(Job *const *jobs, uint32_t count)
+{
+    while (count > 0)
+    {
+        // Consecutive jobs of one level go into that level's queue as one batch
+        uint32_t level = jobs[0]->GetPriorityLevel();
+        uint32_t run = 1;
+        while (run < count && jobs[run]->GetPriorityLevel() == level)
+        {
+            run++;
+        }
+        MPMCQueue<Job *> &injectedJobs = *m_InjectedJobs[level];
+        uint32_t batch = static_cast<uint32_t>(std::min<size_t>(run, injectedJobs.GetCapacity() / 2));
+        bool pushed = batch == 1 ? injectedJobs.TryPush(jobs[0]) : injectedJobs.TryPushBatch(jobs, batch);
+        if (pushed)
+        {
+            jobs += batch;
+            count -= batch;
+#if JOB_SYSTEM_STATS
+            uint64_t depth = injectedJobs.Size();
+            uint64_t highWater = m_InjectedHighWater.load(std::memory_order_relaxed);
+            while (depth > highWater && !m_InjectedHighWater.compare_exchange_weak(highWater, depth, std::memory_order_relaxed))
+            {
+            }
+#endif
+        }
+        else if (!RunPendingJob())
+        {
+            // Queue is full, make room by running a job ourselves before trying again
+            std::this_thread::yield();
+        }
+    }
 }
 
 bool JobPipeLine::PopJob(UniquePtr<Job> &job)
 {
-    std::lock_guard<std::mutex> guard(m_QueueMutex);
-    if (m_Jobs.empty())
+    uint32_t randomState = static_cast<uint32_t>(std::hash<std::thread::id>()(std::this_thread::get_id())) | 1u;
+    Job *pending = FindJob(nullptr, randomState);
+    if (pending)
     {
-        m_JobCV.notify_all();
-        return false;
+        job.reset(pending);
+        return true;
     }
-    job = std::move(m_Jobs.front());
-    m_Jobs.pop_front();
-    return true;
+    return false;
 }
 
 bool JobPipeLine::TransferInWorker(UniquePtr<Worker> &worker)
 {
-    std::lock_guard<std::mutex> guard(m_QueueMutex);
-    worker->Reset();
+    if (!worker || !worker->SetPipeLine(this))
+    {
+        return false;
+    }
+    std::lock_guard<std::mutex> guard(m_WorkerMutex);
     m_Workers.push_back(std::move(worker));
     return true;
 }
 
 bool JobPipeLine::TransferInWorkers(std::vector<UniquePtr<Worker>> &workers)
 {
-    std::lock_guard<std::mutex> guard(m_QueueMutex);
     if (workers.empty())
         return false;
-    m_Workers.reserve(workers.size());
+    bool result = true;
     for (auto &worker : workers)
     {
-        worker->Reset();
-        m_Workers.push_back(std::move(worker));
+        result &= TransferInWorker(worker);
     }
-    return true;
+    workers.clear();
+    return result;
 }
 
 bool JobPipeLine::TransferOutWorker(UniquePtr<Worker> &worker)
 {
-    std::lock_guard<std::mutex> guard(m_QueueMutex);
+    std::lock_guard<std::mutex> guard(m_WorkerMutex);
     if (m_Workers.empty())
     {
         return false;
@@ -179,43 +447,102 @@ bool JobPipeLine::TransferOutWorker(UniquePtr<Worker> &worker)
 
 bool JobPipeLine::TransferOutAllWorkers(std::vector<UniquePtr<Worker>> &workers)
 {
-    std::lock_guard<std::mutex> guard(m_QueueMutex);
+    std::lock_guard<std::mutex> guard(m_WorkerMutex);
     if (m_Workers.empty())
     {
         return false;
     }
     workers = std::move(m_Workers);
+    m_Workers.clear();
     return true;
 }
 
 bool JobPipeLine::IsIdle()
 {
-    std::lock_guard<std::mutex> guard(m_QueueMutex);
-    return m_Jobs.empty();
+    // Completions are summed before submissions: a job is always counted as submitted
+    // before it can be counted as completed, so equal sums mean nothing is in flight.
+    uint64_t completed = m_ExternalCompleted.load(std::memory_order_acquire);
+    for (uint32_t i = 0; i < m_NumSlots; i++)
+    {
+        completed += m_Slots[i].m_Completed.load(std::memory_order_acquire);
+    }
+    uint64_t submitted = m_ExternalSubmitted.load(std::memory_order_acquire);
+    for (uint32_t i = 0; i < m_NumSlots; i++)
+    {
+        submitted += m_Slots[i].m_Submitted.load(std::memory_order_acquire);
+    }
+    return completed == submitted;
+}
+
+bool JobPipeLine::RunPendingJob()
+{
+    JobReplay *replay = m_Replay.load(std::memory_order_relaxed);
+    if (replay && replay->IsSerial())
+        return replay->RunNext();
+    Worker *worker = currentWorker;
+    if (worker != nullptr && worker->m_PipeLine == this)
+    {
+        Job *job = FindJob(worker, worker->m_RandomState);
+        if (job == nullptr)
+            return false;
+        RunJob(job, m_Slots[worker->m_SlotIndex].m_Completed);
+        return true;
+    }
+    UniquePtr<Job> job;
+    if (!PopJob(job))
+        return false;
+    RunJob(job.release(), m_ExternalCompleted);
+    return true;
+}
+
+void JobPipeLine::WaitIdle()
+{
+    while (!IsIdle())
+    {
+        // Help out instead of blocking, the calling thread may be the only one left
+        if (!RunPendingJob())
+        {
+            std::this_thread::yield();
+        }
+    }
 }
 
 void JobPipeLine::SortJobs(ScheduleStrategy strategy)
 {
-    std::lock_guard<std::mutex> guard(m_QueueMutex);
-    switch (strategy)
+    if (strategy == ScheduleStrategy::PRIORITY)
+        return;
+    JobSchedulePolicy policy = GetSchedulePolicy();
+    policy.mLevelOrder.fill(strategy);
+    SetSchedulePolicy(policy);
+}
+
+void JobPipeLine::SetSchedulePolicy(const JobSchedulePolicy &policy)
+{
+    uint32_t lifoLevelMask = 0;
+    for (uint32_t level = 0; level < JOB_PRIORITY_LEVELS; level++)
+    {
+        if (policy.mLevelOrder[level] != ScheduleStrategy::FIFO)
+            lifoLevelMask |= 1u << level;
+    }
+    m_LifoLevelMask.store(lifoLevelMask, std::memory_order_relaxed);
+    m_AgingInterval.store(policy.mAgingInterval, std::memory_order_relaxed);
+}
+
+JobSchedulePolicy JobPipeLine::GetSchedulePolicy() const
+{
+    JobSchedulePolicy policy;
+    uint32_t lifoLevelMask = m_LifoLevelMask.load(std::memory_order_relaxed);
+    for (uint32_t level = 0; level < JOB_PRIORITY_LEVELS; level++)
     {
-    case ScheduleStrategy::FIFO:
-        break;
-    case ScheduleStrategy::LIFO:
-        std::reverse(m_Jobs.begin(), m_Jobs.end());
-        break;
-    case ScheduleStrategy::PRIORITY:
-        std::sort(m_Jobs.begin(), m_Jobs.end());
-        break;
-    default:
-        break;
+        policy.mLevelOrder[level] = (lifoLevelMask & (1u << level)) ? ScheduleStrategy::LIFO : ScheduleStrategy::FIFO;
     }
+    policy.mAgingInterval = m_AgingInterval.load(std::memory_order_relaxed);
+    return policy;
 }
 
 bool JobPipeLine::BorrowWorker(JobPipeLine *pipeLine)
 {
-    std::lock_guard<std::mutex> guard(m_QueueMutex);
-    if (m_Workers.empty())
+    if (pipeLine == nullptr || pipeLine == this)
     {
         return false;
     }
@@ -224,116 +551,1041 @@ bool JobPipeLine::BorrowWorker(JobPipeLine *pipeLine)
     {
         return false;
     }
-    pipeLine->TransferInWorker(worker);
+    if (!pipeLine->TransferInWorker(worker))
+    {
+        TransferInWorker(worker);
+        return false;
+    }
+    std::lock_guard<std::mutex> guard(m_WorkerMutex);
     m_PipeLinesBorrowed.push_back(pipeLine);
     return true;
 }
 
 bool JobPipeLine::CallReturnWorker(JobPipeLine *pipeLine)
 {
-    std::lock_guard<std::mutex> guard(m_QueueMutex);
-    if (m_PipeLinesBorrowed.empty())
+    {
+        std::lock_guard<std::mutex> guard(m_WorkerMutex);
+        auto it = std::find(m_PipeLinesBorrowed.rbegin(), m_PipeLinesBorrowed.rend(), pipeLine);
+        if (it == m_PipeLinesBorrowed.rend())
+        {
+            return false;
+        }
+        m_PipeLinesBorrowed.erase(std::next(it).base());
+    }
+    UniquePtr<Worker> worker;
+    if (!pipeLine->TransferOutWorker(worker))
     {
         return false;
     }
-    std::vector<UniquePtr<Worker>> workers;
-    if (!pipeLine->TransferOutAllWorkers(workers))
+    if (!TransferInWorker(worker))
     {
+        // The worker is busy, it stays lent out until the next call
+        pipeLine->TransferInWorker(worker);
+        std::lock_guard<std::mutex> guard(m_WorkerMutex);
+        m_PipeLinesBorrowed.push_back(pipeLine);
         return false;
     }
-    TransferInWorkers(workers);
-    m_PipeLinesBorrowed.pop_back();
     return true;
 }
 
-JobSystem::JobSystem()
+uint32_t JobPipeLine::GetWorkerCount()
 {
-    HLOG_INFO("JobSystem created\n");
-    m_JobPipeLines.push_back(std::make_unique<JobPipeLine>(m_MaxNumOfWorkers / 2));
-    m_CurrentNumOfWorkers = m_MaxNumOfWorkers / 2;
+    std::lock_guard<std::mutex> guard(m_WorkerMutex);
+    return static_cast<uint32_t>(m_Workers.size());
 }
 
-JobSystem::~JobSystem()
+void JobPipeLine::SetWorkerQuota(uint32_t minWorkers, uint32_t maxWorkers)
 {
-    std::lock_guard<std::mutex> guard(m_Mutex);
-    for (auto &pipeline : m_JobPipeLines)
+    maxWorkers = std::clamp(maxWorkers, 1u, m_NumSlots);
+    m_MinWorkers.store(std::clamp(minWorkers, 1u, maxWorkers), std::memory_order_relaxed);
+    m_MaxWorkers.store(maxWorkers, std::memory_order_relaxed);
+}
+
+uint32_t JobPipeLine::GetMinWorkers() const
+{
+    return m_MinWorkers.load(std::memory_order_relaxed);
+}
+
+uint32_t JobPipeLine::GetMaxWorkers() const
+{
+    return m_MaxWorkers.load(std::memory_order_relaxed);
+}
+
+size_t JobPipeLine::GetQueuedJobCount()
+{
+    size_t count = 0;
+    for (uint32_t level = 0; level < JOB_PRIORITY_LEVELS; level++)
     {
-        pipeline.reset();
+        count += m_InjectedJobs[level]->Size();
+        for (uint32_t i = 0; i < m_NumSlots; i++)
+        {
+            count += m_Slots[i].m_Jobs[level].Size();
+        }
     }
-    m_JobPipeLines.clear();
+    return count;
 }
 
-uint32_t JobSystem::CreateNewPipeLine()
+uint64_t JobPipeLine::GetCompletedJobCount()
 {
-    std::lock_guard<std::mutex> guard(m_Mutex);
-    if (m_CurrentNumOfWorkers >= m_MaxNumOfWorkers)
+    uint64_t completed = m_ExternalCompleted.load(std::memory_order_acquire);
+    for (uint32_t i = 0; i < m_NumSlots; i++)
     {
-        HLOG_ERROR("No more workers can be created\n");
-        return UINT_MAX;
+        completed += m_Slots[i].m_Completed.load(std::memory_order_acquire);
     }
-    uint32_t id = static_cast<size_t>(m_JobPipeLines.size());
-    m_JobPipeLines.push_back(std::make_unique<JobPipeLine>(1));
-    HLOG_INFO("New pipeline created with id %d\n", id);
-    m_CurrentNumOfWorkers++;
-    return id;
+    return completed;
 }
 
-bool JobSystem::DestroyPipeLine(uint32_t pipeLineID)
+uint64_t JobPipeLine::GetCancelledJobCount() const
 {
-    std::lock_guard<std::mutex> guard(m_Mutex);
-    if (pipeLineID >= m_JobPipeLines.size())
+    return m_CancelledJobs.load(std::memory_order_relaxed);
+}
+
+uint64_t JobPipeLine::GetExpiredJobCount() const
+{
+    return m_ExpiredJobs.load(std::memory_order_relaxed);
+}
+
+void JobPipeLine::SetReplay(JobReplay *replay)
+{
+    m_Replay.store(replay, std::memory_order_relaxed);
+}
+
+JobPipeLineStats JobPipeLine::GetStats()
+{
+    JobPipeLineStats stats;
+#if JOB_SYSTEM_STATS
+    std::lock_guard<std::mutex> guard(m_WorkerMutex);
+    stats.mWorkers.resize(m_NumSlots);
+    const int64_t now = StatClock();
+    for (uint32_t i = 0; i < m_NumSlots; i++)
     {
-        HLOG_ERROR("Invalid pipeline id\n");
-        return false;
+        const WorkerSlot &slot = m_Slots[i];
+        JobWorkerStats &worker = stats.mWorkers[i];
+        worker.mJobsRun = slot.m_Completed.load(std::memory_order_relaxed);
+        worker.mBusyNanoseconds = slot.m_BusyNanoseconds.load(std::memory_order_relaxed);
+        worker.mIdleNanoseconds = slot.m_IdleNanoseconds.load(std::memory_order_relaxed);
+        // Include the stretch the worker is in right now, a parked worker books nothing until it wakes
+        int64_t idleSince = slot.m_IdleSince.load(std::memory_order_relaxed);
+        if (idleSince != 0)
+        {
+            worker.mIdleNanoseconds += std::max<int64_t>(now - idleSince, 0);
+        }
+        else if (slot.m_Owner != nullptr)
+        {
+            worker.mBusyNanoseconds += std::max<int64_t>(now - slot.m_ActiveSince.load(std::memory_order_relaxed), 0);
+        }
+        worker.mParks = slot.m_Parks.load(std::memory_order_relaxed);
+        worker.mStealAttempts = slot.m_StealAttempts.load(std::memory_order_relaxed);
+        worker.mSteals = slot.m_Steals.load(std::memory_order_relaxed);
+        worker.mLockWaitNanoseconds = slot.m_LockWaitNanoseconds.load(std::memory_order_relaxed);
+        worker.mQueueHighWater = slot.m_QueueHighWater.load(std::memory_order_relaxed);
     }
-    m_JobPipeLines[pipeLineID].reset();
-    m_JobPipeLines.erase(m_JobPipeLines.begin() + pipeLineID);
-    m_CurrentNumOfWorkers--;
-    return true;
+    stats.mInjectedHighWater = m_InjectedHighWater.load(std::memory_order_relaxed);
+#endif
+    stats.mQueuedJobs = GetQueuedJobCount();
+    return stats;
 }
 
-bool JobSystem::SubmitJob(UniquePtr<Job> &job, const uint32_t pipeLineID)
+void JobPipeLine::SetIdlePolicy(const WorkerIdlePolicy &policy)
 {
-    std::lock_guard<std::mutex> guard(m_Mutex);
-    if (pipeLineID >= m_JobPipeLines.size())
+    m_SpinMicroseconds.store(policy.mSpinMicroseconds, std::memory_order_relaxed);
+    m_YieldMicroseconds.store(policy.mYieldMicroseconds, std::memory_order_relaxed);
+}
+
+WorkerIdlePolicy JobPipeLine::GetIdlePolicy() const
+{
+    WorkerIdlePolicy policy;
+    policy.mSpinMicroseconds = m_SpinMicroseconds.load(std::memory_order_relaxed);
+    policy.mYieldMicroseconds = m_YieldMicroseconds.load(std::memory_order_relaxed);
+    return policy;
+}
+
+JobPipeLine *JobPipeLine::GetCurrentPipeLine()
+{
+    return currentWorker != nullptr ? currentWorker->m_PipeLine : nullptr;
+}
+
+uint32_t JobPipeLine::ClaimSlot(Worker *worker)
+{
+    std::lock_guard<std::mutex> guard(m_WorkerMutex);
+    for (uint32_t i = 0; i < m_NumSlots; i++)
     {
-        HLOG_ERROR("Invalid pipeline id\n");
-        return false;
+        if (m_Slots[i].m_Owner == nullptr)
+        {
+            m_Slots[i].m_Owner = worker;
+#if JOB_SYSTEM_STATS
+            m_Slots[i].m_ActiveSince.store(StatClock(), std::memory_order_relaxed);
+#endif
+            return i;
+        }
     }
-    m_JobPipeLines[pipeLineID]->PushJob(job);
-    HLOG_INFO("Job submitted\n");
-    return true;
+    return UINT_MAX;
 }
 
-void JobSystem::SortJobs(ScheduleStrategy strategy)
+void JobPipeLine::ReleaseSlot(uint32_t slotIndex, Worker *worker)
 {
-    std::lock_guard<std::mutex> guard(m_Mutex);
-    for (auto &pipeline : m_JobPipeLines)
+    std::lock_guard<std::mutex> guard(m_WorkerMutex);
+    if (slotIndex < m_NumSlots && m_Slots[slotIndex].m_Owner == worker)
     {
-        pipeline->SortJobs(strategy);
+        m_Slots[slotIndex].m_Owner = nullptr;
     }
 }
 
-JobSystem *JobSystem::CreateJobSystem()
+Job *JobPipeLine::FindJob(Worker *worker, uint32_t &randomState)
 {
-    if (jobSystemSingleton == nullptr)
+    // Levels are searched from the top, except on every aging interval-th pick of a worker.
+    // The first pass only visits levels hinted to hold jobs, the second catches stale hints.
+    bool bottomUp = false;
+    if (worker != nullptr)
     {
-        jobSystemSingleton = new JobSystem();
+        uint32_t agingInterval = m_AgingInterval.load(std::memory_order_relaxed);
+        bottomUp = agingInterval != 0 && ++worker->m_NumPicks % agingInterval == 0;
     }
-    else
+    uint32_t levelMask = m_LevelMask.load(std::memory_order_relaxed) | 1u;
+    for (uint32_t pass = 0; pass < 2; pass++)
     {
-        HLOG_ERROR("JobSystem is already initialized,JobSystem class is a singleton\n");
+        for (uint32_t i = 0; i < JOB_PRIORITY_LEVELS; i++)
+        {
+            uint32_t level = bottomUp ? i : JOB_PRIORITY_LEVELS - 1 - i;
+            bool hinted = (levelMask & (1u << level)) != 0;
+            if (hinted != (pass == 0))
+                continue;
+            if (Job *job = TakeJob(worker, randomState, level))
+                return job;
+        }
     }
-    return jobSystemSingleton;
+    if (levelMask != 1u)
+    {
+        ClearEmptyLevels();
+    }
+    return nullptr;
 }
 
-void JobSystem::DestroyJobSystem(JobSystem *jobSystem)
+Job *JobPipeLine::TakeJob(Worker *worker, uint32_t &randomState, uint32_t level)
 {
-    if (jobSystemSingleton != nullptr)
+    Job *job = nullptr;
+    uint32_t slotIndex = UINT_MAX;
+    if (worker != nullptr)
     {
-        delete jobSystemSingleton;
-        jobSystemSingleton = nullptr;
+        slotIndex = worker->m_SlotIndex;
+        WorkStealingQueue<Job *> &jobs = m_Slots[slotIndex].m_Jobs[level];
+        // Stealing from its own deque gives the owner the oldest job instead of the newest
+        bool lifo = (m_LifoLevelMask.load(std::memory_order_relaxed) & (1u << level)) != 0;
+        if (lifo ? jobs.Pop(job) : jobs.Steal(job))
+            return job;
+    }
+    if (m_InjectedJobs[level]->TryPop(job))
+        return job;
+#if JOB_SYSTEM_STATS
+    if (worker != nullptr)
+    {
+        WorkerSlot &slot = m_Slots[slotIndex];
+        AddStat(slot.m_StealAttempts, 1);
+        job = StealJob(randomState, slotIndex, level);
+        if (job)
+        {
+            AddStat(slot.m_Steals, 1);
+        }
+        return job;
+    }
+#endif
+    return StealJob(randomState, slotIndex, level);
+}
+
+Job *JobPipeLine::StealJob(uint32_t &randomState, uint32_t skipSlot, uint32_t level)
+{
+    // Start at a random victim so thieves spread out instead of all hitting slot 0
+    uint32_t start = NextRandom(randomState) % m_NumSlots;
+    if (!m_HasCacheDomains || skipSlot >= m_NumSlots)
+    {
+        return StealJobInDomain(start, skipSlot, level, 0, false);
     }
+    // Jobs stolen from a worker sharing our last level cache likely find their data there
+    uint32_t cacheDomain = m_Slots[skipSlot].m_CacheDomain;
+    if (Job *job = StealJobInDomain(start, skipSlot, level, cacheDomain, true))
+    {
+        return job;
+    }
+    return StealJobInDomain(start, skipSlot, level, cacheDomain, false);
+}
+
+Job *JobPipeLine::StealJobInDomain(uint32_t start, uint32_t skipSlot, uint32_t level, uint32_t cacheDomain, bool sameDomain)
+{
+    for (uint32_t i = 0; i < m_NumSlots; i++)
+    {
+        uint32_t victim = (start + i) % m_NumSlots;
+        if (victim == skipSlot)
+            continue;
+        if (m_HasCacheDomains && (m_Slots[victim].m_CacheDomain == cacheDomain) != sameDomain)
+            continue;
+        Job *job = nullptr;
+        WorkStealingQueue<Job *> &jobs = m_Slots[victim].m_Jobs[level];
+        while (!jobs.IsEmpty())
+        {
+            if (jobs.Steal(job))
+            {
+                return job;
+            }
+        }
+    }
+    return nullptr;
+}
+
+bool JobPipeLine::HasQueuedJobs()
+{
+    for (uint32_t level = 0; level < JOB_PRIORITY_LEVELS; level++)
+    {
+        if (HasQueuedJobs(level))
+            return true;
+    }
+    return false;
+}
+
+bool JobPipeLine::HasQueuedJobs(uint32_t level)
+{
+    if (!m_InjectedJobs[level]->IsEmpty())
+        return true;
+    for (uint32_t i = 0; i < m_NumSlots; i++)
+    {
+        if (!m_Slots[i].m_Jobs[level].IsEmpty())
+            return true;
+    }
+    return false;
+}
+
+void JobPipeLine::ClearEmptyLevels()
+{
+    uint32_t levelMask = m_LevelMask.fetch_and(1u, std::memory_order_seq_cst);
+    // Pairs with the fence in NotifyJobsAvailable: a job pushed while we cleared its bit is
+    // either seen here or its submitter sees the cleared bit and sets it again
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    uint32_t stillQueued = 0;
+    for (uint32_t level = 1; level < JOB_PRIORITY_LEVELS; level++)
+    {
+        if ((levelMask & (1u << level)) && HasQueuedJobs(level))
+            stillQueued |= 1u << level;
+    }
+    if (stillQueued != 0)
+    {
+        m_LevelMask.fetch_or(stillQueued, std::memory_order_relaxed);
+    }
+}
+
+void JobPipeLine::RunJob(Job *job, std::atomic<uint64_t> &completed)
+{
+    JobReplay *replay = m_Replay.load(std::memory_order_relaxed);
+    JobReplay::Context replayContext;
+    if (replay)
+    {
+        replayContext = replay->EnterJob(*job);
+    }
+    // Dropped jobs still release their continuations and counters, so nobody waits forever
+    if (job->IsCancelled())
+    {
+        job->m_CancellationToken->m_NumCancelledJobs.fetch_add(1, std::memory_order_relaxed);
+        m_CancelledJobs.fetch_add(1, std::memory_order_relaxed);
+    }
+    else if (job->IsExpired())
+    {
+        m_ExpiredJobs.fetch_add(1, std::memory_order_relaxed);
+    }
+    else
+    {
+        job->Execute();
+    }
+    if (replay)
+    {
+        replay->LeaveJob(*job, replayContext);
+    }
+    // Destroy the job before signalling anyone, waiters may free what its callable captured
+    JobCounter *counter = job->m_Counter;
+    std::vector<Job *> continuations = std::move(job->m_Continuations);
+    delete job;
+    // Continuations are scheduled before this job counts as completed, so IsIdle never
+    // sees a gap between a job and the work it unlocks
+    for (Job *continuation : continuations)
+    {
+        if (continuation->m_PendingDependencies.fetch_sub(1, std::memory_order_acq_rel) == 1)
+        {
+            continuation->m_PipeLine->ScheduleJob(continuation);
+        }
+    }
+    if (counter)
+    {
+        counter->Decrement();
+    }
+    if (&completed == &m_ExternalCompleted)
+    {
+        completed.fetch_add(1, std::memory_order_release);
+    }
+    else
+    {
+        // Slot counters are only ever written by the slot's owner
+        completed.store(completed.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+    }
+}
+
+void JobPipeLine::WaitForJobs(Worker *worker)
+{
+    // Short gaps between bursts of jobs are bridged by spinning, so the worker picks up the
+    // next job without a syscall. Only after the whole idle budget has passed does it park.
+    const auto spinTime = std::chrono::microseconds(m_SpinMicroseconds.load(std::memory_order_relaxed));
+    const auto yieldTime = spinTime + std::chrono::microseconds(m_YieldMicroseconds.load(std::memory_order_relaxed));
+    const auto start = std::chrono::steady_clock::now();
+#if JOB_SYSTEM_STATS
+    WorkerSlot &slot = m_Slots[worker->m_SlotIndex];
+    const int64_t idleSince = std::chrono::duration_cast<std::chrono::nanoseconds>(start.time_since_epoch()).count();
+    AddStat(slot.m_BusyNanoseconds, std::max<int64_t>(idleSince - slot.m_ActiveSince.load(std::memory_order_relaxed), 0));
+    slot.m_IdleSince.store(idleSince, std::memory_order_relaxed);
+#endif
+    bool park = true;
+    for (;;)
+    {
+        if (HasQueuedJobs() || worker->ShouldLeaveIdle())
+        {
+            park = false;
+            break;
+        }
+        auto elapsed = std::chrono::steady_clock::now() - start;
+        if (elapsed < spinTime)
+        {
+            for (uint32_t i = 0; i < WORKER_PAUSES_PER_CHECK; i++)
+            {
+                CpuRelax();
+            }
+        }
+        else if (elapsed < yieldTime)
+        {
+            std::this_thread::yield();
+        }
+        else
+        {
+            break;
+        }
+    }
+    if (park)
+    {
+        ParkWorker(worker);
+    }
+#if JOB_SYSTEM_STATS
+    const int64_t activeSince = StatClock();
+    AddStat(slot.m_IdleNanoseconds, activeSince - idleSince);
+    slot.m_ActiveSince.store(activeSince, std::memory_order_relaxed);
+    slot.m_IdleSince.store(0, std::memory_order_relaxed);
+#endif
+}
+
+void JobPipeLine::ParkWorker(Worker *worker)
+{
+    const uint32_t slotIndex = worker->m_SlotIndex;
+    WorkerSlot &slot = m_Slots[slotIndex];
+#if JOB_SYSTEM_STATS
+    AddStat(slot.m_Parks, 1);
+#endif
+    {
+        std::unique_lock<std::mutex> lock = LockParkMutex();
+        slot.m_ParkState.store(1, std::memory_order_relaxed);
+        m_ParkedSlots.push_back(slotIndex);
+        m_NumSleepingWorkers.fetch_add(1, std::memory_order_seq_cst);
+    }
+    // Pairs with the fence in NotifyJobsAvailable: either we see the new job here or the
+    // submitter sees us parked and wakes us
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (HasQueuedJobs() || worker->ShouldLeaveIdle())
+    {
+        std::unique_lock<std::mutex> lock = LockParkMutex();
+        auto it = std::find(m_ParkedSlots.begin(), m_ParkedSlots.end(), slotIndex);
+        if (it != m_ParkedSlots.end())
+        {
+            m_ParkedSlots.erase(it);
+            m_NumSleepingWorkers.fetch_sub(1, std::memory_order_relaxed);
+            slot.m_ParkState.store(0, std::memory_order_relaxed);
+        }
+    }
+    while (slot.m_ParkState.load(std::memory_order_acquire) != 0)
+    {
+        slot.m_ParkState.wait(1, std::memory_order_acquire);
+    }
+}
+
+void JobPipeLine::NotifyJobsAvailable(uint32_t count, uint32_t levelMask)
+{
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    levelMask &= ~1u;
+    if ((m_LevelMask.load(std::memory_order_relaxed) & levelMask) != levelMask)
+    {
+        m_LevelMask.fetch_or(levelMask, std::memory_order_relaxed);
+    }
+    if (m_NumSleepingWorkers.load(std::memory_order_relaxed) == 0)
+        return;
+    // Wake as many workers as there are new jobs and no more, the rest keep sleeping
+    std::unique_lock<std::mutex> lock = LockParkMutex();
+    while (count > 0 && !m_ParkedSlots.empty())
+    {
+        WorkerSlot &slot = m_Slots[m_ParkedSlots.back()];
+        m_ParkedSlots.pop_back();
+        m_NumSleepingWorkers.fetch_sub(1, std::memory_order_relaxed);
+        slot.m_ParkState.store(0, std::memory_order_release);
+        slot.m_ParkState.notify_one();
+        count--;
+    }
+}
+
+void JobPipeLine::WakeWorker(uint32_t slotIndex)
+{
+    std::unique_lock<std::mutex> lock = LockParkMutex();
+    auto it = std::find(m_ParkedSlots.begin(), m_ParkedSlots.end(), slotIndex);
+    if (it == m_ParkedSlots.end())
+        return;
+    m_ParkedSlots.erase(it);
+    m_NumSleepingWorkers.fetch_sub(1, std::memory_order_relaxed);
+    WorkerSlot &slot = m_Slots[slotIndex];
+    slot.m_ParkState.store(0, std::memory_order_release);
+    slot.m_ParkState.notify_one();
+}
+
+std::unique_lock<std::mutex> JobPipeLine::LockParkMutex()
+{
+#if JOB_SYSTEM_STATS
+    std::unique_lock<std::mutex> lock(m_ParkMutex, std::try_to_lock);
+    if (!lock.owns_lock())
+    {
+        const int64_t start = StatClock();
+        lock.lock();
+        Worker *worker = currentWorker;
+        if (worker != nullptr && worker->m_PipeLine == this)
+        {
+            AddStat(m_Slots[worker->m_SlotIndex].m_LockWaitNanoseconds, StatClock() - start);
+        }
+    }
+    return lock;
+#else
+    return std::unique_lock<std::mutex>(m_ParkMutex);
+#endif
+}
+
+JobSystem::JobSystem()
+{
+    HLOG_INFO("JobSystem created\n");
+    m_Balancer = std::make_unique<WorkerBalancer>();
+    m_FrameArena = std::make_unique<FrameJobArena>();
+    m_Replay = std::make_unique<JobReplay>();
+    m_Topology = CpuTopology::Detect();
+    m_MaxNumOfWorkers = std::max(m_Topology.GetNumLogicalCpus(), 1u);
+    m_CurrentNumOfWorkers = std::max(m_MaxNumOfWorkers / 2, 1u);
+    uint32_t maxCpuID = 0;
+    for (const LogicalCpu &cpu : m_Topology.GetLogicalCpus())
+    {
+        maxCpuID = std::max(maxCpuID, cpu.mID);
+    }
+    m_CpuLoad.resize(maxCpuID + 1, 0);
+    // The main pipeline gets one worker per physical core where it can
+    std::vector<LogicalCpu> cpus = m_Topology.SelectCpus(PipeLinePlacement::SPREAD, m_MaxNumOfWorkers, m_CpuLoad);
+    m_JobPipeLines.push_back(std::make_shared<JobPipeLine>(m_CurrentNumOfWorkers, m_MaxNumOfWorkers, cpus));
+    m_PipeLineCpus.push_back(ReserveCpus(cpus, m_CurrentNumOfWorkers));
+}
+
+JobSystem::~JobSystem()
+{
+    StopTimers();
+    StopWorkerBalancer();
+    FlushJobs();
+    // Its threads submit jobs, so it has to go while the pipelines are still there
+    m_FileService.reset();
+    std::unique_lock<std::shared_mutex> lock(m_Mutex);
+    for (auto &pipeline : m_JobPipeLines)
+    {
+        pipeline.reset();
+    }
+    m_JobPipeLines.clear();
+}
+
+uint32_t JobSystem::CreateNewPipeLine(PipeLinePlacement placement)
+{
+    std::unique_lock<std::shared_mutex> lock(m_Mutex);
+    if (m_CurrentNumOfWorkers >= m_MaxNumOfWorkers)
+    {
+        HLOG_ERROR("No more workers can be created\n");
+        return UINT_MAX;
+    }
+    uint32_t id = static_cast<size_t>(m_JobPipeLines.size());
+    std::vector<LogicalCpu> cpus = m_Topology.SelectCpus(placement, m_MaxNumOfWorkers, m_CpuLoad);
+    m_JobPipeLines.push_back(std::make_shared<JobPipeLine>(1, m_MaxNumOfWorkers, cpus));
+    m_PipeLineCpus.push_back(ReserveCpus(cpus, 1));
+    m_JobPipeLines.back()->SetReplay(m_Replay->IsActive() ? m_Replay.get() : nullptr);
+    HLOG_INFO("New pipeline created with id %d\n", id);
+    m_CurrentNumOfWorkers++;
+    return id;
+}
+
+bool JobSystem::DestroyPipeLine(uint32_t pipeLineID)
+{
+    SharedPtr<JobPipeLine> pipeline;
+    {
+        std::lock_guard<std::mutex> balanceGuard(m_BalanceMutex);
+        std::unique_lock<std::shared_mutex> lock(m_Mutex);
+        if (pipeLineID >= m_JobPipeLines.size())
+        {
+            HLOG_ERROR("Invalid pipeline id\n");
+            return false;
+        }
+        pipeline = std::move(m_JobPipeLines[pipeLineID]);
+        m_JobPipeLines.erase(m_JobPipeLines.begin() + pipeLineID);
+        for (uint32_t cpuID : m_PipeLineCpus[pipeLineID])
+        {
+            m_CpuLoad[cpuID]--;
+        }
+        m_PipeLineCpus.erase(m_PipeLineCpus.begin() + pipeLineID);
+        m_Balancer->Forget(pipeline.get());
+        m_CurrentNumOfWorkers--;
+    }
+    // Submits that looked the pipeline up before it was removed still hold a reference, wait
+    // for them to finish pushing. The acquire fence pairs with the release of their reference.
+    while (pipeline.use_count() > 1)
+    {
+        std::this_thread::yield();
+    }
+    std::atomic_thread_fence(std::memory_order_acquire);
+    // Draining the pipeline may run jobs on this thread, so do it without holding m_Mutex
+    pipeline.reset();
+    return true;
+}
+
+bool JobSystem::SubmitJob(UniquePtr<Job> &job, const uint32_t pipeLineID, JobCounter *counter)
+{
+    SharedPtr<JobPipeLine> pipeline = GetPipeLine(pipeLineID);
+    if (pipeline == nullptr)
+    {
+        HLOG_ERROR("Invalid pipeline id\n");
+        return false;
+    }
+    pipeline->PushJob(job, counter);
+    return true;
+}
+
+bool JobSystem::SubmitJobs(std::span<UniquePtr<Job>> jobs, const uint32_t pipeLineID, JobCounter *counter)
+{
+    SharedPtr<JobPipeLine> pipeline = GetPipeLine(pipeLineID);
+    if (pipeline == nullptr)
+    {
+        HLOG_ERROR("Invalid pipeline id\n");
+        return false;
+    }
+    pipeline->PushJobs(jobs, counter);
+    return true;
+}
+
+bool JobSystem::SetIdlePolicy(const WorkerIdlePolicy &policy, const uint32_t pipeLineID)
+{
+    SharedPtr<JobPipeLine> pipeline = GetPipeLine(pipeLineID);
+    if (pipeline == nullptr)
+    {
+        HLOG_ERROR("Invalid pipeline id\n");
+        return false;
+    }
+    pipeline->SetIdlePolicy(policy);
+    return true;
+}
+
+bool JobSystem::SetSchedulePolicy(const JobSchedulePolicy &policy, const uint32_t pipeLineID)
+{
+    SharedPtr<JobPipeLine> pipeline = GetPipeLine(pipeLineID);
+    if (pipeline == nullptr)
+    {
+        HLOG_ERROR("Invalid pipeline id\n");
+        return false;
+    }
+    pipeline->SetSchedulePolicy(policy);
+    return true;
+}
+
+bool JobSystem::SetWorkerQuota(uint32_t minWorkers, uint32_t maxWorkers, const uint32_t pipeLineID)
+{
+    SharedPtr<JobPipeLine> pipeline = GetPipeLine(pipeLineID);
+    if (pipeline == nullptr)
+    {
+        HLOG_ERROR("Invalid pipeline id\n");
+        return false;
+    }
+    pipeline->SetWorkerQuota(minWorkers, maxWorkers);
+    return true;
+}
+
+bool JobSystem::RebalanceWorkers()
+{
+    std::lock_guard<std::mutex> guard(m_BalanceMutex);
+    std::vector<SharedPtr<JobPipeLine>> references;
+    std::vector<JobPipeLine *> pipelines;
+    for (uint32_t i = 0;; i++)
+    {
+        SharedPtr<JobPipeLine> pipeline = GetPipeLine(i);
+        if (pipeline == nullptr)
+            break;
+        pipelines.push_back(pipeline.get());
+        references.push_back(std::move(pipeline));
+    }
+    return m_Balancer->Rebalance(pipelines);
+}
+
+void JobSystem::StartWorkerBalancer(const WorkerBalancePolicy &policy)
+{
+    StopWorkerBalancer();
+    {
+        std::lock_guard<std::mutex> guard(m_BalanceMutex);
+        m_Balancer->SetPolicy(policy);
+    }
+    m_IsBalancerRunning = true;
+    const auto interval = std::chrono::milliseconds(std::max(policy.mIntervalMilliseconds, 1u));
+    m_BalancerThread = std::thread([this, interval]()
+                                   {
+        std::unique_lock<std::mutex> lock(m_BalancerThreadMutex);
+        while (!m_BalancerCV.wait_for(lock, interval, [this]() { return !m_IsBalancerRunning; }))
+        {
+            lock.unlock();
+            RebalanceWorkers();
+            lock.lock();
+        } });
+}
+
+void JobSystem::StopWorkerBalancer()
+{
+    if (!m_BalancerThread.joinable())
+        return;
+    {
+        std::lock_guard<std::mutex> guard(m_BalancerThreadMutex);
+        m_IsBalancerRunning = false;
+    }
+    m_BalancerCV.notify_all();
+    m_BalancerThread.join();
+}
+
+TimerHandle JobSystem::SubmitDelayedJob(std::chrono::steady_clock::duration delay, JobFunction function, const uint32_t pipeLineID, uint8_t priority)
+{
+    return ScheduleTimer(delay, std::chrono::steady_clock::duration::zero(), std::move(function), pipeLineID, priority);
+}
+
+TimerHandle JobSystem::SubmitPeriodicJob(std::chrono::steady_clock::duration interval, JobFunction function, const uint32_t pipeLineID, uint8_t priority)
+{
+    return ScheduleTimer(interval, std::max<std::chrono::steady_clock::duration>(interval, std::chrono::milliseconds(1)), std::move(function), pipeLineID, priority);
+}
+
+bool JobSystem::CancelTimer(TimerHandle handle)
+{
+    std::lock_guard<std::mutex> guard(m_TimerMutex);
+    return m_Timers.Cancel(handle);
+}
+
+TimerHandle JobSystem::ScheduleTimer(std::chrono::steady_clock::duration delay, std::chrono::steady_clock::duration interval, JobFunction function, uint32_t pipeLineID, uint8_t priority)
+{
+    if (!function)
+    {
+        HLOG_ERROR("Timer has no function\n");
+        return {};
+    }
+    auto timedJob = std::make_shared<TimedJob>();
+    timedJob->mFunction = std::move(function);
+    timedJob->mPipeLineID = pipeLineID;
+    timedJob->mPriority = priority;
+
+    std::lock_guard<std::mutex> guard(m_TimerMutex);
+    if (!m_TimerThread.joinable())
+    {
+        m_TimerEpoch = std::chrono::steady_clock::now();
+        m_IsTimerRunning = true;
+        m_TimerThread = std::thread([this]()
+                                    { RunTimers(); });
+    }
+    // Rounded up, a job never runs before its delay has passed
+    uint64_t expireTick = GetTimerTick(std::chrono::steady_clock::now() + delay + std::chrono::milliseconds(1) - std::chrono::nanoseconds(1));
+    uint64_t period = std::chrono::ceil<std::chrono::milliseconds>(interval).count();
+    uint64_t previousEvent = m_Timers.GetNextEventTick();
+    TimerHandle handle = m_Timers.Schedule(expireTick, period, std::move(timedJob));
+    if (m_Timers.GetNextEventTick() < previousEvent)
+    {
+        m_TimerCV.notify_one();
+    }
+    return handle;
+}
+
+uint64_t JobSystem::GetTimerTick(std::chrono::steady_clock::time_point time) const
+{
+    return std::chrono::duration_cast<std::chrono::milliseconds>(time - m_TimerEpoch).count();
+}
+
+void JobSystem::RunTimers()
+{
+    std::vector<SharedPtr<TimedJob>> expired;
+    std::unique_lock<std::mutex> lock(m_TimerMutex);
+    while (m_IsTimerRunning)
+    {
+        m_Timers.Advance(GetTimerTick(std::chrono::steady_clock::now()), [&expired](SharedPtr<TimedJob> timedJob)
+                         { expired.push_back(std::move(timedJob)); });
+        if (!expired.empty())
+        {
+            lock.unlock();
+            for (SharedPtr<TimedJob> &timedJob : expired)
+            {
+                if (timedJob->mIsRunning.exchange(true, std::memory_order_acquire))
+                    continue;
+                UniquePtr<Job> job = std::make_unique<Job>([timedJob]()
+                                                           {
+                    timedJob->mFunction();
+                    timedJob->mIsRunning.store(false, std::memory_order_release); }, UINT_MAX, timedJob->mPriority);
+                if (!SubmitJob(job, timedJob->mPipeLineID))
+                {
+                    timedJob->mIsRunning.store(false, std::memory_order_release);
+                }
+            }
+            expired.clear();
+            lock.lock();
+            continue;
+        }
+        uint64_t nextTick = m_Timers.GetNextEventTick();
+        if (nextTick == UINT64_MAX)
+        {
+            m_TimerCV.wait(lock);
+        }
+        else
+        {
+            m_TimerCV.wait_until(lock, m_TimerEpoch + std::chrono::milliseconds(nextTick));
+        }
+    }
+}
+
+void JobSystem::StopTimers()
+{
+    {
+        std::lock_guard<std::mutex> guard(m_TimerMutex);
+        if (!m_TimerThread.joinable())
+            return;
+        m_IsTimerRunning = false;
+    }
+    m_TimerCV.notify_all();
+    m_TimerThread.join();
+}
+
+uint64_t JobSystem::GetCancelledJobCount(const uint32_t pipeLineID)
+{
+    SharedPtr<JobPipeLine> pipeline = GetPipeLine(pipeLineID);
+    return pipeline ? pipeline->GetCancelledJobCount() : 0;
+}
+
+uint64_t JobSystem::GetExpiredJobCount(const uint32_t pipeLineID)
+{
+    SharedPtr<JobPipeLine> pipeline = GetPipeLine(pipeLineID);
+    return pipeline ? pipeline->GetExpiredJobCount() : 0;
+}
+
+JobPipeLineStats JobSystem::GetStats(const uint32_t pipeLineID)
+{
+    SharedPtr<JobPipeLine> pipeline = GetPipeLine(pipeLineID);
+    return pipeline ? pipeline->GetStats() : JobPipeLineStats();
+}
+
+void JobSystem::LogStats()
+{
+#if JOB_SYSTEM_STATS
+    for (uint32_t id = 0;; id++)
+    {
+        SharedPtr<JobPipeLine> pipeline = GetPipeLine(id);
+        if (pipeline == nullptr)
+            break;
+        JobPipeLineStats stats = pipeline->GetStats();
+        JobWorkerStats total;
+        for (const JobWorkerStats &worker : stats.mWorkers)
+        {
+            total.mJobsRun += worker.mJobsRun;
+            total.mBusyNanoseconds += worker.mBusyNanoseconds;
+            total.mIdleNanoseconds += worker.mIdleNanoseconds;
+            total.mParks += worker.mParks;
+            total.mStealAttempts += worker.mStealAttempts;
+            total.mSteals += worker.mSteals;
+            total.mLockWaitNanoseconds += worker.mLockWaitNanoseconds;
+            total.mQueueHighWater = std::max(total.mQueueHighWater, worker.mQueueHighWater);
+        }
+        uint64_t tracked = total.mBusyNanoseconds + total.mIdleNanoseconds;
+        double utilization = tracked > 0 ? 100.0 * total.mBusyNanoseconds / tracked : 0.0;
+        HLOG_INFO("PipeLine %u: %u workers, %.1f%% busy, %llu jobs, %llu/%llu steals, %llu parks, %.3f ms lock wait, queue high water %llu/%llu, %zu queued\n",
+                  id, pipeline->GetWorkerCount(), utilization, static_cast<unsigned long long>(total.mJobsRun),
+                  static_cast<unsigned long long>(total.mSteals), static_cast<unsigned long long>(total.mStealAttempts),
+                  static_cast<unsigned long long>(total.mParks), total.mLockWaitNanoseconds * 1e-6,
+                  static_cast<unsigned long long>(total.mQueueHighWater), static_cast<unsigned long long>(stats.mInjectedHighWater), stats.mQueuedJobs);
+    }
+#endif
+}
+
+TimerHandle JobSystem::LogStatsEvery(std::chrono::steady_clock::duration interval)
+{
+    return SubmitPeriodicJob(interval, [this]()
+                             { LogStats(); });
+}
+
+void JobSystem::StartRecording()
+{
+    FlushJobs();
+    m_Replay->StartRecording();
+    UpdateReplay();
+}
+
+JobTrace JobSystem::StopRecording()
+{
+    FlushJobs();
+    JobTrace trace = m_Replay->StopRecording();
+    UpdateReplay();
+    return trace;
+}
+
+void JobSystem::SetSerialExecution(bool serial, uint64_t seed)
+{
+    FlushJobs();
+    m_Replay->SetSerial(serial, seed);
+    UpdateReplay();
+}
+
+void JobSystem::ReplayTrace(const JobTrace &trace)
+{
+    FlushJobs();
+    m_Replay->SetReplayOrder(trace.mExecutionOrder);
+    UpdateReplay();
+}
+
+void JobSystem::UpdateReplay()
+{
+    JobReplay *replay = m_Replay->IsActive() ? m_Replay.get() : nullptr;
+    std::shared_lock<std::shared_mutex> lock(m_Mutex);
+    for (auto &pipeline : m_JobPipeLines)
+    {
+        pipeline->SetReplay(replay);
+    }
+}
+
+FrameJobArena &JobSystem::GetFrameArena()
+{
+    return *m_FrameArena;
+}
+
+AsyncFileService &JobSystem::GetFileService()
+{
+    std::call_once(m_FileServiceOnce, [this]()
+                   { m_FileService = std::make_unique<AsyncFileService>(this); });
+    return *m_FileService;
+}
+
+const CpuTopology &JobSystem::GetCpuTopology() const
+{
+    return m_Topology;
+}
+
+std::vector<uint32_t> JobSystem::ReserveCpus(const std::vector<LogicalCpu> &cpus, uint32_t workerCount)
+{
+    std::vector<uint32_t> reserved;
+    for (uint32_t i = 0; i < workerCount && i < cpus.size(); i++)
+    {
+        m_CpuLoad[cpus[i].mID]++;
+        reserved.push_back(cpus[i].mID);
+    }
+    return reserved;
+}
+
+void JobSystem::WaitForCounter(JobCounter &counter, int32_t value)
+{
+    // Run other jobs on this thread instead of blocking it, preferring the pipeline we belong to
+    JobPipeLine *pipeline = JobPipeLine::GetCurrentPipeLine();
+    while (counter.GetValue() > value)
+    {
+        if (pipeline && pipeline->RunPendingJob())
+            continue;
+        if (RunPendingJob())
+            continue;
+        std::this_thread::yield();
+    }
+}
+
+void JobSystem::FlushJobs()
+{
+    std::vector<SharedPtr<JobPipeLine>> pipeLines;
+    {
+        std::shared_lock<std::shared_mutex> lock(m_Mutex);
+        pipeLines = m_JobPipeLines;
+    }
+    // Waiting helps run jobs, which may submit more jobs, so m_Mutex must not be held here.
+    // Continuations can move work between pipelines, so repeat until one pass finds all idle.
+    bool idle = false;
+    while (!idle)
+    {
+        idle = true;
+        for (const SharedPtr<JobPipeLine> &pipeline : pipeLines)
+        {
+            if (!pipeline->IsIdle())
+            {
+                idle = false;
+                pipeline->WaitIdle();
+            }
+        }
+    }
+}
+
+bool JobSystem::RunPendingJob()
+{
+    for (uint32_t i = 0;; i++)
+    {
+        SharedPtr<JobPipeLine> pipeline = GetPipeLine(i);
+        if (pipeline == nullptr)
+            return false;
+        if (pipeline->RunPendingJob())
+            return true;
+    }
+}
+
+SharedPtr<JobPipeLine> JobSystem::GetPipeLine(uint32_t pipeLineID)
+{
+    // Pushing may run jobs on this thread when the pipeline is full, and those jobs may
+    // submit again, so callers must not hold m_Mutex while using the pipeline. The reference
+    // they get keeps DestroyPipeLine from freeing it in the meantime.
+    std::shared_lock<std::shared_mutex> lock(m_Mutex);
+    if (pipeLineID >= m_JobPipeLines.size())
+    {
+        return nullptr;
+    }
+    return m_JobPipeLines[pipeLineID];
+}
+
+void JobSystem::SortJobs(ScheduleStrategy strategy)
+{
+    for (uint32_t i = 0;; i++)
+    {
+        SharedPtr<JobPipeLine> pipeline = GetPipeLine(i);
+        if (pipeline == nullptr)
+            break;
+        pipeline->SortJobs(strategy);
+    }
+}
+
+JobSystem *JobSystem::CreateJobSystem()
+{
+    if (jobSystemSingleton == nullptr)
+    {
+        jobSystemSingleton = new JobSystem();
+    }
+    else
+    {
+        HLOG_ERROR("JobSystem is already initialized,JobSystem class is a singleton\n");
+    }
+    return jobSystemSingleton;
+}
+
+void JobSystem::DestroyJobSystem(JobSystem *jobSystem)
+{
+    if (jobSystemSingleton != nullptr)
+    {
+        delete jobSystemSingleton;
+        jobSystemSingleton = nullptr;
+    }
+}
+
+JobSystem *JobSystem::GetInstance()
+{
+    return jobSystemSingleton;
 }
 
 bool GetJobSystem(JobSystem **jobSystem)
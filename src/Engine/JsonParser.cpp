@@ -1,5 +1,6 @@
 #include "Common/pch.h"
 #include "Engine/JsonParser.h"
+#include "Engine/AsyncFileService.h"
 
 JsonParser::JsonParser() : document(), allocator(document.GetAllocator())
 {
@@ -13,15 +14,10 @@ void JsonParser::Parse(const std::string &json)
 
 void JsonParser::ParseFile(const std::string &filename)
 {
-    std::ifstream file(filename);
-    if (!file.is_open())
-    {
-        HLOG_ERROR("Failed to open file: %s\n", filename.c_str());
+    std::vector<uint8_t> data;
+    if (!ReadFileBytes(filename, data))
         return;
-    }
-    std::stringstream buffer;
-    buffer << file.rdbuf();
-    Parse(buffer.str());
+    document.Parse(reinterpret_cast<const char *>(data.data()), data.size());
 }
 
 void JsonParser::ParseStream(std::istream &stream)
@@ -0,0 +1,275 @@
+#include "Common/pch.h"
+#include "Engine/MipGenerator.h"
+#include "Engine/Parallel.h"
+#include <cmath>
+#include <cstring>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define MIP_GENERATOR_SSE2 1
+#include <emmintrin.h>
+#endif
+
+// Number of texels filtered per job
+static constexpr size_t MIP_FILTER_GRAIN = 64 * 1024;
+// Kaiser window half width in target texels, and its shape
+static constexpr float KAISER_RADIUS = 3.0f;
+static constexpr float KAISER_ALPHA = 4.0f;
+static constexpr float PI = 3.14159265358979f;
+
+float SrgbToLinear(float value)
+{
+    return value <= 0.04045f ? value / 12.92f : std::pow((value + 0.055f) / 1.055f, 2.4f);
+}
+
+float LinearToSrgb(float value)
+{
+    value = std::max(value, 0.0f);
+    return value <= 0.0031308f ? value * 12.92f : 1.055f * std::pow(value, 1.0f / 2.4f) - 0.055f;
+}
+
+// Modified Bessel function of the first kind, the power series converges quickly for the
+// arguments the window uses
+static float BesselI0(float x)
+{
+    const float quarterSquared = x * x * 0.25f;
+    float sum = 1.0f;
+    float term = 1.0f;
+    for (int k = 1; k < 32 && term > sum * 1e-8f; k++)
+    {
+        term *= quarterSquared / static_cast<float>(k * k);
+        sum += term;
+    }
+    return sum;
+}
+
+// x in target texels from the target texel center
+static float KaiserFilter(float x)
+{
+    if (std::abs(x) >= KAISER_RADIUS)
+        return 0.0f;
+    const float t = x / KAISER_RADIUS;
+    const float sinc = std::abs(x) < 1e-6f ? 1.0f : std::sin(PI * x) / (PI * x);
+    return sinc * BesselI0(KAISER_ALPHA * std::sqrt(1.0f - t * t)) / BesselI0(KAISER_ALPHA);
+}
+
+// Source texels that make up each target texel along one axis, mTapCount per target texel.
+// Texels past the edges are clamped, unused taps have a weight of 0.
+struct FilterTaps
+{
+    uint32_t mTapCount = 0;
+    std::vector<uint32_t> mIndices;
+    std::vector<float> mWeights;
+};
+
+static FilterTaps BuildFilterTaps(MipFilter filter, uint32_t sourceSize, uint32_t targetSize)
+{
+    const float scale = static_cast<float>(sourceSize) / static_cast<float>(targetSize);
+    const float support = filter == MipFilter::BOX ? 0.5f * scale : KAISER_RADIUS * scale;
+    FilterTaps taps;
+    for (uint32_t i = 0; i < targetSize; i++)
+    {
+        const float center = (i + 0.5f) * scale;
+        const int first = static_cast<int>(std::floor(center - support));
+        const int last = static_cast<int>(std::ceil(center + support)) - 1;
+        taps.mTapCount = std::max<uint32_t>(taps.mTapCount, last - first + 1);
+    }
+    taps.mIndices.resize(static_cast<size_t>(targetSize) * taps.mTapCount);
+    taps.mWeights.resize(taps.mIndices.size());
+    for (uint32_t i = 0; i < targetSize; i++)
+    {
+        const float center = (i + 0.5f) * scale;
+        const int first = static_cast<int>(std::floor(center - support));
+        uint32_t *indices = taps.mIndices.data() + static_cast<size_t>(i) * taps.mTapCount;
+        float *weights = taps.mWeights.data() + static_cast<size_t>(i) * taps.mTapCount;
+        float sum = 0.0f;
+        for (uint32_t k = 0; k < taps.mTapCount; k++)
+        {
+            const int texel = first + static_cast<int>(k);
+            float weight;
+            if (filter == MipFilter::BOX)
+            {
+                // How much of the texel lies inside the target texel's footprint
+                weight = std::max(0.0f, std::min(texel + 1.0f, center + support) - std::max(static_cast<float>(texel), center - support));
+            }
+            else
+            {
+                weight = KaiserFilter((texel + 0.5f - center) / scale);
+            }
+            indices[k] = static_cast<uint32_t>(std::clamp(texel, 0, static_cast<int>(sourceSize) - 1));
+            weights[k] = weight;
+            sum += weight;
+        }
+        for (uint32_t k = 0; k < taps.mTapCount; k++)
+        {
+            weights[k] /= sum;
+        }
+    }
+    return taps;
+}
+
+// Filters count RGBA texels along a row, each output texel a weighted sum of input texels
+static void FilterRowHorizontal(const float *source, const FilterTaps &taps, float *target, uint32_t count)
+{
+    for (uint32_t i = 0; i < count; i++)
+    {
+        const uint32_t *indices = taps.mIndices.data() + static_cast<size_t>(i) * taps.mTapCount;
+        const float *weights = taps.mWeights.data() + static_cast<size_t>(i) * taps.mTapCount;
+#ifdef MIP_GENERATOR_SSE2
+        __m128 sum = _mm_setzero_ps();
+        for (uint32_t k = 0; k < taps.mTapCount; k++)
+        {
+            sum = _mm_add_ps(sum, _mm_mul_ps(_mm_loadu_ps(source + indices[k] * 4), _mm_set1_ps(weights[k])));
+        }
+        _mm_storeu_ps(target + i * 4, sum);
+#else
+        float sum[4] = {};
+        for (uint32_t k = 0; k < taps.mTapCount; k++)
+        {
+            for (uint32_t c = 0; c < 4; c++)
+            {
+                sum[c] += source[indices[k] * 4 + c] * weights[k];
+            }
+        }
+        std::memcpy(target + i * 4, sum, sizeof(sum));
+#endif
+    }
+}
+
+// Sums whole rows, count floats each. Negative lobes can push values below zero, which no
+// texel should have.
+static void FilterRowsVertical(const float *const *rows, const float *weights, uint32_t tapCount, float *target, uint32_t count)
+{
+    uint32_t i = 0;
+#ifdef MIP_GENERATOR_SSE2
+    const __m128 zero = _mm_setzero_ps();
+    for (; i + 4 <= count; i += 4)
+    {
+        __m128 sum = zero;
+        for (uint32_t k = 0; k < tapCount; k++)
+        {
+            sum = _mm_add_ps(sum, _mm_mul_ps(_mm_loadu_ps(rows[k] + i), _mm_set1_ps(weights[k])));
+        }
+        _mm_storeu_ps(target + i, _mm_max_ps(sum, zero));
+    }
+#endif
+    for (; i < count; i++)
+    {
+        float sum = 0.0f;
+        for (uint32_t k = 0; k < tapCount; k++)
+        {
+            sum += rows[k][i] * weights[k];
+        }
+        target[i] = std::max(sum, 0.0f);
+    }
+}
+
+// Downsamples one RGBA float level into the next, rows first, then columns
+static void FilterLevel(const float *source, uint32_t sourceWidth, uint32_t sourceHeight, MipFilter filter, float *target, uint32_t targetWidth, uint32_t targetHeight)
+{
+    const FilterTaps horizontal = BuildFilterTaps(filter, sourceWidth, targetWidth);
+    const FilterTaps vertical = BuildFilterTaps(filter, sourceHeight, targetHeight);
+    std::vector<float> rows(static_cast<size_t>(targetWidth) * sourceHeight * 4);
+    const size_t rowPitch = static_cast<size_t>(targetWidth) * 4;
+
+    ParallelFor(0, sourceHeight, std::max<size_t>(1, MIP_FILTER_GRAIN / sourceWidth), [&](size_t rowBegin, size_t rowEnd)
+                {
+        for (size_t row = rowBegin; row < rowEnd; row++)
+        {
+            FilterRowHorizontal(source + row * sourceWidth * 4, horizontal, rows.data() + row * rowPitch, targetWidth);
+        } });
+    ParallelFor(0, targetHeight, std::max<size_t>(1, MIP_FILTER_GRAIN / (static_cast<size_t>(targetWidth) * vertical.mTapCount)), [&](size_t rowBegin, size_t rowEnd)
+                {
+        std::vector<const float *> tapRows(vertical.mTapCount);
+        for (size_t row = rowBegin; row < rowEnd; row++)
+        {
+            for (uint32_t k = 0; k < vertical.mTapCount; k++)
+            {
+                tapRows[k] = rows.data() + vertical.mIndices[row * vertical.mTapCount + k] * rowPitch;
+            }
+            FilterRowsVertical(tapRows.data(), vertical.mWeights.data() + row * vertical.mTapCount, vertical.mTapCount, target + row * rowPitch, static_cast<uint32_t>(rowPitch));
+        } });
+}
+
+// Applies a transfer function to the color channels of a level, alpha stays as it is
+template <typename Function>
+static void TransformColors(float *rgba, size_t pixelCount, Function function)
+{
+    ParallelFor(0, pixelCount, MIP_FILTER_GRAIN, [&](size_t begin, size_t end)
+                {
+        for (size_t i = begin; i < end; i++)
+        {
+            rgba[i * 4] = function(rgba[i * 4]);
+            rgba[i * 4 + 1] = function(rgba[i * 4 + 1]);
+            rgba[i * 4 + 2] = function(rgba[i * 4 + 2]);
+        } });
+}
+
+bool GenerateMips(const Image &source, const MipGenerationSettings &settings, Image &target)
+{
+    if (source.mFormat == PixelFormat::UNKNOWN || IsCompressedFormat(source.mFormat))
+    {
+        HLOG_ERROR("Generating mips of %s images is not supported\n", GetPixelFormatInfo(source.mFormat).mName);
+        return false;
+    }
+    const uint32_t maxLevels = GetMaxMipLevels(source.mWidth, source.mHeight);
+    const uint32_t mipLevels = settings.mMaxLevels == 0 ? maxLevels : std::min(settings.mMaxLevels, maxLevels);
+    std::span<const uint8_t> topLevel = GetMipData(source, 0);
+
+    // The whole chain in linear RGBA floats, the top level decoded from the source
+    Image top;
+    top.mWidth = source.mWidth;
+    top.mHeight = source.mHeight;
+    top.mFormat = source.mFormat;
+    top.mIsSRGB = source.mIsSRGB;
+    top.mData.assign(topLevel.begin(), topLevel.end());
+    Image chain;
+    if (!ConvertImage(top, PixelFormat::RGBA32F, chain))
+        return false;
+    chain.mMipLevels = mipLevels;
+    chain.mData.resize(GetImageDataSize(PixelFormat::RGBA32F, source.mWidth, source.mHeight, mipLevels));
+    auto levelTexels = [&chain](uint32_t level)
+    {
+        return reinterpret_cast<float *>(GetMipData(chain, level).data());
+    };
+    const size_t topPixels = static_cast<size_t>(source.mWidth) * source.mHeight;
+    if (source.mIsSRGB)
+    {
+        if (source.mFormat == PixelFormat::R8 || source.mFormat == PixelFormat::RG8 || source.mFormat == PixelFormat::RGBA8)
+        {
+            // 8-bit values, a table covers all of them
+            float table[256];
+            for (uint32_t i = 0; i < 256; i++)
+            {
+                table[i] = SrgbToLinear(i / 255.0f);
+            }
+            TransformColors(levelTexels(0), topPixels, [&table](float value)
+                            { return table[static_cast<uint32_t>(value * 255.0f + 0.5f)]; });
+        }
+        else
+        {
+            TransformColors(levelTexels(0), topPixels, SrgbToLinear);
+        }
+    }
+
+    for (uint32_t level = 1; level < mipLevels; level++)
+    {
+        FilterLevel(levelTexels(level - 1), GetMipSize(source.mWidth, level - 1), GetMipSize(source.mHeight, level - 1), settings.mFilter,
+                    levelTexels(level), GetMipSize(source.mWidth, level), GetMipSize(source.mHeight, level));
+    }
+    if (source.mIsSRGB)
+    {
+        for (uint32_t level = 1; level < mipLevels; level++)
+        {
+            TransformColors(levelTexels(level), static_cast<size_t>(GetMipSize(source.mWidth, level)) * GetMipSize(source.mHeight, level), LinearToSrgb);
+        }
+    }
+
+    Image result;
+    if (!ConvertImage(chain, source.mFormat, result))
+        return false;
+    // The top level is kept bit for bit
+    std::span<uint8_t> resultTop = GetMipData(result, 0);
+    std::copy(topLevel.begin(), topLevel.end(), resultTop.begin());
+    target = std::move(result);
+    return true;
+}
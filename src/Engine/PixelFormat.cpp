@@ -0,0 +1,328 @@
+#include "Common/pch.h"
+#include "Engine/PixelFormat.h"
+#include "Engine/Parallel.h"
+#include <cmath>
+#include <cstring>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define PIXEL_FORMAT_SSE2 1
+#include <emmintrin.h>
+#endif
+// MSVC has no F16C switch of its own, /arch:AVX2 implies it
+#if defined(__F16C__) || defined(__AVX2__)
+#define PIXEL_FORMAT_F16C 1
+#include <immintrin.h>
+#endif
+
+// Number of pixels converted per job
+static constexpr size_t PIXEL_CONVERT_GRAIN = 64 * 1024;
+
+static const PixelFormatInfo formatInfos[] = {
+    {"Unknown", 1, 0, 0},
+    {"R8", 1, 1, 1},
+    {"RG8", 1, 2, 2},
+    {"RGBA8", 1, 4, 4},
+    {"RGBA16F", 1, 8, 4},
+    {"RGBA32F", 1, 16, 4},
+    {"BC1", 4, 8, 4},
+    {"BC3", 4, 16, 4},
+    {"BC5", 4, 16, 2},
+    {"BC7", 4, 16, 4},
+};
+static_assert(std::size(formatInfos) == static_cast<size_t>(PixelFormat::COUNT));
+
+const PixelFormatInfo &GetPixelFormatInfo(PixelFormat format)
+{
+    HASSERT(format < PixelFormat::COUNT);
+    return formatInfos[static_cast<size_t>(format)];
+}
+
+uint64_t GetImageRowPitch(PixelFormat format, uint32_t width)
+{
+    const PixelFormatInfo &info = GetPixelFormatInfo(format);
+    return static_cast<uint64_t>((width + info.mBlockSize - 1) / info.mBlockSize) * info.mBytesPerBlock;
+}
+
+uint64_t GetImageDataSize(PixelFormat format, uint32_t width, uint32_t height, uint32_t mipLevels)
+{
+    const uint32_t blockSize = GetPixelFormatInfo(format).mBlockSize;
+    uint64_t size = 0;
+    for (uint32_t level = 0; level < mipLevels; level++)
+    {
+        const uint32_t levelHeight = GetMipSize(height, level);
+        size += GetImageRowPitch(format, GetMipSize(width, level)) * ((levelHeight + blockSize - 1) / blockSize);
+    }
+    return size;
+}
+
+uint32_t GetMaxMipLevels(uint32_t width, uint32_t height)
+{
+    uint32_t levels = 1;
+    for (uint32_t size = std::max(width, height); size > 1; size >>= 1)
+    {
+        levels++;
+    }
+    return levels;
+}
+
+std::span<const uint8_t> GetMipData(const Image &image, uint32_t level)
+{
+    HASSERT(level < image.mMipLevels);
+    const uint64_t offset = GetImageDataSize(image.mFormat, image.mWidth, image.mHeight, level);
+    const uint64_t size = GetImageDataSize(image.mFormat, GetMipSize(image.mWidth, level), GetMipSize(image.mHeight, level));
+    HASSERT(offset + size <= image.mData.size());
+    return {image.mData.data() + offset, static_cast<size_t>(size)};
+}
+
+std::span<uint8_t> GetMipData(Image &image, uint32_t level)
+{
+    std::span<const uint8_t> data = GetMipData(static_cast<const Image &>(image), level);
+    return {const_cast<uint8_t *>(data.data()), data.size()};
+}
+
+uint16_t FloatToHalf(float value)
+{
+    uint32_t bits;
+    std::memcpy(&bits, &value, sizeof(bits));
+    const uint16_t sign = static_cast<uint16_t>((bits >> 16) & 0x8000);
+    const uint32_t magnitude = bits & 0x7FFFFFFF;
+    // Inf and NaN, NaN keeps a quiet bit
+    if (magnitude >= 0x7F800000)
+        return sign | 0x7C00 | (magnitude > 0x7F800000 ? 0x200 : 0);
+    // 65520 and up round to infinity
+    if (magnitude >= 0x477FF000)
+        return sign | 0x7C00;
+    // Below 2^-14 the result is subnormal, values under 2^-25 round to zero
+    if (magnitude < 0x38800000)
+    {
+        if (magnitude <= 0x33000000)
+            return sign;
+        const uint32_t shift = 126 - (magnitude >> 23);
+        const uint32_t mantissa = (magnitude & 0x7FFFFF) | 0x800000;
+        uint32_t half = mantissa >> shift;
+        const uint32_t remainder = mantissa & ((1u << shift) - 1);
+        const uint32_t halfway = 1u << (shift - 1);
+        if (remainder > halfway || (remainder == halfway && (half & 1)))
+            half++;
+        return sign | static_cast<uint16_t>(half);
+    }
+    // Rebias the exponent from 127 to 15 and round the mantissa to nearest even, a carry
+    // correctly moves into the exponent
+    uint32_t half = (magnitude - 0x38000000) >> 13;
+    const uint32_t remainder = magnitude & 0x1FFF;
+    if (remainder > 0x1000 || (remainder == 0x1000 && (half & 1)))
+        half++;
+    return sign | static_cast<uint16_t>(half);
+}
+
+float HalfToFloat(uint16_t value)
+{
+    const uint32_t sign = static_cast<uint32_t>(value & 0x8000) << 16;
+    const uint32_t exponent = (value >> 10) & 0x1F;
+    const uint32_t mantissa = value & 0x3FF;
+    uint32_t bits;
+    if (exponent == 0)
+    {
+        // Zero or subnormal, mantissa * 2^-24
+        float magnitude = static_cast<float>(mantissa) * 5.9604644775390625e-8f;
+        std::memcpy(&bits, &magnitude, sizeof(bits));
+        bits |= sign;
+    }
+    else if (exponent == 31)
+    {
+        bits = sign | 0x7F800000 | (mantissa << 13);
+    }
+    else
+    {
+        bits = sign | ((exponent + 112) << 23) | (mantissa << 13);
+    }
+    float result;
+    std::memcpy(&result, &bits, sizeof(result));
+    return result;
+}
+
+static constexpr float UNORM8_SCALE = 1.0f / 255.0f;
+
+static uint8_t EncodeUnorm8(float value)
+{
+    // NaN ends up as 0, like the SSE path
+    value = value > 0.0f ? std::min(value, 1.0f) : 0.0f;
+    return static_cast<uint8_t>(std::nearbyint(value * 255.0f));
+}
+
+// Expands count pixels into RGBA floats
+static void DecodeRow(PixelFormat format, const uint8_t *source, float *rgba, uint32_t count)
+{
+    uint32_t i = 0;
+    switch (format)
+    {
+    case PixelFormat::R8:
+        for (; i < count; i++)
+        {
+            rgba[i * 4] = source[i] * UNORM8_SCALE;
+            rgba[i * 4 + 1] = 0.0f;
+            rgba[i * 4 + 2] = 0.0f;
+            rgba[i * 4 + 3] = 1.0f;
+        }
+        break;
+    case PixelFormat::RG8:
+        for (; i < count; i++)
+        {
+            rgba[i * 4] = source[i * 2] * UNORM8_SCALE;
+            rgba[i * 4 + 1] = source[i * 2 + 1] * UNORM8_SCALE;
+            rgba[i * 4 + 2] = 0.0f;
+            rgba[i * 4 + 3] = 1.0f;
+        }
+        break;
+    case PixelFormat::RGBA8:
+#ifdef PIXEL_FORMAT_SSE2
+    {
+        const __m128 scale = _mm_set1_ps(UNORM8_SCALE);
+        const __m128i zero = _mm_setzero_si128();
+        for (; i + 4 <= count; i += 4)
+        {
+            __m128i bytes = _mm_loadu_si128(reinterpret_cast<const __m128i *>(source + i * 4));
+            __m128i low = _mm_unpacklo_epi8(bytes, zero);
+            __m128i high = _mm_unpackhi_epi8(bytes, zero);
+            _mm_storeu_ps(rgba + i * 4, _mm_mul_ps(_mm_cvtepi32_ps(_mm_unpacklo_epi16(low, zero)), scale));
+            _mm_storeu_ps(rgba + i * 4 + 4, _mm_mul_ps(_mm_cvtepi32_ps(_mm_unpackhi_epi16(low, zero)), scale));
+            _mm_storeu_ps(rgba + i * 4 + 8, _mm_mul_ps(_mm_cvtepi32_ps(_mm_unpacklo_epi16(high, zero)), scale));
+            _mm_storeu_ps(rgba + i * 4 + 12, _mm_mul_ps(_mm_cvtepi32_ps(_mm_unpackhi_epi16(high, zero)), scale));
+        }
+    }
+#endif
+        for (i *= 4; i < count * 4; i++)
+        {
+            rgba[i] = source[i] * UNORM8_SCALE;
+        }
+        break;
+    case PixelFormat::RGBA16F:
+    {
+        const uint16_t *halves = reinterpret_cast<const uint16_t *>(source);
+#ifdef PIXEL_FORMAT_F16C
+        for (; i < count; i++)
+        {
+            _mm_storeu_ps(rgba + i * 4, _mm_cvtph_ps(_mm_loadl_epi64(reinterpret_cast<const __m128i *>(halves + i * 4))));
+        }
+#endif
+        for (i *= 4; i < count * 4; i++)
+        {
+            rgba[i] = HalfToFloat(halves[i]);
+        }
+        break;
+    }
+    case PixelFormat::RGBA32F:
+        std::memcpy(rgba, source, count * 4 * sizeof(float));
+        break;
+    default:
+        HASSERT_LOG(false, "Pixel format can't be decoded");
+    }
+}
+
+static void EncodeRow(PixelFormat format, const float *rgba, uint8_t *target, uint32_t count)
+{
+    uint32_t i = 0;
+    switch (format)
+    {
+    case PixelFormat::R8:
+        for (; i < count; i++)
+        {
+            target[i] = EncodeUnorm8(rgba[i * 4]);
+        }
+        break;
+    case PixelFormat::RG8:
+        for (; i < count; i++)
+        {
+            target[i * 2] = EncodeUnorm8(rgba[i * 4]);
+            target[i * 2 + 1] = EncodeUnorm8(rgba[i * 4 + 1]);
+        }
+        break;
+    case PixelFormat::RGBA8:
+#ifdef PIXEL_FORMAT_SSE2
+    {
+        const __m128 zero = _mm_setzero_ps();
+        const __m128 one = _mm_set1_ps(1.0f);
+        const __m128 scale = _mm_set1_ps(255.0f);
+        auto encode = [&](const float *values)
+        {
+            // max returns its second operand for NaN, which maps NaN to 0
+            return _mm_cvtps_epi32(_mm_mul_ps(_mm_min_ps(_mm_max_ps(_mm_loadu_ps(values), zero), one), scale));
+        };
+        for (; i + 4 <= count; i += 4)
+        {
+            __m128i low = _mm_packs_epi32(encode(rgba + i * 4), encode(rgba + i * 4 + 4));
+            __m128i high = _mm_packs_epi32(encode(rgba + i * 4 + 8), encode(rgba + i * 4 + 12));
+            _mm_storeu_si128(reinterpret_cast<__m128i *>(target + i * 4), _mm_packus_epi16(low, high));
+        }
+    }
+#endif
+        for (i *= 4; i < count * 4; i++)
+        {
+            target[i] = EncodeUnorm8(rgba[i]);
+        }
+        break;
+    case PixelFormat::RGBA16F:
+    {
+        uint16_t *halves = reinterpret_cast<uint16_t *>(target);
+#ifdef PIXEL_FORMAT_F16C
+        for (; i < count; i++)
+        {
+            _mm_storel_epi64(reinterpret_cast<__m128i *>(halves + i * 4), _mm_cvtps_ph(_mm_loadu_ps(rgba + i * 4), _MM_FROUND_TO_NEAREST_INT));
+        }
+#endif
+        for (i *= 4; i < count * 4; i++)
+        {
+            halves[i] = FloatToHalf(rgba[i]);
+        }
+        break;
+    }
+    case PixelFormat::RGBA32F:
+        std::memcpy(target, rgba, count * 4 * sizeof(float));
+        break;
+    default:
+        HASSERT_LOG(false, "Pixel format can't be encoded");
+    }
+}
+
+bool ConvertImage(const Image &source, PixelFormat format, Image &target)
+{
+    if (source.mFormat == PixelFormat::UNKNOWN || format == PixelFormat::UNKNOWN || IsCompressedFormat(source.mFormat) || IsCompressedFormat(format))
+    {
+        HLOG_ERROR("Converting %s images to %s is not supported\n", GetPixelFormatInfo(source.mFormat).mName, GetPixelFormatInfo(format).mName);
+        return false;
+    }
+    HASSERT(source.mData.size() >= GetImageDataSize(source.mFormat, source.mWidth, source.mHeight, source.mMipLevels));
+    // Built on the side, source and target may be the same image
+    Image result;
+    result.mWidth = source.mWidth;
+    result.mHeight = source.mHeight;
+    result.mFormat = format;
+    result.mMipLevels = source.mMipLevels;
+    result.mIsSRGB = source.mIsSRGB;
+    if (format == source.mFormat)
+    {
+        result.mData = source.mData;
+        target = std::move(result);
+        return true;
+    }
+    result.mData.resize(GetImageDataSize(format, source.mWidth, source.mHeight, source.mMipLevels));
+    for (uint32_t level = 0; level < source.mMipLevels; level++)
+    {
+        const uint32_t width = GetMipSize(source.mWidth, level);
+        const uint8_t *sourceLevel = GetMipData(source, level).data();
+        uint8_t *targetLevel = GetMipData(result, level).data();
+        const uint64_t sourcePitch = GetImageRowPitch(source.mFormat, width);
+        const uint64_t targetPitch = GetImageRowPitch(format, width);
+        const size_t rowsPerJob = std::max<size_t>(1, PIXEL_CONVERT_GRAIN / std::max(width, 1u));
+        ParallelFor(0, GetMipSize(source.mHeight, level), rowsPerJob, [&](size_t rowBegin, size_t rowEnd)
+                    {
+            std::vector<float> rgba(static_cast<size_t>(width) * 4);
+            for (size_t row = rowBegin; row < rowEnd; row++)
+            {
+                DecodeRow(source.mFormat, sourceLevel + row * sourcePitch, rgba.data(), width);
+                EncodeRow(format, rgba.data(), targetLevel + row * targetPitch, width);
+            } });
+    }
+    target = std::move(result);
+    return true;
+}
@@ -0,0 +1,877 @@
+#include "Common/pch.h"
+#include "Engine/TextureCompressor.h"
+#include "Engine/Parallel.h"
+#include <cmath>
+#include <cstring>
+#include <limits>
+
+#if defined(__AVX2__)
+#define TEXTURE_COMPRESSOR_AVX2 1
+#include <immintrin.h>
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define TEXTURE_COMPRESSOR_SSE2 1
+#include <emmintrin.h>
+#endif
+
+// Blocks encoded per job
+static constexpr uint32_t COMPRESS_BLOCK_GRAIN = 256;
+
+// 4x4 texels as 0-255 floats, one array per channel so the kernels load 4 or 8 texels at once
+struct alignas(32) BlockTexels
+{
+    float mChannels[4][16];
+};
+
+// Entries hold the channels the palette is for, starting at 0
+struct BlockPalette
+{
+    float mEntries[16][4];
+    uint32_t mSize = 0;
+};
+
+// The two ends of the line the palette is interpolated along
+struct BlockEndpoints
+{
+    float mColors[2][4] = {};
+};
+
+struct BlockBitWriter
+{
+    uint8_t *mData;
+    uint32_t mPosition = 0;
+
+    void Write(uint32_t value, uint32_t bits)
+    {
+        for (uint32_t i = 0; i < bits; i++, mPosition++)
+        {
+            mData[mPosition >> 3] |= static_cast<uint8_t>(((value >> i) & 1) << (mPosition & 7));
+        }
+    }
+};
+
+struct BlockBitReader
+{
+    const uint8_t *mData;
+    uint32_t mPosition = 0;
+
+    uint32_t Read(uint32_t bits)
+    {
+        uint32_t value = 0;
+        for (uint32_t i = 0; i < bits; i++, mPosition++)
+        {
+            value |= static_cast<uint32_t>((mData[mPosition >> 3] >> (mPosition & 7)) & 1) << i;
+        }
+        return value;
+    }
+};
+
+static float Clamp255(float value)
+{
+    return std::min(std::max(value, 0.0f), 255.0f);
+}
+
+// Picks the closest palette entry for every texel, returns the summed squared error. This is
+// where encoding spends its time, so it compares 8 or 4 texels against an entry at once.
+static float FindClosestEntries(const BlockTexels &block, uint32_t firstChannel, uint32_t channelCount, const BlockPalette &palette, uint8_t indices[16])
+{
+#if defined(TEXTURE_COMPRESSOR_AVX2)
+    __m256 total = _mm256_setzero_ps();
+    for (uint32_t texel = 0; texel < 16; texel += 8)
+    {
+        __m256 bestError = _mm256_set1_ps(std::numeric_limits<float>::max());
+        __m256i bestIndex = _mm256_setzero_si256();
+        for (uint32_t k = 0; k < palette.mSize; k++)
+        {
+            __m256 error = _mm256_setzero_ps();
+            for (uint32_t c = 0; c < channelCount; c++)
+            {
+                __m256 diff = _mm256_sub_ps(_mm256_load_ps(&block.mChannels[firstChannel + c][texel]), _mm256_set1_ps(palette.mEntries[k][c]));
+                error = _mm256_add_ps(error, _mm256_mul_ps(diff, diff));
+            }
+            __m256 isCloser = _mm256_cmp_ps(error, bestError, _CMP_LT_OQ);
+            bestError = _mm256_min_ps(error, bestError);
+            bestIndex = _mm256_blendv_epi8(bestIndex, _mm256_set1_epi32(static_cast<int>(k)), _mm256_castps_si256(isCloser));
+        }
+        total = _mm256_add_ps(total, bestError);
+        alignas(32) int32_t lanes[8];
+        _mm256_store_si256(reinterpret_cast<__m256i *>(lanes), bestIndex);
+        for (uint32_t i = 0; i < 8; i++)
+        {
+            indices[texel + i] = static_cast<uint8_t>(lanes[i]);
+        }
+    }
+    alignas(32) float sums[8];
+    _mm256_store_ps(sums, total);
+    return sums[0] + sums[1] + sums[2] + sums[3] + sums[4] + sums[5] + sums[6] + sums[7];
+#elif defined(TEXTURE_COMPRESSOR_SSE2)
+    __m128 total = _mm_setzero_ps();
+    for (uint32_t texel = 0; texel < 16; texel += 4)
+    {
+        __m128 bestError = _mm_set1_ps(std::numeric_limits<float>::max());
+        __m128i bestIndex = _mm_setzero_si128();
+        for (uint32_t k = 0; k < palette.mSize; k++)
+        {
+            __m128 error = _mm_setzero_ps();
+            for (uint32_t c = 0; c < channelCount; c++)
+            {
+                __m128 diff = _mm_sub_ps(_mm_load_ps(&block.mChannels[firstChannel + c][texel]), _mm_set1_ps(palette.mEntries[k][c]));
+                error = _mm_add_ps(error, _mm_mul_ps(diff, diff));
+            }
+            __m128i isCloser = _mm_castps_si128(_mm_cmplt_ps(error, bestError));
+            bestError = _mm_min_ps(error, bestError);
+            bestIndex = _mm_or_si128(_mm_and_si128(isCloser, _mm_set1_epi32(static_cast<int>(k))), _mm_andnot_si128(isCloser, bestIndex));
+        }
+        total = _mm_add_ps(total, bestError);
+        alignas(16) int32_t lanes[4];
+        _mm_store_si128(reinterpret_cast<__m128i *>(lanes), bestIndex);
+        for (uint32_t i = 0; i < 4; i++)
+        {
+            indices[texel + i] = static_cast<uint8_t>(lanes[i]);
+        }
+    }
+    alignas(16) float sums[4];
+    _mm_store_ps(sums, total);
+    return sums[0] + sums[1] + sums[2] + sums[3];
+#else
+    float total = 0.0f;
+    for (uint32_t texel = 0; texel < 16; texel++)
+    {
+        float bestError = std::numeric_limits<float>::max();
+        for (uint32_t k = 0; k < palette.mSize; k++)
+        {
+            float error = 0.0f;
+            for (uint32_t c = 0; c < channelCount; c++)
+            {
+                float diff = block.mChannels[firstChannel + c][texel] - palette.mEntries[k][c];
+                error += diff * diff;
+            }
+            if (error < bestError)
+            {
+                bestError = error;
+                indices[texel] = static_cast<uint8_t>(k);
+            }
+        }
+        total += bestError;
+    }
+    return total;
+#endif
+}
+
+// Per channel minimum and maximum. Channels that fall while the first one rises are flipped,
+// so the box diagonal follows the colors.
+static BlockEndpoints BoundingBoxEndpoints(const BlockTexels &block, uint32_t firstChannel, uint32_t channelCount)
+{
+    BlockEndpoints endpoints;
+    float mean[4] = {};
+    for (uint32_t c = 0; c < channelCount; c++)
+    {
+        const float *values = block.mChannels[firstChannel + c];
+        endpoints.mColors[0][c] = *std::min_element(values, values + 16);
+        endpoints.mColors[1][c] = *std::max_element(values, values + 16);
+        for (uint32_t i = 0; i < 16; i++)
+        {
+            mean[c] += values[i] / 16.0f;
+        }
+    }
+    for (uint32_t c = 1; c < channelCount; c++)
+    {
+        float covariance = 0.0f;
+        for (uint32_t i = 0; i < 16; i++)
+        {
+            covariance += (block.mChannels[firstChannel][i] - mean[0]) * (block.mChannels[firstChannel + c][i] - mean[c]);
+        }
+        if (covariance < 0.0f)
+        {
+            std::swap(endpoints.mColors[0][c], endpoints.mColors[1][c]);
+        }
+    }
+    return endpoints;
+}
+
+// The extent of the texels along the direction of largest variance
+static BlockEndpoints PrincipalAxisEndpoints(const BlockTexels &block, uint32_t firstChannel, uint32_t channelCount)
+{
+    float mean[4] = {};
+    for (uint32_t c = 0; c < channelCount; c++)
+    {
+        for (uint32_t i = 0; i < 16; i++)
+        {
+            mean[c] += block.mChannels[firstChannel + c][i];
+        }
+        mean[c] /= 16.0f;
+    }
+    float covariance[4][4] = {};
+    for (uint32_t i = 0; i < 16; i++)
+    {
+        for (uint32_t a = 0; a < channelCount; a++)
+        {
+            for (uint32_t b = 0; b < channelCount; b++)
+            {
+                covariance[a][b] += (block.mChannels[firstChannel + a][i] - mean[a]) * (block.mChannels[firstChannel + b][i] - mean[b]);
+            }
+        }
+    }
+    // Power iteration, starting from the channel that varies most
+    uint32_t widest = 0;
+    for (uint32_t c = 1; c < channelCount; c++)
+    {
+        if (covariance[c][c] > covariance[widest][widest])
+            widest = c;
+    }
+    float axis[4] = {};
+    std::memcpy(axis, covariance[widest], sizeof(axis));
+    for (int iteration = 0; iteration < 8; iteration++)
+    {
+        float next[4] = {};
+        float length = 0.0f;
+        for (uint32_t a = 0; a < channelCount; a++)
+        {
+            for (uint32_t b = 0; b < channelCount; b++)
+            {
+                next[a] += covariance[a][b] * axis[b];
+            }
+            length += next[a] * next[a];
+        }
+        if (length < 1e-12f)
+            break;
+        length = 1.0f / std::sqrt(length);
+        for (uint32_t c = 0; c < channelCount; c++)
+        {
+            axis[c] = next[c] * length;
+        }
+    }
+
+    float lowest = 0.0f, highest = 0.0f;
+    for (uint32_t i = 0; i < 16; i++)
+    {
+        float t = 0.0f;
+        for (uint32_t c = 0; c < channelCount; c++)
+        {
+            t += (block.mChannels[firstChannel + c][i] - mean[c]) * axis[c];
+        }
+        lowest = std::min(lowest, t);
+        highest = std::max(highest, t);
+    }
+    BlockEndpoints endpoints;
+    for (uint32_t c = 0; c < channelCount; c++)
+    {
+        endpoints.mColors[0][c] = Clamp255(mean[c] + lowest * axis[c]);
+        endpoints.mColors[1][c] = Clamp255(mean[c] + highest * axis[c]);
+    }
+    return endpoints;
+}
+
+static BlockEndpoints InitialEndpoints(const BlockTexels &block, uint32_t firstChannel, uint32_t channelCount, TextureCompressionQuality quality)
+{
+    return quality == TextureCompressionQuality::FAST ? BoundingBoxEndpoints(block, firstChannel, channelCount)
+                                                      : PrincipalAxisEndpoints(block, firstChannel, channelCount);
+}
+
+static uint32_t GetRefinementCount(TextureCompressionQuality quality)
+{
+    static const uint32_t counts[] = {0, 1, 4};
+    return counts[static_cast<uint32_t>(quality)];
+}
+
+// Least squares endpoints for texels at the given weights between the two, false when all
+// weights are the same and the endpoints can't be told apart
+static bool RefineEndpoints(const BlockTexels &block, uint32_t firstChannel, uint32_t channelCount, const float weights[16], BlockEndpoints &endpoints)
+{
+    float aa = 0.0f, ab = 0.0f, bb = 0.0f;
+    for (uint32_t i = 0; i < 16; i++)
+    {
+        aa += (1.0f - weights[i]) * (1.0f - weights[i]);
+        ab += (1.0f - weights[i]) * weights[i];
+        bb += weights[i] * weights[i];
+    }
+    const float determinant = aa * bb - ab * ab;
+    if (std::abs(determinant) < 1e-6f)
+        return false;
+    for (uint32_t c = 0; c < channelCount; c++)
+    {
+        float a = 0.0f, b = 0.0f;
+        for (uint32_t i = 0; i < 16; i++)
+        {
+            a += (1.0f - weights[i]) * block.mChannels[firstChannel + c][i];
+            b += weights[i] * block.mChannels[firstChannel + c][i];
+        }
+        endpoints.mColors[0][c] = Clamp255((bb * a - ab * b) / determinant);
+        endpoints.mColors[1][c] = Clamp255((aa * b - ab * a) / determinant);
+    }
+    return true;
+}
+
+static uint16_t QuantizeRgb565(const float *rgb)
+{
+    uint32_t r = static_cast<uint32_t>(std::lround(rgb[0] * 31.0f / 255.0f));
+    uint32_t g = static_cast<uint32_t>(std::lround(rgb[1] * 63.0f / 255.0f));
+    uint32_t b = static_cast<uint32_t>(std::lround(rgb[2] * 31.0f / 255.0f));
+    return static_cast<uint16_t>((r << 11) | (g << 5) | b);
+}
+
+static void ExpandRgb565(uint16_t color, int rgb[3])
+{
+    const int r = (color >> 11) & 31, g = (color >> 5) & 63, b = color & 31;
+    rgb[0] = (r << 3) | (r >> 2);
+    rgb[1] = (g << 2) | (g >> 4);
+    rgb[2] = (b << 3) | (b >> 2);
+}
+
+// Four colors from c0 to c1, in the order of their distance to c0
+static void BuildBc1Palette(uint16_t c0, uint16_t c1, BlockPalette &palette)
+{
+    int a[3], b[3];
+    ExpandRgb565(c0, a);
+    ExpandRgb565(c1, b);
+    for (uint32_t c = 0; c < 3; c++)
+    {
+        palette.mEntries[0][c] = static_cast<float>(a[c]);
+        palette.mEntries[1][c] = static_cast<float>((2 * a[c] + b[c]) / 3);
+        palette.mEntries[2][c] = static_cast<float>((a[c] + 2 * b[c]) / 3);
+        palette.mEntries[3][c] = static_cast<float>(b[c]);
+    }
+    palette.mSize = 4;
+}
+
+static void EncodeBc1Colors(const BlockTexels &block, TextureCompressionQuality quality, uint8_t *out)
+{
+    static const uint8_t indexFromOrder[4] = {0, 2, 3, 1};
+    BlockEndpoints endpoints = InitialEndpoints(block, 0, 3, quality);
+    uint16_t c0 = QuantizeRgb565(endpoints.mColors[0]);
+    uint16_t c1 = QuantizeRgb565(endpoints.mColors[1]);
+    uint16_t best[2] = {c0, c1};
+    uint8_t bestIndices[16] = {};
+    float bestError = std::numeric_limits<float>::max();
+    for (uint32_t refinement = 0;; refinement++)
+    {
+        BlockPalette palette;
+        BuildBc1Palette(c0, c1, palette);
+        uint8_t indices[16];
+        float error = FindClosestEntries(block, 0, 3, palette, indices);
+        if (error < bestError)
+        {
+            bestError = error;
+            best[0] = c0;
+            best[1] = c1;
+            std::memcpy(bestIndices, indices, sizeof(indices));
+        }
+        if (refinement == GetRefinementCount(quality))
+            break;
+        float weights[16];
+        for (uint32_t i = 0; i < 16; i++)
+        {
+            weights[i] = indices[i] / 3.0f;
+        }
+        if (!RefineEndpoints(block, 0, 3, weights, endpoints))
+            break;
+        uint16_t next[2] = {QuantizeRgb565(endpoints.mColors[0]), QuantizeRgb565(endpoints.mColors[1])};
+        if (next[0] == c0 && next[1] == c1)
+            break;
+        c0 = next[0];
+        c1 = next[1];
+    }
+
+    // Four color mode needs c0 > c1, equal endpoints leave a single color
+    if (best[0] < best[1])
+    {
+        std::swap(best[0], best[1]);
+        for (uint8_t &index : bestIndices)
+        {
+            index = 3 - index;
+        }
+    }
+    uint32_t bits = 0;
+    for (uint32_t i = 0; i < 16; i++)
+    {
+        bits |= static_cast<uint32_t>(best[0] == best[1] ? 0 : indexFromOrder[bestIndices[i]]) << (2 * i);
+    }
+    out[0] = static_cast<uint8_t>(best[0]);
+    out[1] = static_cast<uint8_t>(best[0] >> 8);
+    out[2] = static_cast<uint8_t>(best[1]);
+    out[3] = static_cast<uint8_t>(best[1] >> 8);
+    for (uint32_t i = 0; i < 4; i++)
+    {
+        out[4 + i] = static_cast<uint8_t>(bits >> (8 * i));
+    }
+}
+
+// Eight values from a0 to a1, in the order of their distance to a0
+static void BuildBc4Palette(int a0, int a1, BlockPalette &palette)
+{
+    for (int k = 0; k < 8; k++)
+    {
+        palette.mEntries[k][0] = static_cast<float>(((7 - k) * a0 + k * a1 + 3) / 7);
+    }
+    palette.mSize = 8;
+}
+
+// One channel, also the alpha of BC3 and each half of BC5
+static void EncodeBc4Block(const BlockTexels &block, uint32_t channel, TextureCompressionQuality quality, uint8_t *out)
+{
+    static const uint8_t indexFromOrder[8] = {0, 2, 3, 4, 5, 6, 7, 1};
+    const float *values = block.mChannels[channel];
+    // The eight value mode needs a0 > a1
+    BlockEndpoints endpoints;
+    endpoints.mColors[0][0] = *std::max_element(values, values + 16);
+    endpoints.mColors[1][0] = *std::min_element(values, values + 16);
+    int a0 = static_cast<int>(std::lround(endpoints.mColors[0][0]));
+    int a1 = static_cast<int>(std::lround(endpoints.mColors[1][0]));
+    std::memset(out, 0, 8);
+    if (a0 == a1)
+    {
+        // Every index 0 is a0
+        out[0] = static_cast<uint8_t>(a0);
+        out[1] = static_cast<uint8_t>(a1);
+        return;
+    }
+    int best[2] = {a0, a1};
+    uint8_t bestIndices[16] = {};
+    float bestError = std::numeric_limits<float>::max();
+    for (uint32_t refinement = 0;; refinement++)
+    {
+        BlockPalette palette;
+        BuildBc4Palette(a0, a1, palette);
+        uint8_t indices[16];
+        float error = FindClosestEntries(block, channel, 1, palette, indices);
+        if (error < bestError)
+        {
+            bestError = error;
+            best[0] = a0;
+            best[1] = a1;
+            std::memcpy(bestIndices, indices, sizeof(indices));
+        }
+        if (refinement == GetRefinementCount(quality))
+            break;
+        float weights[16];
+        for (uint32_t i = 0; i < 16; i++)
+        {
+            weights[i] = indices[i] / 7.0f;
+        }
+        if (!RefineEndpoints(block, channel, 1, weights, endpoints))
+            break;
+        int next[2] = {static_cast<int>(std::lround(endpoints.mColors[0][0])), static_cast<int>(std::lround(endpoints.mColors[1][0]))};
+        if (next[0] <= next[1] || (next[0] == a0 && next[1] == a1))
+            break;
+        a0 = next[0];
+        a1 = next[1];
+    }
+    out[0] = static_cast<uint8_t>(best[0]);
+    out[1] = static_cast<uint8_t>(best[1]);
+    uint64_t bits = 0;
+    for (uint32_t i = 0; i < 16; i++)
+    {
+        bits |= static_cast<uint64_t>(indexFromOrder[bestIndices[i]]) << (3 * i);
+    }
+    for (uint32_t i = 0; i < 6; i++)
+    {
+        out[2 + i] = static_cast<uint8_t>(bits >> (8 * i));
+    }
+}
+
+static const uint8_t BC7_WEIGHTS4[16] = {0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64};
+
+// Mode 6 endpoint, 7 bits per channel and a shared lowest bit
+struct Bc7Endpoint
+{
+    uint8_t mValues[4] = {};
+    uint8_t mPBit = 0;
+
+    int Expand(uint32_t channel) const
+    {
+        return (mValues[channel] << 1) | mPBit;
+    }
+};
+
+static Bc7Endpoint QuantizeBc7Endpoint(const float *color, uint8_t pBit)
+{
+    Bc7Endpoint endpoint;
+    endpoint.mPBit = pBit;
+    for (uint32_t c = 0; c < 4; c++)
+    {
+        endpoint.mValues[c] = static_cast<uint8_t>(std::clamp<long>(std::lround((color[c] - pBit) / 2.0f), 0, 127));
+    }
+    return endpoint;
+}
+
+// The p-bit that gets the endpoint closest to the color
+static Bc7Endpoint QuantizeBc7EndpointClosest(const float *color)
+{
+    Bc7Endpoint candidates[2] = {QuantizeBc7Endpoint(color, 0), QuantizeBc7Endpoint(color, 1)};
+    float errors[2] = {};
+    for (uint32_t p = 0; p < 2; p++)
+    {
+        for (uint32_t c = 0; c < 4; c++)
+        {
+            float diff = candidates[p].Expand(c) - color[c];
+            errors[p] += diff * diff;
+        }
+    }
+    return candidates[errors[1] < errors[0] ? 1 : 0];
+}
+
+static void BuildBc7Palette(const Bc7Endpoint &e0, const Bc7Endpoint &e1, BlockPalette &palette)
+{
+    for (uint32_t k = 0; k < 16; k++)
+    {
+        const int weight = BC7_WEIGHTS4[k];
+        for (uint32_t c = 0; c < 4; c++)
+        {
+            palette.mEntries[k][c] = static_cast<float>(((64 - weight) * e0.Expand(c) + weight * e1.Expand(c) + 32) >> 6);
+        }
+    }
+    palette.mSize = 16;
+}
+
+static void EncodeBc7Block(const BlockTexels &block, TextureCompressionQuality quality, uint8_t *out)
+{
+    BlockEndpoints endpoints = InitialEndpoints(block, 0, 4, quality);
+    Bc7Endpoint best[2];
+    uint8_t bestIndices[16] = {};
+    float bestError = std::numeric_limits<float>::max();
+    for (uint32_t refinement = 0;; refinement++)
+    {
+        Bc7Endpoint candidates[4][2];
+        uint32_t candidateCount = 0;
+        if (quality == TextureCompressionQuality::HIGH)
+        {
+            for (uint8_t p = 0; p < 4; p++)
+            {
+                candidates[candidateCount][0] = QuantizeBc7Endpoint(endpoints.mColors[0], p & 1);
+                candidates[candidateCount++][1] = QuantizeBc7Endpoint(endpoints.mColors[1], p >> 1);
+            }
+        }
+        else
+        {
+            candidates[0][0] = QuantizeBc7EndpointClosest(endpoints.mColors[0]);
+            candidates[candidateCount++][1] = QuantizeBc7EndpointClosest(endpoints.mColors[1]);
+        }
+        uint8_t roundIndices[16] = {};
+        float roundError = std::numeric_limits<float>::max();
+        for (uint32_t i = 0; i < candidateCount; i++)
+        {
+            BlockPalette palette;
+            BuildBc7Palette(candidates[i][0], candidates[i][1], palette);
+            uint8_t indices[16];
+            float error = FindClosestEntries(block, 0, 4, palette, indices);
+            if (error < roundError)
+            {
+                roundError = error;
+                std::memcpy(roundIndices, indices, sizeof(indices));
+            }
+            if (error < bestError)
+            {
+                bestError = error;
+                best[0] = candidates[i][0];
+                best[1] = candidates[i][1];
+                std::memcpy(bestIndices, indices, sizeof(indices));
+            }
+        }
+        if (refinement == GetRefinementCount(quality) || roundError > bestError)
+            break;
+        float weights[16];
+        for (uint32_t i = 0; i < 16; i++)
+        {
+            weights[i] = BC7_WEIGHTS4[roundIndices[i]] / 64.0f;
+        }
+        if (!RefineEndpoints(block, 0, 4, weights, endpoints))
+            break;
+    }
+
+    // The first index drops its top bit, so it has to be in the lower half
+    if (bestIndices[0] >= 8)
+    {
+        std::swap(best[0], best[1]);
+        for (uint8_t &index : bestIndices)
+        {
+            index = 15 - index;
+        }
+    }
+    std::memset(out, 0, 16);
+    BlockBitWriter writer{out};
+    writer.Write(1 << 6, 7);
+    for (uint32_t c = 0; c < 4; c++)
+    {
+        writer.Write(best[0].mValues[c], 7);
+        writer.Write(best[1].mValues[c], 7);
+    }
+    writer.Write(best[0].mPBit, 1);
+    writer.Write(best[1].mPBit, 1);
+    for (uint32_t i = 0; i < 16; i++)
+    {
+        writer.Write(bestIndices[i], i == 0 ? 3 : 4);
+    }
+}
+
+// Edge blocks repeat the last row and column
+static void LoadBlock(const uint8_t *rgba, uint32_t width, uint32_t height, uint32_t blockX, uint32_t blockY, BlockTexels &block)
+{
+    for (uint32_t y = 0; y < 4; y++)
+    {
+        const uint32_t row = std::min(blockY * 4 + y, height - 1);
+        for (uint32_t x = 0; x < 4; x++)
+        {
+            const uint32_t column = std::min(blockX * 4 + x, width - 1);
+            const uint8_t *texel = rgba + (static_cast<size_t>(row) * width + column) * 4;
+            for (uint32_t c = 0; c < 4; c++)
+            {
+                block.mChannels[c][y * 4 + x] = texel[c];
+            }
+        }
+    }
+}
+
+static void EncodeBlock(const BlockTexels &block, const TextureCompressionSettings &settings, uint8_t *out)
+{
+    switch (settings.mFormat)
+    {
+    case PixelFormat::BC1:
+        EncodeBc1Colors(block, settings.mQuality, out);
+        break;
+    case PixelFormat::BC3:
+        EncodeBc4Block(block, 3, settings.mQuality, out);
+        EncodeBc1Colors(block, settings.mQuality, out + 8);
+        break;
+    case PixelFormat::BC5:
+        EncodeBc4Block(block, 0, settings.mQuality, out);
+        EncodeBc4Block(block, 1, settings.mQuality, out + 8);
+        break;
+    case PixelFormat::BC7:
+        EncodeBc7Block(block, settings.mQuality, out);
+        break;
+    default:
+        HASSERT_LOG(false, "Not a block compressed format");
+    }
+}
+
+bool CompressImage(const Image &source, const TextureCompressionSettings &settings, Image &target)
+{
+    if (!IsCompressedFormat(settings.mFormat) || source.mFormat == PixelFormat::UNKNOWN || IsCompressedFormat(source.mFormat))
+    {
+        HLOG_ERROR("Compressing %s images to %s is not supported\n", GetPixelFormatInfo(source.mFormat).mName, GetPixelFormatInfo(settings.mFormat).mName);
+        return false;
+    }
+    const Image *rgba = &source;
+    Image converted;
+    if (source.mFormat != PixelFormat::RGBA8)
+    {
+        if (!ConvertImage(source, PixelFormat::RGBA8, converted))
+            return false;
+        rgba = &converted;
+    }
+    Image result;
+    result.mWidth = source.mWidth;
+    result.mHeight = source.mHeight;
+    result.mFormat = settings.mFormat;
+    result.mMipLevels = source.mMipLevels;
+    result.mIsSRGB = source.mIsSRGB;
+    result.mData.resize(GetImageDataSize(settings.mFormat, source.mWidth, source.mHeight, source.mMipLevels));
+    const uint32_t bytesPerBlock = GetPixelFormatInfo(settings.mFormat).mBytesPerBlock;
+    for (uint32_t level = 0; level < source.mMipLevels; level++)
+    {
+        const uint32_t width = GetMipSize(source.mWidth, level);
+        const uint32_t height = GetMipSize(source.mHeight, level);
+        const uint8_t *texels = GetMipData(*rgba, level).data();
+        uint8_t *blocks = GetMipData(result, level).data();
+        const uint32_t blocksX = (width + 3) / 4;
+        const uint32_t blocksY = (height + 3) / 4;
+        const size_t rowsPerJob = std::max<size_t>(1, COMPRESS_BLOCK_GRAIN / std::max(blocksX, 1u));
+        ParallelFor(0, blocksY, rowsPerJob, [&](size_t rowBegin, size_t rowEnd)
+                    {
+            BlockTexels block;
+            for (size_t blockY = rowBegin; blockY < rowEnd; blockY++)
+            {
+                for (uint32_t blockX = 0; blockX < blocksX; blockX++)
+                {
+                    LoadBlock(texels, width, height, blockX, static_cast<uint32_t>(blockY), block);
+                    EncodeBlock(block, settings, blocks + (blockY * blocksX + blockX) * bytesPerBlock);
+                }
+            } });
+    }
+    target = std::move(result);
+    return true;
+}
+
+static void DecodeBc1Colors(const uint8_t *in, bool hasAlphaMode, uint8_t texels[16][4])
+{
+    const uint16_t c0 = static_cast<uint16_t>(in[0] | (in[1] << 8));
+    const uint16_t c1 = static_cast<uint16_t>(in[2] | (in[3] << 8));
+    int a[3], b[3];
+    ExpandRgb565(c0, a);
+    ExpandRgb565(c1, b);
+    uint8_t palette[4][4] = {};
+    for (uint32_t c = 0; c < 3; c++)
+    {
+        palette[0][c] = static_cast<uint8_t>(a[c]);
+        palette[1][c] = static_cast<uint8_t>(b[c]);
+        if (c0 > c1 || !hasAlphaMode)
+        {
+            palette[2][c] = static_cast<uint8_t>((2 * a[c] + b[c]) / 3);
+            palette[3][c] = static_cast<uint8_t>((a[c] + 2 * b[c]) / 3);
+        }
+        else
+        {
+            palette[2][c] = static_cast<uint8_t>((a[c] + b[c]) / 2);
+        }
+    }
+    palette[0][3] = palette[1][3] = palette[2][3] = 255;
+    // Index 3 is transparent black in BC1's three color mode
+    palette[3][3] = (c0 > c1 || !hasAlphaMode) ? 255 : 0;
+    const uint32_t bits = in[4] | (in[5] << 8) | (in[6] << 16) | (static_cast<uint32_t>(in[7]) << 24);
+    for (uint32_t i = 0; i < 16; i++)
+    {
+        std::memcpy(texels[i], palette[(bits >> (2 * i)) & 3], 4);
+    }
+}
+
+static void DecodeBc4Block(const uint8_t *in, uint32_t channel, uint8_t texels[16][4])
+{
+    const int a0 = in[0], a1 = in[1];
+    uint8_t palette[8] = {static_cast<uint8_t>(a0), static_cast<uint8_t>(a1)};
+    if (a0 > a1)
+    {
+        for (int k = 1; k < 7; k++)
+        {
+            palette[k + 1] = static_cast<uint8_t>(((7 - k) * a0 + k * a1 + 3) / 7);
+        }
+    }
+    else
+    {
+        for (int k = 1; k < 5; k++)
+        {
+            palette[k + 1] = static_cast<uint8_t>(((5 - k) * a0 + k * a1 + 2) / 5);
+        }
+        palette[6] = 0;
+        palette[7] = 255;
+    }
+    uint64_t bits = 0;
+    for (uint32_t i = 0; i < 6; i++)
+    {
+        bits |= static_cast<uint64_t>(in[2 + i]) << (8 * i);
+    }
+    for (uint32_t i = 0; i < 16; i++)
+    {
+        texels[i][channel] = palette[(bits >> (3 * i)) & 7];
+    }
+}
+
+static bool DecodeBc7Block(const uint8_t *in, uint8_t texels[16][4])
+{
+    if ((in[0] & 0x7F) != 0x40)
+        return false;
+    BlockBitReader reader{in};
+    reader.Read(7);
+    Bc7Endpoint endpoints[2];
+    for (uint32_t c = 0; c < 4; c++)
+    {
+        endpoints[0].mValues[c] = static_cast<uint8_t>(reader.Read(7));
+        endpoints[1].mValues[c] = static_cast<uint8_t>(reader.Read(7));
+    }
+    endpoints[0].mPBit = static_cast<uint8_t>(reader.Read(1));
+    endpoints[1].mPBit = static_cast<uint8_t>(reader.Read(1));
+    for (uint32_t i = 0; i < 16; i++)
+    {
+        const int weight = BC7_WEIGHTS4[reader.Read(i == 0 ? 3 : 4)];
+        for (uint32_t c = 0; c < 4; c++)
+        {
+            texels[i][c] = static_cast<uint8_t>(((64 - weight) * endpoints[0].Expand(c) + weight * endpoints[1].Expand(c) + 32) >> 6);
+        }
+    }
+    return true;
+}
+
+// Writes one level of blocks out as RGBA8 texels, false if a block can't be decoded
+static bool DecompressLevel(PixelFormat format, const uint8_t *blocks, uint32_t width, uint32_t height, uint8_t *rgba)
+{
+    const uint32_t blocksX = (width + 3) / 4;
+    const uint32_t blocksY = (height + 3) / 4;
+    const uint32_t bytesPerBlock = GetPixelFormatInfo(format).mBytesPerBlock;
+    std::atomic<bool> isValid = true;
+    const size_t rowsPerJob = std::max<size_t>(1, COMPRESS_BLOCK_GRAIN / std::max(blocksX, 1u));
+    ParallelFor(0, blocksY, rowsPerJob, [&](size_t rowBegin, size_t rowEnd)
+                {
+        for (size_t blockY = rowBegin; blockY < rowEnd; blockY++)
+        {
+            for (uint32_t blockX = 0; blockX < blocksX; blockX++)
+            {
+                const uint8_t *in = blocks + (blockY * blocksX + blockX) * bytesPerBlock;
+                uint8_t texels[16][4] = {};
+                switch (format)
+                {
+                case PixelFormat::BC1:
+                    DecodeBc1Colors(in, true, texels);
+                    break;
+                case PixelFormat::BC3:
+                    DecodeBc1Colors(in + 8, false, texels);
+                    DecodeBc4Block(in, 3, texels);
+                    break;
+                case PixelFormat::BC5:
+                    DecodeBc4Block(in, 0, texels);
+                    DecodeBc4Block(in + 8, 1, texels);
+                    for (uint8_t *texel : texels)
+                    {
+                        texel[3] = 255;
+                    }
+                    break;
+                default:
+                    if (!DecodeBc7Block(in, texels))
+                    {
+                        isValid.store(false, std::memory_order_relaxed);
+                    }
+                }
+                for (uint32_t y = 0; y < 4 && blockY * 4 + y < height; y++)
+                {
+                    for (uint32_t x = 0; x < 4 && blockX * 4 + x < width; x++)
+                    {
+                        std::memcpy(rgba + ((blockY * 4 + y) * width + blockX * 4 + x) * 4, texels[y * 4 + x], 4);
+                    }
+                }
+            }
+        } });
+    return isValid.load(std::memory_order_relaxed);
+}
+
+bool DecompressImage(const Image &source, Image &target)
+{
+    if (!IsCompressedFormat(source.mFormat) || source.mData.size() < GetImageDataSize(source.mFormat, source.mWidth, source.mHeight, source.mMipLevels))
+    {
+        HLOG_ERROR("%s image can't be decompressed\n", GetPixelFormatInfo(source.mFormat).mName);
+        return false;
+    }
+    Image result;
+    result.mWidth = source.mWidth;
+    result.mHeight = source.mHeight;
+    result.mFormat = PixelFormat::RGBA8;
+    result.mMipLevels = source.mMipLevels;
+    result.mIsSRGB = source.mIsSRGB;
+    result.mData.resize(GetImageDataSize(PixelFormat::RGBA8, source.mWidth, source.mHeight, source.mMipLevels));
+    for (uint32_t level = 0; level < source.mMipLevels; level++)
+    {
+        if (!DecompressLevel(source.mFormat, GetMipData(source, level).data(), GetMipSize(source.mWidth, level), GetMipSize(source.mHeight, level), GetMipData(result, level).data()))
+        {
+            HLOG_ERROR("Only BC7 blocks in mode 6 can be decompressed\n");
+            return false;
+        }
+    }
+    target = std::move(result);
+    return true;
+}
+
+double ComputeImagePSNR(const Image &a, const Image &b, uint32_t channels)
+{
+    HASSERT(a.mFormat == PixelFormat::RGBA8 && b.mFormat == PixelFormat::RGBA8);
+    HASSERT(a.mWidth == b.mWidth && a.mHeight == b.mHeight && channels <= 4);
+    const size_t pixelCount = static_cast<size_t>(a.mWidth) * a.mHeight;
+    double squaredError = 0.0;
+    for (size_t i = 0; i < pixelCount; i++)
+    {
+        for (uint32_t c = 0; c < channels; c++)
+        {
+            double diff = static_cast<double>(a.mData[i * 4 + c]) - b.mData[i * 4 + c];
+            squaredError += diff * diff;
+        }
+    }
+    if (squaredError == 0.0)
+        return std::numeric_limits<double>::infinity();
+    const double meanSquaredError = squaredError / (static_cast<double>(pixelCount) * channels);
+    return 10.0 * std::log10(255.0 * 255.0 / meanSquaredError);
+}
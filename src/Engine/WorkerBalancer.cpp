@@ -0,0 +1,90 @@
+#include "Common/pch.h"
+#include "Engine/WorkerBalancer.h"
+
+WorkerBalancer::WorkerBalancer(const WorkerBalancePolicy &policy) : m_Policy(policy)
+{
+}
+
+void WorkerBalancer::SetPolicy(const WorkerBalancePolicy &policy)
+{
+    m_Policy = policy;
+}
+
+const WorkerBalancePolicy &WorkerBalancer::GetPolicy() const
+{
+    return m_Policy;
+}
+
+bool WorkerBalancer::Rebalance(std::span<JobPipeLine *const> pipeLines)
+{
+    struct Load
+    {
+        JobPipeLine *mPipeLine;
+        double mDrainSeconds;
+        uint32_t mWorkers;
+    };
+
+    const auto now = std::chrono::steady_clock::now();
+    const double targetDrainSeconds = m_Policy.mTargetDrainMicroseconds * 1e-6;
+    std::vector<Load> loads;
+    for (JobPipeLine *pipeLine : pipeLines)
+    {
+        uint64_t completed = pipeLine->GetCompletedJobCount();
+        auto [it, inserted] = m_Samples.try_emplace(pipeLine);
+        Sample previous = it->second;
+        it->second.mCompleted = completed;
+        it->second.mTime = now;
+        if (inserted)
+            continue;
+
+        double seconds = std::chrono::duration<double>(now - previous.mTime).count();
+        double rate = seconds > 0.0 ? (completed - previous.mCompleted) / seconds : 0.0;
+        size_t queued = pipeLine->GetQueuedJobCount();
+        double drainSeconds = 0.0;
+        if (queued > 0)
+        {
+            drainSeconds = rate > 0.0 ? queued / rate : std::numeric_limits<double>::infinity();
+        }
+        loads.push_back({pipeLine, drainSeconds, pipeLine->GetWorkerCount()});
+    }
+
+    const Load *receiver = nullptr;
+    for (const Load &load : loads)
+    {
+        if (load.mDrainSeconds > targetDrainSeconds && load.mWorkers < load.mPipeLine->GetMaxWorkers() &&
+            (receiver == nullptr || load.mDrainSeconds > receiver->mDrainSeconds))
+        {
+            receiver = &load;
+        }
+    }
+    if (receiver == nullptr)
+        return false;
+
+    // Only take from pipelines that would keep up comfortably with one worker less
+    const Load *donor = nullptr;
+    for (const Load &load : loads)
+    {
+        if (&load != receiver && load.mDrainSeconds < targetDrainSeconds * 0.5 && load.mWorkers > load.mPipeLine->GetMinWorkers() &&
+            (donor == nullptr || load.mDrainSeconds < donor->mDrainSeconds))
+        {
+            donor = &load;
+        }
+    }
+    if (donor == nullptr)
+        return false;
+
+    UniquePtr<Worker> worker;
+    if (!donor->mPipeLine->TransferOutWorker(worker))
+        return false;
+    if (!receiver->mPipeLine->TransferInWorker(worker))
+    {
+        donor->mPipeLine->TransferInWorker(worker);
+        return false;
+    }
+    return true;
+}
+
+void WorkerBalancer::Forget(JobPipeLine *pipeLine)
+{
+    m_Samples.erase(pipeLine);
+}
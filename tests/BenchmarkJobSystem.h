@@ -0,0 +1,314 @@
+#pragma once
+#include <gtest/gtest.h>
+#include <atomic>
+#include <chrono>
+#include "Engine/JobSystem.h"
+#include "Engine/Task.h"
+#include <ctime>
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#endif
+
+// Throughput of tiny jobs for 1..hardware_concurrency() workers. Each root job fans out
+// its share of the work from inside a worker, so the other workers have to steal it.
+inline double MeasureJobThroughput(uint32_t workerCount, uint32_t jobCount)
+{
+    JobPipeLine pipeLine(workerCount);
+    std::atomic<uint32_t> counter = 0;
+    const uint32_t rootCount = workerCount * 4;
+    const uint32_t jobsPerRoot = jobCount / rootCount;
+
+    auto start = std::chrono::steady_clock::now();
+    for (uint32_t i = 0; i < rootCount; i++)
+    {
+        auto root = std::make_unique<Job>([&pipeLine, &counter, jobsPerRoot]()
+                                          {
+            for (uint32_t j = 0; j < jobsPerRoot; j++)
+            {
+                auto job = std::make_unique<Job>([&counter]() { counter.fetch_add(1, std::memory_order_relaxed); });
+                pipeLine.PushJob(job);
+            } });
+        pipeLine.PushJob(root);
+    }
+    pipeLine.WaitIdle();
+    auto end = std::chrono::steady_clock::now();
+
+    EXPECT_EQ(counter.load(), rootCount * jobsPerRoot);
+    double seconds = std::chrono::duration<double>(end - start).count();
+    return (rootCount * (jobsPerRoot + 1)) / seconds;
+}
+
+TEST(JobSystemBenchmark, WorkStealingScaling)
+{
+    const uint32_t maxWorkers = std::max(std::thread::hardware_concurrency(), 1u);
+    std::vector<uint32_t> workerCounts;
+    for (uint32_t workers = 1; workers < maxWorkers; workers *= 2)
+    {
+        workerCounts.push_back(workers);
+    }
+    workerCounts.push_back(maxWorkers);
+
+    for (uint32_t jobCount : {10000u, 100000u, 1000000u})
+    {
+        double baseline = 0.0;
+        for (uint32_t workers : workerCounts)
+        {
+            double jobsPerSecond = MeasureJobThroughput(workers, jobCount);
+            if (workers == 1)
+                baseline = jobsPerSecond;
+            printf("[JobSystemBenchmark] jobs: %7u workers: %3u throughput: %12.0f jobs/s speedup: %5.2fx\n",
+                   jobCount, workers, jobsPerSecond, jobsPerSecond / baseline);
+        }
+    }
+}
+
+// Many threads injecting into one pipeline at once, one job per call or in batches
+inline double MeasureSubmitThroughput(uint32_t producerCount, uint32_t jobsPerProducer, uint32_t batchSize)
+{
+    JobPipeLine pipeLine(std::max(std::thread::hardware_concurrency(), 1u));
+    std::atomic<uint32_t> counter = 0;
+    std::atomic<bool> go = false;
+    std::vector<std::thread> producers;
+    for (uint32_t p = 0; p < producerCount; p++)
+    {
+        producers.emplace_back([&]()
+                               {
+            std::vector<UniquePtr<Job>> batch(batchSize);
+            while (!go.load(std::memory_order_acquire))
+                std::this_thread::yield();
+            for (uint32_t i = 0; i < jobsPerProducer; i += batchSize)
+            {
+                for (auto &job : batch)
+                {
+                    job = std::make_unique<Job>([&counter]() { counter.fetch_add(1, std::memory_order_relaxed); });
+                }
+                if (batchSize == 1)
+                    pipeLine.PushJob(batch[0]);
+                else
+                    pipeLine.PushJobs(batch);
+            } });
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    go.store(true, std::memory_order_release);
+    for (auto &producer : producers)
+    {
+        producer.join();
+    }
+    pipeLine.WaitIdle();
+    auto end = std::chrono::steady_clock::now();
+
+    uint32_t expected = producerCount * ((jobsPerProducer + batchSize - 1) / batchSize) * batchSize;
+    EXPECT_EQ(counter.load(), expected);
+    return expected / std::chrono::duration<double>(end - start).count();
+}
+
+TEST(JobSystemBenchmark, SubmitContention)
+{
+    const uint32_t producerCount = std::max(std::thread::hardware_concurrency(), 8u);
+    const uint32_t jobsPerProducer = 100000;
+    for (uint32_t batchSize : {1u, 16u, 64u})
+    {
+        double jobsPerSecond = MeasureSubmitThroughput(producerCount, jobsPerProducer, batchSize);
+        printf("[JobSystemBenchmark] producers: %3u batch: %3u throughput: %12.0f jobs/s\n",
+               producerCount, batchSize, jobsPerSecond);
+    }
+}
+
+// Load -> decode -> upload chains of small steps. The future version blocks the calling
+// thread on every step, the coroutine version keeps all chains in flight on the workers.
+inline uint64_t SimulateAssetStep(uint64_t value)
+{
+    for (int i = 0; i < 256; i++)
+        value = value * 6364136223846793005ull + 1442695040888963407ull;
+    return value;
+}
+
+inline Task<uint64_t> LoadAssetAsync(uint64_t seed)
+{
+    co_await ScheduleOn();
+    uint64_t data = SimulateAssetStep(seed);
+    co_await ScheduleOn();
+    data = SimulateAssetStep(data);
+    co_await ScheduleOn();
+    co_return SimulateAssetStep(data);
+}
+
+TEST(JobSystemBenchmark, CoroutineVersusFuture)
+{
+    const uint32_t assetCount = 10000;
+    JobSystem *jobSystem = JobSystem::CreateJobSystem();
+
+    uint64_t futureChecksum = 0;
+    auto start = std::chrono::steady_clock::now();
+    for (uint32_t i = 0; i < assetCount; i++)
+    {
+        uint64_t data = i;
+        for (int step = 0; step < 3; step++)
+        {
+            auto job = std::make_unique<Job>(nullptr);
+            std::future<uint64_t> result = job->BindOperation(SimulateAssetStep, data);
+            jobSystem->SubmitJob(job);
+            data = result.get();
+        }
+        futureChecksum += data;
+    }
+    double futureSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    std::vector<Task<uint64_t>> tasks;
+    tasks.reserve(assetCount);
+    start = std::chrono::steady_clock::now();
+    for (uint32_t i = 0; i < assetCount; i++)
+    {
+        tasks.push_back(LoadAssetAsync(i));
+    }
+    SyncWaitAll<uint64_t>(tasks);
+    double taskSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    uint64_t taskChecksum = 0;
+    for (Task<uint64_t> &task : tasks)
+    {
+        taskChecksum += task.TakeResult();
+    }
+    EXPECT_EQ(taskChecksum, futureChecksum);
+    printf("[JobSystemBenchmark] asset chains: %u future: %8.2f ms coroutine: %8.2f ms speedup: %5.2fx\n",
+           assetCount, futureSeconds * 1000.0, taskSeconds * 1000.0, futureSeconds / taskSeconds);
+    JobSystem::DestroyJobSystem(jobSystem);
+}
+
+inline double GetProcessCpuSeconds()
+{
+#ifdef _WIN32
+    FILETIME creationTime, exitTime, kernelTime, userTime;
+    GetProcessTimes(GetCurrentProcess(), &creationTime, &exitTime, &kernelTime, &userTime);
+    auto toSeconds = [](const FILETIME &time)
+    { return ((uint64_t(time.dwHighDateTime) << 32) | time.dwLowDateTime) * 1e-7; };
+    return toSeconds(kernelTime) + toSeconds(userTime);
+#else
+    return double(std::clock()) / CLOCKS_PER_SEC;
+#endif
+}
+
+struct WakeLatencyResult
+{
+    double mP50Microseconds;
+    double mP99Microseconds;
+    double mIdleCpuPercent;
+};
+
+// Time from PushJob to the job starting, with gap of nothing to do between jobs, then the
+// CPU the idle workers burn while nothing is submitted at all
+inline WakeLatencyResult MeasureWakeLatency(const WorkerIdlePolicy &policy, std::chrono::microseconds gap, uint32_t samples)
+{
+    using Clock = std::chrono::steady_clock;
+    const uint32_t workerCount = std::max(std::thread::hardware_concurrency() / 2, 1u);
+    JobPipeLine pipeLine(workerCount);
+    pipeLine.SetIdlePolicy(policy);
+    std::vector<double> latencies;
+    latencies.reserve(samples);
+    for (uint32_t i = 0; i < samples; i++)
+    {
+        auto resume = Clock::now() + gap;
+        while (Clock::now() < resume)
+        {
+        }
+        std::atomic<int64_t> started = 0;
+        auto submitted = Clock::now();
+        auto job = std::make_unique<Job>([&started]()
+                                         { started.store(Clock::now().time_since_epoch().count(), std::memory_order_release); });
+        pipeLine.PushJob(job);
+        while (started.load(std::memory_order_acquire) == 0)
+        {
+            std::this_thread::yield();
+        }
+        auto latency = Clock::duration(started.load()) - submitted.time_since_epoch();
+        latencies.push_back(std::chrono::duration<double, std::micro>(latency).count());
+    }
+    std::sort(latencies.begin(), latencies.end());
+
+    const auto idleTime = std::chrono::milliseconds(200);
+    double cpuStart = GetProcessCpuSeconds();
+    std::this_thread::sleep_for(idleTime);
+    double cpuSeconds = GetProcessCpuSeconds() - cpuStart;
+
+    WakeLatencyResult result;
+    result.mP50Microseconds = latencies[latencies.size() / 2];
+    result.mP99Microseconds = latencies[latencies.size() * 99 / 100];
+    result.mIdleCpuPercent = 100.0 * cpuSeconds / std::chrono::duration<double>(idleTime).count();
+    return result;
+}
+
+TEST(JobSystemBenchmark, WakeLatency)
+{
+    WorkerIdlePolicy parkImmediately;
+    parkImmediately.mSpinMicroseconds = 0;
+    parkImmediately.mYieldMicroseconds = 0;
+    WorkerIdlePolicy spinThenPark;
+    for (auto gap : {std::chrono::microseconds(20), std::chrono::microseconds(2000)})
+    {
+        for (WorkerIdlePolicy *policy : {&parkImmediately, &spinThenPark})
+        {
+            WakeLatencyResult result = MeasureWakeLatency(*policy, gap, 500);
+            printf("[JobSystemBenchmark] spin: %4u us yield: %4u us gap: %5lld us wake p50: %8.2f us p99: %8.2f us idle cpu: %5.1f%%\n",
+                   policy->mSpinMicroseconds, policy->mYieldMicroseconds, static_cast<long long>(gap.count()),
+                   result.mP50Microseconds, result.mP99Microseconds, result.mIdleCpuPercent);
+        }
+    }
+}
+
+// Start latency of periodic probe jobs while another thread floods the pipeline with low
+// priority work. A probe on the flood's level waits behind it, a higher level one does not.
+inline std::vector<double> MeasureProbeLatency(uint8_t probePriority, uint32_t floodJobs, uint32_t probes)
+{
+    using Clock = std::chrono::steady_clock;
+    JobPipeLine pipeLine(std::max(std::thread::hardware_concurrency(), 1u));
+    std::atomic<bool> flooding = true;
+    std::thread flood([&]()
+                      {
+        std::vector<UniquePtr<Job>> batch(64);
+        for (uint32_t i = 0; i < floodJobs; i += 64)
+        {
+            for (auto &job : batch)
+            {
+                job = std::make_unique<Job>([]() { SimulateAssetStep(1); }, UINT_MAX, JOB_PRIORITY_LOW);
+            }
+            pipeLine.PushJobs(batch);
+        }
+        flooding.store(false); });
+
+    std::vector<double> latencies;
+    while (flooding.load() && latencies.size() < probes)
+    {
+        std::atomic<int64_t> started = 0;
+        auto submitted = Clock::now();
+        auto probe = std::make_unique<Job>([&started]()
+                                           { started.store(Clock::now().time_since_epoch().count()); },
+                                           UINT_MAX, probePriority);
+        pipeLine.PushJob(probe);
+        while (started.load() == 0)
+        {
+            std::this_thread::yield();
+        }
+        auto latency = Clock::duration(started.load()) - submitted.time_since_epoch();
+        latencies.push_back(std::chrono::duration<double, std::micro>(latency).count());
+        std::this_thread::sleep_for(std::chrono::microseconds(200));
+    }
+    flood.join();
+    pipeLine.WaitIdle();
+    std::sort(latencies.begin(), latencies.end());
+    return latencies;
+}
+
+TEST(JobSystemBenchmark, PriorityLatencyUnderFlood)
+{
+    for (uint8_t priority : {JOB_PRIORITY_LOW, JOB_PRIORITY_CRITICAL})
+    {
+        std::vector<double> latencies = MeasureProbeLatency(priority, 200000, 200);
+        ASSERT_FALSE(latencies.empty());
+        printf("[JobSystemBenchmark] probe priority: %3u probes: %3zu start latency p50: %10.2f us p99: %10.2f us\n",
+               priority, latencies.size(), latencies[latencies.size() / 2], latencies[latencies.size() * 99 / 100]);
+    }
+}
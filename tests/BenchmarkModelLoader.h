@@ -0,0 +1,173 @@
+#pragma once
+#include <gtest/gtest.h>
+#include "Engine/AssetLoader.h"
+#include "Engine/CookedMesh.h"
+#include <chrono>
+#include <cmath>
+#include <filesystem>
+#ifdef __linux__
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+// Grid of (size + 1)^2 vertices and 2 * size^2 triangles, with normals and texture coordinates
+inline std::string WriteGridObj(const std::string &name, uint32_t size)
+{
+    std::filesystem::path path = std::filesystem::temp_directory_path() / name;
+    std::ofstream file(path);
+    file << "o Grid\nvn 0 0 1\n";
+    for (uint32_t y = 0; y <= size; y++)
+    {
+        for (uint32_t x = 0; x <= size; x++)
+        {
+            file << "v " << x << " " << y << " 0\nvt " << float(x) / size << " " << float(y) / size << "\n";
+        }
+    }
+    for (uint32_t y = 0; y < size; y++)
+    {
+        for (uint32_t x = 0; x < size; x++)
+        {
+            uint32_t a = y * (size + 1) + x + 1, b = a + 1, c = a + size + 1, d = c + 1;
+            file << "f " << a << "/" << a << "/1 " << b << "/" << b << "/1 " << d << "/" << d << "/1\n";
+            file << "f " << a << "/" << a << "/1 " << d << "/" << d << "/1 " << c << "/" << c << "/1\n";
+        }
+    }
+    return path.string();
+}
+
+// Best effort, only Linux lets an unprivileged process drop a file from the page cache
+inline void DropFromPageCache(const std::string &path)
+{
+#ifdef __linux__
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd >= 0)
+    {
+        fdatasync(fd);
+        posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED);
+        close(fd);
+    }
+#endif
+}
+
+template <typename Function>
+inline double MeasureMilliseconds(Function &&function)
+{
+    auto start = std::chrono::steady_clock::now();
+    function();
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+TEST(ModelLoaderBenchmark, CookedVersusImported)
+{
+    JobSystem *jobSystem = JobSystem::CreateJobSystem();
+    // 2 * 707^2 = 999698 triangles
+    std::string objPath = WriteGridObj("ModelLoaderBenchmark.obj", 707);
+    std::string cookedPath = objPath + COOKED_MESH_EXTENSION;
+    ModelLoader loader;
+    ASSERT_TRUE(loader.Cook(objPath, cookedPath));
+    AssetRegistry<Model>::GetInstance().EvictUnused();
+
+    size_t importedIndices = 0;
+    size_t cookedIndices = 0;
+    uint64_t mappedChecksum = 0;
+    auto import = [&]()
+    {
+        AssetHandle<Model> model = loader.Load(objPath);
+        importedIndices = model->GetMeshes()[0].mIndices.size();
+    };
+    auto loadCooked = [&]()
+    {
+        AssetHandle<Model> model = loader.Load(cookedPath);
+        cookedIndices = model->GetMeshes()[0].mIndices.size();
+    };
+    // What an upload from the mapping costs, every index is read once
+    auto mapCooked = [&]()
+    {
+        CookedModel cooked;
+        ASSERT_TRUE(cooked.Open(cookedPath));
+        for (uint32_t index : cooked.GetMesh(0).mIndices)
+        {
+            mappedChecksum += index;
+        }
+    };
+    auto measure = [&](const char *name, const std::string &path, auto &&load)
+    {
+        DropFromPageCache(path);
+        double cold = MeasureMilliseconds(load);
+        AssetRegistry<Model>::GetInstance().EvictUnused();
+        double warm = MeasureMilliseconds(load);
+        AssetRegistry<Model>::GetInstance().EvictUnused();
+        printf("[ModelLoaderBenchmark] %-10s cold: %9.2f ms warm: %9.2f ms\n", name, cold, warm);
+        return warm;
+    };
+    double importMs = measure("importer", objPath, import);
+    double cookedMs = measure("cooked", cookedPath, loadCooked);
+    double mappedMs = measure("mapped", cookedPath, mapCooked);
+    printf("[ModelLoaderBenchmark] warm speedup cooked: %6.1fx mapped: %6.1fx\n", importMs / cookedMs, importMs / mappedMs);
+
+    EXPECT_EQ(cookedIndices, importedIndices);
+    EXPECT_GT(mappedChecksum, 0u);
+    JobSystem::DestroyJobSystem(jobSystem);
+    std::filesystem::remove(objPath);
+    std::filesystem::remove(cookedPath);
+}
+
+// Scene of meshCount separate objects, every one a grid of 2 * size^2 triangles
+inline std::string WriteMultiMeshObj(const std::string &name, uint32_t meshCount, uint32_t size)
+{
+    std::filesystem::path path = std::filesystem::temp_directory_path() / name;
+    std::ofstream file(path);
+    file << "vn 0 0 1\nvt 0 0\n";
+    uint32_t base = 0;
+    for (uint32_t m = 0; m < meshCount; m++)
+    {
+        file << "o Mesh" << m << "\n";
+        for (uint32_t y = 0; y <= size; y++)
+        {
+            for (uint32_t x = 0; x <= size; x++)
+            {
+                file << "v " << x << " " << y << " " << m << "\n";
+            }
+        }
+        for (uint32_t y = 0; y < size; y++)
+        {
+            for (uint32_t x = 0; x < size; x++)
+            {
+                uint32_t a = base + y * (size + 1) + x + 1, b = a + 1, c = a + size + 1, d = c + 1;
+                file << "f " << a << "/1/1 " << b << "/1/1 " << d << "/1/1\n";
+                file << "f " << a << "/1/1 " << d << "/1/1 " << c << "/1/1\n";
+            }
+        }
+        base += (size + 1) * (size + 1);
+    }
+    return path.string();
+}
+
+TEST(ModelLoaderBenchmark, MultiMeshImport)
+{
+    JobSystem *jobSystem = JobSystem::CreateJobSystem();
+    ModelLoader loader;
+    for (uint32_t meshCount : {4u, 64u})
+    {
+        // About 500k triangles per scene
+        const uint32_t size = static_cast<uint32_t>(std::sqrt(250000.0 / meshCount));
+        std::string path = WriteMultiMeshObj("ModelLoaderMultiMesh.obj", meshCount, size);
+        double milliseconds[2] = {};
+        for (bool isSerial : {true, false})
+        {
+            // Serial execution runs every mesh job on the loading thread
+            jobSystem->SetSerialExecution(isSerial);
+            milliseconds[isSerial ? 0 : 1] = MeasureMilliseconds([&]()
+                                                                 {
+                AssetHandle<Model> model = loader.Load(path);
+                ASSERT_EQ(model->GetMeshes().size(), meshCount);
+                EXPECT_EQ(model->GetMeshes()[0].mIndices.size(), size * size * 6u); });
+            AssetRegistry<Model>::GetInstance().EvictUnused();
+        }
+        jobSystem->SetSerialExecution(false);
+        printf("[ModelLoaderBenchmark] meshes: %3u triangles: %7u serial: %8.2f ms parallel: %8.2f ms speedup: %5.2fx\n",
+               meshCount, meshCount * size * size * 2, milliseconds[0], milliseconds[1], milliseconds[0] / milliseconds[1]);
+        std::filesystem::remove(path);
+    }
+    JobSystem::DestroyJobSystem(jobSystem);
+}
@@ -0,0 +1,51 @@
+#pragma once
+#include <gtest/gtest.h>
+#include "Engine/TextureCompressor.h"
+#include <chrono>
+
+// Gradients with some noise on top, so blocks aren't trivially flat
+inline Image MakeCompressorBenchmarkImage(uint32_t size)
+{
+    Image image;
+    image.mWidth = size;
+    image.mHeight = size;
+    image.mFormat = PixelFormat::RGBA8;
+    image.mData.resize(static_cast<size_t>(size) * size * 4);
+    uint32_t noise = 12345;
+    for (uint32_t y = 0; y < size; y++)
+    {
+        for (uint32_t x = 0; x < size; x++)
+        {
+            noise = noise * 1664525u + 1013904223u;
+            uint8_t *texel = image.mData.data() + (static_cast<size_t>(y) * size + x) * 4;
+            texel[0] = static_cast<uint8_t>((x * 255 / size + (noise >> 28)) & 0xFF);
+            texel[1] = static_cast<uint8_t>(y * 255 / size);
+            texel[2] = static_cast<uint8_t>(((x / 32 + y / 32) & 1) ? 200 : 30);
+            texel[3] = static_cast<uint8_t>(128 + (noise >> 26));
+        }
+    }
+    return image;
+}
+
+TEST(TextureCompressorBenchmark, ThroughputAndQuality)
+{
+    JobSystem *jobSystem = JobSystem::CreateJobSystem();
+    const uint32_t size = 1024;
+    Image source = MakeCompressorBenchmarkImage(size);
+    const char *qualityNames[] = {"fast", "normal", "high"};
+    for (PixelFormat format : {PixelFormat::BC1, PixelFormat::BC3, PixelFormat::BC5, PixelFormat::BC7})
+    {
+        const uint32_t channels = format == PixelFormat::BC1 ? 3 : format == PixelFormat::BC5 ? 2 : 4;
+        for (TextureCompressionQuality quality : {TextureCompressionQuality::FAST, TextureCompressionQuality::NORMAL, TextureCompressionQuality::HIGH})
+        {
+            Image compressed, decompressed;
+            auto start = std::chrono::steady_clock::now();
+            ASSERT_TRUE(CompressImage(source, {format, quality}, compressed));
+            double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+            ASSERT_TRUE(DecompressImage(compressed, decompressed));
+            printf("[TextureCompressorBenchmark] %s %-6s %8.2f MTexels/s PSNR: %6.2f dB\n", GetPixelFormatInfo(format).mName,
+                   qualityNames[static_cast<int>(quality)], size * size / seconds / 1e6, ComputeImagePSNR(source, decompressed, channels));
+        }
+    }
+    JobSystem::DestroyJobSystem(jobSystem);
+}
@@ -0,0 +1,154 @@
+#include "HeapAllocationCounter.h"
+#include <atomic>
+#include <cstdlib>
+#include <new>
+
+// Replacement operators have to live in exactly one translation unit, and every form is
+// replaced so that blocks are always freed by the allocator that made them
+static std::atomic<uint64_t> heapAllocationCount = 0;
+
+uint64_t GetHeapAllocationCount()
+{
+    return heapAllocationCount.load(std::memory_order_relaxed);
+}
+
+static void *Allocate(size_t size)
+{
+    heapAllocationCount.fetch_add(1, std::memory_order_relaxed);
+    return std::malloc(size ? size : 1);
+}
+
+static void *AllocateAligned(size_t size, std::align_val_t alignment)
+{
+    heapAllocationCount.fetch_add(1, std::memory_order_relaxed);
+    const size_t bytes = static_cast<size_t>(alignment);
+    size = size ? size : 1;
+#ifdef _WIN32
+    return _aligned_malloc(size, bytes);
+#else
+    // aligned_alloc wants a multiple of the alignment
+    return std::aligned_alloc(bytes, (size + bytes - 1) / bytes * bytes);
+#endif
+}
+
+static void Free(void *block) noexcept
+{
+    std::free(block);
+}
+
+static void FreeAligned(void *block) noexcept
+{
+#ifdef _WIN32
+    _aligned_free(block);
+#else
+    std::free(block);
+#endif
+}
+
+void *operator new(size_t size)
+{
+    if (void *block = Allocate(size))
+        return block;
+    throw std::bad_alloc();
+}
+
+void *operator new[](size_t size)
+{
+    if (void *block = Allocate(size))
+        return block;
+    throw std::bad_alloc();
+}
+
+void *operator new(size_t size, std::align_val_t alignment)
+{
+    if (void *block = AllocateAligned(size, alignment))
+        return block;
+    throw std::bad_alloc();
+}
+
+void *operator new[](size_t size, std::align_val_t alignment)
+{
+    if (void *block = AllocateAligned(size, alignment))
+        return block;
+    throw std::bad_alloc();
+}
+
+void *operator new(size_t size, const std::nothrow_t &) noexcept
+{
+    return Allocate(size);
+}
+
+void *operator new[](size_t size, const std::nothrow_t &) noexcept
+{
+    return Allocate(size);
+}
+
+void *operator new(size_t size, std::align_val_t alignment, const std::nothrow_t &) noexcept
+{
+    return AllocateAligned(size, alignment);
+}
+
+void *operator new[](size_t size, std::align_val_t alignment, const std::nothrow_t &) noexcept
+{
+    return AllocateAligned(size, alignment);
+}
+
+void operator delete(void *block) noexcept
+{
+    Free(block);
+}
+
+void operator delete[](void *block) noexcept
+{
+    Free(block);
+}
+
+void operator delete(void *block, size_t) noexcept
+{
+    Free(block);
+}
+
+void operator delete[](void *block, size_t) noexcept
+{
+    Free(block);
+}
+
+void operator delete(void *block, const std::nothrow_t &) noexcept
+{
+    Free(block);
+}
+
+void operator delete[](void *block, const std::nothrow_t &) noexcept
+{
+    Free(block);
+}
+
+void operator delete(void *block, std::align_val_t) noexcept
+{
+    FreeAligned(block);
+}
+
+void operator delete[](void *block, std::align_val_t) noexcept
+{
+    FreeAligned(block);
+}
+
+void operator delete(void *block, size_t, std::align_val_t) noexcept
+{
+    FreeAligned(block);
+}
+
+void operator delete[](void *block, size_t, std::align_val_t) noexcept
+{
+    FreeAligned(block);
+}
+
+void operator delete(void *block, std::align_val_t, const std::nothrow_t &) noexcept
+{
+    FreeAligned(block);
+}
+
+void operator delete[](void *block, std::align_val_t, const std::nothrow_t &) noexcept
+{
+    FreeAligned(block);
+}
@@ -0,0 +1,5 @@
+#pragma once
+#include <cstdint>
+
+// Number of global operator new calls made by the test binary so far, in every form
+uint64_t GetHeapAllocationCount();
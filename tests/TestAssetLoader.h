@@ -0,0 +1,229 @@
+#pragma once
+#include <gtest/gtest.h>
+#include "Engine/AssetLoader.h"
+#include <filesystem>
+
+inline std::string WriteTestObj(const std::string &name)
+{
+    std::filesystem::path path = std::filesystem::temp_directory_path() / name;
+    std::ofstream file(path);
+    file << "o First\n"
+            "v 0 0 0\nv 1 0 0\nv 0 1 0\nv 0 0 1\n"
+            "vn 0 0 1\n"
+            "vt 0 0\n"
+            "f 1/1/1 2/1/1 3/1/1\n"
+            "f 1/1/1 3/1/1 4/1/1\n"
+            "o Second\n"
+            "f 2/1/1 3/1/1 4/1/1\n";
+    return path.string();
+}
+
+// Binary PPM, every pixel has the given grey value
+inline std::string WriteTestPpm(const std::string &name, int width, int height, uint8_t value)
+{
+    std::filesystem::path path = std::filesystem::temp_directory_path() / name;
+    std::ofstream file(path, std::ios::binary);
+    file << "P6 " << width << " " << height << " 255\n";
+    std::vector<uint8_t> pixels(static_cast<size_t>(width) * height * 3, value);
+    file.write(reinterpret_cast<const char *>(pixels.data()), static_cast<std::streamsize>(pixels.size()));
+    return path.string();
+}
+
+// Binary PGM, one grey channel
+inline std::string WriteTestPgm(const std::string &name, int width, int height, uint8_t value)
+{
+    std::filesystem::path path = std::filesystem::temp_directory_path() / name;
+    std::ofstream file(path, std::ios::binary);
+    file << "P5 " << width << " " << height << " 255\n";
+    std::vector<uint8_t> pixels(static_cast<size_t>(width) * height, value);
+    file.write(reinterpret_cast<const char *>(pixels.data()), static_cast<std::streamsize>(pixels.size()));
+    return path.string();
+}
+
+// Uncompressed grey TGA with an alpha byte per pixel
+inline std::string WriteTestGreyAlphaTga(const std::string &name, int width, int height, uint8_t grey, uint8_t alpha)
+{
+    std::filesystem::path path = std::filesystem::temp_directory_path() / name;
+    std::ofstream file(path, std::ios::binary);
+    const uint8_t header[18] = {0, 0, 3, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+                                static_cast<uint8_t>(width), static_cast<uint8_t>(width >> 8),
+                                static_cast<uint8_t>(height), static_cast<uint8_t>(height >> 8), 16, 8};
+    file.write(reinterpret_cast<const char *>(header), sizeof(header));
+    for (int i = 0; i < width * height; ++i)
+    {
+        file.put(static_cast<char>(grey));
+        file.put(static_cast<char>(alpha));
+    }
+    return path.string();
+}
+
+TEST(AssetLoaderTest, CoalescesRequestsForTheSamePath) {
+    JobSystem *jobSystem = JobSystem::CreateJobSystem();
+    std::string path = WriteTestPpm("AssetLoaderShared.ppm", 8, 8, 51);
+    ImageLoader loader;
+    AssetRegistry<Image> &registry = AssetRegistry<Image>::GetInstance();
+    // Start from an empty cache, images of earlier tests would count against the budget
+    registry.EvictUnused();
+    // Serial execution holds the decode jobs back until somebody waits, so both requests
+    // are made while the first one is still in flight
+    jobSystem->SetSerialExecution(true);
+    AssetLoadHandle<Image> first = loader.ReadFileAsync(path, JOB_PRIORITY_LOW);
+    AssetLoadHandle<Image> second = loader.ReadFileAsync(path, JOB_PRIORITY_HIGH);
+    EXPECT_FALSE(first.IsDone());
+    ASSERT_TRUE(second.Wait());
+    ASSERT_TRUE(first.Wait());
+    EXPECT_EQ(&first.Get(), &second.Get());
+    EXPECT_EQ(first.Get().mWidth, 8u);
+    EXPECT_EQ(first.Get().mData[0], 51);
+    jobSystem->SetSerialExecution(false);
+
+    // Once loaded, requests share the registered asset without loading or copying it
+    AssetLoadHandle<Image> third = loader.ReadFileAsync(path);
+    EXPECT_TRUE(third.IsDone());
+    EXPECT_EQ(&third.Get(), &first.Get());
+    EXPECT_EQ(loader.Load(path).Get(), &first.Get());
+
+    // Unused assets stay cached within the budget, once evicted the next request loads it again
+    const uint64_t imageBytes = sizeof(Image) + first.Get().mData.capacity();
+    first = {};
+    second = {};
+    third = {};
+    EXPECT_TRUE(registry.Find(InternAssetPath(path)).IsValid());
+    EXPECT_EQ(registry.GetStats().mResidentBytes, imageBytes);
+    registry.EvictUnused();
+    EXPECT_FALSE(registry.Find(InternAssetPath(path)).IsValid());
+    AssetHandle<Image> reloaded = loader.Load(path);
+    ASSERT_TRUE(reloaded.IsValid());
+    EXPECT_EQ(reloaded->mWidth, 8u);
+    JobSystem::DestroyJobSystem(jobSystem);
+    std::filesystem::remove(path);
+}
+
+TEST(AssetLoaderTest, LoadsManyAssetsInParallel) {
+    JobSystem *jobSystem = JobSystem::CreateJobSystem();
+    std::string modelPath = WriteTestObj("AssetLoaderModel.obj");
+    std::vector<std::string> imagePaths;
+    ModelLoader modelLoader;
+    ImageLoader imageLoader;
+    AssetLoadHandle<Model> model = modelLoader.ReadFileAsync(modelPath, JOB_PRIORITY_HIGH);
+    std::vector<AssetLoadHandle<Image>> images;
+    for (int i = 0; i < 16; i++)
+    {
+        imagePaths.push_back(WriteTestPpm("AssetLoaderImage" + std::to_string(i) + ".ppm", 32 + i, 16, static_cast<uint8_t>(i * 10)));
+        images.push_back(imageLoader.ReadFileAsync(imagePaths.back(), i % 2 ? JOB_PRIORITY_LOW : JOB_PRIORITY_NORMAL));
+    }
+    AssetLoadHandle<Image> missing = imageLoader.ReadFileAsync(imagePaths.back() + ".missing");
+
+    ASSERT_TRUE(model.Wait());
+    ASSERT_EQ(model.Get().GetMeshes().size(), 2u);
+    EXPECT_FALSE(model.Get().GetMeshes()[0].mIndices.empty());
+    for (int i = 0; i < 16; i++)
+    {
+        ASSERT_TRUE(images[i].Wait());
+        EXPECT_EQ(images[i].Get().mWidth, static_cast<uint32_t>(32 + i));
+        EXPECT_EQ(images[i].Get().mData[0], i * 10);
+    }
+    EXPECT_FALSE(missing.Wait());
+    EXPECT_EQ(missing.GetStatus(), AssetLoadStatus::FAILED);
+    imageLoader.WaitIdle();
+    modelLoader.WaitIdle();
+    JobSystem::DestroyJobSystem(jobSystem);
+    std::filesystem::remove(modelPath);
+    for (const std::string &path : imagePaths)
+    {
+        std::filesystem::remove(path);
+    }
+}
+
+TEST(AssetLoaderTest, ModelStreamsMatchVertexCount) {
+    std::string path = WriteTestObj("AssetLoaderStreams.obj");
+    ModelLoader loader;
+    AssetHandle<Model> model = loader.Load(path);
+    ASSERT_TRUE(model.IsValid());
+    ASSERT_EQ(model->GetMeshes().size(), 2u);
+    // Every face corner of the file becomes its own vertex, each stream holds exactly one
+    // entry per vertex and each triangle three indices
+    const uint32_t numTriangles[2] = {2, 1};
+    for (size_t i = 0; i < 2; i++)
+    {
+        const Mesh &mesh = model->GetMeshes()[i];
+        EXPECT_EQ(mesh.mVertices.size(), numTriangles[i] * 3u);
+        EXPECT_EQ(mesh.mNormals.size(), mesh.mVertices.size());
+        ASSERT_EQ(mesh.mTexCoordsArray.size(), 1u);
+        EXPECT_EQ(mesh.mTexCoordsArray[0].size(), mesh.mVertices.size());
+        EXPECT_EQ(mesh.mIndices.size(), numTriangles[i] * 3u);
+        for (uint32_t index : mesh.mIndices)
+        {
+            EXPECT_LT(index, mesh.mVertices.size());
+        }
+    }
+    // The second object is the triangle 2 3 4 with normal 0 0 1
+    const Mesh &second = model->GetMeshes()[1];
+    EXPECT_FLOAT_EQ(second.mNormals[0].z(), 1.0f);
+    EXPECT_FLOAT_EQ(second.mVertices[second.mIndices[0]].x(), 1.0f);
+    EXPECT_FLOAT_EQ(second.mVertices[second.mIndices[2]].z(), 1.0f);
+    std::filesystem::remove(path);
+}
+
+TEST(AssetLoaderTest, ModelSideFilesGoThroughTheFileService) {
+    JobSystem *jobSystem = JobSystem::CreateJobSystem();
+    std::filesystem::path modelPath = std::filesystem::temp_directory_path() / "AssetLoaderSideFiles.obj";
+    std::filesystem::path materialPath = std::filesystem::temp_directory_path() / "AssetLoaderSideFiles.mtl";
+    {
+        std::ofstream model(modelPath);
+        model << "mtllib AssetLoaderSideFiles.mtl\n"
+                 "v 0 0 0\nv 1 0 0\nv 0 1 0\n"
+                 "usemtl Surface\n"
+                 "f 1 2 3\n";
+        std::ofstream material(materialPath);
+        material << "newmtl Surface\nKd 1 0 0\n";
+    }
+    AssetRegistry<Model>::GetInstance().EvictUnused();
+    AsyncFileService &files = jobSystem->GetFileService();
+    const uint64_t readsBefore = files.GetNumReads();
+    ModelLoader loader;
+    AssetLoadHandle<Model> model = loader.ReadFileAsync(modelPath.string());
+    ASSERT_TRUE(model.Wait());
+    EXPECT_EQ(model.Get().GetMeshes().size(), 1u);
+    // The .obj is parsed from the bytes already read, only the .mtl is read on top
+    EXPECT_EQ(files.GetNumReads() - readsBefore, 2u);
+    loader.WaitIdle();
+    JobSystem::DestroyJobSystem(jobSystem);
+    std::filesystem::remove(modelPath);
+    std::filesystem::remove(materialPath);
+}
+
+TEST(AssetLoaderTest, ImagesKeepEightBitTexels) {
+    std::string rgbPath = WriteTestPpm("AssetLoaderRgb.ppm", 5, 3, 200);
+    std::string greyPath = WriteTestPgm("AssetLoaderGrey.pgm", 5, 3, 17);
+    std::string greyAlphaPath = WriteTestGreyAlphaTga("AssetLoaderGreyAlpha.tga", 4, 2, 90, 128);
+    ImageLoader loader;
+    // RGB files get an opaque alpha, one byte per channel
+    AssetHandle<Image> rgb = loader.Load(rgbPath);
+    ASSERT_TRUE(rgb.IsValid());
+    EXPECT_EQ(rgb->mFormat, PixelFormat::RGBA8);
+    ASSERT_EQ(rgb->mData.size(), 5u * 3u * 4u);
+    EXPECT_EQ(rgb->mData[4], 200);
+    EXPECT_EQ(rgb->mData[7], 255);
+    // Grey files are spread over the colour channels instead of ending up red
+    AssetHandle<Image> grey = loader.Load(greyPath);
+    ASSERT_TRUE(grey.IsValid());
+    EXPECT_EQ(grey->mFormat, PixelFormat::RGBA8);
+    ASSERT_EQ(grey->mData.size(), 5u * 3u * 4u);
+    EXPECT_EQ(grey->mData[56], 17);
+    EXPECT_EQ(grey->mData[57], 17);
+    EXPECT_EQ(grey->mData[58], 17);
+    EXPECT_EQ(grey->mData[59], 255);
+    // and the second channel of grey files is alpha
+    AssetHandle<Image> greyAlpha = loader.Load(greyAlphaPath);
+    ASSERT_TRUE(greyAlpha.IsValid());
+    EXPECT_EQ(greyAlpha->mFormat, PixelFormat::RGBA8);
+    ASSERT_EQ(greyAlpha->mData.size(), 4u * 2u * 4u);
+    EXPECT_EQ(greyAlpha->mData[28], 90);
+    EXPECT_EQ(greyAlpha->mData[29], 90);
+    EXPECT_EQ(greyAlpha->mData[30], 90);
+    EXPECT_EQ(greyAlpha->mData[31], 128);
+    std::filesystem::remove(rgbPath);
+    std::filesystem::remove(greyPath);
+    std::filesystem::remove(greyAlphaPath);
+}
@@ -0,0 +1,158 @@
+#pragma once
+#include <gtest/gtest.h>
+#include "Engine/AssetRegistry.h"
+
+struct TestAsset
+{
+    int mValue = 0;
+    std::atomic<int> *mDestroyed = nullptr;
+
+    ~TestAsset()
+    {
+        if (mDestroyed)
+        {
+            (*mDestroyed)++;
+        }
+    }
+};
+
+inline UniquePtr<TestAsset> MakeTestAsset(int value, std::atomic<int> &destroyed)
+{
+    UniquePtr<TestAsset> asset = std::make_unique<TestAsset>();
+    asset->mValue = value;
+    asset->mDestroyed = &destroyed;
+    return asset;
+}
+
+TEST(AssetRegistryTest, InternsPaths) {
+    AssetPathID id = InternAssetPath("textures/brick.png");
+    EXPECT_EQ(InternAssetPath(std::string("textures/brick.png")), id);
+    EXPECT_NE(InternAssetPath("textures/brick2.png"), id);
+    EXPECT_EQ(GetAssetPath(id), "textures/brick.png");
+    EXPECT_TRUE(GetAssetPath(12345).empty());
+}
+
+TEST(AssetRegistryTest, HandlesShareAndFreeDeterministically) {
+    AssetRegistry<TestAsset> &registry = AssetRegistry<TestAsset>::GetInstance();
+    // Without a budget nothing is cached once unused
+    registry.SetBudget(0);
+    std::atomic<int> destroyed = 0;
+    AssetPathID path = InternAssetPath("AssetRegistryTest/first");
+    AssetHandle<TestAsset> first = registry.Add(path, MakeTestAsset(1, destroyed));
+    ASSERT_TRUE(first.IsValid());
+    EXPECT_EQ(first->mValue, 1);
+
+    // Hits hand out the same data, a second registration of the path is dropped
+    AssetHandle<TestAsset> found = registry.Find(path);
+    AssetHandle<TestAsset> duplicate = registry.Add(path, MakeTestAsset(2, destroyed));
+    EXPECT_EQ(found.Get(), first.Get());
+    EXPECT_EQ(duplicate.Get(), first.Get());
+    EXPECT_EQ(destroyed.load(), 1);
+    EXPECT_EQ(first.GetRefCount(), 3u);
+    EXPECT_EQ(registry.GetNumAssets(), 1u);
+
+    AssetID id = first.GetID();
+    AssetHandle<TestAsset> copy = first;
+    first.Reset();
+    found.Reset();
+    duplicate.Reset();
+    EXPECT_EQ(destroyed.load(), 1);
+    EXPECT_EQ(registry.Resolve(id).Get(), copy.Get());
+
+    // Dropping the last handle frees the asset right there
+    copy.Reset();
+    EXPECT_EQ(destroyed.load(), 2);
+    EXPECT_EQ(registry.GetNumAssets(), 0u);
+    EXPECT_FALSE(registry.Find(path).IsValid());
+    EXPECT_FALSE(registry.Resolve(id).IsValid());
+
+    // The slot is reused with a new generation, the old id stays stale
+    AssetHandle<TestAsset> second = registry.Add(InternAssetPath("AssetRegistryTest/second"), MakeTestAsset(3, destroyed));
+    EXPECT_EQ(second.GetID().mIndex, id.mIndex);
+    EXPECT_NE(second.GetID().mGeneration, id.mGeneration);
+    EXPECT_FALSE(registry.Resolve(id).IsValid());
+    second.Reset();
+    EXPECT_EQ(destroyed.load(), 3);
+    registry.SetBudget(AssetRegistry<TestAsset>::DEFAULT_BUDGET_BYTES);
+}
+
+TEST(AssetRegistryTest, ConcurrentLookupsAndReleases) {
+    AssetRegistry<TestAsset> &registry = AssetRegistry<TestAsset>::GetInstance();
+    // A small budget keeps the cache evicting while other threads look the assets up again
+    registry.SetBudget(sizeof(TestAsset));
+    std::atomic<int> destroyed = 0;
+    std::atomic<int> created = 0;
+    const AssetPathID paths[2] = {InternAssetPath("AssetRegistryTest/a"), InternAssetPath("AssetRegistryTest/b")};
+    std::vector<std::thread> threads;
+    for (int t = 0; t < 4; t++)
+    {
+        threads.emplace_back([&, t]()
+                             {
+            for (int i = 0; i < 2000; i++)
+            {
+                AssetPathID path = paths[(i + t) % 2];
+                AssetHandle<TestAsset> handle = registry.Find(path);
+                if (!handle)
+                {
+                    created++;
+                    handle = registry.Add(path, MakeTestAsset(static_cast<int>(path & 0xFF), destroyed));
+                }
+                AssetHandle<TestAsset> copy = handle;
+                EXPECT_EQ(copy->mValue, static_cast<int>(path & 0xFF));
+            } });
+    }
+    for (std::thread &thread : threads)
+    {
+        thread.join();
+    }
+    // Every asset created was freed again, once
+    registry.EvictUnused();
+    EXPECT_EQ(destroyed.load(), created.load());
+    EXPECT_EQ(registry.GetNumAssets(), 0u);
+    registry.SetBudget(AssetRegistry<TestAsset>::DEFAULT_BUDGET_BYTES);
+}
+
+TEST(AssetRegistryTest, EvictsLeastRecentlyUsedOverBudget) {
+    AssetRegistry<TestAsset> &registry = AssetRegistry<TestAsset>::GetInstance();
+    registry.SetBudget(300);
+    const AssetCacheStats before = registry.GetStats();
+    std::atomic<int> destroyed = 0;
+    const AssetPathID paths[4] = {InternAssetPath("AssetRegistryTest/lru0"), InternAssetPath("AssetRegistryTest/lru1"),
+                                  InternAssetPath("AssetRegistryTest/lru2"), InternAssetPath("AssetRegistryTest/lru3")};
+
+    // Unused assets stay cached while they fit the budget
+    AssetHandle<TestAsset> pinned = registry.Add(paths[0], MakeTestAsset(0, destroyed), 100);
+    registry.Add(paths[1], MakeTestAsset(1, destroyed), 100);
+    registry.Add(paths[2], MakeTestAsset(2, destroyed), 100);
+    EXPECT_EQ(destroyed.load(), 0);
+    EXPECT_EQ(registry.GetStats().mResidentBytes, 300u);
+    EXPECT_EQ(registry.Find(paths[1])->mValue, 1);
+
+    // Going over evicts the unused asset that wasn't looked up, the pinned one is kept
+    registry.Add(paths[3], MakeTestAsset(3, destroyed), 100);
+    EXPECT_EQ(destroyed.load(), 1);
+    EXPECT_FALSE(registry.Find(paths[2]).IsValid());
+    EXPECT_TRUE(registry.Find(paths[1]).IsValid());
+    EXPECT_TRUE(registry.Find(paths[3]).IsValid());
+    EXPECT_EQ(pinned->mValue, 0);
+
+    AssetCacheStats stats = registry.GetStats();
+    EXPECT_EQ(stats.mResidentBytes, 300u);
+    EXPECT_EQ(stats.mNumAssets, 3u);
+    EXPECT_EQ(stats.mNumPinned, 1u);
+    EXPECT_EQ(stats.mPinnedBytes, 100u);
+    EXPECT_EQ(stats.mNumHits - before.mNumHits, 3u);
+    EXPECT_EQ(stats.mNumMisses - before.mNumMisses, 1u);
+    EXPECT_EQ(stats.mNumEvictions - before.mNumEvictions, 1u);
+    EXPECT_EQ(stats.mEvictedBytes - before.mEvictedBytes, 100u);
+
+    // Pinned assets are never evicted, not even when they alone exceed the budget
+    registry.SetBudget(50);
+    EXPECT_EQ(destroyed.load(), 3);
+    EXPECT_EQ(registry.GetStats().mResidentBytes, 100u);
+    EXPECT_EQ(pinned->mValue, 0);
+    pinned.Reset();
+    EXPECT_EQ(destroyed.load(), 4);
+    EXPECT_EQ(registry.GetNumAssets(), 0u);
+    registry.SetBudget(AssetRegistry<TestAsset>::DEFAULT_BUDGET_BYTES);
+}
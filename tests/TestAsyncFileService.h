@@ -0,0 +1,206 @@
+#pragma once
+#include <gtest/gtest.h>
+#include "Engine/AsyncFileService.h"
+#include <filesystem>
+
+inline std::string WriteTestFile(const std::string &name, size_t size, uint8_t seed)
+{
+    std::filesystem::path path = std::filesystem::temp_directory_path() / name;
+    std::vector<uint8_t> data(size);
+    for (size_t i = 0; i < size; i++)
+    {
+        data[i] = static_cast<uint8_t>(i * 31 + seed);
+    }
+    std::ofstream file(path, std::ios::binary);
+    file.write(reinterpret_cast<const char *>(data.data()), static_cast<std::streamsize>(data.size()));
+    return path.string();
+}
+
+inline bool HasTestPattern(const std::vector<uint8_t> &data, size_t offset, uint8_t seed)
+{
+    for (size_t i = 0; i < data.size(); i++)
+    {
+        if (data[i] != static_cast<uint8_t>((offset + i) * 31 + seed))
+            return false;
+    }
+    return true;
+}
+
+// Whether a WriteFileAtomically of path left a temporary file behind
+inline bool HasTemporaryFiles(const std::string &path)
+{
+    std::filesystem::path target(path);
+    const std::string prefix = target.filename().string() + ".";
+    for (const std::filesystem::directory_entry &entry : std::filesystem::directory_iterator(target.parent_path()))
+    {
+        std::string name = entry.path().filename().string();
+        if (name.starts_with(prefix) && entry.path().extension() == ".tmp")
+            return true;
+    }
+    return false;
+}
+
+// Runs every test on io_uring where the kernel allows it and on the blocking threads
+class AsyncFileServiceTest : public ::testing::TestWithParam<bool>
+{
+protected:
+    void SetUp() override
+    {
+        m_JobSystem = JobSystem::CreateJobSystem();
+        m_Policy.mUseIoUring = GetParam();
+    }
+
+    void TearDown() override
+    {
+        JobSystem::DestroyJobSystem(m_JobSystem);
+    }
+
+    JobSystem *m_JobSystem = nullptr;
+    AsyncFileServicePolicy m_Policy;
+};
+
+TEST_P(AsyncFileServiceTest, ReadsWholeFilesAndRanges) {
+    AsyncFileService service(m_JobSystem, m_Policy);
+    const size_t size = 3 * 1024 * 1024 + 17;
+    std::string path = WriteTestFile("AsyncFileServiceLarge.bin", size, 7);
+
+    std::vector<uint8_t> data;
+    ASSERT_TRUE(service.ReadFileAndWait(path, data));
+    EXPECT_EQ(data.size(), size);
+    EXPECT_TRUE(HasTestPattern(data, 0, 7));
+
+    // Ranges past the end are cut short, missing files still get their callback
+    JobCounter counter;
+    std::vector<FileReadRequest> requests(3);
+    requests[0] = {path, 1000, 4096, &counter};
+    requests[1] = {path, size - 10, 4096, &counter};
+    requests[2] = {path + ".missing", 0, FileReadRequest::WHOLE_FILE, &counter};
+    std::mutex mutex;
+    std::map<uint64_t, FileReadResult> results;
+    for (const FileReadRequest &request : requests)
+    {
+        service.Read(request, [&mutex, &results, offset = request.mOffset](FileReadResult &result)
+                     {
+            std::lock_guard<std::mutex> guard(mutex);
+            results[offset] = std::move(result); });
+    }
+    m_JobSystem->WaitForCounter(counter);
+    ASSERT_EQ(results.size(), 3u);
+    EXPECT_TRUE(results[1000].mSucceeded);
+    EXPECT_EQ(results[1000].mData.size(), 4096u);
+    EXPECT_TRUE(HasTestPattern(results[1000].mData, 1000, 7));
+    EXPECT_TRUE(results[size - 10].mSucceeded);
+    EXPECT_EQ(results[size - 10].mData.size(), 10u);
+    EXPECT_TRUE(HasTestPattern(results[size - 10].mData, size - 10, 7));
+    EXPECT_FALSE(results[0].mSucceeded);
+    EXPECT_EQ(results[0].mPath, path + ".missing");
+    std::filesystem::remove(path);
+}
+
+TEST_P(AsyncFileServiceTest, BatchesSmallReads) {
+    m_Policy.mMaxBatchReads = 16;
+    // Deep enough that waiting for room never cuts a batch short
+    m_Policy.mQueueDepth = 128;
+    AsyncFileService service(m_JobSystem, m_Policy);
+    const uint32_t fileCount = 100;
+    std::vector<FileReadRequest> requests(fileCount);
+    JobCounter counter;
+    for (uint32_t i = 0; i < fileCount; i++)
+    {
+        requests[i].mPath = WriteTestFile("AsyncFileServiceSmall" + std::to_string(i) + ".bin", 100 + i, static_cast<uint8_t>(i));
+        requests[i].mCounter = &counter;
+    }
+    std::atomic<uint32_t> matches = 0;
+    service.Read(requests, [&matches](FileReadResult &result)
+                 {
+        uint8_t seed = static_cast<uint8_t>(result.mData.size() - 100);
+        if (result.mSucceeded && HasTestPattern(result.mData, 0, seed))
+            matches++; });
+    m_JobSystem->WaitForCounter(counter);
+    EXPECT_EQ(matches.load(), fileCount);
+    EXPECT_EQ(service.GetNumReads(), fileCount);
+    // Queued together, so the dispatcher sees all of them at once
+    EXPECT_LE(service.GetNumBatches(), (fileCount + 15) / 16);
+    for (const FileReadRequest &request : requests)
+    {
+        std::filesystem::remove(request.mPath);
+    }
+}
+
+TEST_P(AsyncFileServiceTest, BoundsInFlightBytes) {
+    m_Policy.mMaxInFlightBytes = 64 * 1024;
+    AsyncFileService service(m_JobSystem, m_Policy);
+    const size_t size = 16 * 1024;
+    std::string path = WriteTestFile("AsyncFileServiceBudget.bin", size * 32, 3);
+    std::vector<FileReadRequest> requests(32);
+    JobCounter counter;
+    for (size_t i = 0; i < requests.size(); i++)
+    {
+        requests[i] = {path, i * size, size, &counter};
+    }
+    std::atomic<uint32_t> matches = 0;
+    service.Read(requests, [&matches](FileReadResult &result)
+                 {
+        if (result.mSucceeded && result.mData.size() == 16 * 1024)
+            matches++;
+        std::this_thread::sleep_for(std::chrono::microseconds(200)); });
+    m_JobSystem->WaitForCounter(counter);
+    EXPECT_EQ(matches.load(), requests.size());
+    EXPECT_LE(service.GetPeakInFlightBytes(), m_Policy.mMaxInFlightBytes);
+    EXPECT_EQ(service.GetInFlightBytes(), 0u);
+
+    // A read larger than the whole budget still goes through on its own
+    std::vector<uint8_t> data;
+    EXPECT_TRUE(service.ReadFileAndWait(path, data));
+    EXPECT_EQ(data.size(), size * 32);
+    EXPECT_TRUE(HasTestPattern(data, 0, 3));
+    std::filesystem::remove(path);
+}
+
+INSTANTIATE_TEST_SUITE_P(Backends, AsyncFileServiceTest, ::testing::Bool(), [](const ::testing::TestParamInfo<bool> &info)
+                         { return info.param ? std::string("IoUring") : std::string("Threads"); });
+
+TEST(ReadFileBytesTest, UsesJobSystemWhenThereIsOne) {
+    std::string path = WriteTestFile("AsyncFileServiceBytes.bin", 1000, 11);
+    std::vector<uint8_t> data;
+    ASSERT_TRUE(ReadFileBytes(path, data));
+    EXPECT_TRUE(HasTestPattern(data, 0, 11));
+
+    JobSystem *jobSystem = JobSystem::CreateJobSystem();
+    data.clear();
+    ASSERT_TRUE(ReadFileBytes(path, data));
+    EXPECT_EQ(data.size(), 1000u);
+    EXPECT_TRUE(HasTestPattern(data, 0, 11));
+    EXPECT_FALSE(ReadFileBytes(path + ".missing", data));
+    JobSystem::DestroyJobSystem(jobSystem);
+    std::filesystem::remove(path);
+}
+
+TEST(WriteFileAtomicallyTest, ConcurrentWritersOfOnePath) {
+    std::string path = (std::filesystem::temp_directory_path() / "AsyncFileServiceAtomic.bin").string();
+    const uint32_t writerCount = 4;
+    std::atomic<uint32_t> failures = 0;
+    std::vector<std::thread> writers;
+    for (uint32_t i = 0; i < writerCount; i++)
+    {
+        writers.emplace_back([&path, &failures, i]()
+                             {
+            std::vector<uint8_t> data(64 * 1024, static_cast<uint8_t>(i + 1));
+            for (int round = 0; round < 20; round++)
+            {
+                if (!WriteFileAtomically(path, data))
+                    failures++;
+            } });
+    }
+    for (std::thread &writer : writers)
+        writer.join();
+
+    // Every write lands whole, the last rename wins
+    EXPECT_EQ(failures.load(), 0u);
+    std::vector<uint8_t> data;
+    ASSERT_TRUE(ReadFileBytes(path, data));
+    ASSERT_EQ(data.size(), 64u * 1024);
+    EXPECT_EQ(std::count(data.begin(), data.end(), data[0]), static_cast<std::ptrdiff_t>(data.size()));
+    EXPECT_FALSE(HasTemporaryFiles(path));
+    std::filesystem::remove(path);
+}
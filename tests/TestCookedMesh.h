@@ -0,0 +1,126 @@
+#pragma once
+#include <gtest/gtest.h>
+#include "Engine/CookedMesh.h"
+#include "TestAssetLoader.h"
+#include "TestAsyncFileService.h"
+#include <cstring>
+
+template <typename Element>
+inline bool IsSameStream(std::span<const Element> a, const std::vector<Element> &b)
+{
+    return a.size() == b.size() && (a.empty() || std::memcmp(a.data(), b.data(), a.size_bytes()) == 0);
+}
+
+inline std::vector<Mesh> MakeCookTestMeshes()
+{
+    std::vector<Mesh> meshes(2);
+    for (uint32_t i = 0; i < 5; i++)
+    {
+        float value = static_cast<float>(i);
+        meshes[0].mVertices.emplace_back(value, value + 0.5f, -value);
+        meshes[0].mNormals.emplace_back(0.0f, 0.0f, 1.0f);
+        meshes[0].mTangents.emplace_back(1.0f, 0.0f, 0.0f, value);
+    }
+    meshes[0].mTexCoordsArray.resize(2);
+    for (uint32_t i = 0; i < 5; i++)
+    {
+        meshes[0].mTexCoordsArray[0].emplace_back(i * 0.25f, 0.0f);
+        meshes[0].mTexCoordsArray[1].emplace_back(0.0f, i * 0.5f);
+    }
+    meshes[0].mIndices = {0, 1, 2, 2, 3, 4};
+    meshes[0].mColor.r = 0.25f;
+    meshes[0].mColor.a = 1.0f;
+    // Positions only, with a count that leaves the streams unaligned before padding
+    meshes[1].mVertices = {MathLib::HVector3(1.0f, 2.0f, 3.0f), MathLib::HVector3(4.0f, 5.0f, 6.0f), MathLib::HVector3(7.0f, 8.0f, 9.0f)};
+    meshes[1].mIndices = {2, 1, 0};
+    return meshes;
+}
+
+TEST(CookedMeshTest, RoundTripsMeshesThroughMapping) {
+    std::string path = (std::filesystem::temp_directory_path() / "CookedMeshRoundTrip.hmesh").string();
+    std::vector<Mesh> meshes = MakeCookTestMeshes();
+    ASSERT_TRUE(WriteCookedMeshes(path, meshes));
+    EXPECT_FALSE(HasTemporaryFiles(path));
+
+    CookedModel cooked;
+    ASSERT_TRUE(cooked.Open(path));
+    ASSERT_EQ(cooked.GetNumMeshes(), 2u);
+    for (uint32_t i = 0; i < 2; i++)
+    {
+        CookedMeshView view = cooked.GetMesh(i);
+        EXPECT_TRUE(IsSameStream(view.mVertices, meshes[i].mVertices));
+        EXPECT_TRUE(IsSameStream(view.mNormals, meshes[i].mNormals));
+        EXPECT_TRUE(IsSameStream(view.mTangents, meshes[i].mTangents));
+        EXPECT_TRUE(IsSameStream(view.mIndices, meshes[i].mIndices));
+        ASSERT_EQ(view.mTexCoordsArray.size(), meshes[i].mTexCoordsArray.size());
+        for (size_t j = 0; j < view.mTexCoordsArray.size(); j++)
+        {
+            EXPECT_TRUE(IsSameStream(view.mTexCoordsArray[j], meshes[i].mTexCoordsArray[j]));
+            EXPECT_EQ(reinterpret_cast<uintptr_t>(view.mTexCoordsArray[j].data()) % COOKED_MESH_ALIGNMENT, 0u);
+        }
+        // The views point straight into the mapping, aligned for uploads
+        EXPECT_EQ(reinterpret_cast<uintptr_t>(view.mVertices.data()) % COOKED_MESH_ALIGNMENT, 0u);
+        EXPECT_EQ(reinterpret_cast<uintptr_t>(view.mIndices.data()) % COOKED_MESH_ALIGNMENT, 0u);
+
+        Mesh copy;
+        view.CopyTo(copy);
+        EXPECT_TRUE(IsSameStream(std::span<const MathLib::HVector3>(copy.mVertices), meshes[i].mVertices));
+        EXPECT_TRUE(IsSameStream(std::span<const uint32_t>(copy.mIndices), meshes[i].mIndices));
+        EXPECT_EQ(copy.mColor.r, meshes[i].mColor.r);
+    }
+    std::filesystem::remove(path);
+}
+
+TEST(CookedMeshTest, RejectsDamagedFiles) {
+    std::string path = (std::filesystem::temp_directory_path() / "CookedMeshDamaged.hmesh").string();
+    ASSERT_TRUE(WriteCookedMeshes(path, MakeCookTestMeshes()));
+    std::vector<uint8_t> data;
+    ASSERT_TRUE(ReadFileBytes(path, data));
+    CookedModel cooked;
+    EXPECT_TRUE(cooked.Parse(data));
+    EXPECT_TRUE(IsCookedMeshData(data));
+
+    std::vector<uint8_t> truncated(data.begin(), data.end() - 4);
+    EXPECT_FALSE(cooked.Parse(truncated));
+    std::vector<uint8_t> outdated = data;
+    outdated[4] = COOKED_MESH_VERSION + 1;
+    EXPECT_FALSE(cooked.Parse(outdated));
+    // A stream offset pointing past the end of the file
+    std::vector<uint8_t> corrupt = data;
+    CookedMeshRecord record;
+    std::memcpy(&record, corrupt.data() + sizeof(CookedMeshFileHeader), sizeof(record));
+    record.mIndicesOffset = corrupt.size();
+    std::memcpy(corrupt.data() + sizeof(CookedMeshFileHeader), &record, sizeof(record));
+    EXPECT_FALSE(cooked.Parse(corrupt));
+    // An index past the last vertex of its mesh
+    std::vector<uint8_t> badIndex = data;
+    std::memcpy(&record, badIndex.data() + sizeof(CookedMeshFileHeader), sizeof(record));
+    std::memcpy(badIndex.data() + record.mIndicesOffset + sizeof(uint32_t), &record.mNumVertices, sizeof(uint32_t));
+    EXPECT_FALSE(cooked.Parse(badIndex));
+    EXPECT_EQ(cooked.GetNumMeshes(), 0u);
+    EXPECT_FALSE(cooked.Open(path + ".missing"));
+    std::filesystem::remove(path);
+}
+
+TEST(CookedMeshTest, ModelLoaderReadsCookedModels) {
+    std::string objPath = WriteTestObj("CookedMeshSource.obj");
+    std::string cookedPath = objPath + COOKED_MESH_EXTENSION;
+    ModelLoader loader;
+    ASSERT_TRUE(loader.Cook(objPath, cookedPath));
+    AssetHandle<Model> imported = loader.Load(objPath);
+    AssetHandle<Model> cooked = loader.Load(cookedPath);
+    ASSERT_TRUE(imported && cooked);
+    EXPECT_NE(imported.Get(), cooked.Get());
+    ASSERT_EQ(cooked->GetMeshes().size(), imported->GetMeshes().size());
+    for (size_t i = 0; i < cooked->GetMeshes().size(); i++)
+    {
+        const Mesh &a = imported->GetMeshes()[i];
+        const Mesh &b = cooked->GetMeshes()[i];
+        EXPECT_TRUE(IsSameStream(std::span<const MathLib::HVector3>(b.mVertices), a.mVertices));
+        EXPECT_TRUE(IsSameStream(std::span<const MathLib::HVector3>(b.mNormals), a.mNormals));
+        EXPECT_TRUE(IsSameStream(std::span<const uint32_t>(b.mIndices), a.mIndices));
+        EXPECT_EQ(b.mTexCoordsArray.size(), a.mTexCoordsArray.size());
+    }
+    std::filesystem::remove(objPath);
+    std::filesystem::remove(cookedPath);
+}
@@ -0,0 +1,47 @@
+#pragma once
+#include <cstddef>
+#include <cstring>
+#include <gtest/gtest.h>
+#include "Engine/CookedTexture.h"
+#include "TestAssetLoader.h"
+#include "TestAsyncFileService.h"
+
+TEST(CookedTextureTest, ImageLoaderReadsCookedTextures) {
+    std::string sourcePath = WriteTestPpm("CookedTextureSource.ppm", 12, 10, 51);
+    std::string cookedPath = sourcePath + COOKED_TEXTURE_EXTENSION;
+    ImageLoader loader;
+    TextureCookSettings settings;
+    settings.mCompression = {PixelFormat::BC1, TextureCompressionQuality::FAST};
+    ASSERT_TRUE(loader.Cook(sourcePath, cookedPath, settings));
+    EXPECT_FALSE(HasTemporaryFiles(cookedPath));
+
+    // Loaded as cooked, mips and all, without filtering or compressing again
+    AssetHandle<Image> cooked = loader.Load(cookedPath);
+    ASSERT_TRUE(cooked.IsValid());
+    EXPECT_EQ(cooked->mFormat, PixelFormat::BC1);
+    EXPECT_EQ(cooked->mMipLevels, 4u);
+    EXPECT_TRUE(cooked->mIsSRGB);
+    EXPECT_EQ(cooked->mData.size(), GetImageDataSize(PixelFormat::BC1, 12, 10, 4));
+    Image decompressed;
+    ASSERT_TRUE(DecompressImage(*cooked, decompressed));
+    std::span<const uint8_t> smallest = GetMipData(decompressed, 3);
+    EXPECT_NEAR(smallest[0], 51, 4);
+
+    std::vector<uint8_t> data;
+    ASSERT_TRUE(ReadFileBytes(cookedPath, data));
+    Image image;
+    EXPECT_TRUE(IsCookedTextureData(data));
+    EXPECT_TRUE(ReadCookedTexture(data, image));
+    std::vector<uint8_t> truncated(data.begin(), data.end() - 8);
+    EXPECT_FALSE(ReadCookedTexture(truncated, image));
+    std::vector<uint8_t> outdated = data;
+    outdated[4] = COOKED_TEXTURE_VERSION + 1;
+    EXPECT_FALSE(ReadCookedTexture(outdated, image));
+    // A format past the end of PixelFormat, even one whose low byte names a valid format
+    std::vector<uint8_t> badFormat = data;
+    const uint32_t format = static_cast<uint32_t>(PixelFormat::BC1) + 0x100;
+    std::memcpy(badFormat.data() + offsetof(CookedTextureFileHeader, mFormat), &format, sizeof(format));
+    EXPECT_FALSE(ReadCookedTexture(badFormat, image));
+    std::filesystem::remove(sourcePath);
+    std::filesystem::remove(cookedPath);
+}
@@ -0,0 +1,131 @@
+#pragma once
+#include <gtest/gtest.h>
+#include <filesystem>
+#include <fstream>
+#include "Engine/CpuTopology.h"
+#include "Engine/JobSystem.h"
+
+// Fake /sys/devices/system of a 4 core, 8 thread part with two L3 domains on two NUMA nodes.
+// Like Linux numbers them, cpu0-3 are the first threads of cores 0-3 and cpu4-7 their siblings.
+class CpuTopologyTest : public ::testing::Test {
+protected:
+    void SetUp() override {
+        root = std::filesystem::temp_directory_path() / "RendererCpuTopologyTest";
+        std::filesystem::remove_all(root);
+        WriteFile("cpu/online", "0-7");
+        for (uint32_t cpu = 0; cpu < 8; cpu++)
+        {
+            std::string path = "cpu/cpu" + std::to_string(cpu) + "/";
+            uint32_t core = cpu % 4;
+            WriteFile(path + "topology/core_id", std::to_string(core));
+            WriteFile(path + "topology/physical_package_id", "0");
+            WriteFile(path + "cache/index0/level", "1");
+            WriteFile(path + "cache/index0/type", "Data");
+            WriteFile(path + "cache/index0/shared_cpu_list", std::to_string(core) + "," + std::to_string(core + 4));
+            WriteFile(path + "cache/index1/level", "1");
+            WriteFile(path + "cache/index1/type", "Instruction");
+            WriteFile(path + "cache/index1/shared_cpu_list", std::to_string(core) + "," + std::to_string(core + 4));
+            WriteFile(path + "cache/index3/level", "3");
+            WriteFile(path + "cache/index3/type", "Unified");
+            WriteFile(path + "cache/index3/shared_cpu_list", core < 2 ? "0-1,4-5" : "2-3,6-7");
+        }
+        WriteFile("node/node0/cpulist", "0-1,4-5");
+        WriteFile("node/node1/cpulist", "2-3,6-7");
+        ASSERT_TRUE(CpuTopology::ParseSysfs(root.string(), topology));
+    }
+
+    void TearDown() override {
+        std::filesystem::remove_all(root);
+    }
+
+    void WriteFile(const std::string &path, const std::string &content) {
+        std::filesystem::path file = root / path;
+        std::filesystem::create_directories(file.parent_path());
+        std::ofstream(file) << content << "\n";
+    }
+
+    const LogicalCpu &Cpu(uint32_t id) {
+        return topology.GetLogicalCpus()[id];
+    }
+
+    std::filesystem::path root;
+    CpuTopology topology;
+};
+
+TEST_F(CpuTopologyTest, ParsesCoresSmtCachesAndNodes) {
+    EXPECT_EQ(topology.GetNumLogicalCpus(), 8u);
+    EXPECT_EQ(topology.GetNumPhysicalCores(), 4u);
+    EXPECT_EQ(topology.GetNumCacheDomains(), 2u);
+    EXPECT_EQ(topology.GetNumNumaNodes(), 2u);
+
+    EXPECT_EQ(Cpu(1).mCoreID, Cpu(5).mCoreID);
+    EXPECT_EQ(Cpu(1).mSmtIndex, 0u);
+    EXPECT_EQ(Cpu(5).mSmtIndex, 1u);
+    EXPECT_EQ(Cpu(0).mCacheDomainID, Cpu(5).mCacheDomainID);
+    EXPECT_NE(Cpu(0).mCacheDomainID, Cpu(2).mCacheDomainID);
+    EXPECT_EQ(Cpu(6).mNumaNode, 1u);
+}
+
+TEST_F(CpuTopologyTest, SpreadUsesOneThreadPerCoreAcrossDomains) {
+    std::vector<LogicalCpu> cpus = topology.SelectCpus(PipeLinePlacement::SPREAD, 4);
+    ASSERT_EQ(cpus.size(), 4u);
+    std::set<uint32_t> cores;
+    for (const LogicalCpu &cpu : cpus)
+    {
+        EXPECT_EQ(cpu.mSmtIndex, 0u);
+        cores.insert(cpu.mCoreID);
+    }
+    EXPECT_EQ(cores.size(), 4u);
+    EXPECT_NE(cpus[0].mCacheDomainID, cpus[1].mCacheDomainID);
+}
+
+TEST_F(CpuTopologyTest, SharedCacheStaysInLeastLoadedDomain) {
+    std::vector<LogicalCpu> cpus = topology.SelectCpus(PipeLinePlacement::SHARED_CACHE, 6);
+    ASSERT_EQ(cpus.size(), 6u);
+    for (const LogicalCpu &cpu : cpus)
+    {
+        EXPECT_EQ(cpu.mCacheDomainID, cpus[0].mCacheDomainID);
+    }
+    EXPECT_EQ(cpus[0].mSmtIndex, 0u);
+    EXPECT_EQ(cpus[1].mSmtIndex, 0u);
+
+    std::vector<uint32_t> cpuLoad(8, 0);
+    cpuLoad[0] = 1;
+    std::vector<LogicalCpu> other = topology.SelectCpus(PipeLinePlacement::SHARED_CACHE, 2, cpuLoad);
+    EXPECT_NE(other[0].mCacheDomainID, Cpu(0).mCacheDomainID);
+}
+
+TEST_F(CpuTopologyTest, SmtSiblingsAndAny) {
+    for (const LogicalCpu &cpu : topology.SelectCpus(PipeLinePlacement::SMT_SIBLINGS, 4))
+    {
+        EXPECT_EQ(cpu.mSmtIndex, 1u);
+    }
+    EXPECT_TRUE(topology.SelectCpus(PipeLinePlacement::ANY, 4).empty());
+}
+
+TEST(CpuTopologyFallbackTest, MissingSysfsAndFlatTopology) {
+    CpuTopology topology;
+    EXPECT_FALSE(CpuTopology::ParseSysfs("/nonexistent/sys/devices/system", topology));
+
+    CpuTopology flat = CpuTopology::MakeFlat(3);
+    EXPECT_EQ(flat.GetNumPhysicalCores(), 3u);
+    EXPECT_EQ(flat.GetNumCacheDomains(), 1u);
+    EXPECT_EQ(flat.SelectCpus(PipeLinePlacement::SMT_SIBLINGS, 1)[0].mID, 2u);
+
+    CpuTopology detected = CpuTopology::Detect();
+    EXPECT_GE(detected.GetNumLogicalCpus(), 1u);
+}
+
+TEST(CpuTopologyFallbackTest, PinnedPipeLineRunsJobs) {
+    CpuTopology topology = CpuTopology::Detect();
+    std::vector<LogicalCpu> cpus = topology.SelectCpus(PipeLinePlacement::SPREAD, 2);
+    JobPipeLine pipeLine(2, 0, cpus);
+    std::atomic<int> counter = 0;
+    for (int i = 0; i < 1000; i++)
+    {
+        auto job = std::make_unique<Job>([&counter]() { counter++; });
+        pipeLine.PushJob(job);
+    }
+    pipeLine.WaitIdle();
+    EXPECT_EQ(counter.load(), 1000);
+}
@@ -0,0 +1,187 @@
+#pragma once
+#include <gtest/gtest.h>
+#include "Engine/DerivedDataCache.h"
+#include "TestAssetLoader.h"
+
+inline std::string MakeDerivedDataTestDirectory(const std::string &name)
+{
+    std::filesystem::path directory = std::filesystem::temp_directory_path() / name;
+    std::filesystem::remove_all(directory);
+    return directory.string();
+}
+
+TEST(DerivedDataCacheTest, KeysCoverEveryInput) {
+    std::vector<uint8_t> bytes(100);
+    for (size_t i = 0; i < bytes.size(); i++)
+    {
+        bytes[i] = static_cast<uint8_t>(i * 37);
+    }
+    DerivedDataKey whole = DerivedDataKeyBuilder("Test").Add(bytes).Finish();
+    // Fed in pieces that don't line up with the 16 byte blocks
+    DerivedDataKeyBuilder pieces("Test");
+    pieces.Add(std::span<const uint8_t>(bytes).first(5)).Add(std::span<const uint8_t>(bytes).subspan(5, 30)).Add(std::span<const uint8_t>(bytes).subspan(35));
+    EXPECT_EQ(pieces.Finish(), whole);
+    EXPECT_EQ(whole.ToString().size(), 32u);
+
+    EXPECT_NE(DerivedDataKeyBuilder("Other").Add(bytes).Finish(), whole);
+    bytes[99]++;
+    EXPECT_NE(DerivedDataKeyBuilder("Test").Add(bytes).Finish(), whole);
+    EXPECT_NE(DerivedDataKeyBuilder("Test").Add(1).Finish(), DerivedDataKeyBuilder("Test").Add(2).Finish());
+    EXPECT_NE(DerivedDataKeyBuilder("Test").Add("ab").Add("c").Finish(), DerivedDataKeyBuilder("Test").Add("a").Add("bc").Finish());
+}
+
+TEST(DerivedDataCacheTest, EvictsLeastRecentlyUsedEntries) {
+    std::string directory = MakeDerivedDataTestDirectory("DerivedDataCacheEviction");
+    DerivedDataCache cache;
+    std::vector<uint8_t> data;
+    DerivedDataKey keys[3];
+    for (uint32_t i = 0; i < 3; i++)
+    {
+        keys[i] = DerivedDataKeyBuilder("Test").Add(i).Finish();
+    }
+    // Closed caches neither find nor store anything
+    EXPECT_FALSE(cache.Put(keys[0], std::vector<uint8_t>(10, 1)));
+    ASSERT_TRUE(cache.Open(directory));
+    for (uint32_t i = 0; i < 3; i++)
+    {
+        ASSERT_TRUE(cache.Put(keys[i], std::vector<uint8_t>(1000, static_cast<uint8_t>(i))));
+    }
+    ASSERT_TRUE(cache.Get(keys[0], data));
+    EXPECT_EQ(data, std::vector<uint8_t>(1000, 0));
+    EXPECT_FALSE(cache.Get(DerivedDataKeyBuilder("Test").Add(3).Finish(), data));
+    DerivedDataCacheStats stats = cache.GetStats();
+    EXPECT_EQ(stats.mNumEntries, 3u);
+    EXPECT_EQ(stats.mNumWrites, 3u);
+    EXPECT_EQ(stats.mNumHits, 1u);
+    EXPECT_EQ(stats.mNumMisses, 1u);
+    EXPECT_DOUBLE_EQ(stats.GetHitRate(), 0.5);
+
+    // Room for two, the oldest one not read since goes
+    const uint64_t entryBytes = stats.mResidentBytes / 3;
+    cache.SetBudget(entryBytes * 2);
+    stats = cache.GetStats();
+    EXPECT_EQ(stats.mNumEvictions, 1u);
+    EXPECT_EQ(stats.mResidentBytes, entryBytes * 2);
+    EXPECT_FALSE(cache.Get(keys[1], data));
+    EXPECT_TRUE(cache.Get(keys[2], data));
+
+    // A restart finds what is on disk, a damaged entry only costs a miss
+    cache.Close();
+    ASSERT_TRUE(cache.Open(directory));
+    EXPECT_EQ(cache.GetStats().mNumEntries, 2u);
+    std::string path = (std::filesystem::path(directory) / keys[2].ToString().substr(0, 2) / keys[2].ToString()).string();
+    {
+        std::fstream file(path, std::ios::binary | std::ios::in | std::ios::out);
+        file.seekp(-1, std::ios::end);
+        file.put(42);
+    }
+    EXPECT_FALSE(cache.Get(keys[2], data));
+    EXPECT_FALSE(std::filesystem::exists(path));
+    EXPECT_TRUE(cache.Get(keys[0], data));
+    EXPECT_EQ(cache.GetStats().mNumEntries, 1u);
+    cache.Close();
+    std::filesystem::remove_all(directory);
+}
+
+TEST(DerivedDataCacheTest, LoadersSkipImportersWhenWarm) {
+    std::string directory = MakeDerivedDataTestDirectory("DerivedDataCacheLoaders");
+    DerivedDataCache &cache = DerivedDataCache::GetInstance();
+    ASSERT_TRUE(cache.Open(directory));
+    std::string imagePath = WriteTestPpm("DerivedDataCacheImage.ppm", 6, 4, 77);
+    std::string modelPath = WriteTestObj("DerivedDataCacheModel.obj");
+    ImageLoader imageLoader;
+    ModelLoader modelLoader;
+    Image firstImage, secondImage;
+    Model firstModel, secondModel;
+
+    // The first loads import and store, the second ones come from the cache once the
+    // registries have let go of the assets. Models store the list of files they read as well.
+    AssetRegistry<Image>::GetInstance().EvictUnused();
+    AssetRegistry<Model>::GetInstance().EvictUnused();
+    imageLoader.ReadFile(imagePath, firstImage);
+    modelLoader.ReadFile(modelPath, firstModel);
+    EXPECT_EQ(cache.GetStats().mNumWrites, 3u);
+    AssetRegistry<Image>::GetInstance().EvictUnused();
+    AssetRegistry<Model>::GetInstance().EvictUnused();
+    imageLoader.ReadFile(imagePath, secondImage);
+    modelLoader.ReadFile(modelPath, secondModel);
+    DerivedDataCacheStats stats = cache.GetStats();
+    EXPECT_EQ(stats.mNumHits, 3u);
+    EXPECT_EQ(stats.mNumWrites, 3u);
+    EXPECT_EQ(secondImage.mFormat, firstImage.mFormat);
+    EXPECT_EQ(secondImage.mData, firstImage.mData);
+    ASSERT_EQ(secondModel.GetMeshes().size(), firstModel.GetMeshes().size());
+    EXPECT_EQ(secondModel.GetMeshes()[0].mIndices, firstModel.GetMeshes()[0].mIndices);
+
+    // Cooking again with the same settings reuses the compressed result
+    std::string cookedPath = imagePath + COOKED_TEXTURE_EXTENSION;
+    ASSERT_TRUE(imageLoader.Cook(imagePath, cookedPath));
+    std::vector<uint8_t> firstCook, secondCook;
+    ASSERT_TRUE(ReadFileBytes(cookedPath, firstCook));
+    const uint64_t hits = cache.GetStats().mNumHits;
+    ASSERT_TRUE(imageLoader.Cook(imagePath, cookedPath));
+    ASSERT_TRUE(ReadFileBytes(cookedPath, secondCook));
+    EXPECT_EQ(cache.GetStats().mNumHits, hits + 1);
+    EXPECT_EQ(firstCook, secondCook);
+
+    cache.Close();
+    std::filesystem::remove(imagePath);
+    std::filesystem::remove(modelPath);
+    std::filesystem::remove(cookedPath);
+    std::filesystem::remove_all(directory);
+}
+
+TEST(DerivedDataCacheTest, ModelKeysCoverTheFilesTheyRead) {
+    std::string directory = MakeDerivedDataTestDirectory("DerivedDataCacheSideFiles");
+    DerivedDataCache &cache = DerivedDataCache::GetInstance();
+    ASSERT_TRUE(cache.Open(directory));
+    std::filesystem::path modelPath = std::filesystem::temp_directory_path() / "DerivedDataCacheSideFiles.gltf";
+    std::filesystem::path bufferPath = std::filesystem::temp_directory_path() / "DerivedDataCacheSideFiles.bin";
+    {
+        std::ofstream file(modelPath);
+        file << R"({"asset":{"version":"2.0"},"scene":0,"scenes":[{"nodes":[0]}],"nodes":[{"mesh":0}],)"
+                R"("meshes":[{"primitives":[{"attributes":{"POSITION":0}}]}],)"
+                R"("buffers":[{"uri":"DerivedDataCacheSideFiles.bin","byteLength":36}],)"
+                R"("bufferViews":[{"buffer":0,"byteOffset":0,"byteLength":36}],)"
+                R"("accessors":[{"bufferView":0,"componentType":5126,"count":3,"type":"VEC3","min":[0,0,0],"max":[2,1,0]}]})";
+    }
+    auto writeBuffer = [&](float x)
+    {
+        const float positions[9] = {0.0f, 0.0f, 0.0f, x, 0.0f, 0.0f, 0.0f, 1.0f, 0.0f};
+        std::ofstream file(bufferPath, std::ios::binary);
+        file.write(reinterpret_cast<const char *>(positions), sizeof(positions));
+    };
+    ModelLoader modelLoader;
+    auto load = [&](Model &model)
+    {
+        AssetRegistry<Model>::GetInstance().EvictUnused();
+        modelLoader.ReadFile(modelPath.string(), model);
+        ASSERT_EQ(model.GetMeshes().size(), 1u);
+    };
+
+    // The second load comes from the cache, the buffer is read but not imported again
+    writeBuffer(1.0f);
+    Model first, second, third;
+    load(first);
+    load(second);
+    EXPECT_EQ(cache.GetStats().mNumHits, 2u);
+    EXPECT_EQ(second.GetMeshes()[0].mVertices, first.GetMeshes()[0].mVertices);
+
+    // Only the buffer changes, the .gltf bytes stay the same, still the cooked model misses
+    writeBuffer(2.0f);
+    load(third);
+    DerivedDataCacheStats stats = cache.GetStats();
+    EXPECT_EQ(stats.mNumHits, 3u);
+    EXPECT_EQ(stats.mNumMisses, 2u);
+    float largestX = 0.0f;
+    for (const MathLib::HVector3 &vertex : third.GetMeshes()[0].mVertices)
+    {
+        largestX = std::max(largestX, vertex.x());
+    }
+    EXPECT_FLOAT_EQ(largestX, 2.0f);
+
+    cache.Close();
+    std::filesystem::remove(modelPath);
+    std::filesystem::remove(bufferPath);
+    std::filesystem::remove_all(directory);
+}
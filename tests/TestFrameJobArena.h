@@ -0,0 +1,93 @@
+#pragma once
+#include <gtest/gtest.h>
+#include "Engine/FrameJobArena.h"
+#include "Engine/JobSystem.h"
+
+TEST(FrameJobArenaTest, DataStaysValidWhileFrameIsInFlight) {
+    FrameJobArena arena(3, 4096);
+    int *first = arena.New<int>(1);
+    arena.NextFrame();
+    int *second = arena.New<int>(2);
+    arena.NextFrame();
+    EXPECT_EQ(*first, 1);
+    EXPECT_EQ(*second, 2);
+
+    // Allocations bigger than a chunk get a chunk of their own
+    std::span<uint64_t> large = arena.NewArray<uint64_t>(4096);
+    EXPECT_EQ(large.size(), 4096u);
+    EXPECT_EQ(large[4095], 0u);
+    EXPECT_EQ(reinterpret_cast<uintptr_t>(large.data()) % alignof(uint64_t), 0u);
+
+    // The fourth frame reuses the memory of the first one
+    arena.NextFrame();
+    EXPECT_EQ(arena.New<int>(3), first);
+}
+
+TEST(FrameJobArenaTest, LiveJobsKeepTheirFrame) {
+    FrameJobArena arena(2, 4096);
+    std::atomic<int> counter = 0;
+    UniquePtr<Job> job = arena.CreateJob([&counter]() { counter++; });
+    int *value = arena.New<int>(42);
+    EXPECT_EQ(reinterpret_cast<uintptr_t>(job.get()) % JobAllocator::BLOCK_ALIGNMENT, 0u);
+
+    // Without a JobSystem nobody can run the job, so its frame must not be recycled
+    arena.NextFrame();
+    arena.NextFrame();
+    EXPECT_EQ(*value, 42);
+    EXPECT_GT(arena.GetUsedBytes(), 0u);
+    job->Execute();
+    job.reset();
+    EXPECT_EQ(counter.load(), 1);
+
+    arena.NextFrame();
+    arena.NextFrame();
+    EXPECT_EQ(arena.GetUsedBytes(), 0u);
+}
+
+TEST(FrameJobArenaTest, FootprintStaysFlatOverFrames) {
+    JobSystem *jobSystem = JobSystem::CreateJobSystem();
+    FrameJobArena arena(2, 16 * 1024);
+    const uint32_t frameCount = 5000;
+    const uint32_t jobsPerFrame = 64;
+    std::atomic<uint64_t> sum = 0;
+    JobCounter counters[2];
+    size_t warmReservedBytes = 0;
+    uint64_t warmChunkAllocations = 0;
+    uint64_t warmSlabAllocations = 0;
+    for (uint32_t frame = 0; frame < frameCount; frame++)
+    {
+        JobCounter &counter = counters[frame % 2];
+        std::span<uint32_t> values = arena.NewArray<uint32_t>(jobsPerFrame);
+        for (uint32_t i = 0; i < jobsPerFrame; i++)
+        {
+            UniquePtr<Job> job = arena.CreateJob([&sum, values, i, frame]()
+                                                 {
+                values[i] = frame + i;
+                sum.fetch_add(values[i], std::memory_order_relaxed); });
+            jobSystem->SubmitJob(job, 0, &counter);
+        }
+        // The jobs of this frame may still run during the next one, only the previous
+        // frame has to be finished before its buffer is recycled
+        jobSystem->WaitForCounter(counters[(frame + 1) % 2]);
+        arena.NextFrame();
+        if (frame == 8)
+        {
+            warmReservedBytes = arena.GetReservedBytes();
+            warmChunkAllocations = arena.GetNumChunkAllocations();
+            warmSlabAllocations = JobAllocator::GetNumSlabAllocations();
+        }
+    }
+    jobSystem->FlushJobs();
+
+    uint64_t expected = 0;
+    for (uint64_t frame = 0; frame < frameCount; frame++)
+    {
+        expected += frame * jobsPerFrame + uint64_t(jobsPerFrame) * (jobsPerFrame - 1) / 2;
+    }
+    EXPECT_EQ(sum.load(), expected);
+    EXPECT_EQ(arena.GetReservedBytes(), warmReservedBytes);
+    EXPECT_EQ(arena.GetNumChunkAllocations(), warmChunkAllocations);
+    // Arena jobs never go through the pooled allocator
+    EXPECT_EQ(JobAllocator::GetNumSlabAllocations(), warmSlabAllocations);
+    JobSystem::DestroyJobSystem(jobSystem);
+}
@@ -4,6 +4,10 @@
 #include <functional>
 #include <future>
 #include "Engine/JobSystem.h"
+#include "Engine/Parallel.h"
+#include "Engine/Task.h"
+#include "Engine/WorkerBalancer.h"
+#include "HeapAllocationCounter.h"
 
 class JobSystemTest : public ::testing::Test {
 protected:
@@ -24,11 +28,692 @@ TEST_F(JobSystemTest, JobExecution) {
     bool executed = false;
     auto job = std::make_unique<Job>([&executed]() { executed = true; });
     jobSystem->SubmitJob(job);
-    // Assuming there's a way to ensure the job has been executed, like a flush or sync method in JobSystem
-    // jobSystem->FlushJobs();
+    jobSystem->FlushJobs();
     EXPECT_TRUE(executed);
 }
 
+TEST_F(JobSystemTest, ManyJobsExecuteOnce) {
+    const int jobCount = 10000;
+    std::vector<std::atomic<int>> runs(jobCount);
+    for (int i = 0; i < jobCount; i++)
+    {
+        auto job = std::make_unique<Job>([&runs, i]() { runs[i]++; });
+        jobSystem->SubmitJob(job);
+    }
+    jobSystem->FlushJobs();
+    for (int i = 0; i < jobCount; i++)
+    {
+        EXPECT_EQ(runs[i].load(), 1);
+    }
+}
+
+TEST_F(JobSystemTest, NestedJobsAreStolen) {
+    // Jobs submitted from a worker go to its own deque, the other workers have to steal them
+    std::atomic<int> counter = 0;
+    for (int i = 0; i < 16; i++)
+    {
+        auto job = std::make_unique<Job>([this, &counter]() {
+            for (int j = 0; j < 256; j++)
+            {
+                auto child = std::make_unique<Job>([&counter]() { counter++; });
+                jobSystem->SubmitJob(child);
+            }
+        });
+        jobSystem->SubmitJob(job);
+    }
+    jobSystem->FlushJobs();
+    EXPECT_EQ(counter.load(), 16 * 256);
+}
+
+TEST_F(JobSystemTest, DependencyRunsAfterPredecessor) {
+    std::atomic<bool> firstDone = false;
+    bool orderKept = false;
+    auto first = std::make_unique<Job>([&firstDone]() { firstDone = true; });
+    auto second = std::make_unique<Job>([&firstDone, &orderKept]() { orderKept = firstDone.load(); });
+    second->AddDependency(*first);
+
+    JobCounter counter;
+    // Submitting the dependent job first must not let it run early
+    jobSystem->SubmitJob(second, 0, &counter);
+    jobSystem->SubmitJob(first, 0, &counter);
+    jobSystem->WaitForCounter(counter);
+    EXPECT_TRUE(orderKept);
+}
+
+TEST_F(JobSystemTest, FrameGraph) {
+    // physics -> animation (fan out) -> culling (fan out) -> render submit
+    const int batchCount = 8;
+    std::atomic<int> stage = 0;
+    std::atomic<int> animated = 0;
+    std::atomic<int> culled = 0;
+    std::atomic<bool> orderKept = true;
+
+    auto physics = std::make_unique<Job>([&stage]() { stage = 1; });
+    auto renderSubmit = std::make_unique<Job>([&]() {
+        if (stage != 1 || animated != batchCount || culled != batchCount)
+            orderKept = false;
+    });
+    std::vector<UniquePtr<Job>> animation;
+    std::vector<UniquePtr<Job>> culling;
+    for (int i = 0; i < batchCount; i++)
+    {
+        animation.push_back(std::make_unique<Job>([&]() {
+            if (stage != 1)
+                orderKept = false;
+            animated++;
+        }));
+        animation.back()->AddDependency(*physics);
+    }
+    for (int i = 0; i < batchCount; i++)
+    {
+        culling.push_back(std::make_unique<Job>([&]() {
+            if (animated != batchCount)
+                orderKept = false;
+            culled++;
+        }));
+        for (auto &job : animation)
+        {
+            culling.back()->AddDependency(*job);
+        }
+        renderSubmit->AddDependency(*culling.back());
+    }
+
+    JobCounter frame;
+    jobSystem->SubmitJob(renderSubmit, 0, &frame);
+    for (auto &job : culling)
+        jobSystem->SubmitJob(job, 0, &frame);
+    for (auto &job : animation)
+        jobSystem->SubmitJob(job, 0, &frame);
+    jobSystem->SubmitJob(physics, 0, &frame);
+    jobSystem->WaitForCounter(frame);
+
+    EXPECT_EQ(frame.GetValue(), 0);
+    EXPECT_EQ(culled.load(), batchCount);
+    EXPECT_TRUE(orderKept);
+}
+
+TEST_F(JobSystemTest, WaitForCounterHelpsInsideJobs) {
+    // Every worker blocks in WaitForCounter on children, which only finishes if waiting runs jobs
+    std::atomic<int> leaves = 0;
+    JobCounter roots;
+    for (int i = 0; i < 32; i++)
+    {
+        auto root = std::make_unique<Job>([this, &leaves]() {
+            JobCounter children;
+            for (int j = 0; j < 32; j++)
+            {
+                auto child = std::make_unique<Job>([&leaves]() { leaves++; });
+                jobSystem->SubmitJob(child, 0, &children);
+            }
+            jobSystem->WaitForCounter(children);
+        });
+        jobSystem->SubmitJob(root, 0, &roots);
+    }
+    jobSystem->WaitForCounter(roots);
+    EXPECT_EQ(leaves.load(), 32 * 32);
+}
+
+TEST_F(JobSystemTest, SubmitJobsBatch) {
+    std::atomic<int> counter = 0;
+    std::vector<UniquePtr<Job>> jobs;
+    for (int i = 0; i < 1000; i++)
+    {
+        jobs.push_back(std::make_unique<Job>([&counter]() { counter++; }));
+    }
+    JobCounter batch;
+    EXPECT_TRUE(jobSystem->SubmitJobs(jobs, 0, &batch));
+    jobSystem->WaitForCounter(batch);
+    EXPECT_EQ(counter.load(), 1000);
+    EXPECT_FALSE(jobSystem->SubmitJobs(jobs, 100));
+}
+
+TEST_F(JobSystemTest, ParallelForCoversRangeOnce) {
+    const size_t count = 100003;
+    std::vector<std::atomic<int>> visits(count);
+    std::atomic<size_t> largestChunk = 0;
+    ParallelFor(0, count, 1000, [&](size_t begin, size_t end) {
+        size_t chunk = end - begin;
+        size_t largest = largestChunk.load();
+        while (chunk > largest && !largestChunk.compare_exchange_weak(largest, chunk))
+        {
+        }
+        for (size_t i = begin; i < end; i++)
+            visits[i]++;
+    });
+    EXPECT_LE(largestChunk.load(), 1000u);
+    for (size_t i = 0; i < count; i++)
+    {
+        EXPECT_EQ(visits[i].load(), 1);
+    }
+}
+
+TEST_F(JobSystemTest, NestedParallelFor) {
+    std::atomic<int> counter = 0;
+    ParallelFor(0, 16, 1, [&](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; i++)
+        {
+            ParallelFor(0, 1000, 64, [&](size_t innerBegin, size_t innerEnd) {
+                counter += static_cast<int>(innerEnd - innerBegin);
+            });
+        }
+    });
+    EXPECT_EQ(counter.load(), 16 * 1000);
+}
+
+TEST_F(JobSystemTest, ParallelReduceSum) {
+    std::vector<uint64_t> values(1 << 20);
+    for (size_t i = 0; i < values.size(); i++)
+        values[i] = i;
+    uint64_t sum = ParallelReduce(
+        0, values.size(), 4096, uint64_t(0),
+        [&](size_t begin, size_t end) {
+            uint64_t partial = 0;
+            for (size_t i = begin; i < end; i++)
+                partial += values[i];
+            return partial;
+        },
+        [](uint64_t a, uint64_t b) { return a + b; });
+    EXPECT_EQ(sum, uint64_t(values.size()) * (values.size() - 1) / 2);
+}
+
+TEST(ParallelTest, RunsInlineWithoutJobSystem) {
+    ASSERT_EQ(JobSystem::GetInstance(), nullptr);
+    int calls = 0;
+    ParallelFor(0, 100, 10, [&](size_t begin, size_t end) {
+        calls++;
+        EXPECT_EQ(begin, 0u);
+        EXPECT_EQ(end, 100u);
+    });
+    EXPECT_EQ(calls, 1);
+    int sum = ParallelReduce(0, 10, 1, 0, [](size_t begin, size_t end) { return int(end - begin); }, [](int a, int b) { return a + b; });
+    EXPECT_EQ(sum, 10);
+}
+
+TEST(MPMCQueueTest, ConcurrentProducersAndConsumers) {
+    MPMCQueue<uint32_t> queue(64);
+    const uint32_t producerCount = 4;
+    const uint32_t itemsPerProducer = 20000;
+    std::atomic<uint64_t> sum = 0;
+    std::atomic<uint32_t> popped = 0;
+    std::vector<std::thread> threads;
+    for (uint32_t p = 0; p < producerCount; p++)
+    {
+        threads.emplace_back([&queue, p]() {
+            for (uint32_t i = 0; i < itemsPerProducer; i += 4)
+            {
+                uint32_t items[4] = {i, i + 1, i + 2, i + 3};
+                // Mix single and batched pushes on the same queue
+                if (p % 2 == 0)
+                {
+                    while (!queue.TryPushBatch(items, 4))
+                        std::this_thread::yield();
+                }
+                else
+                {
+                    for (uint32_t item : items)
+                        while (!queue.TryPush(item))
+                            std::this_thread::yield();
+                }
+            }
+        });
+    }
+    for (uint32_t c = 0; c < 2; c++)
+    {
+        threads.emplace_back([&]() {
+            uint32_t item = 0;
+            while (popped.load() < producerCount * itemsPerProducer)
+            {
+                if (queue.TryPop(item))
+                {
+                    sum += item;
+                    popped++;
+                }
+                else
+                {
+                    std::this_thread::yield();
+                }
+            }
+        });
+    }
+    for (auto &thread : threads)
+        thread.join();
+
+    uint64_t expected = uint64_t(producerCount) * (uint64_t(itemsPerProducer) * (itemsPerProducer - 1) / 2);
+    EXPECT_EQ(sum.load(), expected);
+    EXPECT_TRUE(queue.IsEmpty());
+}
+
+TEST(JobPipeLineTest, BorrowAndReturnWorker) {
+    JobPipeLine lender(2);
+    JobPipeLine borrower(1, 4);
+    EXPECT_TRUE(lender.BorrowWorker(&borrower));
+    EXPECT_EQ(lender.GetWorkerCount(), 1u);
+    EXPECT_EQ(borrower.GetWorkerCount(), 2u);
+
+    std::atomic<int> counter = 0;
+    for (int i = 0; i < 1000; i++)
+    {
+        auto job = std::make_unique<Job>([&counter]() { counter++; });
+        borrower.PushJob(job);
+    }
+    borrower.WaitIdle();
+    EXPECT_EQ(counter.load(), 1000);
+
+    EXPECT_TRUE(lender.CallReturnWorker(&borrower));
+    EXPECT_EQ(lender.GetWorkerCount(), 2u);
+    EXPECT_EQ(borrower.GetWorkerCount(), 1u);
+}
+
+TEST(JobPipeLineTest, BusyWorkerIsNotWaitedFor) {
+    JobPipeLine lender(1);
+    JobPipeLine borrower(1, 4);
+    std::atomic<bool> started = false;
+    std::atomic<bool> release = false;
+    auto blocker = std::make_unique<Job>([&started, &release]()
+                                         {
+        started = true;
+        while (!release.load())
+        {
+            std::this_thread::yield();
+        } });
+    lender.PushJob(blocker);
+    while (!started.load())
+    {
+        std::this_thread::yield();
+    }
+
+    // The only worker is stuck in a job, moving it gives up instead of blocking
+    EXPECT_FALSE(lender.BorrowWorker(&borrower));
+    EXPECT_EQ(lender.GetWorkerCount(), 1u);
+    EXPECT_EQ(borrower.GetWorkerCount(), 1u);
+
+    release = true;
+    lender.WaitIdle();
+    EXPECT_TRUE(lender.BorrowWorker(&borrower));
+    EXPECT_EQ(borrower.GetWorkerCount(), 2u);
+    EXPECT_TRUE(lender.CallReturnWorker(&borrower));
+    EXPECT_EQ(lender.GetWorkerCount(), 1u);
+}
+
+TEST(JobPipeLineTest, ParkedWorkersWakeForEachJob) {
+    JobPipeLine pipeLine(2);
+    WorkerIdlePolicy policy;
+    policy.mSpinMicroseconds = 0;
+    policy.mYieldMicroseconds = 0;
+    pipeLine.SetIdlePolicy(policy);
+    EXPECT_EQ(pipeLine.GetIdlePolicy().mSpinMicroseconds, 0u);
+
+    std::atomic<int> counter = 0;
+    for (int round = 0; round < 20; round++)
+    {
+        // Let the workers park, then a single job has to wake one of them
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        auto job = std::make_unique<Job>([&counter]() { counter++; });
+        pipeLine.PushJob(job);
+        while (counter.load() != round + 1)
+        {
+            std::this_thread::yield();
+        }
+    }
+    EXPECT_EQ(counter.load(), 20);
+}
+
+TEST(JobPipeLineTest, MoveWorkerKeepsThread) {
+    JobPipeLine from(2);
+    JobPipeLine to(1, 4);
+    UniquePtr<Worker> worker;
+    ASSERT_TRUE(from.TransferOutWorker(worker));
+    std::thread::id threadID = worker->GetThreadID();
+    Worker *raw = worker.get();
+    ASSERT_TRUE(to.TransferInWorker(worker));
+    EXPECT_EQ(raw->GetThreadID(), threadID);
+    EXPECT_EQ(from.GetWorkerCount(), 1u);
+    EXPECT_EQ(to.GetWorkerCount(), 2u);
+
+    std::atomic<int> counter = 0;
+    for (int i = 0; i < 1000; i++)
+    {
+        auto job = std::make_unique<Job>([&counter]() { counter++; });
+        to.PushJob(job);
+    }
+    to.WaitIdle();
+    EXPECT_EQ(counter.load(), 1000);
+}
+
+TEST(WorkerBalancerTest, MovesWorkerToPressuredPipeLine) {
+    JobPipeLine busy(1, 4);
+    JobPipeLine idle(2);
+    idle.SetWorkerQuota(1, 2);
+    std::vector<JobPipeLine *> pipeLines = {&busy, &idle};
+    WorkerBalancer balancer;
+    EXPECT_FALSE(balancer.Rebalance(pipeLines));
+
+    // The only worker of busy is stuck, so its queue doesn't drain at all
+    std::atomic<bool> release = false;
+    std::atomic<int> counter = 0;
+    auto blocker = std::make_unique<Job>([&release]()
+                                         {
+        while (!release.load())
+        {
+            std::this_thread::yield();
+        } });
+    busy.PushJob(blocker);
+    for (int i = 0; i < 100; i++)
+    {
+        auto job = std::make_unique<Job>([&counter]() { counter++; });
+        busy.PushJob(job);
+    }
+    while (busy.GetQueuedJobCount() == 101)
+    {
+        std::this_thread::yield();
+    }
+
+    EXPECT_TRUE(balancer.Rebalance(pipeLines));
+    EXPECT_EQ(busy.GetWorkerCount(), 2u);
+    EXPECT_EQ(idle.GetWorkerCount(), 1u);
+    // idle is at its minimum now
+    EXPECT_FALSE(balancer.Rebalance(pipeLines));
+    EXPECT_EQ(idle.GetWorkerCount(), 1u);
+
+    while (counter.load() != 100)
+    {
+        std::this_thread::yield();
+    }
+    release = true;
+    busy.WaitIdle();
+}
+
+TEST_F(JobSystemTest, BackgroundWorkerBalancer) {
+    WorkerBalancePolicy policy;
+    policy.mIntervalMilliseconds = 1;
+    jobSystem->StartWorkerBalancer(policy);
+    EXPECT_TRUE(jobSystem->SetWorkerQuota(1, 1));
+    EXPECT_FALSE(jobSystem->SetWorkerQuota(1, 1, UINT_MAX));
+
+    std::atomic<int> counter = 0;
+    for (int i = 0; i < 10000; i++)
+    {
+        auto job = std::make_unique<Job>([&counter]() { counter++; });
+        jobSystem->SubmitJob(job);
+    }
+    jobSystem->FlushJobs();
+    jobSystem->StopWorkerBalancer();
+    EXPECT_EQ(counter.load(), 10000);
+}
+
+TEST(JobPipeLineTest, CancelledJobsAreDropped) {
+    JobPipeLine pipeLine(1);
+    std::atomic<bool> release = false;
+    auto blocker = std::make_unique<Job>([&release]()
+                                         {
+        while (!release.load())
+        {
+            std::this_thread::yield();
+        } });
+    pipeLine.PushJob(blocker);
+
+    CancellationToken token;
+    JobCounter counter;
+    std::atomic<int> executed = 0;
+    std::atomic<bool> continuationRan = false;
+    std::vector<UniquePtr<Job>> jobs;
+    for (int i = 0; i < 100; i++)
+    {
+        jobs.push_back(std::make_unique<Job>([&executed]() { executed++; }));
+        jobs.back()->SetCancellationToken(&token);
+    }
+    // A continuation without the token still runs once its cancelled predecessor is dropped
+    auto continuation = std::make_unique<Job>([&continuationRan]() { continuationRan = true; });
+    continuation->AddDependency(*jobs[0]);
+    pipeLine.PushJobs(jobs, &counter);
+    pipeLine.PushJob(continuation);
+    token.Cancel();
+    release = true;
+    pipeLine.WaitIdle();
+
+    EXPECT_EQ(executed.load(), 0);
+    EXPECT_EQ(counter.GetValue(), 0);
+    EXPECT_EQ(token.GetNumCancelledJobs(), 100u);
+    EXPECT_EQ(pipeLine.GetCancelledJobCount(), 100u);
+    EXPECT_TRUE(continuationRan.load());
+
+    token.Reset();
+    auto job = std::make_unique<Job>([&executed]() { executed++; });
+    job->SetCancellationToken(&token);
+    pipeLine.PushJob(job);
+    pipeLine.WaitIdle();
+    EXPECT_EQ(executed.load(), 1);
+}
+
+TEST(JobPipeLineTest, ExpiredJobsAreSkipped) {
+    JobPipeLine pipeLine(1);
+    std::atomic<int> executed = 0;
+    auto expired = std::make_unique<Job>([&executed]() { executed++; });
+    expired->SetDeadline(std::chrono::steady_clock::now() - std::chrono::milliseconds(1));
+    auto inTime = std::make_unique<Job>([&executed]() { executed += 10; });
+    inTime->SetTimeout(std::chrono::seconds(60));
+    pipeLine.PushJob(expired);
+    pipeLine.PushJob(inTime);
+    pipeLine.WaitIdle();
+    EXPECT_EQ(executed.load(), 10);
+    EXPECT_EQ(pipeLine.GetExpiredJobCount(), 1u);
+    EXPECT_EQ(pipeLine.GetCancelledJobCount(), 0u);
+}
+
+#if JOB_SYSTEM_STATS
+TEST(JobPipeLineTest, StatsCountWorkAndIdleTime) {
+    JobPipeLine pipeLine(2);
+    std::atomic<int> counter = 0;
+    // Spawned children land in the spawning worker's deque, the other one has to steal them
+    auto parent = std::make_unique<Job>([&pipeLine, &counter]()
+                                        {
+        for (int i = 0; i < 256; i++)
+        {
+            auto child = std::make_unique<Job>([&counter]() { counter++; });
+            pipeLine.PushJob(child);
+        } });
+    pipeLine.PushJob(parent);
+    while (counter.load() != 256)
+    {
+        std::this_thread::yield();
+    }
+    pipeLine.WaitIdle();
+    std::this_thread::sleep_for(std::chrono::milliseconds(5));
+
+    JobPipeLineStats stats = pipeLine.GetStats();
+    ASSERT_EQ(stats.mWorkers.size(), 2u);
+    JobWorkerStats total;
+    for (const JobWorkerStats &worker : stats.mWorkers)
+    {
+        total.mJobsRun += worker.mJobsRun;
+        total.mIdleNanoseconds += worker.mIdleNanoseconds;
+        total.mStealAttempts += worker.mStealAttempts;
+        total.mSteals += worker.mSteals;
+        total.mQueueHighWater = std::max(total.mQueueHighWater, worker.mQueueHighWater);
+        EXPECT_LE(worker.mSteals, worker.mStealAttempts);
+    }
+    EXPECT_LE(total.mJobsRun, 257u);
+    EXPECT_GT(total.mJobsRun, 0u);
+    EXPECT_GT(total.mIdleNanoseconds, 0u);
+    EXPECT_GT(total.mStealAttempts, 0u);
+    EXPECT_GE(total.mQueueHighWater, 1u);
+    EXPECT_GE(stats.mInjectedHighWater, 1u);
+    EXPECT_EQ(stats.mQueuedJobs, 0u);
+}
+#endif
+
+// Root jobs spawning children plus a small dependency chain, returns the order jobs ran in
+inline std::vector<int> RunReplayWorkload(JobSystem *jobSystem)
+{
+    std::mutex mutex;
+    std::vector<int> order;
+    auto log = [&mutex, &order](int label)
+    {
+        std::lock_guard<std::mutex> guard(mutex);
+        order.push_back(label);
+    };
+    JobCounter counter;
+    for (int root = 0; root < 8; root++)
+    {
+        auto job = std::make_unique<Job>([jobSystem, &log, &counter, root]()
+                                         {
+            log(root * 10);
+            for (int child = 1; child <= 4; child++)
+            {
+                auto childJob = std::make_unique<Job>([&log, root, child]() { log(root * 10 + child); });
+                jobSystem->SubmitJob(childJob, 0, &counter);
+            } });
+        jobSystem->SubmitJob(job, 0, &counter);
+    }
+    auto first = std::make_unique<Job>([&log]() { log(100); });
+    auto second = std::make_unique<Job>([&log]() { log(101); });
+    second->AddDependency(*first);
+    jobSystem->SubmitJob(second, 0, &counter);
+    jobSystem->SubmitJob(first, 0, &counter);
+    jobSystem->WaitForCounter(counter);
+    return order;
+}
+
+TEST_F(JobSystemTest, SerialExecutionIsReproducible) {
+    jobSystem->SetSerialExecution(true, 42);
+    jobSystem->StartRecording();
+    std::vector<int> first = RunReplayWorkload(jobSystem);
+    JobTrace trace = jobSystem->StopRecording();
+    ASSERT_EQ(first.size(), 42u);
+    EXPECT_EQ(trace.mJobs.size(), 42u);
+    EXPECT_EQ(trace.mExecutionOrder.size(), 42u);
+    ASSERT_EQ(trace.mDependencies.size(), 1u);
+
+    jobSystem->SetSerialExecution(true, 42);
+    EXPECT_EQ(RunReplayWorkload(jobSystem), first);
+
+    // Another seed runs the same jobs in another order, still respecting the dependency
+    jobSystem->SetSerialExecution(true, 7);
+    std::vector<int> other = RunReplayWorkload(jobSystem);
+    EXPECT_NE(other, first);
+    EXPECT_LT(std::find(other.begin(), other.end(), 100), std::find(other.begin(), other.end(), 101));
+    std::sort(other.begin(), other.end());
+    std::sort(first.begin(), first.end());
+    EXPECT_EQ(other, first);
+    jobSystem->SetSerialExecution(false);
+}
+
+TEST_F(JobSystemTest, ReplayReproducesParallelRun) {
+    jobSystem->StartRecording();
+    std::vector<int> parallel = RunReplayWorkload(jobSystem);
+    JobTrace trace = jobSystem->StopRecording();
+    ASSERT_EQ(trace.mExecutionOrder.size(), parallel.size());
+
+    jobSystem->ReplayTrace(trace);
+    jobSystem->StartRecording();
+    std::vector<int> replayed = RunReplayWorkload(jobSystem);
+    JobTrace replayTrace = jobSystem->StopRecording();
+    EXPECT_EQ(replayTrace.mExecutionOrder, trace.mExecutionOrder);
+
+    // Workers may log in another order than they started in, the replay always logs the same
+    jobSystem->ReplayTrace(trace);
+    EXPECT_EQ(RunReplayWorkload(jobSystem), replayed);
+    jobSystem->SetSerialExecution(false);
+    std::sort(replayed.begin(), replayed.end());
+    std::sort(parallel.begin(), parallel.end());
+    EXPECT_EQ(replayed, parallel);
+}
+
+// Runs jobs of the given priorities on a single blocked worker, then returns the order they ran in
+inline std::vector<uint8_t> RunPrioritizedJobs(const JobSchedulePolicy &policy, const std::vector<uint8_t> &priorities)
+{
+    JobPipeLine pipeLine(1);
+    pipeLine.SetSchedulePolicy(policy);
+    std::atomic<bool> released = false;
+    auto gate = std::make_unique<Job>([&released]() {
+        while (!released.load())
+            std::this_thread::yield();
+    });
+    pipeLine.PushJob(gate);
+
+    std::mutex mutex;
+    std::vector<uint8_t> order;
+    for (uint8_t priority : priorities)
+    {
+        auto job = std::make_unique<Job>([&, priority]() {
+            std::lock_guard<std::mutex> guard(mutex);
+            order.push_back(priority);
+        }, UINT_MAX, priority);
+        pipeLine.PushJob(job);
+    }
+    released.store(true);
+    // Not WaitIdle, a helping main thread would run jobs out of order
+    for (;;)
+    {
+        {
+            std::lock_guard<std::mutex> guard(mutex);
+            if (order.size() == priorities.size())
+                break;
+        }
+        std::this_thread::yield();
+    }
+    pipeLine.WaitIdle();
+    return order;
+}
+
+TEST(JobPipeLineTest, HigherPriorityLevelsRunFirst) {
+    std::vector<uint8_t> priorities(50, JOB_PRIORITY_LOW);
+    priorities.insert(priorities.end(), 50, JOB_PRIORITY_CRITICAL);
+    priorities.insert(priorities.end(), 50, JOB_PRIORITY_NORMAL);
+    JobSchedulePolicy policy;
+    policy.mAgingInterval = 0;
+    std::vector<uint8_t> order = RunPrioritizedJobs(policy, priorities);
+    ASSERT_EQ(order.size(), priorities.size());
+    EXPECT_TRUE(std::is_sorted(order.begin(), order.end(), std::greater<uint8_t>()));
+}
+
+TEST(JobPipeLineTest, AgingServesLowerLevels) {
+    std::vector<uint8_t> priorities(50, JOB_PRIORITY_LOW);
+    priorities.insert(priorities.end(), 50, JOB_PRIORITY_CRITICAL);
+    JobSchedulePolicy policy;
+    policy.mAgingInterval = 4;
+    std::vector<uint8_t> order = RunPrioritizedJobs(policy, priorities);
+    ASSERT_EQ(order.size(), priorities.size());
+    EXPECT_GE(std::count(order.begin(), order.begin() + 40, JOB_PRIORITY_LOW), 5);
+}
+
+TEST(JobPipeLineTest, LevelOrderForSpawnedJobs) {
+    for (ScheduleStrategy strategy : {ScheduleStrategy::FIFO, ScheduleStrategy::LIFO})
+    {
+        JobPipeLine pipeLine(1);
+        pipeLine.SortJobs(strategy);
+        EXPECT_EQ(pipeLine.GetSchedulePolicy().mLevelOrder[0], strategy);
+        std::mutex mutex;
+        std::vector<int> order;
+        auto parent = std::make_unique<Job>([&]() {
+            for (int i = 0; i < 10; i++)
+            {
+                auto child = std::make_unique<Job>([&, i]() {
+                    std::lock_guard<std::mutex> guard(mutex);
+                    order.push_back(i);
+                });
+                pipeLine.PushJob(child);
+            }
+        });
+        pipeLine.PushJob(parent);
+        // Helping from this thread would steal children from the wrong end
+        for (;;)
+        {
+            {
+                std::lock_guard<std::mutex> guard(mutex);
+                if (order.size() == 10)
+                    break;
+            }
+            std::this_thread::yield();
+        }
+        pipeLine.WaitIdle();
+        if (strategy == ScheduleStrategy::FIFO)
+            EXPECT_TRUE(std::is_sorted(order.begin(), order.end()));
+        else
+            EXPECT_TRUE(std::is_sorted(order.begin(), order.end(), std::greater<int>()));
+    }
+}
+
 TEST_F(JobSystemTest, JobPriority) {
     auto jobHighPriority = std::make_unique<Job>([]() {}, 0, 10); // Higher priority
     auto jobLowPriority = std::make_unique<Job>([]() {}, 0, 1); // Lower priority
@@ -45,3 +730,171 @@ TEST_F(JobSystemTest, JobIsFinished) {
 int AddNumber(int a, int b)
 { return a + b; }
 
+TEST_F(JobSystemTest, BindOperationReturnsFuture) {
+    auto job = std::make_unique<Job>(nullptr);
+    std::future<int> result = job->BindOperation(AddNumber, 1, 2);
+    jobSystem->SubmitJob(job);
+    EXPECT_EQ(result.get(), 3);
+}
+
+TEST(JobFunctionTest, StoresSmallCallablesInline) {
+    struct Payload
+    {
+        uint64_t values[6];
+    };
+    Payload payload = {{1, 2, 3, 4, 5, 6}};
+    uint64_t sum = 0;
+    auto small = [payload, &sum]() { for (uint64_t value : payload.values) sum += value; };
+    EXPECT_TRUE(JobFunction::IsStoredInline<decltype(small)>());
+
+    uint64_t before = GetHeapAllocationCount();
+    JobFunction function(small);
+    JobFunction moved(std::move(function));
+    moved();
+    EXPECT_EQ(GetHeapAllocationCount(), before);
+    EXPECT_FALSE(function);
+    EXPECT_EQ(sum, 21u);
+
+    struct Large
+    {
+        uint64_t values[16];
+    };
+    Large large = {};
+    JobFunction boxed([large, &sum]() { sum += large.values[0] + 1; });
+    boxed();
+    EXPECT_EQ(sum, 22u);
+}
+
+TEST(JobFunctionTest, AcceptsMoveOnlyCallables) {
+    auto value = std::make_unique<int>(7);
+    int result = 0;
+    JobFunction function([value = std::move(value), &result]() { result = *value; });
+    function();
+    EXPECT_EQ(result, 7);
+    EXPECT_FALSE(JobFunction(std::function<void()>()));
+}
+
+TEST_F(JobSystemTest, FireAndForgetJobsDoNotAllocate) {
+    // Captures bigger than std::function's small buffer, as typical job lambdas are
+    std::atomic<uint64_t> sum = 0;
+    auto submit = [this, &sum](uint32_t jobCount) {
+        JobCounter counter;
+        for (uint32_t i = 0; i < jobCount; i++)
+        {
+            uint64_t a = i, b = i + 1, c = i + 2, d = i + 3;
+            auto job = std::make_unique<Job>([&sum, a, b, c, d]() { sum.fetch_add(a + b + c + d, std::memory_order_relaxed); });
+            jobSystem->SubmitJob(job, 0, &counter);
+        }
+        jobSystem->WaitForCounter(counter);
+    };
+
+    // Warm up the job pool and the worker deques
+    submit(20000);
+    submit(20000);
+
+    uint64_t slabsBefore = JobAllocator::GetNumSlabAllocations();
+    uint64_t allocationsBefore = GetHeapAllocationCount();
+    submit(10000);
+    EXPECT_EQ(GetHeapAllocationCount() - allocationsBefore, 0u);
+    EXPECT_EQ(JobAllocator::GetNumSlabAllocations(), slabsBefore);
+}
+
+
+Task<int> AddNumberAsync(int a, int b)
+{
+    co_await ScheduleOn();
+    co_return a + b;
+}
+
+Task<int> SumChunksAsync(uint32_t chunkCount, std::atomic<int> &visited)
+{
+    std::vector<UniquePtr<Job>> jobs;
+    for (uint32_t i = 0; i < chunkCount; i++)
+    {
+        jobs.push_back(std::make_unique<Job>([&visited]() { visited++; }));
+    }
+    co_await RunJobs(jobs);
+    int first = co_await AddNumberAsync(1, 2);
+    int second = co_await AddNumberAsync(first, 4);
+    co_return second;
+}
+
+Task<void> ThrowAsync()
+{
+    co_await ScheduleOn();
+    throw std::runtime_error("task failed");
+}
+
+TEST(TaskTest, RunsInlineWithoutJobSystem) {
+    ASSERT_EQ(JobSystem::GetInstance(), nullptr);
+    std::atomic<int> visited = 0;
+    EXPECT_EQ(SyncWait(SumChunksAsync(8, visited)), 7);
+    EXPECT_EQ(visited.load(), 8);
+}
+
+TEST_F(JobSystemTest, TaskChainsResumeOnJobs) {
+    std::atomic<int> visited = 0;
+    EXPECT_EQ(SyncWait(SumChunksAsync(64, visited)), 7);
+    EXPECT_EQ(visited.load(), 64);
+}
+
+TEST_F(JobSystemTest, ManyTasksInFlight) {
+    std::atomic<int> visited = 0;
+    std::vector<Task<int>> tasks;
+    for (int i = 0; i < 100; i++)
+    {
+        tasks.push_back(SumChunksAsync(4, visited));
+    }
+    SyncWaitAll<int>(tasks);
+    int total = 0;
+    for (Task<int> &task : tasks)
+    {
+        EXPECT_TRUE(task.IsDone());
+        total += task.TakeResult();
+    }
+    EXPECT_EQ(visited.load(), 400);
+    EXPECT_EQ(total, 700);
+}
+
+TEST_F(JobSystemTest, TaskOnFileIOPipeLine) {
+    uint32_t fileIOPipeLine = jobSystem->CreateNewPipeLine();
+    auto read = [](uint32_t pipeLineID) -> Task<std::string> {
+        co_await ScheduleOn(pipeLineID);
+        std::string data = "file contents";
+        co_await ScheduleOn();
+        co_return data + " decoded";
+    };
+    EXPECT_EQ(SyncWait(read(fileIOPipeLine)), "file contents decoded");
+}
+
+TEST_F(JobSystemTest, DestroyPipeLineWhileSubmitting) {
+    uint32_t pipeLineID = jobSystem->CreateNewPipeLine();
+    if (pipeLineID == UINT_MAX)
+    {
+        GTEST_SKIP() << "No worker left for a second pipeline";
+    }
+    std::atomic<int> executed = 0;
+    std::atomic<int> submitted = 0;
+    // Keeps submitting until the pipeline is gone, some of the submits race the destroy
+    std::thread submitter([&]() {
+        while (true)
+        {
+            UniquePtr<Job> job = std::make_unique<Job>([&executed]() { executed++; });
+            if (!jobSystem->SubmitJob(job, pipeLineID))
+                break;
+            submitted++;
+        }
+    });
+    while (submitted.load() < 100)
+    {
+        std::this_thread::yield();
+    }
+    EXPECT_TRUE(jobSystem->DestroyPipeLine(pipeLineID));
+    submitter.join();
+    // Destroying drains the pipeline, every accepted job has run
+    EXPECT_EQ(executed.load(), submitted.load());
+}
+
+TEST_F(JobSystemTest, TaskPropagatesExceptions) {
+    EXPECT_THROW(SyncWait(ThrowAsync()), std::runtime_error);
+}
@@ -1,5 +1,20 @@
 #include <gtest/gtest.h>
-// #include "TestJobSystem.h"
+#include "TestJobSystem.h"
+#include "BenchmarkJobSystem.h"
+#include "TestCpuTopology.h"
+#include "TestFrameJobArena.h"
+#include "TestTimerWheel.h"
+#include "TestAsyncFileService.h"
+#include "TestAssetRegistry.h"
+#include "TestAssetLoader.h"
+#include "TestCookedMesh.h"
+#include "TestPixelFormat.h"
+#include "TestTextureCompressor.h"
+#include "TestMipGenerator.h"
+#include "TestCookedTexture.h"
+#include "TestDerivedDataCache.h"
+#include "BenchmarkTextureCompressor.h"
+#include "BenchmarkModelLoader.h"
 // #include "TestWindow.h"
 #include "TestJsonParser.h"
 
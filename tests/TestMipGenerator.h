@@ -0,0 +1,129 @@
+#pragma once
+#include <gtest/gtest.h>
+#include "Engine/MipGenerator.h"
+#include "Engine/TextureCompressor.h"
+
+inline Image MakeSolidMipTestImage(uint32_t width, uint32_t height, PixelFormat format, const uint8_t *texel, bool isSRGB)
+{
+    Image image;
+    image.mWidth = width;
+    image.mHeight = height;
+    image.mFormat = format;
+    image.mIsSRGB = isSRGB;
+    const uint32_t bytesPerPixel = GetPixelFormatInfo(format).mBytesPerBlock;
+    for (uint32_t i = 0; i < width * height; i++)
+    {
+        image.mData.insert(image.mData.end(), texel, texel + bytesPerPixel);
+    }
+    return image;
+}
+
+TEST(MipGeneratorTest, ChainLayout) {
+    EXPECT_EQ(GetMaxMipLevels(1, 1), 1u);
+    EXPECT_EQ(GetMaxMipLevels(256, 256), 9u);
+    // 300, 150, 75, 37, 18, 9, 4, 2, 1
+    EXPECT_EQ(GetMaxMipLevels(300, 17), 9u);
+    EXPECT_EQ(GetMipSize(17, 5), 1u);
+    EXPECT_EQ(GetImageDataSize(PixelFormat::RGBA8, 4, 4, 3), 64u + 16u + 4u);
+    // Every level of a compressed format is at least one block
+    EXPECT_EQ(GetImageDataSize(PixelFormat::BC1, 8, 8, 4), 4u * 8u + 8u + 8u + 8u);
+
+    const uint8_t grey = 90;
+    Image image = MakeSolidMipTestImage(37, 23, PixelFormat::R8, &grey, false);
+    Image mips;
+    ASSERT_TRUE(GenerateMips(image, {MipFilter::BOX, 3}, mips));
+    EXPECT_EQ(mips.mMipLevels, 3u);
+    EXPECT_EQ(mips.mData.size(), 37u * 23u + 18u * 11u + 9u * 5u);
+    EXPECT_EQ(GetMipData(mips, 2).size(), 9u * 5u);
+    EXPECT_EQ(GetMipData(mips, 2).data(), mips.mData.data() + 37 * 23 + 18 * 11);
+    ASSERT_TRUE(GenerateMips(image, {}, mips));
+    EXPECT_EQ(mips.mMipLevels, 6u);
+}
+
+TEST(MipGeneratorTest, AveragesColorInLinearLight) {
+    // Black and white texels with alpha 0 and 255
+    Image checker;
+    checker.mWidth = 2;
+    checker.mHeight = 2;
+    checker.mFormat = PixelFormat::RGBA8;
+    checker.mData = {0, 0, 0, 0, 255, 255, 255, 255, 255, 255, 255, 255, 0, 0, 0, 0};
+    Image linear, srgb;
+    ASSERT_TRUE(GenerateMips(checker, {MipFilter::BOX}, linear));
+    checker.mIsSRGB = true;
+    ASSERT_TRUE(GenerateMips(checker, {MipFilter::BOX}, srgb));
+    ASSERT_EQ(linear.mMipLevels, 2u);
+    ASSERT_EQ(srgb.mMipLevels, 2u);
+    std::span<const uint8_t> plain = GetMipData(linear, 1);
+    std::span<const uint8_t> corrected = GetMipData(srgb, 1);
+    EXPECT_EQ(plain[0], 128);
+    // Half the light is 188 in sRGB, averaging the encoded values would give a darker 128
+    EXPECT_EQ(corrected[0], 188);
+    EXPECT_EQ(corrected[2], 188);
+    // Alpha is linear either way
+    EXPECT_EQ(corrected[3], 128);
+    EXPECT_TRUE(srgb.mIsSRGB);
+    // The top level is left untouched
+    EXPECT_TRUE(std::equal(checker.mData.begin(), checker.mData.end(), srgb.mData.begin()));
+}
+
+TEST(MipGeneratorTest, NonPowerOfTwoSizes) {
+    // Solid images stay solid at every level, whatever the filter and size
+    const uint8_t color[4] = {200, 90, 17, 255};
+    for (MipFilter filter : {MipFilter::BOX, MipFilter::KAISER})
+    {
+        Image image = MakeSolidMipTestImage(37, 23, PixelFormat::RGBA8, color, true);
+        Image mips;
+        ASSERT_TRUE(GenerateMips(image, {filter}, mips));
+        for (uint32_t level = 1; level < mips.mMipLevels; level++)
+        {
+            std::span<const uint8_t> texels = GetMipData(mips, level);
+            for (size_t i = 0; i < texels.size(); i++)
+            {
+                ASSERT_EQ(texels[i], color[i % 4]) << "level " << level;
+            }
+        }
+    }
+
+    // Three texels into one, each weighted by a third
+    Image odd;
+    odd.mWidth = 3;
+    odd.mHeight = 1;
+    odd.mFormat = PixelFormat::RGBA32F;
+    const float values[3] = {0.0f, 0.3f, 0.9f};
+    for (float value : values)
+    {
+        const float texel[4] = {value, value, value, 1.0f};
+        odd.mData.insert(odd.mData.end(), reinterpret_cast<const uint8_t *>(texel), reinterpret_cast<const uint8_t *>(texel + 4));
+    }
+    Image mips;
+    ASSERT_TRUE(GenerateMips(odd, {MipFilter::BOX}, mips));
+    ASSERT_EQ(mips.mMipLevels, 2u);
+    const float *bottom = reinterpret_cast<const float *>(GetMipData(mips, 1).data());
+    EXPECT_NEAR(bottom[0], 0.4f, 1e-6f);
+    EXPECT_NEAR(bottom[3], 1.0f, 1e-6f);
+}
+
+TEST(MipGeneratorTest, ChainsConvertAndCompress) {
+    Image source;
+    source.mWidth = 20;
+    source.mHeight = 12;
+    source.mFormat = PixelFormat::RGBA8;
+    for (uint32_t i = 0; i < 20 * 12; i++)
+    {
+        const uint8_t texel[4] = {static_cast<uint8_t>(i), static_cast<uint8_t>(i * 7), 128, 255};
+        source.mData.insert(source.mData.end(), texel, texel + 4);
+    }
+    Image mips, half, compressed, decompressed;
+    ASSERT_TRUE(GenerateMips(source, {}, mips));
+    ASSERT_EQ(mips.mMipLevels, 5u);
+    ASSERT_TRUE(ConvertImage(mips, PixelFormat::RGBA16F, half));
+    EXPECT_EQ(half.mMipLevels, 5u);
+    EXPECT_EQ(half.mData.size(), GetImageDataSize(PixelFormat::RGBA16F, 20, 12, 5));
+    ASSERT_TRUE(CompressImage(mips, {PixelFormat::BC7, TextureCompressionQuality::FAST}, compressed));
+    EXPECT_EQ(compressed.mData.size(), GetImageDataSize(PixelFormat::BC7, 20, 12, 5));
+    ASSERT_TRUE(DecompressImage(compressed, decompressed));
+    EXPECT_EQ(decompressed.mMipLevels, 5u);
+    EXPECT_EQ(decompressed.mData.size(), mips.mData.size());
+    // Compressed images have to be decompressed first
+    EXPECT_FALSE(GenerateMips(compressed, {}, mips));
+}
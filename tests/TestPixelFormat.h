@@ -0,0 +1,89 @@
+#pragma once
+#include <gtest/gtest.h>
+#include "Engine/PixelFormat.h"
+#include <cmath>
+#include <limits>
+
+TEST(PixelFormatTest, DataSizes) {
+    EXPECT_EQ(GetImageDataSize(PixelFormat::R8, 5, 3), 15u);
+    EXPECT_EQ(GetImageDataSize(PixelFormat::RGBA16F, 5, 3), 120u);
+    // Partial blocks at the edges take a whole block
+    EXPECT_EQ(GetImageDataSize(PixelFormat::BC1, 5, 3), 2u * 1u * 8u);
+    EXPECT_EQ(GetImageDataSize(PixelFormat::BC7, 8, 8), 4u * 16u);
+    EXPECT_EQ(GetImageRowPitch(PixelFormat::BC3, 9), 3u * 16u);
+    EXPECT_TRUE(IsCompressedFormat(PixelFormat::BC5));
+    EXPECT_FALSE(IsCompressedFormat(PixelFormat::RGBA8));
+    // Compressed formats cut an RGBA8 texture by 4-8x, float per channel was another 4x on top
+    EXPECT_EQ(GetImageDataSize(PixelFormat::RGBA8, 1024, 1024) / GetImageDataSize(PixelFormat::BC1, 1024, 1024), 8u);
+}
+
+TEST(PixelFormatTest, HalfConversion) {
+    EXPECT_EQ(FloatToHalf(0.0f), 0x0000);
+    EXPECT_EQ(FloatToHalf(-0.0f), 0x8000);
+    EXPECT_EQ(FloatToHalf(1.0f), 0x3C00);
+    EXPECT_EQ(FloatToHalf(-2.0f), 0xC000);
+    EXPECT_EQ(FloatToHalf(0.5f), 0x3800);
+    EXPECT_EQ(FloatToHalf(65504.0f), 0x7BFF);
+    EXPECT_EQ(FloatToHalf(65520.0f), 0x7C00);
+    EXPECT_EQ(FloatToHalf(std::numeric_limits<float>::infinity()), 0x7C00);
+    EXPECT_EQ(FloatToHalf(std::ldexp(1.0f, -24)), 0x0001);
+    EXPECT_EQ(FloatToHalf(std::ldexp(1.0f, -25)), 0x0000);
+    // Halfway between 1 and the next half rounds to even
+    EXPECT_EQ(FloatToHalf(1.0f + std::ldexp(1.0f, -11)), 0x3C00);
+    EXPECT_EQ(FloatToHalf(1.0f + 3 * std::ldexp(1.0f, -11)), 0x3C02);
+    EXPECT_TRUE(std::isnan(HalfToFloat(FloatToHalf(std::nanf("")))));
+    // Every finite half survives the round trip
+    for (uint32_t half = 0; half < 0x10000; half++)
+    {
+        if ((half & 0x7C00) != 0x7C00)
+        {
+            EXPECT_EQ(FloatToHalf(HalfToFloat(static_cast<uint16_t>(half))), half);
+        }
+    }
+}
+
+TEST(PixelFormatTest, ConvertsBetweenFormats) {
+    Image source;
+    source.mWidth = 7;
+    source.mHeight = 3;
+    source.mFormat = PixelFormat::RGBA8;
+    for (uint32_t i = 0; i < source.mWidth * source.mHeight * 4; i++)
+    {
+        source.mData.push_back(static_cast<uint8_t>(i * 13));
+    }
+
+    // 8-bit values survive a trip through half and full floats exactly
+    Image half, full, back;
+    ASSERT_TRUE(ConvertImage(source, PixelFormat::RGBA16F, half));
+    ASSERT_EQ(half.mData.size(), GetImageDataSize(PixelFormat::RGBA16F, 7, 3));
+    ASSERT_TRUE(ConvertImage(half, PixelFormat::RGBA32F, full));
+    const float *values = reinterpret_cast<const float *>(full.mData.data());
+    EXPECT_NEAR(values[5], source.mData[5] / 255.0f, 1e-3f);
+    ASSERT_TRUE(ConvertImage(full, PixelFormat::RGBA8, back));
+    EXPECT_EQ(back.mData, source.mData);
+
+    // Narrower formats keep the leading channels, wider ones fill in 0 and an opaque alpha
+    Image red, expanded;
+    ASSERT_TRUE(ConvertImage(source, PixelFormat::R8, red));
+    ASSERT_EQ(red.mData.size(), 21u);
+    EXPECT_EQ(red.mData[6], source.mData[24]);
+    ASSERT_TRUE(ConvertImage(red, PixelFormat::RGBA8, expanded));
+    EXPECT_EQ(expanded.mData[24], source.mData[24]);
+    EXPECT_EQ(expanded.mData[25], 0);
+    EXPECT_EQ(expanded.mData[27], 255);
+
+    // Out of range floats clamp, converting in place works
+    float clamped[4] = {-1.0f, 2.0f, std::nanf(""), 0.5f};
+    Image floats;
+    floats.mWidth = 1;
+    floats.mHeight = 1;
+    floats.mFormat = PixelFormat::RGBA32F;
+    floats.mData.resize(sizeof(clamped));
+    std::memcpy(floats.mData.data(), clamped, sizeof(clamped));
+    ASSERT_TRUE(ConvertImage(floats, PixelFormat::RGBA8, floats));
+    EXPECT_EQ(floats.mData, (std::vector<uint8_t>{0, 255, 0, 128}));
+
+    Image compressed;
+    compressed.mFormat = PixelFormat::BC1;
+    EXPECT_FALSE(ConvertImage(compressed, PixelFormat::RGBA8, back));
+}
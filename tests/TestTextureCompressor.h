@@ -0,0 +1,96 @@
+#pragma once
+#include <gtest/gtest.h>
+#include "Engine/TextureCompressor.h"
+
+// Smooth gradients in every channel, with a hard edge through the middle
+inline Image MakeCompressorTestImage(uint32_t width, uint32_t height)
+{
+    Image image;
+    image.mWidth = width;
+    image.mHeight = height;
+    image.mFormat = PixelFormat::RGBA8;
+    image.mData.resize(static_cast<size_t>(width) * height * 4);
+    for (uint32_t y = 0; y < height; y++)
+    {
+        for (uint32_t x = 0; x < width; x++)
+        {
+            uint8_t *texel = image.mData.data() + (static_cast<size_t>(y) * width + x) * 4;
+            texel[0] = static_cast<uint8_t>(x * 255 / std::max(width - 1, 1u));
+            texel[1] = static_cast<uint8_t>(y * 255 / std::max(height - 1, 1u));
+            texel[2] = static_cast<uint8_t>(x < width / 2 ? 40 : 220);
+            texel[3] = static_cast<uint8_t>(255 - (x + y) * 255 / std::max(width + height - 2, 1u));
+        }
+    }
+    return image;
+}
+
+inline double MeasureCompressionPSNR(const Image &source, PixelFormat format, TextureCompressionQuality quality, uint32_t channels)
+{
+    Image compressed, decompressed;
+    EXPECT_TRUE(CompressImage(source, {format, quality}, compressed));
+    EXPECT_EQ(compressed.mData.size(), GetImageDataSize(format, source.mWidth, source.mHeight));
+    EXPECT_TRUE(DecompressImage(compressed, decompressed));
+    return ComputeImagePSNR(source, decompressed, channels);
+}
+
+TEST(TextureCompressorTest, SolidBlocksAreExact) {
+    // Values every format represents exactly: 565 colors, even for BC7's shared p-bit
+    const uint8_t colors[2][4] = {{0, 130, 66, 200}, {222, 130, 0, 200}};
+    Image solid;
+    solid.mWidth = 8;
+    solid.mHeight = 4;
+    solid.mFormat = PixelFormat::RGBA8;
+    for (uint32_t i = 0; i < 32; i++)
+    {
+        // The left and right block each have their own color
+        const uint8_t *color = colors[(i % 8) < 4 ? 0 : 1];
+        solid.mData.insert(solid.mData.end(), color, color + 4);
+    }
+    EXPECT_TRUE(std::isinf(MeasureCompressionPSNR(solid, PixelFormat::BC7, TextureCompressionQuality::NORMAL, 4)));
+    EXPECT_TRUE(std::isinf(MeasureCompressionPSNR(solid, PixelFormat::BC5, TextureCompressionQuality::FAST, 2)));
+    EXPECT_TRUE(std::isinf(MeasureCompressionPSNR(solid, PixelFormat::BC3, TextureCompressionQuality::NORMAL, 4)));
+}
+
+TEST(TextureCompressorTest, QualityOnGradients) {
+    // Not a multiple of the block size, edge blocks repeat the last texels
+    Image source = MakeCompressorTestImage(70, 45);
+    EXPECT_GT(MeasureCompressionPSNR(source, PixelFormat::BC1, TextureCompressionQuality::NORMAL, 3), 32.0);
+    EXPECT_GT(MeasureCompressionPSNR(source, PixelFormat::BC3, TextureCompressionQuality::NORMAL, 4), 32.0);
+    EXPECT_GT(MeasureCompressionPSNR(source, PixelFormat::BC5, TextureCompressionQuality::NORMAL, 2), 40.0);
+    EXPECT_GT(MeasureCompressionPSNR(source, PixelFormat::BC7, TextureCompressionQuality::NORMAL, 4), 38.0);
+    for (PixelFormat format : {PixelFormat::BC1, PixelFormat::BC7})
+    {
+        const uint32_t channels = format == PixelFormat::BC1 ? 3 : 4;
+        double fast = MeasureCompressionPSNR(source, format, TextureCompressionQuality::FAST, channels);
+        double high = MeasureCompressionPSNR(source, format, TextureCompressionQuality::HIGH, channels);
+        EXPECT_GE(high, fast) << GetPixelFormatInfo(format).mName;
+    }
+}
+
+TEST(TextureCompressorTest, WritesValidBlocks) {
+    Image source = MakeCompressorTestImage(16, 16);
+    Image bc7;
+    ASSERT_TRUE(CompressImage(source, {PixelFormat::BC7, TextureCompressionQuality::HIGH}, bc7));
+    for (size_t block = 0; block < bc7.mData.size(); block += 16)
+    {
+        // Mode 6, and the anchor index fits in three bits
+        EXPECT_EQ(bc7.mData[block] & 0x7F, 0x40);
+    }
+    Image bc1;
+    ASSERT_TRUE(CompressImage(source, {PixelFormat::BC1, TextureCompressionQuality::NORMAL}, bc1));
+    for (size_t block = 0; block < bc1.mData.size(); block += 8)
+    {
+        // Four color mode, c0 > c1, or a single color
+        uint16_t c0 = bc1.mData[block] | (bc1.mData[block + 1] << 8);
+        uint16_t c1 = bc1.mData[block + 2] | (bc1.mData[block + 3] << 8);
+        EXPECT_TRUE(c0 > c1 || (c0 == c1 && bc1.mData[block + 4] == 0));
+    }
+
+    // Other uncompressed formats are converted first, compressed ones are rejected
+    Image half, fromHalf;
+    ASSERT_TRUE(ConvertImage(source, PixelFormat::RGBA16F, half));
+    ASSERT_TRUE(CompressImage(half, {PixelFormat::BC7, TextureCompressionQuality::HIGH}, fromHalf));
+    EXPECT_EQ(fromHalf.mData, bc7.mData);
+    EXPECT_FALSE(CompressImage(bc7, {PixelFormat::BC1, TextureCompressionQuality::FAST}, bc1));
+    EXPECT_FALSE(CompressImage(source, {PixelFormat::RGBA8, TextureCompressionQuality::FAST}, bc1));
+}
@@ -0,0 +1,107 @@
+#pragma once
+#include <gtest/gtest.h>
+#include "Engine/TimerWheel.h"
+#include "Engine/JobSystem.h"
+
+inline std::vector<std::pair<uint64_t, int>> AdvanceWheel(TimerWheel<int> &wheel, uint64_t tick)
+{
+    std::vector<std::pair<uint64_t, int>> fired;
+    wheel.Advance(tick, [&wheel, &fired](int payload)
+                  { fired.push_back({wheel.GetCurrentTick(), payload}); });
+    return fired;
+}
+
+TEST(TimerWheelTest, FiresInOrderAcrossLevels) {
+    TimerWheel<int> wheel;
+    // One timer per level, plus some on the boundaries between levels
+    const std::vector<uint64_t> ticks = {3, 255, 256, 257, 1000, 65535, 65536, 70000, 16777216, 20000000};
+    for (size_t i = 0; i < ticks.size(); i++)
+    {
+        wheel.Schedule(ticks[i], 0, static_cast<int>(i));
+    }
+    EXPECT_EQ(wheel.GetNumTimers(), ticks.size());
+
+    std::vector<std::pair<uint64_t, int>> fired = AdvanceWheel(wheel, 20000000);
+    ASSERT_EQ(fired.size(), ticks.size());
+    for (size_t i = 0; i < ticks.size(); i++)
+    {
+        EXPECT_EQ(fired[i].first, ticks[i]);
+        EXPECT_EQ(fired[i].second, static_cast<int>(i));
+    }
+    EXPECT_EQ(wheel.GetNumTimers(), 0u);
+    EXPECT_EQ(wheel.GetNextEventTick(), UINT64_MAX);
+}
+
+TEST(TimerWheelTest, CancelAndReuse) {
+    TimerWheel<int> wheel;
+    TimerHandle first = wheel.Schedule(10, 0, 1);
+    TimerHandle second = wheel.Schedule(10, 0, 2);
+    TimerHandle third = wheel.Schedule(300, 0, 3);
+    EXPECT_EQ(wheel.GetNextEventTick(), 10u);
+    EXPECT_TRUE(wheel.Cancel(second));
+    EXPECT_FALSE(wheel.Cancel(second));
+    EXPECT_TRUE(wheel.Cancel(third));
+
+    // The freed entry is reused, the stale handle must not cancel the new timer
+    TimerHandle reused = wheel.Schedule(20, 0, 4);
+    EXPECT_EQ(reused.mIndex, third.mIndex);
+    EXPECT_FALSE(wheel.Cancel(third));
+
+    std::vector<std::pair<uint64_t, int>> fired = AdvanceWheel(wheel, 100);
+    ASSERT_EQ(fired.size(), 2u);
+    EXPECT_EQ(fired[0].second, 1);
+    EXPECT_EQ(fired[1].second, 4);
+    EXPECT_FALSE(wheel.IsScheduled(first));
+}
+
+TEST(TimerWheelTest, PeriodicTimersSkipMissedPeriods) {
+    TimerWheel<int> wheel;
+    TimerHandle handle = wheel.Schedule(5, 5, 7);
+    size_t runs = 0;
+    for (uint64_t tick = 1; tick <= 20; tick++)
+    {
+        runs += AdvanceWheel(wheel, tick).size();
+    }
+    EXPECT_EQ(runs, 4u);
+    EXPECT_TRUE(wheel.IsScheduled(handle));
+
+    // Advancing far in one go fires once, not once per missed period
+    EXPECT_EQ(AdvanceWheel(wheel, 1000).size(), 1u);
+    std::vector<std::pair<uint64_t, int>> fired = AdvanceWheel(wheel, 1005);
+    ASSERT_EQ(fired.size(), 1u);
+    EXPECT_EQ(fired[0].first, 1005u);
+
+    EXPECT_TRUE(wheel.Cancel(handle));
+    EXPECT_TRUE(AdvanceWheel(wheel, 2000).empty());
+}
+
+TEST(TimerWheelTest, DelayedAndPeriodicJobs) {
+    JobSystem *jobSystem = JobSystem::CreateJobSystem();
+    const auto start = std::chrono::steady_clock::now();
+    std::atomic<int64_t> delayedAfter = -1;
+    jobSystem->SubmitDelayedJob(std::chrono::milliseconds(20), [&delayedAfter, start]()
+                                { delayedAfter = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start).count(); });
+    std::atomic<int> cancelledRuns = 0;
+    TimerHandle cancelled = jobSystem->SubmitDelayedJob(std::chrono::milliseconds(10), [&cancelledRuns]()
+                                                        { cancelledRuns++; });
+    EXPECT_TRUE(jobSystem->CancelTimer(cancelled));
+
+    std::atomic<int> periodicRuns = 0;
+    TimerHandle periodic = jobSystem->SubmitPeriodicJob(std::chrono::milliseconds(2), [&periodicRuns]()
+                                                        { periodicRuns++; });
+    while (delayedAfter.load() < 0 || periodicRuns.load() < 3)
+    {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    EXPECT_GE(delayedAfter.load(), 20);
+    EXPECT_TRUE(jobSystem->CancelTimer(periodic));
+    EXPECT_FALSE(jobSystem->CancelTimer(periodic));
+    // A run the timer thread took out of the wheel just before the cancel may still be submitted
+    std::this_thread::sleep_for(std::chrono::milliseconds(5));
+    jobSystem->FlushJobs();
+    int runs = periodicRuns.load();
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    EXPECT_EQ(periodicRuns.load(), runs);
+    EXPECT_EQ(cancelledRuns.load(), 0);
+    JobSystem::DestroyJobSystem(jobSystem);
+}